@@ -38,7 +38,8 @@ func _enter_tree() -> void:
 	# affecting the runtime singleton
 	if ClassDB.class_exists("Prologot"):
 		editor_engine = ClassDB.instantiate("Prologot")
-		if editor_engine.initialize():
+		# Keep the output of the rules for the dock rather than stdout
+		if editor_engine.initialize({"output buffer": 65536, "output flush": false}):
 			print("Prologot: Editor engine initialized")
 		else:
 			push_error("Prologot: Failed to initialize editor engine")
@@ -59,21 +60,22 @@ func _enter_tree() -> void:
 ## Called when the plugin is disabled/unloaded from the editor.
 ##
 ## Cleans up all plugin resources:
-## 1. Shuts down the editor Prologot engine
-## 2. Removes and frees the dock control
+## 1. Removes and frees the dock control
+## 2. Shuts down the editor Prologot engine
 ## 3. Removes the autoload singleton registration
 ###############################################################################
 func _exit_tree() -> void:
+	# Remove the dock from the editor and free it. The dock is removed first:
+	# it waits for the query it may still be running on a worker thread.
+	if dock:
+		remove_control_from_docks(dock)
+		dock.queue_free()
+
 	# Cleanup the editor engine and free its resources
 	if editor_engine:
 		editor_engine.cleanup()
 		editor_engine = null
 
-	# Remove the dock from the editor and free it
-	if dock:
-		remove_control_from_docks(dock)
-		dock.queue_free()
-
 	# Remove the autoload singleton registration
 	# This prevents the singleton from being available in future editor sessions
 	remove_autoload_singleton("PrologotEngine")
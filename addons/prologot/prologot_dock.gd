@@ -25,6 +25,28 @@ var predicates_list: ItemList
 ## Allows users to write Prolog code directly in the editor and load it.
 var code_input: TextEdit
 
+## Button fetching the next page of solutions of the running query.
+var load_more_btn: Button
+
+## Number of solutions fetched per page by the query runner.
+const PAGE_SIZE := 20
+
+## Query cursor of the last query (0 when no query is open).
+## Its solutions are fetched by pages on a worker thread.
+var cursor := 0
+
+## WorkerThreadPool task fetching a page (-1 when idle).
+var fetch_task := -1
+
+## Number of measured calls of the Benchmark button.
+const BENCHMARK_ITERATIONS := 1000
+
+## Number of calls before the measures of the Benchmark button.
+const BENCHMARK_WARMUP := 100
+
+## WorkerThreadPool task running a benchmark (-1 when idle).
+var benchmark_task := -1
+
 ## Prologot engine instance (set by the plugin).
 ## This is the Prolog engine used for executing queries in the editor dock.
 ## Set by the plugin when the dock is created.
@@ -38,6 +60,21 @@ func _ready() -> void:
 	name = "Prologot Console"
 	_build_ui()
 
+###############################################################################
+## Waits for the page being fetched when the dock leaves the scene tree, so
+## that no task uses the engine once the plugin cleans it up.
+###############################################################################
+func _exit_tree() -> void:
+	if fetch_task != -1:
+		WorkerThreadPool.wait_for_task_completion(fetch_task)
+		fetch_task = -1
+	if benchmark_task != -1:
+		WorkerThreadPool.wait_for_task_completion(benchmark_task)
+		benchmark_task = -1
+	if cursor != 0 and engine:
+		engine.query_close(cursor)
+		cursor = 0
+
 ###############################################################################
 ## Builds the dock UI components.
 ##
@@ -74,8 +111,9 @@ func _build_ui() -> void:
 ## Builds the query input section.
 ##
 ## Creates a horizontal container with a label, text input field for Prolog
-## queries, and an Execute button. Users can submit queries by pressing Enter
-## in the input field or clicking the Execute button.
+## queries, an Execute button and a Benchmark button. Users can submit
+## queries by pressing Enter in the input field or clicking the Execute
+## button.
 ###############################################################################
 func _build_query_section() -> void:
 	var query_container := HBoxContainer.new()
@@ -100,6 +138,14 @@ func _build_query_section() -> void:
 	query_btn.pressed.connect(_on_query_button_pressed)
 	query_container.add_child(query_btn)
 
+	# Benchmark button: measures the cost of the query as a goal
+	var benchmark_btn := Button.new()
+	benchmark_btn.text = "Benchmark"
+	benchmark_btn.tooltip_text = "Call the goal %d times (after %d warm-up calls) and show its cost" % [
+		BENCHMARK_ITERATIONS, BENCHMARK_WARMUP]
+	benchmark_btn.pressed.connect(_on_benchmark_pressed)
+	query_container.add_child(benchmark_btn)
+
 	add_child(query_container)
 
 ###############################################################################
@@ -125,12 +171,20 @@ func _build_result_section() -> void:
 ## Builds the action buttons section.
 ##
 ## Creates a horizontal container with action buttons for common operations:
+## - Load more: Fetches the next solutions of the last query
 ## - Clear: Clears the results display
 ## - Load .pl file: Opens a file dialog to load Prolog files
 ###############################################################################
 func _build_action_buttons() -> void:
 	var actions_container := HBoxContainer.new()
 
+	# Button to fetch the next page of solutions
+	load_more_btn = Button.new()
+	load_more_btn.text = "Load more"
+	load_more_btn.disabled = true
+	load_more_btn.pressed.connect(_fetch_page)
+	actions_container.add_child(load_more_btn)
+
 	# Button to clear the results output
 	var clear_btn := Button.new()
 	clear_btn.text = "Clear"
@@ -214,11 +268,11 @@ func _on_query_button_pressed() -> void:
 	_execute_query(query_input.text)
 
 ###############################################################################
-## Executes a Prolog query and displays the results.
+## Executes a Prolog query and displays its first solutions.
 ##
-## Executes the given Prolog query using the engine and formats the results
-## in a readable way. Displays "false." if no solutions are found, or lists
-## all solutions with their numbers if found.
+## Opens a query cursor on the engine and fetches the first PAGE_SIZE
+## solutions on a worker thread, so that a long query does not freeze the
+## editor. The next solutions are fetched with the "Load more" button.
 ##
 ## @param query: The Prolog query string to execute
 ###############################################################################
@@ -232,20 +286,137 @@ func _execute_query(query: String) -> void:
 		_append_result("❌ Error: Prologot engine not available")
 		return
 
+	# One query runs at a time
+	if fetch_task != -1 or benchmark_task != -1:
+		_append_result("⏳ The previous query is still running")
+		return
+
+	# Close the previous query: only the last one can load more solutions
+	if cursor != 0:
+		engine.query_close(cursor)
+		cursor = 0
+
 	# Display the query in Prolog format
 	_append_result("\n?- " + query)
 
-	# Execute the query and get all solutions
-	var results = engine.query_all(query)
-	if results.is_empty():
-		# No solutions found
-		_append_result("false.")
+	cursor = engine.query_open(query)
+	if cursor == 0:
+		_append_result("✗ " + engine.get_last_error())
+		load_more_btn.disabled = true
+		return
+	_fetch_page()
+
+###############################################################################
+## Fetches the next page of solutions of the cursor on a worker thread.
+###############################################################################
+func _fetch_page() -> void:
+	if cursor == 0 or fetch_task != -1:
+		return
+	load_more_btn.disabled = true
+	fetch_task = WorkerThreadPool.add_task(
+		_run_fetch.bind(cursor), false, "Prologot dock query")
+
+###############################################################################
+## Worker thread task: computes a page of solutions.
+##
+## @param from_cursor: The cursor to fetch from
+###############################################################################
+func _run_fetch(from_cursor: int) -> void:
+	var page = engine.query_next(from_cursor, PAGE_SIZE)
+	_on_page_fetched.call_deferred(from_cursor, page)
+
+###############################################################################
+## Displays a page of solutions fetched by _run_fetch(), then the cost of
+## the query so far: wall time, inferences and number of solutions.
+##
+## @param from_cursor: The cursor the page was fetched from
+## @param page: The solutions
+###############################################################################
+func _on_page_fetched(from_cursor: int, page: Array) -> void:
+	WorkerThreadPool.wait_for_task_completion(fetch_task)
+	fetch_task = -1
+	if from_cursor != cursor:
+		return
+
+	_append_prolog_output()
+	for error in engine.take_errors():
+		_append_result("✗ " + error["message"])
+
+	var stats: Dictionary = engine.query_stats(cursor)
+	var first: int = stats["solutions"] - page.size()
+	for i in page.size():
+		_append_result("  Solution %d: %s" % [first + i + 1, _format_result(page[i])])
+
+	var cost := "%.3f ms, %d inferences" % [
+		stats["wall_time_usec"] / 1000.0, stats["inferences"]]
+	if not stats["exhausted"]:
+		_append_result("… %d solution(s) so far (%s)" % [stats["solutions"], cost])
+		load_more_btn.disabled = false
+		return
+
+	if stats["solutions"] == 0:
+		_append_result("false. (%s)" % cost)
 	else:
-		# Display each solution found
-		for i in results.size():
-			_append_result("  Solution %d: %s" % [i + 1, _format_result(results[i])])
-		# Show summary
-		_append_result("true. (%d solution(s))" % results.size())
+		_append_result("true. (%d solution(s), %s)" % [stats["solutions"], cost])
+	engine.query_close(cursor)
+	cursor = 0
+
+###############################################################################
+## Event handler for benchmark button pressed.
+##
+## Calls the goal of the query field BENCHMARK_ITERATIONS times in a native
+## loop, after BENCHMARK_WARMUP calls, on a worker thread so that the editor
+## stays responsive.
+###############################################################################
+func _on_benchmark_pressed() -> void:
+	var goal := query_input.text
+	if goal.is_empty():
+		return
+
+	if not engine:
+		_append_result("❌ Error: Prologot engine not available")
+		return
+
+	if fetch_task != -1 or benchmark_task != -1:
+		_append_result("⏳ The previous query is still running")
+		return
+
+	_append_result("\n⏱ " + goal)
+	benchmark_task = WorkerThreadPool.add_task(
+		_run_benchmark.bind(goal), false, "Prologot dock benchmark")
+
+###############################################################################
+## Worker thread task: runs the benchmark of a goal.
+##
+## @param goal: The goal to measure
+###############################################################################
+func _run_benchmark(goal: String) -> void:
+	var report = engine.benchmark(goal, BENCHMARK_ITERATIONS, BENCHMARK_WARMUP)
+	_on_benchmark_done.call_deferred(report)
+
+###############################################################################
+## Displays the report of a benchmark: time per call (mean, median and 99th
+## percentile), inferences and bytes of terms allocated per call.
+##
+## @param report: The Dictionary returned by benchmark()
+###############################################################################
+func _on_benchmark_done(report: Dictionary) -> void:
+	WorkerThreadPool.wait_for_task_completion(benchmark_task)
+	benchmark_task = -1
+
+	_append_prolog_output()
+	for error in engine.take_errors():
+		_append_result("✗ " + error["message"])
+	if report.is_empty():
+		_append_result("✗ Benchmark failed")
+		return
+
+	_append_result("  %d calls, %d succeeded" % [
+		report["iterations"], report["succeeded"]])
+	_append_result("  mean %.3f µs, p50 %.3f µs, p99 %.3f µs" % [
+		report["mean_usec"], report["p50_usec"], report["p99_usec"]])
+	_append_result("  %.1f inferences/call, %.0f bytes allocated/call" % [
+		report["inferences_per_call"], report["allocated_bytes_per_call"]])
 
 ###############################################################################
 ## Formats a Prolog result for display.
@@ -298,6 +469,26 @@ func _append_result(text: String) -> void:
 	# Auto-scroll to bottom to show latest output
 	result_output.scroll_vertical = result_output.get_line_count()
 
+###############################################################################
+## Appends the text written by Prolog to the result output.
+##
+## Shows what the last call wrote with format/2, writeln/1 or print_message/2,
+## which the editor engine keeps in memory instead of printing it to stdout
+## (see the "output buffer" option set by the plugin).
+###############################################################################
+func _append_prolog_output() -> void:
+	var text: Dictionary = engine.take_output()
+	if text.is_empty():
+		return
+	var output: String = text["output"]
+	var error: String = text["error"]
+	if not output.is_empty():
+		_append_result(output.trim_suffix("\n"))
+	if not error.is_empty():
+		_append_result("⚠ " + error.trim_suffix("\n").replace("\n", "\n⚠ "))
+	if text["dropped"] > 0:
+		_append_result("(%d bytes of output dropped)" % text["dropped"])
+
 ###############################################################################
 ## Event handler for clear button pressed.
 ###############################################################################
@@ -335,7 +526,9 @@ func _on_file_selected(path: String) -> void:
 		return
 
 	# Try to load the Prolog file
-	if engine.consult_file(path):
+	var loaded: bool = engine.consult_file(path)
+	_append_prolog_output()
+	if loaded:
 		_append_result("✓ File loaded: " + path)
 		# Refresh the predicates list to show newly loaded predicates
 		_on_refresh_predicates()
@@ -364,7 +557,9 @@ func _on_consult_string_pressed() -> void:
 		return
 
 	# Load the code from the text area
-	if engine.consult_string(code):
+	var loaded: bool = engine.consult_string(code)
+	_append_prolog_output()
+	if loaded:
 		_append_result("✓ Code loaded successfully")
 		# Refresh predicates list to show newly loaded predicates
 		_on_refresh_predicates()
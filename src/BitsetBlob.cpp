@@ -0,0 +1,471 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the BitsetBlob class.
+ */
+
+#include "BitsetBlob.hpp"
+#include "PackedArrayBlob.hpp"
+#include "SimdKernels.hpp"
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/vector2i.hpp>
+
+#include <cstring>
+#include <new>
+#include <vector>
+
+namespace
+{
+
+/** Bits of a set: bit I is bit I % 64 of word I / 64. */
+struct Bitset
+{
+    std::vector<uint64_t> words;
+    int64_t size = 0;
+
+    explicit Bitset(int64_t p_size)
+        : words(size_t((p_size + 63) / 64), 0), size(p_size)
+    {
+    }
+
+    bool test(int64_t p_index) const
+    {
+        return (words[size_t(p_index / 64)] >> (p_index % 64)) & 1u;
+    }
+
+    void set(int64_t p_index)
+    {
+        words[size_t(p_index / 64)] |= uint64_t(1) << (p_index % 64);
+    }
+
+    /** First member at or after p_from, or size if none. */
+    int64_t next(int64_t p_from) const
+    {
+        if (p_from >= size)
+            return size;
+        size_t word = size_t(p_from / 64);
+        uint64_t bits = words[word] & (~uint64_t(0) << (p_from % 64));
+        while (bits == 0)
+        {
+            if (++word == words.size())
+                return size;
+            bits = words[word];
+        }
+        return int64_t(word) * 64 + lowest_bit(bits);
+    }
+
+private:
+
+    static int64_t lowest_bit(uint64_t p_bits)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(p_bits);
+#else
+        int64_t index = 0;
+        while ((p_bits & 1u) == 0)
+        {
+            p_bits >>= 1;
+            ++index;
+        }
+        return index;
+#endif
+    }
+};
+
+//! Largest set: 2^32 members take 512 MiB.
+const int64_t MAX_BITSET_SIZE = int64_t(1) << 32;
+
+/**
+ * Allocates an empty set, or raises a resource error and returns nullptr:
+ * std::bad_alloc must not unwind through the C frames of SWI-Prolog.
+ */
+Bitset* new_bitset(int64_t p_size)
+{
+    if (p_size > MAX_BITSET_SIZE)
+    {
+        PL_resource_error("memory");
+        return nullptr;
+    }
+    try
+    {
+        return new Bitset(p_size);
+    }
+    catch (std::bad_alloc const&)
+    {
+        PL_resource_error("memory");
+        return nullptr;
+    }
+}
+
+int release_bitset(atom_t p_atom);
+int write_bitset(IOSTREAM* p_stream, atom_t p_atom, int p_flags);
+
+PL_blob_t bitset_blob = {
+    PL_BLOB_MAGIC,
+    PL_BLOB_UNIQUE, // One atom per set
+    (char*)"bitset",
+    release_bitset,
+    nullptr, // compare: by address
+    write_bitset,
+    nullptr, // acquire
+    nullptr, // save
+    nullptr, // load
+};
+
+Bitset* blob_bitset(atom_t p_atom)
+{
+    Bitset* bitset;
+    memcpy(&bitset, PL_blob_data(p_atom, nullptr, nullptr), sizeof(bitset));
+    return bitset;
+}
+
+/** Gets the set of a blob term, or nullptr if not a bitset. */
+Bitset* term_bitset(term_t p_term)
+{
+    void* data = nullptr;
+    PL_blob_t* type = nullptr;
+    if (!PL_get_blob(p_term, &data, nullptr, &type) || type != &bitset_blob)
+    {
+        return nullptr;
+    }
+    Bitset* bitset;
+    memcpy(&bitset, data, sizeof(bitset));
+    return bitset;
+}
+
+int release_bitset(atom_t p_atom)
+{
+    delete blob_bitset(p_atom);
+    return TRUE;
+}
+
+int write_bitset(IOSTREAM* p_stream, atom_t p_atom, int p_flags)
+{
+    Sfprintf(p_stream, "<bitset>(%lld)", (long long)blob_bitset(p_atom)->size);
+    return TRUE;
+}
+
+/** Wraps a set in a blob, taking its ownership. */
+bool put_bitset(term_t p_term, Bitset* p_bitset)
+{
+    if (!PL_put_blob(p_term, &p_bitset, sizeof(p_bitset), &bitset_blob))
+    {
+        delete p_bitset;
+        return false;
+    }
+    return true;
+}
+
+/** Unifies a term with a new blob owning p_bitset. */
+bool unify_bitset(term_t p_term, Bitset* p_bitset)
+{
+    term_t blob = PL_new_term_ref();
+    return put_bitset(blob, p_bitset) && PL_unify(p_term, blob);
+}
+
+/** Gets the set of an argument or raises a type error. */
+bool bitset_arg(term_t p_term, Bitset*& r_bitset)
+{
+    r_bitset = term_bitset(p_term);
+    if (r_bitset == nullptr)
+        return PL_type_error("bitset", p_term);
+    return true;
+}
+
+/** Gets a size argument or raises an error. */
+bool size_arg(term_t p_term, int64_t& r_size)
+{
+    if (!PL_get_int64_ex(p_term, &r_size))
+        return false;
+    if (r_size < 0)
+        return PL_domain_error("not_less_than_zero", p_term);
+    return true;
+}
+
+foreign_t pl_bs_new(term_t p_size, term_t p_set)
+{
+    int64_t size;
+    if (!size_arg(p_size, size))
+        return FALSE;
+    Bitset* bitset = new_bitset(size);
+    return bitset != nullptr && unify_bitset(p_set, bitset);
+}
+
+foreign_t pl_bs_from_list(term_t p_size, term_t p_indexes, term_t p_set)
+{
+    int64_t size;
+    if (!size_arg(p_size, size))
+        return FALSE;
+
+    Bitset* bitset = new_bitset(size);
+    if (bitset == nullptr)
+        return FALSE;
+    term_t head = PL_new_term_ref();
+    term_t tail = PL_copy_term_ref(p_indexes);
+    while (PL_get_list(tail, head, tail))
+    {
+        int64_t index;
+        if (!PL_get_int64_ex(head, &index))
+        {
+            delete bitset;
+            return FALSE;
+        }
+        if (index < 0 || index >= size)
+        {
+            delete bitset;
+            return PL_domain_error("bitset_index", head);
+        }
+        bitset->set(index);
+    }
+    if (!PL_get_nil(tail))
+    {
+        delete bitset;
+        return PL_type_error("list", p_indexes);
+    }
+    return unify_bitset(p_set, bitset);
+}
+
+foreign_t pl_bs_from_bytes(term_t p_bytes, term_t p_set)
+{
+    Bitset* bitset;
+    PackedArrayBlob::View view;
+    if (PackedArrayBlob::get(p_bytes, view))
+    {
+        int64_t size = view.length * view.channels;
+        bitset = new_bitset(size);
+        if (bitset == nullptr)
+            return FALSE;
+        for (int64_t i = 0; i < size; i++)
+        {
+            bool member = (view.type == PackedArrayBlob::ElementType::BYTE)
+                              ? (view.data[i] != 0)
+                              : (view.number(i) != 0.0);
+            if (member)
+                bitset->set(i);
+        }
+        return unify_bitset(p_set, bitset);
+    }
+
+    std::vector<bool> members;
+    term_t head = PL_new_term_ref();
+    term_t tail = PL_copy_term_ref(p_bytes);
+    while (PL_get_list(tail, head, tail))
+    {
+        double value;
+        if (!PL_get_float(head, &value))
+            return PL_type_error("number", head);
+        members.push_back(value != 0.0);
+    }
+    if (!PL_get_nil(tail))
+        return PL_type_error("list", p_bytes);
+
+    bitset = new_bitset(int64_t(members.size()));
+    if (bitset == nullptr)
+        return FALSE;
+    for (size_t i = 0; i < members.size(); i++)
+    {
+        if (members[i])
+            bitset->set(int64_t(i));
+    }
+    return unify_bitset(p_set, bitset);
+}
+
+/** Combines two sets of the same size with a SimdKernels operation. */
+foreign_t combine(term_t p_a,
+                  term_t p_b,
+                  term_t p_set,
+                  void (*p_kernel)(const uint64_t*,
+                                   const uint64_t*,
+                                   uint64_t*,
+                                   size_t))
+{
+    Bitset* a;
+    Bitset* b;
+    if (!bitset_arg(p_a, a) || !bitset_arg(p_b, b))
+        return FALSE;
+    if (a->size != b->size)
+        return PL_domain_error("bitset_of_same_size", p_b);
+
+    Bitset* result = new_bitset(a->size);
+    if (result == nullptr)
+        return FALSE;
+    p_kernel(a->words.data(),
+             b->words.data(),
+             result->words.data(),
+             result->words.size());
+    return unify_bitset(p_set, result);
+}
+
+foreign_t pl_bs_union(term_t p_a, term_t p_b, term_t p_set)
+{
+    return combine(p_a, p_b, p_set, SimdKernels::bit_or);
+}
+
+foreign_t pl_bs_intersect(term_t p_a, term_t p_b, term_t p_set)
+{
+    return combine(p_a, p_b, p_set, SimdKernels::bit_and);
+}
+
+foreign_t pl_bs_difference(term_t p_a, term_t p_b, term_t p_set)
+{
+    return combine(p_a, p_b, p_set, SimdKernels::bit_and_not);
+}
+
+foreign_t pl_bs_count(term_t p_set, term_t p_count)
+{
+    Bitset* bitset;
+    if (!bitset_arg(p_set, bitset))
+        return FALSE;
+    size_t count =
+        SimdKernels::popcount(bitset->words.data(), bitset->words.size());
+    return PL_unify_int64(p_count, int64_t(count));
+}
+
+foreign_t pl_bs_size(term_t p_set, term_t p_size)
+{
+    Bitset* bitset;
+    return bitset_arg(p_set, bitset) && PL_unify_int64(p_size, bitset->size);
+}
+
+foreign_t pl_bs_member(term_t p_index, term_t p_set, control_t p_ctx)
+{
+    // The set is kept alive by the caller's term: re-read it on redo
+    Bitset* bitset;
+    int64_t from = 0;
+    switch (PL_foreign_control(p_ctx))
+    {
+        case PL_FIRST_CALL:
+            if (!bitset_arg(p_set, bitset))
+                return FALSE;
+            if (!PL_is_variable(p_index))
+            {
+                int64_t index;
+                if (!PL_get_int64_ex(p_index, &index))
+                    return FALSE;
+                return index >= 0 && index < bitset->size &&
+                       bitset->test(index);
+            }
+            break;
+        case PL_REDO:
+            bitset = term_bitset(p_set);
+            from = int64_t(PL_foreign_context(p_ctx));
+            break;
+        default: // PL_PRUNED
+            return TRUE;
+    }
+
+    // Look ahead so that the last member leaves no choice point
+    int64_t index = bitset->next(from);
+    if (index == bitset->size || !PL_unify_int64(p_index, index))
+        return FALSE;
+    int64_t next = bitset->next(index + 1);
+    if (next < bitset->size)
+        PL_retry(intptr_t(next));
+    return TRUE;
+}
+
+foreign_t pl_bs_to_list(term_t p_set, term_t p_indexes)
+{
+    Bitset* bitset;
+    if (!bitset_arg(p_set, bitset))
+        return FALSE;
+
+    term_t list = PL_copy_term_ref(p_indexes);
+    term_t item = PL_new_term_ref();
+    for (int64_t i = bitset->next(0); i < bitset->size;
+         i = bitset->next(i + 1))
+    {
+        if (!PL_unify_list(list, item, list) || !PL_unify_int64(item, i))
+            return FALSE;
+    }
+    return PL_unify_nil(list);
+}
+
+} // namespace
+
+// =============================================================================
+// BitsetBlob
+// =============================================================================
+
+bool BitsetBlob::put_bitmap(term_t p_term, BitMap const* p_bitmap)
+{
+    Vector2i dimensions = p_bitmap->get_size();
+    int64_t size = int64_t(dimensions.x) * dimensions.y;
+    Bitset* bitset = new_bitset(size);
+    if (bitset == nullptr)
+        return false;
+
+    // The "data" property packs the bits in the same order (LSB first):
+    // assemble words from it instead of calling get_bit() per pixel
+    Dictionary data = p_bitmap->get("data");
+    PackedByteArray bytes = data.get("data", PackedByteArray());
+    if (bytes.size() >= (size + 7) / 8)
+    {
+        const uint8_t* bits = bytes.ptr();
+        for (int64_t i = 0; i < (size + 7) / 8; i++)
+        {
+            bitset->words[size_t(i / 8)] |= uint64_t(bits[i])
+                                            << ((i % 8) * 8);
+        }
+        // Clear the bits past the end of the set
+        if (size % 64 != 0)
+            bitset->words.back() &= (uint64_t(1) << (size % 64)) - 1;
+    }
+    else
+    {
+        for (int32_t y = 0; y < dimensions.y; y++)
+        {
+            for (int32_t x = 0; x < dimensions.x; x++)
+            {
+                if (p_bitmap->get_bit(x, y))
+                    bitset->set(int64_t(y) * dimensions.x + x);
+            }
+        }
+    }
+    return put_bitset(p_term, bitset);
+}
+
+Variant BitsetBlob::to_variant(term_t p_term)
+{
+    Bitset* bitset = term_bitset(p_term);
+    if (bitset == nullptr)
+        return Variant();
+
+    PackedByteArray bytes;
+    bytes.resize(bitset->size);
+    uint8_t* cells = bytes.ptrw();
+    for (int64_t i = 0; i < bitset->size; i++)
+        cells[i] = bitset->test(i) ? 1 : 0;
+    return bytes;
+}
+
+void BitsetBlob::register_predicates()
+{
+    PL_register_foreign_in_module(
+        "user", "bs_new", 2, (pl_function_t)pl_bs_new, 0);
+    PL_register_foreign_in_module(
+        "user", "bs_from_list", 3, (pl_function_t)pl_bs_from_list, 0);
+    PL_register_foreign_in_module(
+        "user", "bs_from_bytes", 2, (pl_function_t)pl_bs_from_bytes, 0);
+    PL_register_foreign_in_module(
+        "user", "bs_union", 3, (pl_function_t)pl_bs_union, 0);
+    PL_register_foreign_in_module(
+        "user", "bs_intersect", 3, (pl_function_t)pl_bs_intersect, 0);
+    PL_register_foreign_in_module(
+        "user", "bs_difference", 3, (pl_function_t)pl_bs_difference, 0);
+    PL_register_foreign_in_module(
+        "user", "bs_count", 2, (pl_function_t)pl_bs_count, 0);
+    PL_register_foreign_in_module(
+        "user", "bs_size", 2, (pl_function_t)pl_bs_size, 0);
+    PL_register_foreign_in_module("user",
+                                  "bs_member",
+                                  2,
+                                  (pl_function_t)pl_bs_member,
+                                  PL_FA_NONDETERMINISTIC);
+    PL_register_foreign_in_module(
+        "user", "bs_to_list", 2, (pl_function_t)pl_bs_to_list, 0);
+}
@@ -0,0 +1,72 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the BitsetBlob class: fixed-size sets of integers
+ * passed to Prolog as blobs.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <godot_cpp/classes/bit_map.hpp>
+#include <godot_cpp/variant/variant.hpp>
+
+using namespace godot;
+
+/**
+ * @class BitsetBlob
+ * @brief Prolog blob type holding a set of integers in [0, Size) as bits.
+ *
+ * Visibility and fog-of-war rules over thousands of cells are slow as
+ * visible(Cell) facts checked with member/2. A bitset stores a cell per bit
+ * and combines whole sets 256 bits at a time (see SimdKernels). Bitsets are
+ * immutable like any Prolog term: operations return new bitsets.
+ *
+ * A Godot BitMap becomes a bitset of width * height bits (bit y * width + x
+ * is pixel (x, y)). A bitset is given back to Godot as a PackedByteArray of
+ * one byte (0 or 1) per bit.
+ *
+ * Foreign predicates (registered in the user module):
+ * - bs_new(+Size, -Set): empty set. Sizes above 2^32 (and allocation
+ *   failures) raise resource_error(memory), as for all the predicates
+ *   creating a set.
+ * - bs_from_list(+Size, +Indexes, -Set): set of the given indexes.
+ * - bs_from_bytes(+Bytes, -Set): bit I is set if element I is not zero;
+ *   Bytes is a packed array blob or a list of numbers.
+ * - bs_union(+A, +B, -Set), bs_intersect(+A, +B, -Set),
+ *   bs_difference(+A, +B, -Set): A and B must have the same size.
+ * - bs_count(+Set, -N): number of members.
+ * - bs_size(+Set, -Size): capacity given at creation.
+ * - bs_member(?Index, +Set): checks or enumerates members in increasing
+ *   order.
+ * - bs_to_list(+Set, -Indexes): members in increasing order.
+ */
+class BitsetBlob
+{
+public:
+
+    /**
+     * @brief Puts a bitset of the bits of a BitMap in a term.
+     *
+     * @param p_term Term reference receiving the blob.
+     * @param p_bitmap Source bitmap.
+     * @return true on success.
+     */
+    static bool put_bitmap(term_t p_term, BitMap const* p_bitmap);
+
+    /**
+     * @brief Converts a bitset to a PackedByteArray of one byte per bit.
+     *
+     * @param p_term Term to inspect.
+     * @return The bytes, or Variant() if the term is not a bitset.
+     */
+    static Variant to_variant(term_t p_term);
+
+    /**
+     * @brief Registers the bs_* foreign predicates.
+     */
+    static void register_predicates();
+};
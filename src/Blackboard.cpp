@@ -0,0 +1,209 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the Blackboard class.
+ */
+
+#include "Blackboard.hpp"
+#include "Prologot.hpp"
+
+std::unordered_map<atom_t, std::unordered_map<std::string, record_t>>
+    Blackboard::s_values;
+std::mutex Blackboard::s_mutex;
+
+namespace
+{
+
+/** Text of a key atom; raises a type error if p_key is not an atom. */
+bool key_text(term_t p_key, std::string& r_key)
+{
+    char* text = nullptr;
+    size_t length = 0;
+    if (!PL_get_nchars(p_key, &length, &text, CVT_ATOM | CVT_EXCEPTION |
+                                                  REP_UTF8 | BUF_DISCARDABLE))
+    {
+        return false;
+    }
+    r_key.assign(text, length);
+    return true;
+}
+
+/** '$prologot_bb_get'(+Module, +Key, -Value): fails on missing keys. */
+foreign_t pl_bb_get(term_t p_module, term_t p_key, term_t p_value)
+{
+    atom_t module;
+    std::string key;
+    term_t value = PL_new_term_ref();
+    return PL_get_atom_ex(p_module, &module) && key_text(p_key, key) &&
+           Blackboard::load_term(module, key, value) &&
+           PL_unify(p_value, value);
+}
+
+/** '$prologot_bb_set'(+Module, +Key, +Value): replaces the key value. */
+foreign_t pl_bb_set(term_t p_module, term_t p_key, term_t p_value)
+{
+    atom_t module;
+    std::string key;
+    if (!PL_get_atom_ex(p_module, &module) || !key_text(p_key, key))
+        return FALSE;
+    Blackboard::store_term(module, key, p_value);
+    return TRUE;
+}
+
+} // namespace
+
+// =============================================================================
+// Blackboard
+// =============================================================================
+
+bool Blackboard::set(module_t p_module,
+                     String const& p_key,
+                     Variant const& p_value,
+                     String& r_error)
+{
+    fid_t fid = PL_open_foreign_frame();
+    term_t value = Prologot::variant_to_term(p_value);
+    bool ok = (value != 0);
+    if (ok)
+    {
+        store_term(module_name(p_module), p_key.utf8().get_data(), value);
+    }
+    else
+    {
+        r_error = "Cannot convert the blackboard value of " + p_key;
+    }
+    PL_discard_foreign_frame(fid);
+    return ok;
+}
+
+bool Blackboard::get(module_t p_module,
+                     String const& p_key,
+                     Variant& r_value)
+{
+    fid_t fid = PL_open_foreign_frame();
+    term_t value = PL_new_term_ref();
+    bool found =
+        load_term(module_name(p_module), p_key.utf8().get_data(), value);
+    if (found)
+    {
+        r_value = Prologot::term_to_variant(value);
+    }
+    PL_discard_foreign_frame(fid);
+    return found;
+}
+
+Dictionary Blackboard::get_many(module_t p_module,
+                                PackedStringArray const& p_keys)
+{
+    // The value reference is created before the inner frame: rewinding it
+    // after each key only releases the term of that key
+    Dictionary values;
+    atom_t module = module_name(p_module);
+    fid_t outer = PL_open_foreign_frame();
+    term_t value = PL_new_term_ref();
+    fid_t fid = PL_open_foreign_frame();
+    for (int64_t i = 0; i < p_keys.size(); i++)
+    {
+        if (load_term(module, p_keys[i].utf8().get_data(), value))
+        {
+            values[p_keys[i]] = Prologot::term_to_variant(value);
+        }
+        PL_rewind_foreign_frame(fid);
+    }
+    PL_discard_foreign_frame(fid);
+    PL_discard_foreign_frame(outer);
+    return values;
+}
+
+bool Blackboard::erase(module_t p_module, String const& p_key)
+{
+    atom_t module = module_name(p_module);
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto values = s_values.find(module);
+    if (values == s_values.end())
+        return false;
+    auto it = values->second.find(p_key.utf8().get_data());
+    if (it == values->second.end())
+        return false;
+
+    PL_erase(it->second);
+    values->second.erase(it);
+    return true;
+}
+
+void Blackboard::clear(module_t p_module)
+{
+    atom_t module = module_name(p_module);
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto values = s_values.find(module);
+    if (values == s_values.end())
+        return;
+
+    for (auto const& value : values->second)
+        PL_erase(value.second);
+    s_values.erase(values);
+}
+
+void Blackboard::clear_all()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    for (auto const& values : s_values)
+    {
+        for (auto const& value : values.second)
+            PL_erase(value.second);
+    }
+    s_values.clear();
+}
+
+atom_t Blackboard::module_name(module_t p_module)
+{
+    if (p_module != NULL)
+        return PL_module_name(p_module);
+
+    atom_t user = PL_new_atom("user");
+    module_t module = PL_new_module(user);
+    PL_unregister_atom(user);
+    return PL_module_name(module);
+}
+
+void Blackboard::store_term(atom_t p_module,
+                            std::string const& p_key,
+                            term_t p_term)
+{
+    // Recorded outside the lock: copying a large term does not block readers
+    record_t record = PL_record(p_term);
+    record_t previous = 0;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        record_t& slot = s_values[p_module][p_key];
+        previous = slot;
+        slot = record;
+    }
+    if (previous != 0)
+    {
+        PL_erase(previous);
+    }
+}
+
+bool Blackboard::load_term(atom_t p_module,
+                           std::string const& p_key,
+                           term_t p_term)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto values = s_values.find(p_module);
+    if (values == s_values.end())
+        return false;
+    auto it = values->second.find(p_key);
+    return (it != values->second.end()) && PL_recorded(it->second, p_term);
+}
+
+void Blackboard::register_predicates()
+{
+    PL_register_foreign_in_module(
+        "user", "$prologot_bb_get", 3, (pl_function_t)pl_bb_get, 0);
+    PL_register_foreign_in_module(
+        "user", "$prologot_bb_set", 3, (pl_function_t)pl_bb_set, 0);
+}
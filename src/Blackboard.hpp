@@ -0,0 +1,146 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the Blackboard class: a key-value store for values
+ * updated many times per frame, shared by Godot and Prolog.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+#include <godot_cpp/variant/variant.hpp>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+using namespace godot;
+
+/**
+ * @class Blackboard
+ * @brief Native key-value store visible to Prolog rules.
+ *
+ * Storing a changing scalar as a fact (retract then assert) creates a clause
+ * per update, which the clause garbage collector has to reclaim. Blackboard
+ * values are Prolog records held in a hash table instead: an update replaces
+ * the record of its key in O(1) and leaves no clause behind.
+ *
+ * Rules read and write the same values with bb_get(+Key, -Value) and
+ * bb_set(+Key, +Value) (see register_predicates()). Keys are atoms. Values
+ * are copied like assert/1 does: variables are not shared with the caller.
+ *
+ * Each module has its own keys: the instances using the user module share
+ * its blackboard, while an overlay module (see Prologot::setup_module())
+ * keeps its keys apart from its base and from the other overlays. The
+ * blackboards are shared by all threads.
+ */
+class Blackboard
+{
+public:
+
+    /**
+     * @brief Sets the value of a key.
+     *
+     * @param p_module Module owning the key (NULL for user).
+     * @param p_key Key name.
+     * @param p_value Value, converted to a Prolog term.
+     * @param r_error Error message when the value cannot be converted.
+     * @return true on success.
+     */
+    static bool set(module_t p_module,
+                    String const& p_key,
+                    Variant const& p_value,
+                    String& r_error);
+
+    /**
+     * @brief Gets the value of a key.
+     *
+     * @param p_module Module owning the key (NULL for user).
+     * @param p_key Key name.
+     * @param r_value Value converted to a Variant.
+     * @return false if the key has no value.
+     */
+    static bool get(module_t p_module, String const& p_key, Variant& r_value);
+
+    /**
+     * @brief Gets the values of several keys (missing keys are skipped).
+     *
+     * @param p_module Module owning the keys (NULL for user).
+     * @param p_keys Key names.
+     * @return Key -> value Dictionary.
+     */
+    static Dictionary get_many(module_t p_module,
+                               PackedStringArray const& p_keys);
+
+    /**
+     * @brief Removes a key.
+     *
+     * @param p_module Module owning the key (NULL for user).
+     * @param p_key Key name.
+     * @return true if the key had a value.
+     */
+    static bool erase(module_t p_module, String const& p_key);
+
+    /**
+     * @brief Removes the keys of a module (called when an overlay module is
+     * emptied).
+     *
+     * @param p_module Module owning the keys (NULL for user).
+     */
+    static void clear(module_t p_module);
+
+    /**
+     * @brief Removes the keys of all modules (called before shutting down
+     * Prolog).
+     */
+    static void clear_all();
+
+    /**
+     * @brief Registers the foreign predicates behind bb_get/2 and bb_set/2:
+     * '$prologot_bb_get'(+Module, +Key, -Value) and
+     * '$prologot_bb_set'(+Module, +Key, +Value), in the user module.
+     *
+     * bb_get/2 and bb_set/2 are bootstrap rules calling them with the module
+     * of the caller (see Prologot::start_engine()).
+     */
+    static void register_predicates();
+
+    /**
+     * @brief Replaces the value of a key by a copy of a term.
+     *
+     * @param p_module Name of the module owning the key.
+     * @param p_key UTF-8 key name.
+     * @param p_term New value.
+     */
+    static void
+    store_term(atom_t p_module, std::string const& p_key, term_t p_term);
+
+    /**
+     * @brief Puts a copy of the value of a key in a term reference.
+     *
+     * @param p_module Name of the module owning the key.
+     * @param p_key UTF-8 key name.
+     * @param p_term Term reference receiving the value.
+     * @return false if the key has no value.
+     */
+    static bool
+    load_term(atom_t p_module, std::string const& p_key, term_t p_term);
+
+private:
+
+    /** Name of a module, the user module for NULL. */
+    static atom_t module_name(module_t p_module);
+
+    //! Values by module name, then by key. Module names stay valid: modules
+    //! are never deleted.
+    static std::unordered_map<atom_t,
+                              std::unordered_map<std::string, record_t>>
+        s_values;
+    static std::mutex s_mutex;
+};
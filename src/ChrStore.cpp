@@ -0,0 +1,305 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the ChrStore class.
+ */
+
+#include "ChrStore.hpp"
+#include "Prologot.hpp"
+
+#include <cstring>
+
+bool ChrStore::s_bootstrapped = false;
+
+namespace
+{
+
+/** Helper predicates, asserted in the prologot_chr module. */
+const char* const HELPERS[] = {
+    // Loads rules through the CHR compiler (consult_string() would assert
+    // the rules without compiling them)
+    "load(Code) :- "
+    "open_string(Code, Stream), "
+    "call_cleanup(load_files(user:prologot_chr_program, [stream(Stream)]), "
+    "close(Stream))",
+
+    // Engine of the calling thread, created on first use
+    "engine(E) :- "
+    "nb_current('$prologot_chr_engine', E), is_engine(E), !",
+    "engine(E) :- "
+    "engine_create(_, prologot_chr:serve, E), "
+    "nb_setval('$prologot_chr_engine', E)",
+
+    "post(Command, Reply) :- engine(E), engine_post(E, Command, Reply)",
+
+    "reset :- "
+    "( nb_current('$prologot_chr_engine', E), is_engine(E) "
+    "-> engine_destroy(E) ; true ), "
+    "nb_setval('$prologot_chr_engine', none)",
+
+    // Adds a snapshot to a new engine, which replaces the current one only
+    // if all the constraints were added
+    "restore(Constraints, Reply) :- "
+    "engine_create(_, prologot_chr:serve, New), "
+    "engine_post(New, add(Constraints), Reply), "
+    "( Reply == true -> reset, nb_setval('$prologot_chr_engine', New) "
+    "; engine_destroy(New) )",
+
+    // Command loop of the engine: never backtracks into a previous command,
+    // so the store built by the commands persists. A failed command undoes
+    // its own changes only.
+    "serve :- "
+    "engine_fetch(Command), "
+    "( catch(prologot_chr:handle(Command, Reply0), Error, "
+    "Reply0 = error(Error)) -> Reply = Reply0 ; Reply = false ), "
+    "engine_yield(Reply), "
+    "prologot_chr:serve",
+
+    "handle(add(Constraints), true) :- "
+    "add_all(Constraints)",
+    "add_all([])",
+    "add_all([C|Cs]) :- call(user:C), add_all(Cs)",
+
+    "handle(store(Name), Constraints) :- "
+    "findall(C, ( current_chr_constraint(user:C), "
+    "( Name == '' -> true ; functor(C, Name, _) ) ), Constraints)",
+
+    nullptr
+};
+
+/** Error message of an error(E) reply or of the pending exception. */
+String error_message(term_t p_error, String const& p_context)
+{
+    char* message = nullptr;
+    if (p_error && PL_get_chars(p_error,
+                                &message,
+                                CVT_WRITE | CVT_EXCEPTION | BUF_DISCARDABLE))
+    {
+        return p_context + ": " + String::utf8(message);
+    }
+    return p_context;
+}
+
+/**
+ * Checks the reply of a command: true, false when the constraints are
+ * inconsistent (r_error left empty), or error(E).
+ */
+bool is_true_reply(term_t p_reply, String& r_error)
+{
+    term_t error = PL_new_term_ref();
+    if (PL_is_functor(p_reply, PL_new_functor(PL_new_atom("error"), 1)) &&
+        PL_get_arg(1, p_reply, error))
+    {
+        r_error = error_message(error, "CHR error");
+        return false;
+    }
+    char* result = nullptr;
+    return PL_get_atom_chars(p_reply, &result) && strcmp(result, "true") == 0;
+}
+
+/** Parses constraint texts into the list r_list. */
+bool put_constraints(PackedStringArray const& p_constraints,
+                     term_t r_list,
+                     String& r_error)
+{
+    term_t constraint = PL_new_term_ref();
+    if (!PL_put_nil(r_list))
+        return false;
+    for (int64_t i = p_constraints.size() - 1; i >= 0; i--)
+    {
+        if (!PL_chars_to_term(p_constraints[i].utf8().get_data(), constraint))
+        {
+            r_error = "Invalid CHR constraint: " + p_constraints[i];
+            return false;
+        }
+        if (!PL_cons_list(r_list, constraint, r_list))
+            return false;
+    }
+    return true;
+}
+
+/** Calls prologot_chr:Name/Arity, reporting exceptions in r_error. */
+bool call_helper(char const* p_name,
+                 term_t p_args,
+                 int p_arity,
+                 String& r_error)
+{
+    predicate_t predicate = PL_predicate(p_name, p_arity, "prologot_chr");
+    qid_t qid = PL_open_query(NULL, PL_Q_CATCH_EXCEPTION, predicate, p_args);
+    bool ok = PL_next_solution(qid);
+    if (!ok)
+    {
+        r_error = error_message(PL_exception(qid),
+                                String("CHR ") + p_name + " failed");
+    }
+    PL_cut_query(qid);
+    return ok;
+}
+
+} // namespace
+
+// =============================================================================
+// ChrStore
+// =============================================================================
+
+bool ChrStore::consult(String const& p_code, String& r_error)
+{
+    if (!bootstrap(r_error))
+        return false;
+
+    fid_t fid = PL_open_foreign_frame();
+    term_t code = PL_new_term_ref();
+    String program = ":- use_module(library(chr)).\n" + p_code;
+    bool ok = PL_put_string_chars(code, program.utf8().get_data()) &&
+              call_helper("load", code, 1, r_error);
+    PL_discard_foreign_frame(fid);
+    return ok;
+}
+
+bool ChrStore::add(PackedStringArray const& p_constraints, String& r_error)
+{
+    if (!bootstrap(r_error))
+        return false;
+
+    fid_t fid = PL_open_foreign_frame();
+    term_t list = PL_new_term_ref();
+    term_t reply = PL_new_term_ref();
+    bool ok = put_constraints(p_constraints, list, r_error) &&
+              post("add", list, reply, r_error) &&
+              is_true_reply(reply, r_error);
+    PL_discard_foreign_frame(fid);
+    return ok;
+}
+
+bool ChrStore::restore(PackedStringArray const& p_constraints,
+                       String& r_error)
+{
+    if (!bootstrap(r_error))
+        return false;
+
+    // The current store is kept until the snapshot is fully restored
+    fid_t fid = PL_open_foreign_frame();
+    term_t args = PL_new_term_refs(2);
+    bool ok = put_constraints(p_constraints, args, r_error) &&
+              call_helper("restore", args, 2, r_error) &&
+              is_true_reply(args + 1, r_error);
+    PL_discard_foreign_frame(fid);
+    return ok;
+}
+
+Array ChrStore::get_store(String const& p_name, String& r_error)
+{
+    Array constraints;
+    if (!bootstrap(r_error))
+        return constraints;
+
+    fid_t fid = PL_open_foreign_frame();
+    term_t name = PL_new_term_ref();
+    term_t reply = PL_new_term_ref();
+    term_t head = PL_new_term_ref();
+    if (PL_put_atom_chars(name, p_name.utf8().get_data()) &&
+        post("store", name, reply, r_error))
+    {
+        while (PL_get_list(reply, head, reply))
+            constraints.push_back(Prologot::term_to_variant(head));
+    }
+    PL_discard_foreign_frame(fid);
+    return constraints;
+}
+
+PackedStringArray ChrStore::snapshot(String& r_error)
+{
+    PackedStringArray texts;
+    if (!bootstrap(r_error))
+        return texts;
+
+    fid_t fid = PL_open_foreign_frame();
+    term_t name = PL_new_term_ref();
+    term_t reply = PL_new_term_ref();
+    term_t head = PL_new_term_ref();
+    if (PL_put_atom_chars(name, "") && post("store", name, reply, r_error))
+    {
+        char* text = nullptr;
+        while (PL_get_list(reply, head, reply))
+        {
+            if (PL_get_chars(
+                    head, &text, CVT_WRITEQ | BUF_DISCARDABLE | REP_UTF8))
+            {
+                texts.push_back(String::utf8(text));
+            }
+        }
+    }
+    PL_discard_foreign_frame(fid);
+    return texts;
+}
+
+void ChrStore::reset()
+{
+    if (!s_bootstrapped)
+        return;
+
+    String error;
+    call_helper("reset", PL_new_term_refs(0), 0, error);
+}
+
+void ChrStore::clear()
+{
+    reset();
+    s_bootstrapped = false;
+}
+
+bool ChrStore::bootstrap(String& r_error)
+{
+    if (s_bootstrapped)
+        return true;
+
+    // current_chr_constraint/1 comes from library(chr)
+    fid_t fid = PL_open_foreign_frame();
+    term_t goal = PL_new_term_ref();
+    bool ok =
+        PL_chars_to_term("prologot_chr:use_module(library(chr))", goal) &&
+        PL_call(goal, NULL);
+    predicate_t assertz = PL_predicate("assertz", 1, "user");
+    for (int i = 0; HELPERS[i] != nullptr && ok; i++)
+    {
+        String clause = String("prologot_chr:(") + HELPERS[i] + ")";
+        ok = PL_chars_to_term(clause.utf8().get_data(), goal) &&
+             PL_call_predicate(NULL, PL_Q_CATCH_EXCEPTION, assertz, goal);
+    }
+    if (!ok)
+    {
+        r_error = error_message(PL_exception(0), "Cannot initialize CHR");
+    }
+    PL_clear_exception();
+    PL_discard_foreign_frame(fid);
+    s_bootstrapped = ok;
+    return ok;
+}
+
+bool ChrStore::post(char const* p_command,
+                    term_t p_argument,
+                    term_t r_reply,
+                    String& r_error)
+{
+    term_t args = PL_new_term_refs(2);
+    term_t error = PL_new_term_ref();
+    if (!PL_cons_functor(args,
+                         PL_new_functor(PL_new_atom(p_command), 1),
+                         p_argument) ||
+        !call_helper("post", args, 2, r_error))
+    {
+        return false;
+    }
+
+    // error(E) replies carry the exception raised inside the engine
+    if (PL_is_functor(args + 1, PL_new_functor(PL_new_atom("error"), 1)) &&
+        PL_get_arg(1, args + 1, error))
+    {
+        r_error = error_message(error, "CHR error");
+        return false;
+    }
+    return PL_put_term(r_reply, args + 1);
+}
@@ -0,0 +1,123 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the ChrStore class: a Constraint Handling Rules store
+ * kept alive across calls in a dedicated Prolog engine.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+using namespace godot;
+
+/**
+ * @class ChrStore
+ * @brief Persistent CHR constraint store.
+ *
+ * A CHR store only lives as long as the query that built it: adding a
+ * constraint from a new query would start from an empty store and re-derive
+ * everything. The store is therefore kept in a Prolog engine (see
+ * engine_create/3) running a command loop that never backtracks: each call
+ * posts a command to the engine, which adds constraints to the same store
+ * and yields its reply, so the rules only propagate the new constraints.
+ *
+ * The CHR rules are loaded in the user module with the CHR compiler, and the
+ * constraints are called in the user module. Like Prolog global variables,
+ * the engine belongs to the calling thread, and is shared by the Prologot
+ * instances.
+ */
+class ChrStore
+{
+public:
+
+    /**
+     * @brief Loads CHR rules (library(chr) is imported automatically).
+     *
+     * The CHR compiler compiles the rules of a source file together: every
+     * call loads the same source, and replaces the rules of the previous
+     * call. All the rules must therefore be given at once.
+     *
+     * @param p_code Program text (":- chr_constraint ..." and rules).
+     * @param r_error Error message on failure.
+     * @return true on success.
+     */
+    bool consult(String const& p_code, String& r_error);
+
+    /**
+     * @brief Adds constraints to the store, all or none.
+     *
+     * @param p_constraints Constraint texts.
+     * @param r_error Error message on failure (empty when the constraints
+     * are only inconsistent with the store).
+     * @return true if the constraints were added, false if they failed.
+     */
+    bool add(PackedStringArray const& p_constraints, String& r_error);
+
+    /**
+     * @brief Gets the constraints of the store converted to Variants.
+     *
+     * @param p_name Name of the constraints to get, empty for all.
+     * @param r_error Error message on failure.
+     * @return The constraints, in store order.
+     */
+    Array get_store(String const& p_name, String& r_error);
+
+    /**
+     * @brief Gets the constraints of the store as texts accepted by add().
+     *
+     * @param r_error Error message on failure.
+     * @return The constraint texts.
+     */
+    PackedStringArray snapshot(String& r_error);
+
+    /**
+     * @brief Replaces the store by constraints, all or none.
+     *
+     * The constraints are added to a new engine, which replaces the current
+     * one only if they were all added: on failure the store is unchanged.
+     *
+     * @param p_constraints Constraint texts, e.g. from snapshot().
+     * @param r_error Error message on failure (empty when the constraints
+     * are only inconsistent).
+     * @return true if the store was replaced.
+     */
+    bool restore(PackedStringArray const& p_constraints, String& r_error);
+
+    /**
+     * @brief Empties the store: the engine is destroyed and recreated on the
+     * next use. The rules stay loaded.
+     */
+    void reset();
+
+    /**
+     * @brief Resets the store and forgets the helper predicates (called
+     * before shutting down Prolog).
+     */
+    void clear();
+
+private:
+
+    /** Defines the prologot_chr helper predicates on first use. */
+    bool bootstrap(String& r_error);
+
+    /**
+     * Posts a command to the engine. r_reply receives the reply; fails
+     * with r_error set if the command raised an exception.
+     */
+    bool post(char const* p_command,
+              term_t p_argument,
+              term_t r_reply,
+              String& r_error);
+
+private:
+
+    /** Whether the helper predicates are defined (once per process). */
+    static bool s_bootstrapped;
+};
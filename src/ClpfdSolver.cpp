@@ -0,0 +1,354 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the ClpfdSolver class.
+ */
+
+#include "ClpfdSolver.hpp"
+#include <SWI-Prolog.h>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/vector2i.hpp>
+
+#include <vector>
+
+namespace
+{
+
+/** Solutions of the running solve() of this thread. */
+thread_local PackedInt64Array* s_solutions = nullptr;
+
+/** '$prologot_clpfd_solution'(+Values): appends a solution. */
+foreign_t pl_clpfd_solution(term_t p_values)
+{
+    if (s_solutions == nullptr)
+        return FALSE;
+
+    term_t list = PL_copy_term_ref(p_values);
+    term_t head = PL_new_term_ref();
+    while (PL_get_list(list, head, list))
+    {
+        int64_t value;
+        if (!PL_get_int64_ex(head, &value))
+            return FALSE;
+        s_solutions->push_back(value);
+    }
+    return PL_get_nil_ex(list);
+}
+
+/** Prolog variable names: uppercase letter or '_', then alphanumerics. */
+bool is_variable_name(String const& p_name)
+{
+    if (p_name.is_empty())
+        return false;
+    char32_t first = p_name[0];
+    if (!((first >= 'A' && first <= 'Z') || first == '_'))
+        return false;
+    for (int64_t i = 1; i < p_name.length(); i++)
+    {
+        char32_t c = p_name[i];
+        if (!((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+              (c >= '0' && c <= '9') || c == '_'))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Functor of the running Prolog (functors do not survive PL_cleanup()). */
+functor_t new_functor(const char* p_name, size_t p_arity)
+{
+    atom_t name = PL_new_atom(p_name);
+    functor_t functor = PL_new_functor(name, p_arity);
+    PL_unregister_atom(name);
+    return functor;
+}
+
+/** Puts the CLP(FD) domain of a variable in r_domain. */
+bool put_domain(Variant const& p_domain, term_t r_domain)
+{
+    switch (p_domain.get_type())
+    {
+        case Variant::VECTOR2I:
+        {
+            Vector2i range = p_domain;
+            term_t bounds = PL_new_term_refs(2);
+            return PL_put_int64(bounds, range.x) &&
+                   PL_put_int64(bounds + 1, range.y) &&
+                   PL_cons_functor_v(r_domain, new_functor("..", 2), bounds);
+        }
+        case Variant::STRING:
+        {
+            String text = p_domain;
+            return !text.is_empty() &&
+                   PL_chars_to_term(text.utf8().get_data(), r_domain);
+        }
+        case Variant::ARRAY:
+        case Variant::PACKED_INT32_ARRAY:
+        case Variant::PACKED_INT64_ARRAY:
+        {
+            // V1 \/ V2 \/ ... \/ Vn
+            Array values = p_domain;
+            functor_t either = new_functor("\\/", 2);
+            term_t value = PL_new_term_ref();
+            for (int64_t i = 0; i < values.size(); i++)
+            {
+                Variant item = values[i];
+                if (item.get_type() != Variant::INT)
+                    return false;
+                if (i == 0)
+                {
+                    if (!PL_put_int64(r_domain, item))
+                        return false;
+                }
+                else if (!PL_put_int64(value, item) ||
+                         !PL_cons_functor(r_domain, either, r_domain, value))
+                {
+                    return false;
+                }
+            }
+            return !values.is_empty();
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ * Runs a goal. Returns 1 on success, 0 on failure and -1 on exception
+ * (message in r_error).
+ */
+int call_goal(term_t p_goal, String& r_error)
+{
+    qid_t qid = PL_open_query(NULL,
+                              PL_Q_CATCH_EXCEPTION,
+                              PL_predicate("call", 1, "user"),
+                              p_goal);
+    int result = PL_next_solution(qid) ? 1 : 0;
+    term_t exception = PL_exception(qid);
+    if (exception)
+    {
+        char* message = nullptr;
+        r_error = PL_get_chars(exception,
+                               &message,
+                               CVT_WRITE | CVT_EXCEPTION | BUF_DISCARDABLE)
+                      ? "CLP(FD) error: " + String::utf8(message)
+                      : String("CLP(FD) error");
+        result = -1;
+    }
+    PL_close_query(qid);
+    return result;
+}
+
+/**
+ * Builds the goal labeling the variables: the domains are posted, then the
+ * constraints, then the variables are labeled, each solution being given
+ * to '$prologot_clpfd_solution'/1. The options set the limits.
+ */
+bool put_search(std::vector<term_t> const& p_domains,
+                term_t p_problem,
+                Dictionary const& p_options,
+                term_t r_goal)
+{
+    // The problem is Variables-Constraints-LabelingOptions
+    term_t rest = PL_new_term_ref();
+    term_t variables = PL_new_term_ref();
+    term_t constraints = PL_new_term_ref();
+    term_t labeling = PL_new_term_ref();
+    if (!PL_get_arg(1, p_problem, rest) ||
+        !PL_get_arg(2, p_problem, labeling) ||
+        !PL_get_arg(1, rest, variables) || !PL_get_arg(2, rest, constraints))
+    {
+        return false;
+    }
+
+    // Var in Domain, ..., Constraint, ..., labeling(Options, Variables)
+    std::vector<term_t> posted;
+    term_t list = PL_copy_term_ref(variables);
+    for (term_t domain : p_domains)
+    {
+        term_t variable = PL_new_term_ref();
+        term_t post = PL_new_term_ref();
+        if (!PL_get_list(list, variable, list) ||
+            !PL_cons_functor(
+                post, new_functor("in", 2), variable, domain))
+        {
+            return false;
+        }
+        posted.push_back(post);
+    }
+    list = PL_copy_term_ref(constraints);
+    term_t constraint = PL_new_term_ref();
+    while (PL_get_list(list, constraint, list))
+    {
+        posted.push_back(constraint);
+        constraint = PL_new_term_ref();
+    }
+    if (!PL_get_nil(list) ||
+        !PL_cons_functor(
+            r_goal, new_functor("labeling", 2), labeling, variables))
+    {
+        return false;
+    }
+    functor_t conjunction = new_functor(",", 2);
+    for (auto it = posted.rbegin(); it != posted.rend(); ++it)
+    {
+        if (!PL_cons_functor(r_goal, conjunction, *it, r_goal))
+            return false;
+    }
+
+    // forall(limit(Count, Search), '$prologot_clpfd_solution'(Variables))
+    term_t number = PL_new_term_ref();
+    term_t found = PL_new_term_ref();
+    int64_t count = p_options.get("solutions", 1);
+    if (count > 0 &&
+        (!PL_put_int64(number, count) ||
+         !PL_cons_functor(r_goal, new_functor("limit", 2), number, r_goal)))
+    {
+        return false;
+    }
+    if (!PL_cons_functor(found,
+                         new_functor("$prologot_clpfd_solution", 1),
+                         variables) ||
+        !PL_cons_functor(r_goal, new_functor("forall", 2), r_goal, found))
+    {
+        return false;
+    }
+
+    // Limits: exceeding them makes the goal fail instead of raising
+    int64_t inferences = p_options.get("inference_limit", 0);
+    if (inferences > 0)
+    {
+        term_t outcome = PL_new_term_ref();
+        term_t exceeded = PL_new_term_ref();
+        term_t check = PL_new_term_ref();
+        if (!PL_put_int64(number, inferences) ||
+            !PL_cons_functor(r_goal,
+                             new_functor("call_with_inference_limit", 3),
+                             r_goal,
+                             number,
+                             outcome) ||
+            !PL_put_atom_chars(exceeded, "inference_limit_exceeded") ||
+            !PL_cons_functor(
+                check, new_functor("\\==", 2), outcome, exceeded) ||
+            !PL_cons_functor(r_goal, conjunction, r_goal, check))
+        {
+            return false;
+        }
+    }
+    double seconds = p_options.get("time_limit", 0.0);
+    if (seconds > 0.0)
+    {
+        term_t exceeded = PL_new_term_ref();
+        term_t recovery = PL_new_term_ref();
+        if (!PL_put_float(number, seconds) ||
+            !PL_cons_functor(r_goal,
+                             new_functor("call_with_time_limit", 2),
+                             number,
+                             r_goal) ||
+            !PL_put_atom_chars(exceeded, "time_limit_exceeded") ||
+            !PL_put_atom_chars(recovery, "fail") ||
+            !PL_cons_functor(r_goal,
+                             new_functor("catch", 3),
+                             r_goal,
+                             exceeded,
+                             recovery))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+// =============================================================================
+// ClpfdSolver
+// =============================================================================
+
+ClpfdSolver::Outcome ClpfdSolver::solve(Dictionary const& p_domains,
+                                        PackedStringArray const& p_constraints,
+                                        Dictionary const& p_options,
+                                        PackedInt64Array& r_solutions,
+                                        String& r_error)
+{
+    fid_t fid = PL_open_foreign_frame();
+
+    // The constraint operators (#=, ins, ...) must be known before parsing
+    term_t load = PL_new_term_ref();
+    if (!PL_chars_to_term(
+            "use_module(library(clpfd)), use_module(library(time))", load) ||
+        call_goal(load, r_error) != 1)
+    {
+        if (r_error.is_empty())
+            r_error = "Cannot load library(clpfd)";
+        PL_discard_foreign_frame(fid);
+        return Outcome::ERROR;
+    }
+
+    // Domains are built as terms. Only the texts written by the caller are
+    // parsed, in a single term so that they share the variable names:
+    // [Variables]-[Constraints]-[LabelingOptions]
+    Array names = p_domains.keys();
+    std::vector<term_t> domains;
+    String text = "[";
+    for (int64_t i = 0; i < names.size(); i++)
+    {
+        String name = names[i];
+        domains.push_back(PL_new_term_ref());
+        if (!is_variable_name(name))
+        {
+            r_error = "Invalid CLP(FD) variable name: " + name;
+            PL_discard_foreign_frame(fid);
+            return Outcome::ERROR;
+        }
+        if (!put_domain(p_domains[names[i]], domains.back()))
+        {
+            r_error = "Invalid domain for " + name +
+                      ": expected Vector2i, integer array or domain text";
+            PL_discard_foreign_frame(fid);
+            return Outcome::ERROR;
+        }
+        text += (i > 0 ? ", " : "") + name;
+    }
+    text += "]-[";
+    for (int64_t i = 0; i < p_constraints.size(); i++)
+    {
+        text += (i > 0 ? ", (" : "(") + p_constraints[i] + ")";
+    }
+    PackedStringArray labeling =
+        p_options.get("labeling", PackedStringArray());
+    text += "]-[" + String(", ").join(labeling) + "]";
+
+    term_t problem = PL_new_term_ref();
+    term_t goal = PL_new_term_ref();
+    if (!PL_chars_to_term(text.utf8().get_data(), problem) ||
+        !put_search(domains, problem, p_options, goal))
+    {
+        r_error = "Invalid CLP(FD) problem: " + text;
+        PL_discard_foreign_frame(fid);
+        return Outcome::ERROR;
+    }
+
+    PackedInt64Array* previous = s_solutions;
+    s_solutions = &r_solutions;
+    int result = call_goal(goal, r_error);
+    s_solutions = previous;
+    PL_discard_foreign_frame(fid);
+
+    if (result < 0)
+        return Outcome::ERROR;
+    return (result == 1) ? Outcome::COMPLETE : Outcome::LIMIT_EXCEEDED;
+}
+
+void ClpfdSolver::register_predicates()
+{
+    PL_register_foreign_in_module("user",
+                                  "$prologot_clpfd_solution",
+                                  1,
+                                  (pl_function_t)pl_clpfd_solution,
+                                  0);
+}
@@ -0,0 +1,67 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the ClpfdSolver class: CLP(FD) problems posted from
+ * Godot arrays and solved under a time or inference budget.
+ */
+
+#pragma once
+
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_int64_array.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+using namespace godot;
+
+/**
+ * @class ClpfdSolver
+ * @brief Builds a CLP(FD) goal from variable domains and constraint texts,
+ * labels it and collects the solutions natively.
+ *
+ * Each solution is appended to a flat PackedInt64Array by a foreign
+ * predicate called once per solution, so the solutions found before a time
+ * or inference limit are kept, and no intermediate Dictionary is built.
+ */
+class ClpfdSolver
+{
+public:
+
+    /** Outcome of solve(). */
+    enum class Outcome
+    {
+        //! All the requested solutions, or all the existing ones.
+        COMPLETE,
+        //! The time or inference limit stopped the search.
+        LIMIT_EXCEEDED,
+        //! Invalid input or Prolog error (see r_error).
+        ERROR
+    };
+
+    /**
+     * @brief Solves a finite-domain problem.
+     *
+     * @param p_domains Variable name -> domain: Vector2i (Min..Max), an
+     * array of allowed values or a CLP(FD) domain text.
+     * @param p_constraints CLP(FD) constraints over the variable names.
+     * @param p_options "labeling" (labeling/2 options), "solutions" (how
+     * many), "time_limit" (seconds) and "inference_limit".
+     * @param r_solutions Values of the variables, in p_domains order, for
+     * each solution found.
+     * @param r_error Error message on Outcome::ERROR.
+     * @return How the search ended.
+     */
+    static Outcome solve(Dictionary const& p_domains,
+                         PackedStringArray const& p_constraints,
+                         Dictionary const& p_options,
+                         PackedInt64Array& r_solutions,
+                         String& r_error);
+
+    /**
+     * @brief Registers the solution collector foreign predicate.
+     */
+    static void register_predicates();
+};
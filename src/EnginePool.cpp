@@ -0,0 +1,90 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the EnginePool class.
+ */
+
+#include "EnginePool.hpp"
+#include "OutputCapture.hpp"
+
+// =============================================================================
+// EnginePool
+// =============================================================================
+
+EnginePool::~EnginePool()
+{
+    // Engines belong to Prolog: clear() must have been called before
+    // PL_cleanup(), so only forget them here
+    m_idle.clear();
+}
+
+bool EnginePool::reserve(size_t p_count, String& r_error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (m_idle.size() < p_count)
+    {
+        PL_engine_t engine = create_engine();
+        if (engine == nullptr)
+        {
+            r_error = "Cannot create a Prolog engine (is Prolog initialized "
+                      "with the \"threads\" option?)";
+            return false;
+        }
+        m_idle.push_back(engine);
+    }
+    return true;
+}
+
+PL_engine_t EnginePool::acquire()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_idle.empty())
+        {
+            PL_engine_t engine = m_idle.back();
+            m_idle.pop_back();
+            return engine;
+        }
+    }
+    return create_engine();
+}
+
+void EnginePool::release(PL_engine_t p_engine)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_idle.push_back(p_engine);
+}
+
+void EnginePool::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (PL_engine_t engine : m_idle)
+        PL_destroy_engine(engine);
+    m_idle.clear();
+}
+
+void EnginePool::set_output(OutputCapture* p_output)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_output = p_output;
+}
+
+PL_engine_t EnginePool::create_engine()
+{
+    PL_engine_t engine = PL_create_engine(NULL);
+    if (engine == nullptr || m_output == nullptr)
+        return engine;
+
+    // Stream aliases are local to an engine: redirect them from within
+    PL_engine_t previous = nullptr;
+    if (PL_set_engine(engine, &previous) == PL_ENGINE_SET)
+    {
+        String error;
+        m_output->redirect(error);
+        PL_set_engine(previous, nullptr);
+    }
+    return engine;
+}
@@ -0,0 +1,88 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the EnginePool class: Prolog engines reused by the
+ * worker threads.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <godot_cpp/variant/string.hpp>
+
+#include <mutex>
+#include <vector>
+
+using namespace godot;
+
+class OutputCapture;
+
+/**
+ * @class EnginePool
+ * @brief Pool of Prolog engines for threads that are not Prolog threads.
+ *
+ * Godot's worker threads are not known to Prolog: to run a goal, a thread
+ * has to attach an engine (see PL_create_engine() and PL_set_engine()).
+ * Creating an engine allocates its stacks, so engines are created once and
+ * handed to the tasks that need one. An engine is used by one thread at a
+ * time, but any thread can use it.
+ */
+class EnginePool
+{
+public:
+
+    ~EnginePool();
+
+    /**
+     * @brief Creates engines until the pool holds at least p_count idle
+     * engines. Called from a Prolog thread before dispatching tasks.
+     *
+     * @param p_count Number of engines needed.
+     * @param r_error Error message on failure (e.g., Prolog started without
+     * threads).
+     * @return true on success.
+     */
+    bool reserve(size_t p_count, String& r_error);
+
+    /**
+     * @brief Takes an idle engine, creating one if none is left.
+     *
+     * @return The engine, or nullptr if no engine can be created.
+     */
+    PL_engine_t acquire();
+
+    /**
+     * @brief Gives back an engine taken with acquire(). The engine must not
+     * be attached to a thread anymore.
+     */
+    void release(PL_engine_t p_engine);
+
+    /**
+     * @brief Destroys the idle engines (called before shutting down Prolog,
+     * when no task runs).
+     */
+    void clear();
+
+    /**
+     * @brief Sets the capture of the output of the engines created next
+     * (nullptr to keep the process stdout).
+     */
+    void set_output(OutputCapture* p_output);
+
+private:
+
+    /**
+     * @brief Creates an engine, with its output redirected to m_output if
+     * set.
+     */
+    PL_engine_t create_engine();
+
+private:
+
+    std::vector<PL_engine_t> m_idle;
+    OutputCapture* m_output = nullptr;
+    std::mutex m_mutex;
+};
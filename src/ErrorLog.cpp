@@ -0,0 +1,175 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the ErrorLog class.
+ */
+
+#include "ErrorLog.hpp"
+
+// =============================================================================
+// ErrorRecord
+// =============================================================================
+
+void ErrorRecord::set_exception(term_t p_exception)
+{
+    exception.reset(PL_record(p_exception), PL_erase);
+    message = String();
+}
+
+String ErrorRecord::get_message() const
+{
+    if (!exception || !message.is_empty())
+        return message;
+
+    // A thread without a Prolog engine cannot rebuild the term
+    String text = "(exception not readable from this thread)";
+    if (PL_thread_self() != -1)
+    {
+        fid_t fid = PL_open_foreign_frame();
+        term_t term = PL_new_term_ref();
+        if (PL_recorded(exception.get(), term))
+        {
+            text = term_text(term);
+        }
+        PL_discard_foreign_frame(fid);
+    }
+    return context + " error: " + text;
+}
+
+void ErrorRecord::resolve()
+{
+    if (exception)
+    {
+        message = get_message();
+        exception.reset();
+    }
+}
+
+Dictionary ErrorRecord::to_dictionary() const
+{
+    Dictionary record;
+    record["type"] = type;
+    record["context"] = context;
+    record["goal"] = goal;
+    record["message"] = get_message();
+    record["thread"] = int64_t(thread);
+    return record;
+}
+
+Dictionary ErrorRecord::exception_to_dictionary() const
+{
+    if (!exception || PL_thread_self() == -1)
+        return Dictionary();
+
+    Dictionary info = to_dictionary();
+    fid_t fid = PL_open_foreign_frame();
+    term_t term = PL_new_term_ref();
+    term_t formal = PL_new_term_ref();
+    term_t arg = PL_new_term_ref();
+    atom_t name = 0;
+    size_t arity = 0;
+    if (PL_recorded(exception.get(), term))
+    {
+        info["term"] = term_text(term, CVT_WRITEQ);
+        info["kind"] = "throw";
+        info["culprit"] = info["term"];
+        info["detail"] = String();
+
+        // error(Formal, Context): Formal is instantiation_error, or e.g.
+        // type_error(Type, Culprit), evaluation_error(Which)
+        if (PL_get_name_arity(term, &name, &arity) && arity == 2 &&
+            String(PL_atom_chars(name)) == "error" &&
+            PL_get_arg(1, term, formal) &&
+            PL_get_name_arity(formal, &name, &arity))
+        {
+            info["kind"] = String(PL_atom_chars(name));
+            info["culprit"] = String();
+            if (arity >= 1 && PL_get_arg(1, formal, arg))
+            {
+                info["detail"] = term_text(arg, CVT_WRITEQ);
+            }
+            if (arity >= 2 && PL_get_arg(arity, formal, arg))
+            {
+                info["culprit"] = term_text(arg, CVT_WRITEQ);
+            }
+        }
+    }
+    PL_discard_foreign_frame(fid);
+    return info;
+}
+
+String ErrorRecord::term_text(term_t p_term, unsigned p_flags)
+{
+    char* text = nullptr;
+    size_t length = 0;
+    if (!PL_get_nchars(
+            p_term, &length, &text, p_flags | BUF_DISCARDABLE | REP_UTF8))
+    {
+        return String();
+    }
+    return String::utf8(text, int64_t(length));
+}
+
+// =============================================================================
+// ErrorLog
+// =============================================================================
+
+void ErrorLog::add(ErrorRecord const& p_record)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_last[p_record.thread] = p_record;
+    if (m_pending.size() >= MAX_PENDING)
+    {
+        m_pending.pop_front();
+        m_dropped++;
+    }
+    m_pending.push_back(p_record);
+}
+
+bool ErrorLog::last(uint64_t p_thread, ErrorRecord& r_record) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_last.find(p_thread);
+    if (it == m_last.end())
+        return false;
+
+    r_record = it->second;
+    return true;
+}
+
+Array ErrorLog::take_pending(int64_t& r_dropped)
+{
+    // The queue is swapped out so that the Dictionaries are built unlocked
+    std::deque<ErrorRecord> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pending.swap(m_pending);
+        r_dropped = m_dropped;
+        m_dropped = 0;
+    }
+
+    Array records;
+    for (ErrorRecord const& record : pending)
+        records.push_back(record.to_dictionary());
+    return records;
+}
+
+void ErrorLog::resolve_all()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& last : m_last)
+        last.second.resolve();
+    for (ErrorRecord& record : m_pending)
+        record.resolve();
+}
+
+void ErrorLog::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_last.clear();
+    m_pending.clear();
+    m_dropped = 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the ErrorLog class: the error records of each thread
+ * and their queue to the main thread.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+
+using namespace godot;
+
+/**
+ * @struct ErrorRecord
+ * @brief An error raised by a call of the API.
+ *
+ * When the error is a Prolog exception, the exception term is recorded and
+ * the message is only written when asked for (see get_message()): callers
+ * that only check that a call failed do not pay for formatting.
+ */
+struct ErrorRecord
+{
+    /** "error" or "warning". */
+    String type;
+    /** What was running (e.g., "Query"); empty for a plain message. */
+    String context;
+    /** Goal, fact or file the error is about; may be empty. */
+    String goal;
+    /** Message of the error; empty while the exception is not formatted. */
+    String message;
+    /** Thread that raised the error (see OS::get_thread_caller_id()). */
+    uint64_t thread = 0;
+    /** Recorded exception term (see PL_record()), erased with the last
+     * copy of the record; null for a plain message. */
+    std::shared_ptr<std::remove_pointer_t<record_t>> exception;
+
+    /**
+     * @brief Records an exception term as the cause of the error.
+     */
+    void set_exception(term_t p_exception);
+
+    /**
+     * @brief Gets the message: "<context> error: <exception>" for an
+     * exception, written by the calling thread (which must have a Prolog
+     * engine to show the term).
+     */
+    String get_message() const;
+
+    /**
+     * @brief Writes the message and drops the exception term, which must
+     * not outlive Prolog.
+     */
+    void resolve();
+
+    /**
+     * @brief Builds the Dictionary returned to GDScript: {"type", "context",
+     * "goal", "message", "thread"}.
+     */
+    Dictionary to_dictionary() const;
+
+    /**
+     * @brief Decomposes the exception term: to_dictionary() plus "kind" (the
+     * ISO error name such as "type_error", or "throw" for a term that is not
+     * error(Formal, Context)), "culprit" (the last argument of the formal
+     * term, or the thrown term), "detail" (its first argument, e.g. the
+     * expected type) and "term" (the whole exception, quoted).
+     *
+     * @return The Dictionary, or an empty one if the error has no exception
+     * term or the calling thread has no Prolog engine.
+     */
+    Dictionary exception_to_dictionary() const;
+
+    /**
+     * @brief Writes a term as text (UTF-8), for messages.
+     *
+     * @param p_term The term.
+     * @param p_flags CVT_WRITE or CVT_WRITEQ.
+     */
+    static String term_text(term_t p_term, unsigned p_flags = CVT_WRITE);
+};
+
+/**
+ * @class ErrorLog
+ * @brief Last error of each thread, and queue of the errors to deliver to
+ * the main thread.
+ *
+ * Any thread may raise errors (e.g., queries run by worker threads), so the
+ * last error is kept per thread: a thread never reads the error of another
+ * one. Each error is also queued until the main thread takes it. Records are
+ * kept as ErrorRecord and only turned into a Dictionary when asked for, and
+ * the queue is bounded so that a thread failing in a loop costs a constant
+ * amount of memory.
+ *
+ * Records holding an exception term must be resolved with resolve_all()
+ * before Prolog shuts down.
+ */
+class ErrorLog
+{
+public:
+
+    /** Number of queued records above which the oldest are dropped. */
+    static constexpr size_t MAX_PENDING = 256;
+
+    /**
+     * @brief Stores the last error of the calling thread (p_record.thread)
+     * and queues it for the main thread.
+     */
+    void add(ErrorRecord const& p_record);
+
+    /**
+     * @brief Gets the last error of a thread.
+     *
+     * @param p_thread Thread id.
+     * @param r_record The record, if any.
+     * @return false if the thread did not raise any error.
+     */
+    bool last(uint64_t p_thread, ErrorRecord& r_record) const;
+
+    /**
+     * @brief Takes the queued records, oldest first, as Dictionaries.
+     *
+     * @param r_dropped Number of records dropped since the previous call
+     * because the queue was full.
+     */
+    Array take_pending(int64_t& r_dropped);
+
+    /**
+     * @brief Writes the messages of all the records and drops their
+     * exception terms (see ErrorRecord::resolve()). Called before shutting
+     * down Prolog.
+     */
+    void resolve_all();
+
+    /**
+     * @brief Forgets the last errors and the queued records.
+     */
+    void clear();
+
+private:
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint64_t, ErrorRecord> m_last;
+    std::deque<ErrorRecord> m_pending;
+    int64_t m_dropped = 0;
+};
@@ -0,0 +1,788 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the FactLoader class.
+ */
+
+#include "FactLoader.hpp"
+#include "JsonValue.hpp"
+#include <cstring>
+#include <locale>
+#include <sstream>
+#include <utility>
+
+namespace
+{
+
+using ValueType = FactLoader::ValueType;
+
+//! Number of bytes read from the input at once.
+const size_t CHUNK_SIZE = 64 * 1024;
+
+//! Listener of the facts asserted by this thread, if any.
+thread_local FactLoader::Listener* s_listener = nullptr;
+
+/** '$prologot_asserted'(+Fact): notifies the listener of this thread. */
+foreign_t pl_asserted(term_t p_fact)
+{
+    FactLoader::Listener::notify(p_fact);
+    return TRUE;
+}
+
+// -----------------------------------------------------------------------------
+// Number parsing
+// -----------------------------------------------------------------------------
+
+bool parse_int(std::string const& p_text, int64_t& r_value)
+{
+    JsonValue number;
+    if (!JsonValue::parse_number(p_text.data(), p_text.size(), true, number) ||
+        number.type != JsonValue::Type::INTEGER)
+    {
+        return false;
+    }
+    r_value = number.integer;
+    return true;
+}
+
+bool parse_float(std::string const& p_text, double& r_value)
+{
+    JsonValue number;
+    if (!JsonValue::parse_number(p_text.data(), p_text.size(), true, number))
+        return false;
+    r_value = (number.type == JsonValue::Type::INTEGER)
+                  ? double(number.integer)
+                  : number.number;
+    return true;
+}
+
+const char* type_name(ValueType p_type)
+{
+    switch (p_type)
+    {
+        case ValueType::INT:
+            return "int";
+        case ValueType::FLOAT:
+            return "float";
+        case ValueType::ATOM:
+            return "atom";
+        case ValueType::STRING:
+            return "string";
+        default:
+            return "auto";
+    }
+}
+
+/** Checks that a text can be converted to a (non-inferred) type. */
+bool text_convertible(std::string const& p_text, ValueType p_type)
+{
+    int64_t integer;
+    double number;
+    switch (p_type)
+    {
+        case ValueType::INT:
+            return parse_int(p_text, integer);
+        case ValueType::FLOAT:
+            return parse_float(p_text, number);
+        default:
+            return true;
+    }
+}
+
+/** Puts a text converted to a (non-inferred) type in a term. */
+bool put_text(term_t p_term, std::string const& p_text, ValueType p_type)
+{
+    int64_t integer = 0;
+    double number = 0.0;
+    switch (p_type)
+    {
+        case ValueType::INT:
+            return parse_int(p_text, integer) && PL_put_int64(p_term, integer);
+        case ValueType::FLOAT:
+            return parse_float(p_text, number) && PL_put_float(p_term, number);
+        case ValueType::STRING:
+            return PL_put_chars(
+                p_term, PL_STRING | REP_UTF8, p_text.size(), p_text.c_str());
+        default:
+            return PL_put_chars(
+                p_term, PL_ATOM | REP_UTF8, p_text.size(), p_text.c_str());
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Bulk assertion
+// -----------------------------------------------------------------------------
+
+/**
+ * Asserts p_functor(A1, ..., An) facts one at a time. The terms built for a
+ * row are discarded once it is asserted, so the stacks do not grow with the
+ * input.
+ */
+class FactWriter
+{
+public:
+
+    FactWriter(String const& p_functor, module_t p_module, size_t p_arity)
+        : m_name(p_functor), m_module(p_module)
+    {
+        // The functor keeps its name: the references of the atoms are
+        // released at once
+        CharString name = p_functor.utf8();
+        atom_t atom =
+            PL_new_atom_mbchars(REP_UTF8, name.length(), name.get_data());
+        m_functor = PL_new_functor(atom, p_arity);
+        PL_unregister_atom(atom);
+        if (m_module == NULL)
+        {
+            atom_t user = PL_new_atom("user");
+            m_module = PL_new_module(user);
+            PL_unregister_atom(user);
+        }
+
+        // The references outlive the frame rewound after each row
+        m_args = PL_new_term_refs(p_arity);
+        m_fact = PL_new_term_ref();
+        m_fid = PL_open_foreign_frame();
+    }
+
+    ~FactWriter()
+    {
+        PL_discard_foreign_frame(m_fid);
+    }
+
+    /**
+     * Asserts a row: p_fill(args) puts its arguments in the n consecutive
+     * term references args. The row must have been validated: p_fill only
+     * fails on resource errors.
+     */
+    template <typename FILL>
+    bool add(FILL p_fill, String& r_error)
+    {
+        if (!p_fill(m_args) || !PL_cons_functor_v(m_fact, m_functor, m_args) ||
+            !PL_assert(m_fact, m_module, PL_ASSERTZ))
+        {
+            char* message = nullptr;
+            term_t exception = PL_exception(0);
+            if (exception && PL_get_chars(exception,
+                                          &message,
+                                          CVT_WRITE | CVT_EXCEPTION |
+                                              BUF_DISCARDABLE))
+            {
+                r_error = "Failed to assert " + m_name + " facts: " +
+                          String::utf8(message);
+            }
+            else
+            {
+                r_error = "Failed to assert " + m_name + " facts";
+            }
+            PL_clear_exception();
+            return false;
+        }
+        FactLoader::Listener::notify(m_fact);
+        PL_rewind_foreign_frame(m_fid);
+        m_count++;
+        return true;
+    }
+
+    int64_t count() const
+    {
+        return m_count;
+    }
+
+private:
+
+    String m_name;
+    module_t m_module;
+    functor_t m_functor;
+    term_t m_args;
+    term_t m_fact;
+    fid_t m_fid;
+    int64_t m_count = 0;
+};
+
+// -----------------------------------------------------------------------------
+// CSV
+// -----------------------------------------------------------------------------
+
+/**
+ * Splits a CSV input into records of cells (RFC 4180, plus LF endings),
+ * reading it by chunks. p_record(cells, line) is called with the cells of
+ * each record and the line (1-based) where it starts; it stops the reading
+ * if it returns false.
+ */
+template <typename RECORD>
+bool read_csv(FactLoader::Input& p_input,
+              char p_separator,
+              RECORD p_record,
+              String& r_error)
+{
+    enum class State
+    {
+        RECORD_START, //!< Between records: blank lines are skipped
+        FIELD_START,  //!< Before the first character of a field
+        UNQUOTED,     //!< In a field without quotes
+        QUOTED,       //!< In a quoted field
+        QUOTE,        //!< After a quote in a quoted field: "" or its end
+        AFTER_QUOTED  //!< After a quoted field: separator or end of line
+    };
+
+    // The cells are reused from one record to the next
+    std::vector<std::string> cells;
+    std::vector<char> chunk(CHUNK_SIZE);
+    State state = State::RECORD_START;
+    size_t fields = 0;
+    size_t columns = 0;
+    size_t line = 1;
+    size_t record_line = 1;
+    bool first_chunk = true;
+    bool first_record = true;
+
+    auto end_record = [&]() -> bool
+    {
+        // All the records must have the same number of fields
+        if (first_record)
+        {
+            columns = fields;
+            first_record = false;
+        }
+        else if (fields != columns)
+        {
+            r_error = "Line " + String::num_uint64(record_line) + " has " +
+                      String::num_uint64(fields) + " fields instead of " +
+                      String::num_uint64(columns);
+            return false;
+        }
+        cells.resize(fields);
+        state = State::RECORD_START;
+        return p_record(cells, record_line);
+    };
+
+    // The end of a field either starts the next one or ends the record
+    auto end_field = [&](char p_char) -> bool
+    {
+        fields++;
+        if (p_char == p_separator)
+        {
+            state = State::FIELD_START;
+            return true;
+        }
+        return end_record();
+    };
+
+    while (size_t size = p_input.read(chunk.data(), chunk.size()))
+    {
+        const char* cursor = chunk.data();
+        const char* end = cursor + size;
+
+        // Skip the UTF-8 byte order mark written by spreadsheet exports
+        if (first_chunk && size >= 3 && (unsigned char)cursor[0] == 0xEF &&
+            (unsigned char)cursor[1] == 0xBB &&
+            (unsigned char)cursor[2] == 0xBF)
+        {
+            cursor += 3;
+        }
+        first_chunk = false;
+
+        while (cursor < end)
+        {
+            char c = *cursor;
+            switch (state)
+            {
+                case State::RECORD_START:
+                    if (c == '\n' || c == '\r')
+                    {
+                        line += (c == '\n');
+                        ++cursor;
+                        break;
+                    }
+                    record_line = line;
+                    fields = 0;
+                    state = State::FIELD_START;
+                    break;
+                case State::FIELD_START:
+                    if (fields == cells.size())
+                        cells.emplace_back();
+                    cells[fields].clear();
+                    if (c == '"')
+                    {
+                        ++cursor;
+                        state = State::QUOTED;
+                    }
+                    else
+                    {
+                        state = State::UNQUOTED;
+                    }
+                    break;
+                case State::UNQUOTED:
+                {
+                    // Copy runs of plain characters at once
+                    const char* run = cursor;
+                    while (cursor < end && *cursor != p_separator &&
+                           *cursor != '\n' && *cursor != '\r')
+                    {
+                        ++cursor;
+                    }
+                    cells[fields].append(run, size_t(cursor - run));
+                    if (cursor < end)
+                    {
+                        // The separator is consumed, the end of line is
+                        // skipped by RECORD_START
+                        char stop = *cursor;
+                        cursor += (stop == p_separator);
+                        if (!end_field(stop))
+                            return false;
+                    }
+                    break;
+                }
+                case State::QUOTED:
+                {
+                    // Quoted field: may contain separators, newlines and ""
+                    const char* run = cursor;
+                    while (cursor < end && *cursor != '"')
+                    {
+                        line += (*cursor == '\n');
+                        ++cursor;
+                    }
+                    cells[fields].append(run, size_t(cursor - run));
+                    if (cursor < end)
+                    {
+                        ++cursor;
+                        state = State::QUOTE;
+                    }
+                    break;
+                }
+                case State::QUOTE:
+                    if (c == '"')
+                    {
+                        cells[fields] += '"';
+                        ++cursor;
+                        state = State::QUOTED;
+                    }
+                    else
+                    {
+                        state = State::AFTER_QUOTED;
+                    }
+                    break;
+                case State::AFTER_QUOTED:
+                    if (c != p_separator && c != '\n' && c != '\r')
+                    {
+                        r_error =
+                            "Unexpected character after quoted field at line " +
+                            String::num_uint64(line);
+                        return false;
+                    }
+                    cursor += (c == p_separator);
+                    if (!end_field(c))
+                        return false;
+                    break;
+            }
+        }
+    }
+
+    switch (state)
+    {
+        case State::RECORD_START:
+            return true;
+        case State::QUOTED:
+            r_error = "Unterminated quoted field at line " +
+                      String::num_uint64(record_line);
+            return false;
+        case State::FIELD_START:
+            // Separator at the end of the input: last field empty
+            if (fields == cells.size())
+                cells.emplace_back();
+            cells[fields].clear();
+            fields++;
+            return end_record();
+        default:
+            fields++;
+            return end_record();
+    }
+}
+
+// -----------------------------------------------------------------------------
+// JSON
+// -----------------------------------------------------------------------------
+
+/** Checks that a JSON value can be converted to a type. */
+bool json_convertible(JsonValue const& p_value, ValueType p_type)
+{
+    switch (p_value.type)
+    {
+        case JsonValue::Type::OBJECT:
+            return false;
+        case JsonValue::Type::ARRAY:
+            if (p_type != ValueType::INFER)
+                return false;
+            for (JsonValue const& item : p_value.items)
+            {
+                if (!json_convertible(item, ValueType::INFER))
+                    return false;
+            }
+            return true;
+        case JsonValue::Type::STRING:
+            return text_convertible(p_value.text, p_type);
+        case JsonValue::Type::INTEGER:
+            return true;
+        case JsonValue::Type::NUMBER:
+            return p_type != ValueType::INT;
+        default: // null and booleans
+            return p_type != ValueType::INT && p_type != ValueType::FLOAT;
+    }
+}
+
+/** Puts a JSON value validated by json_convertible() in a term. */
+bool put_json(term_t p_term, JsonValue const& p_value, ValueType p_type)
+{
+    switch (p_value.type)
+    {
+        case JsonValue::Type::ARRAY:
+        {
+            term_t item = PL_new_term_ref();
+            if (!PL_put_nil(p_term))
+                return false;
+            for (size_t i = p_value.items.size(); i-- > 0;)
+            {
+                if (!put_json(item, p_value.items[i], ValueType::INFER) ||
+                    !PL_cons_list(p_term, item, p_term))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case JsonValue::Type::STRING:
+            return put_text(p_term,
+                            p_value.text,
+                            (p_type == ValueType::INFER) ? ValueType::ATOM
+                                                         : p_type);
+        case JsonValue::Type::INTEGER:
+            if (p_type == ValueType::INT || p_type == ValueType::INFER)
+                return PL_put_int64(p_term, p_value.integer);
+            if (p_type == ValueType::FLOAT)
+                return PL_put_float(p_term, (double)p_value.integer);
+            return put_text(p_term, std::to_string(p_value.integer), p_type);
+        case JsonValue::Type::NUMBER:
+            if (p_type == ValueType::FLOAT || p_type == ValueType::INFER)
+                return PL_put_float(p_term, p_value.number);
+        {
+            // Written with a '.' whatever the C locale
+            std::ostringstream text;
+            text.imbue(std::locale::classic());
+            text.precision(17);
+            text << p_value.number;
+            return put_text(p_term, text.str(), p_type);
+        }
+        case JsonValue::Type::BOOLEAN:
+            return put_text(p_term,
+                            p_value.boolean ? "true" : "false",
+                            (p_type == ValueType::STRING) ? p_type
+                                                          : ValueType::ATOM);
+        default:
+            return put_text(p_term,
+                            "null",
+                            (p_type == ValueType::STRING) ? p_type
+                                                          : ValueType::ATOM);
+    }
+}
+
+} // namespace
+
+// =============================================================================
+// FactLoader
+// =============================================================================
+
+bool FactLoader::parse_types(PackedStringArray const& p_names,
+                             std::vector<ValueType>& r_types,
+                             String& r_error)
+{
+    r_types.clear();
+    for (int64_t i = 0; i < p_names.size(); i++)
+    {
+        String name = p_names[i];
+        if (name == "int")
+            r_types.push_back(ValueType::INT);
+        else if (name == "float")
+            r_types.push_back(ValueType::FLOAT);
+        else if (name == "atom")
+            r_types.push_back(ValueType::ATOM);
+        else if (name == "string")
+            r_types.push_back(ValueType::STRING);
+        else if (name == "auto" || name.is_empty())
+            r_types.push_back(ValueType::INFER);
+        else
+        {
+            r_error = "Unknown column type: " + name;
+            return false;
+        }
+    }
+    return true;
+}
+
+int64_t FactLoader::load_csv(Input& p_input,
+                             String const& p_functor,
+                             module_t p_module,
+                             std::vector<ValueType> const& p_types,
+                             char p_separator,
+                             bool p_header,
+                             String& r_error)
+{
+    // First pass: validate the declared types, infer the others from the
+    // whole column
+    std::vector<ValueType> declared;
+    std::vector<ValueType> types;
+    size_t rows = 0;
+    bool header = p_header;
+    bool ok = read_csv(
+        p_input,
+        p_separator,
+        [&](std::vector<std::string> const& p_cells, size_t p_line)
+        {
+            if (header)
+            {
+                header = false;
+                return true;
+            }
+            size_t columns = p_cells.size();
+            if (rows++ == 0)
+            {
+                if (!p_types.empty() && p_types.size() != columns)
+                {
+                    r_error = "Expected " +
+                              String::num_uint64(p_types.size()) +
+                              " columns but the CSV has " +
+                              String::num_uint64(columns);
+                    return false;
+                }
+                declared = p_types;
+                declared.resize(columns, ValueType::INFER);
+                types = declared;
+                for (ValueType& type : types)
+                {
+                    if (type == ValueType::INFER)
+                        type = ValueType::INT;
+                }
+            }
+            for (size_t column = 0; column < columns; column++)
+            {
+                std::string const& cell = p_cells[column];
+                if (text_convertible(cell, types[column]))
+                    continue;
+                if (declared[column] != ValueType::INFER)
+                {
+                    r_error = "Line " + String::num_uint64(p_line) +
+                              ", column " + String::num_uint64(column + 1) +
+                              ": '" + String::utf8(cell.c_str()) +
+                              "' is not " + type_name(types[column]);
+                    return false;
+                }
+                // Widen the inferred type: int -> float -> atom
+                types[column] = text_convertible(cell, ValueType::FLOAT)
+                                    ? ValueType::FLOAT
+                                    : ValueType::ATOM;
+            }
+            return true;
+        },
+        r_error);
+    if (!ok)
+        return -1;
+    if (rows == 0)
+        return 0;
+
+    // Second pass: assert the rows
+    if (!p_input.rewind())
+    {
+        r_error = "Cannot read the CSV file again";
+        return -1;
+    }
+    FactWriter writer(p_functor, p_module, types.size());
+    header = p_header;
+    ok = read_csv(
+        p_input,
+        p_separator,
+        [&](std::vector<std::string> const& p_cells, size_t)
+        {
+            if (header)
+            {
+                header = false;
+                return true;
+            }
+            return writer.add(
+                [&](term_t p_args)
+                {
+                    for (size_t i = 0; i < types.size(); i++)
+                    {
+                        if (!put_text(p_args + i, p_cells[i], types[i]))
+                            return false;
+                    }
+                    return true;
+                },
+                r_error);
+        },
+        r_error);
+    return ok ? writer.count() : -1;
+}
+
+int64_t FactLoader::load_json(Input& p_input,
+                              String const& p_root,
+                              String const& p_functor,
+                              module_t p_module,
+                              PackedStringArray const& p_fields,
+                              std::vector<ValueType> const& p_types,
+                              String& r_error)
+{
+    size_t arity = (size_t)p_fields.size();
+    if (arity == 0)
+    {
+        r_error = "No field to load from the JSON objects";
+        return -1;
+    }
+    if (!p_types.empty() && p_types.size() != arity)
+    {
+        r_error = "Expected one type per field";
+        return -1;
+    }
+
+    std::vector<std::string> fields;
+    for (int64_t i = 0; i < p_fields.size(); i++)
+    {
+        fields.push_back(p_fields[i].utf8().get_data());
+    }
+    std::vector<ValueType> types = p_types;
+    types.resize(arity, ValueType::INFER);
+    std::string root = p_root.utf8().get_data();
+    JsonValue::ReadFunction read = [&](char* r_data, size_t p_size)
+    { return p_input.read(r_data, p_size); };
+
+    // First pass: validate the fields of every object
+    std::string error;
+    bool ok = JsonValue::parse_items(
+        read,
+        root,
+        [&](JsonValue const& p_row, size_t p_index)
+        {
+            for (size_t i = 0; i < arity; i++)
+            {
+                JsonValue const* value = p_row.find(fields[i]);
+                if (value == nullptr || !json_convertible(*value, types[i]))
+                {
+                    r_error = "Row " + String::num_uint64(p_index) +
+                              ": field '" + p_fields[i] +
+                              ((value == nullptr) ? "' is missing"
+                                                  : "' has an invalid value");
+                    return false;
+                }
+            }
+            return true;
+        },
+        error);
+    if (!ok)
+    {
+        if (!error.empty())
+            r_error = String::utf8(error.c_str());
+        return -1;
+    }
+
+    // Second pass: assert the objects
+    if (!p_input.rewind())
+    {
+        r_error = "Cannot read the JSON file again";
+        return -1;
+    }
+    FactWriter writer(p_functor, p_module, arity);
+    ok = JsonValue::parse_items(
+        read,
+        root,
+        [&](JsonValue const& p_row, size_t)
+        {
+            return writer.add(
+                [&](term_t p_args)
+                {
+                    for (size_t i = 0; i < arity; i++)
+                    {
+                        JsonValue const* value = p_row.find(fields[i]);
+                        if (value == nullptr ||
+                            !json_convertible(*value, types[i]) ||
+                            !put_json(p_args + i, *value, types[i]))
+                        {
+                            return false;
+                        }
+                    }
+                    return true;
+                },
+                r_error);
+        },
+        error);
+    if (!ok && !error.empty())
+        r_error = String::utf8(error.c_str());
+    return ok ? writer.count() : -1;
+}
+
+int64_t
+FactLoader::assert_rows(String const& p_functor,
+                        module_t p_module,
+                        size_t p_arity,
+                        size_t p_rows,
+                        std::function<bool(size_t, term_t)> const& p_fill,
+                        String& r_error)
+{
+    FactWriter writer(p_functor, p_module, p_arity);
+    for (size_t row = 0; row < p_rows; row++)
+    {
+        if (!writer.add([&](term_t p_args) { return p_fill(row, p_args); },
+                        r_error))
+        {
+            return -1;
+        }
+    }
+    return writer.count();
+}
+
+// =============================================================================
+// FactLoader::FileInput
+// =============================================================================
+
+FactLoader::FileInput::FileInput(Ref<FileAccess> p_file) : m_file(p_file) {}
+
+size_t FactLoader::FileInput::read(char* r_data, size_t p_size)
+{
+    PackedByteArray bytes = m_file->get_buffer(int64_t(p_size));
+    memcpy(r_data, bytes.ptr(), size_t(bytes.size()));
+    return size_t(bytes.size());
+}
+
+bool FactLoader::FileInput::rewind()
+{
+    m_file->seek(0);
+    return m_file->get_error() == OK;
+}
+
+// =============================================================================
+// FactLoader::Listener
+// =============================================================================
+
+FactLoader::Listener::Listener(std::function<void(term_t)> p_on_assert)
+    : m_on_assert(std::move(p_on_assert)), m_previous(s_listener)
+{
+    s_listener = this;
+}
+
+FactLoader::Listener::~Listener()
+{
+    s_listener = m_previous;
+}
+
+void FactLoader::Listener::notify(term_t p_fact)
+{
+    if (s_listener != nullptr)
+        s_listener->m_on_assert(p_fact);
+}
+
+void FactLoader::Listener::register_predicates()
+{
+    PL_register_foreign_in_module(
+        "user", "$prologot_asserted", 1, (pl_function_t)pl_asserted, 0);
+}
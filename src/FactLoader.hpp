@@ -0,0 +1,195 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the FactLoader class: bulk loading of CSV and JSON data
+ * as Prolog facts, without going through GDScript nor the Prolog parser.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace godot;
+
+/**
+ * @class FactLoader
+ * @brief Parses tabular data and asserts one fact per row.
+ *
+ * The input is read by chunks and parsed twice: a first pass validates
+ * every row (and infers the types of the columns), a second pass converts
+ * each row directly to a term (no intermediate string nor Variant) and
+ * asserts it with PL_assert(). Only the row being parsed is kept in memory,
+ * and a malformed file does not leave half of its facts behind.
+ */
+class FactLoader
+{
+public:
+
+    /** Bytes of a file, read by chunks. */
+    class Input
+    {
+    public:
+
+        virtual ~Input() = default;
+
+        /**
+         * @brief Reads the next bytes into r_data (at most p_size).
+         * @return The number of bytes read, 0 at the end of the input.
+         */
+        virtual size_t read(char* r_data, size_t p_size) = 0;
+
+        /**
+         * @brief Goes back to the first byte, for the second pass.
+         * @return false on failure.
+         */
+        virtual bool rewind() = 0;
+    };
+
+    /** Input reading a file opened with FileAccess (also in a PCK). */
+    class FileInput : public Input
+    {
+    public:
+
+        explicit FileInput(Ref<FileAccess> p_file);
+        size_t read(char* r_data, size_t p_size) override;
+        bool rewind() override;
+
+    private:
+
+        Ref<FileAccess> m_file;
+    };
+
+    /**
+     * @brief While it exists, passes each fact asserted by this thread to a
+     * function (e.g., to match it against the forward rules).
+     */
+    class Listener
+    {
+    public:
+
+        explicit Listener(std::function<void(term_t)> p_on_assert);
+        ~Listener();
+        Listener(Listener const&) = delete;
+        Listener& operator=(Listener const&) = delete;
+
+        /** @brief Passes a fact just asserted to the current listener. */
+        static void notify(term_t p_fact);
+
+        /**
+         * @brief Registers '$prologot_asserted'(+Fact), which passes a fact
+         * asserted by Prolog code to the current listener.
+         */
+        static void register_predicates();
+
+    private:
+
+        std::function<void(term_t)> m_on_assert;
+        //! Listener replaced by this one, restored by the destructor.
+        Listener* m_previous;
+    };
+
+    /** Type of the values of a column. */
+    enum class ValueType
+    {
+        INFER,  //!< Deduced from the data
+        INT,    //!< Prolog integer
+        FLOAT,  //!< Prolog float
+        ATOM,   //!< Prolog atom
+        STRING  //!< Prolog string
+    };
+
+    /**
+     * @brief Parses column type names ("int", "float", "atom", "string" or
+     * "auto").
+     *
+     * @param p_names Type names.
+     * @param r_types Parsed types.
+     * @param r_error Error message on unknown type name.
+     * @return true if all the names are valid.
+     */
+    static bool parse_types(PackedStringArray const& p_names,
+                            std::vector<ValueType>& r_types,
+                            String& r_error);
+
+    /**
+     * @brief Asserts the rows of a CSV text as p_functor/N facts.
+     *
+     * Fields may be quoted with double quotes (doubled inside quotes to
+     * escape them) and span several lines. Undeclared column types are
+     * inferred from all the cells of the column: int, then float, then atom.
+     * Numbers are read with a '.' decimal point, whatever the C locale.
+     *
+     * @param p_input UTF-8 CSV text.
+     * @param p_functor Functor of the facts.
+     * @param p_module Module of the facts (NULL for user).
+     * @param p_types Column types (empty to infer them all).
+     * @param p_separator Field separator.
+     * @param p_header Whether the first line holds column names to skip.
+     * @param r_error Error message, with the line number, on failure.
+     * @return The number of facts asserted, or -1 on failure.
+     */
+    static int64_t load_csv(Input& p_input,
+                            String const& p_functor,
+                            module_t p_module,
+                            std::vector<ValueType> const& p_types,
+                            char p_separator,
+                            bool p_header,
+                            String& r_error);
+
+    /**
+     * @brief Asserts the objects of a JSON array as p_functor/N facts.
+     *
+     * Each object gives one fact whose arguments are the values of p_fields.
+     * Numbers map to integers or floats, strings to atoms, booleans and null
+     * to the atoms true, false and null, and arrays to lists.
+     *
+     * @param p_input UTF-8 JSON text.
+     * @param p_root Member of the top-level object holding the array of
+     * objects, or empty if the document is the array.
+     * @param p_functor Functor of the facts.
+     * @param p_module Module of the facts (NULL for user).
+     * @param p_fields Object member read for each argument.
+     * @param p_types Argument types (empty to infer them all).
+     * @param r_error Error message, with the row index or the byte offset,
+     * on failure.
+     * @return The number of facts asserted, or -1 on failure.
+     */
+    static int64_t load_json(Input& p_input,
+                             String const& p_root,
+                             String const& p_functor,
+                             module_t p_module,
+                             PackedStringArray const& p_fields,
+                             std::vector<ValueType> const& p_types,
+                             String& r_error);
+
+    /**
+     * @brief Asserts rows produced by native code as p_functor/N facts.
+     *
+     * @param p_functor Functor of the facts.
+     * @param p_module Module of the facts (NULL for user).
+     * @param p_arity Number of arguments N.
+     * @param p_rows Number of facts.
+     * @param p_fill Puts the arguments of a row in the N consecutive term
+     * references it receives; only fails on resource errors.
+     * @param r_error Error message on failure.
+     * @return The number of facts asserted, or -1 on failure.
+     */
+    static int64_t
+    assert_rows(String const& p_functor,
+                module_t p_module,
+                size_t p_arity,
+                size_t p_rows,
+                std::function<bool(size_t, term_t)> const& p_fill,
+                String& r_error);
+};
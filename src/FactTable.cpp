@@ -0,0 +1,1152 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the FactTable class.
+ */
+
+#include "FactTable.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#ifdef _WIN32
+#    include <windows.h> // For CreateFileMapping and MapViewOfFile
+#else
+#    include <fcntl.h>    // For open
+#    include <sys/mman.h> // For mmap
+#    include <sys/stat.h> // For fstat
+#    include <unistd.h>   // For close
+#endif
+#include <godot_cpp/variant/packed_float32_array.hpp>
+#include <godot_cpp/variant/packed_float64_array.hpp>
+#include <godot_cpp/variant/packed_int64_array.hpp>
+
+// =============================================================================
+// Static Member Initialization
+// =============================================================================
+
+std::unordered_map<atom_t, std::shared_ptr<FactTable>> FactTable::s_tables;
+std::mutex FactTable::s_mutex;
+
+// =============================================================================
+// Binary Fact File Format
+// =============================================================================
+
+namespace
+{
+
+//! Removed rows below which a table is never compacted.
+const size_t COMPACT_MIN_REMOVED = 64;
+
+//! First bytes of a binary fact file.
+const char FACT_FILE_MAGIC[8] = { 'P', 'L', 'G', 'T', 'F', 'A', 'C', 'T' };
+//! Format version, bumped on incompatible changes.
+const uint32_t FACT_FILE_VERSION = 1;
+//! Read back as another value on a machine with a different endianness.
+const uint32_t FACT_FILE_BYTE_ORDER = 0x01020304;
+//! Sanity limit on the number of columns.
+const uint32_t FACT_FILE_MAX_ARITY = 1024;
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t arity;
+    uint32_t name_length;
+    uint64_t rows;
+    uint64_t symbol_count;
+    uint64_t name_offset;
+    uint64_t symbols_offset;
+    uint64_t text_offset;
+    uint64_t text_length;
+};
+
+struct ColumnHeader
+{
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t cells_offset;
+};
+
+size_t align8(size_t p_size)
+{
+    return (p_size + 7) & ~size_t(7);
+}
+
+} // namespace
+
+// =============================================================================
+// Memory Mapping
+// =============================================================================
+
+class FactTable::MappedFile
+{
+public:
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (m_data != nullptr)
+            UnmapViewOfFile(m_data);
+        if (m_mapping != NULL)
+            CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+#else
+        if (m_data != nullptr)
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+    }
+
+    /** Maps the whole file read-only, returns nullptr on failure. */
+    static std::unique_ptr<MappedFile> open(String const& p_path,
+                                            String& r_error)
+    {
+        std::unique_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+        file->m_file = CreateFileW((LPCWSTR)p_path.utf16().get_data(),
+                                   GENERIC_READ,
+                                   FILE_SHARE_READ,
+                                   NULL,
+                                   OPEN_EXISTING,
+                                   FILE_ATTRIBUTE_NORMAL,
+                                   NULL);
+        LARGE_INTEGER size;
+        if (file->m_file == INVALID_HANDLE_VALUE ||
+            !GetFileSizeEx(file->m_file, &size))
+        {
+            r_error = "Cannot open fact file: " + p_path;
+            return nullptr;
+        }
+        file->m_size = (size_t)size.QuadPart;
+        if (file->m_size == 0)
+        {
+            r_error = "Empty fact file: " + p_path;
+            return nullptr;
+        }
+        file->m_mapping =
+            CreateFileMappingW(file->m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (file->m_mapping != NULL)
+        {
+            file->m_data = (const uint8_t*)MapViewOfFile(
+                file->m_mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+#else
+        int fd = ::open(p_path.utf8().get_data(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0)
+        {
+            if (fd >= 0)
+                close(fd);
+            r_error = "Cannot open fact file: " + p_path;
+            return nullptr;
+        }
+        file->m_size = (size_t)info.st_size;
+        if (file->m_size == 0)
+        {
+            close(fd);
+            r_error = "Empty fact file: " + p_path;
+            return nullptr;
+        }
+        // MAP_SHARED: the pages are shared with other processes mapping it
+        void* data = mmap(nullptr, file->m_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd); // The mapping stays valid after closing the descriptor
+        if (data != MAP_FAILED)
+        {
+            file->m_data = (const uint8_t*)data;
+        }
+#endif
+        if (file->m_data == nullptr)
+        {
+            r_error = "Cannot memory-map fact file: " + p_path;
+            return nullptr;
+        }
+        return file;
+    }
+
+    const uint8_t* data() const
+    {
+        return m_data;
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    /** Checks that [p_offset, p_offset + p_length) lies in the file. */
+    bool contains(uint64_t p_offset, uint64_t p_length) const
+    {
+        return p_offset <= m_size && p_length <= m_size - p_offset;
+    }
+
+private:
+
+    MappedFile() = default;
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = NULL;
+#endif
+};
+
+// =============================================================================
+// Enumeration State
+// =============================================================================
+
+struct FactTable::Cursor
+{
+    explicit Cursor(std::shared_ptr<FactTable> const& p_table)
+        : table(p_table)
+    {
+        table->m_cursors++;
+    }
+
+    ~Cursor()
+    {
+        table->m_cursors--;
+    }
+
+    //! Keeps the table alive while it is enumerated, even if dropped.
+    std::shared_ptr<FactTable> table;
+    //! Rows sharing the value of an indexed argument, or nullptr to scan.
+    std::vector<uint32_t> const* bucket = nullptr;
+    //! Next position in the bucket or in the table.
+    size_t position = 0;
+    //! Rows (or bucket entries) visible when the enumeration started.
+    size_t end = 0;
+    //! Columns whose argument is bound, and the expected cell values.
+    std::vector<size_t> bound_columns;
+    std::vector<int64_t> keys;
+    //! Row found by advance().
+    size_t row = 0;
+};
+
+// =============================================================================
+// Table Registry
+// =============================================================================
+
+std::shared_ptr<FactTable>
+FactTable::create(String const& p_name,
+                  PackedStringArray const& p_column_types,
+                  Array const& p_columns,
+                  PackedInt32Array const& p_indexes,
+                  String& r_error)
+{
+    if (p_name.is_empty())
+    {
+        r_error = "Empty fact table name";
+        return nullptr;
+    }
+    if (p_column_types.is_empty())
+    {
+        r_error = "Fact table " + p_name + " has no column";
+        return nullptr;
+    }
+
+    // Parse the column types
+    std::vector<ColumnType> types;
+    for (int64_t i = 0; i < p_column_types.size(); i++)
+    {
+        String type = p_column_types[i];
+        if (type == "int")
+            types.push_back(ColumnType::INT);
+        else if (type == "float")
+            types.push_back(ColumnType::FLOAT);
+        else if (type == "atom")
+            types.push_back(ColumnType::ATOM);
+        else
+        {
+            r_error = "Unknown column type '" + type + "' in fact table " +
+                      p_name + " (expected int, float or atom)";
+            return nullptr;
+        }
+    }
+
+    CharString name = p_name.utf8();
+    atom_t name_atom =
+        PL_new_atom_mbchars(REP_UTF8, name.length(), name.get_data());
+    std::shared_ptr<FactTable> table(new FactTable(name_atom, types));
+
+    if (!table->set_indexes(p_indexes, r_error))
+        return nullptr;
+
+    // Fill the table before replacing the previous one
+    if (!p_columns.is_empty() && !table->append(p_columns, r_error))
+        return nullptr;
+    if (!publish(table, r_error))
+        return nullptr;
+    return table;
+}
+
+std::shared_ptr<FactTable> FactTable::map(String const& p_path,
+                                          PackedInt32Array const& p_indexes,
+                                          String& r_error)
+{
+    std::unique_ptr<MappedFile> file = MappedFile::open(p_path, r_error);
+    if (file == nullptr)
+        return nullptr;
+
+    // Check the header
+    const uint8_t* data = file->data();
+    FileHeader header;
+    if (!file->contains(0, sizeof(header)))
+    {
+        r_error = "Truncated fact file: " + p_path;
+        return nullptr;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, FACT_FILE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        r_error = "Not a fact file: " + p_path;
+        return nullptr;
+    }
+    if (header.byte_order != FACT_FILE_BYTE_ORDER ||
+        header.version != FACT_FILE_VERSION)
+    {
+        r_error = "Unsupported fact file version or byte order: " + p_path;
+        return nullptr;
+    }
+
+    // Check that every section lies in the file. The sizes are checked
+    // against the file size first so that the products cannot overflow.
+    size_t columns_size = header.arity * sizeof(ColumnHeader);
+    bool valid =
+        header.arity > 0 && header.arity <= FACT_FILE_MAX_ARITY &&
+        header.rows <= file->size() / sizeof(int64_t) &&
+        header.rows <= UINT32_MAX &&
+        header.symbol_count < file->size() / sizeof(uint64_t) &&
+        file->contains(sizeof(header), columns_size) &&
+        file->contains(header.name_offset, header.name_length) &&
+        file->contains(header.symbols_offset,
+                       (header.symbol_count + 1) * sizeof(uint64_t)) &&
+        file->contains(header.text_offset, header.text_length) &&
+        header.symbols_offset % sizeof(uint64_t) == 0;
+
+    std::vector<ColumnType> types;
+    std::vector<ColumnHeader> columns(valid ? header.arity : 0);
+    for (size_t i = 0; i < columns.size() && valid; i++)
+    {
+        memcpy(&columns[i],
+               data + sizeof(header) + i * sizeof(ColumnHeader),
+               sizeof(ColumnHeader));
+        valid = columns[i].type <= (uint32_t)ColumnType::ATOM &&
+                columns[i].cells_offset % sizeof(int64_t) == 0 &&
+                file->contains(columns[i].cells_offset,
+                               header.rows * sizeof(int64_t));
+        types.push_back((ColumnType)columns[i].type);
+    }
+
+    // Symbol offsets must be increasing and stay in the text
+    const uint64_t* offsets =
+        valid ? (const uint64_t*)(data + header.symbols_offset) : nullptr;
+    for (size_t i = 0; i < header.symbol_count && valid; i++)
+    {
+        valid = offsets[i] <= offsets[i + 1] &&
+                offsets[i + 1] <= header.text_length;
+    }
+    if (!valid)
+    {
+        r_error = "Corrupted fact file: " + p_path;
+        return nullptr;
+    }
+
+    atom_t name_atom =
+        PL_new_atom_mbchars(REP_UTF8,
+                            header.name_length,
+                            (const char*)data + header.name_offset);
+    std::shared_ptr<FactTable> table(new FactTable(name_atom, types));
+
+    // Serve the cells straight from the mapped pages
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+        table->m_columns[i].cells =
+            (const int64_t*)(data + columns[i].cells_offset);
+    }
+    table->m_rows = (size_t)header.rows;
+    table->m_symbol_offsets = offsets;
+    table->m_symbol_text = (const char*)data + header.text_offset;
+    table->m_symbol_count = (size_t)header.symbol_count;
+    table->m_symbols_resolved = (header.symbol_count == 0);
+    table->m_file = std::move(file);
+
+    if (!table->set_indexes(p_indexes, r_error))
+        return nullptr;
+    table->index_rows(0);
+    if (!publish(table, r_error))
+        return nullptr;
+    return table;
+}
+
+bool FactTable::set_indexes(PackedInt32Array const& p_indexes,
+                            String& r_error)
+{
+    for (int64_t i = 0; i < p_indexes.size(); i++)
+    {
+        int32_t column = p_indexes[i];
+        if (column < 0 || column >= (int32_t)m_columns.size())
+        {
+            r_error = "Invalid index column " + String::num_int64(column) +
+                      " in fact table " + name();
+            return false;
+        }
+        m_columns[column].indexed = true;
+    }
+    return true;
+}
+
+bool FactTable::publish(std::shared_ptr<FactTable> const& p_table,
+                        String& r_error)
+{
+    // Serve the table through a foreign predicate named after it
+    if (!PL_register_foreign_in_module("user",
+                                       PL_atom_chars(p_table->m_name),
+                                       (int)p_table->arity(),
+                                       (pl_function_t)FactTable::predicate,
+                                       PL_FA_NONDETERMINISTIC | PL_FA_VARARGS))
+    {
+        r_error =
+            "Failed to register the predicate of fact table " + p_table->name();
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_tables[p_table->m_name] = p_table;
+    return true;
+}
+
+std::shared_ptr<FactTable> FactTable::find(String const& p_name)
+{
+    CharString name = p_name.utf8();
+    atom_t name_atom =
+        PL_new_atom_mbchars(REP_UTF8, name.length(), name.get_data());
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto it = s_tables.find(name_atom);
+    PL_unregister_atom(name_atom);
+    return (it == s_tables.end()) ? nullptr : it->second;
+}
+
+bool FactTable::drop(String const& p_name)
+{
+    std::shared_ptr<FactTable> table = find(p_name);
+    if (table == nullptr)
+        return false;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_tables.erase(table->m_name);
+    return true;
+}
+
+void FactTable::drop_all()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_tables.clear();
+}
+
+// =============================================================================
+// Construction and Loading
+// =============================================================================
+
+FactTable::FactTable(atom_t p_name, std::vector<ColumnType> const& p_types)
+    : m_name(p_name)
+{
+    m_columns.resize(p_types.size());
+    for (size_t i = 0; i < p_types.size(); i++)
+    {
+        m_columns[i].type = p_types[i];
+    }
+}
+
+FactTable::~FactTable()
+{
+    // Release the atoms created by PL_new_atom*() (0 if not yet resolved)
+    for (atom_t atom : m_atoms)
+    {
+        if (atom != 0)
+            PL_unregister_atom(atom);
+    }
+    PL_unregister_atom(m_name);
+}
+
+size_t FactTable::row_count() const
+{
+    return m_rows - m_removed_count;
+}
+
+size_t FactTable::stored_row_count() const
+{
+    return m_rows;
+}
+
+size_t FactTable::arity() const
+{
+    return m_columns.size();
+}
+
+String FactTable::name() const
+{
+    return String::utf8(PL_atom_chars(m_name));
+}
+
+std::string FactTable::symbol_text(int64_t p_id) const
+{
+    return std::string(m_symbol_text + m_symbol_offsets[p_id],
+                       m_symbol_offsets[p_id + 1] - m_symbol_offsets[p_id]);
+}
+
+void FactTable::resolve_symbols()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (m_symbols_resolved)
+        return;
+
+    m_atoms.resize(m_symbol_count);
+    for (size_t i = 0; i < m_symbol_count; i++)
+    {
+        std::string text = symbol_text((int64_t)i);
+        m_atoms[i] = PL_new_atom_mbchars(REP_UTF8, text.size(), text.c_str());
+        m_atom_ids[m_atoms[i]] = (int64_t)i;
+    }
+    m_symbols_resolved = true;
+}
+
+int64_t FactTable::intern(std::string const& p_text)
+{
+    auto it = m_symbol_ids.find(p_text);
+    if (it != m_symbol_ids.end())
+        return it->second;
+
+    atom_t atom =
+        PL_new_atom_mbchars(REP_UTF8, p_text.size(), p_text.c_str());
+    int64_t id = (int64_t)m_atoms.size();
+    m_atoms.push_back(atom);
+    m_atom_ids[atom] = id;
+    m_symbol_ids.emplace(p_text, id);
+    return id;
+}
+
+bool FactTable::append_column(Column& p_column, Variant const& p_values)
+{
+    std::vector<int64_t>& cells = p_column.storage;
+
+    switch (p_column.type)
+    {
+        case ColumnType::INT:
+            if (p_values.get_type() == Variant::PACKED_INT32_ARRAY)
+            {
+                PackedInt32Array values = p_values;
+                const int32_t* data = values.ptr();
+                cells.insert(cells.end(), data, data + values.size());
+                return true;
+            }
+            if (p_values.get_type() == Variant::PACKED_INT64_ARRAY)
+            {
+                PackedInt64Array values = p_values;
+                const int64_t* data = values.ptr();
+                cells.insert(cells.end(), data, data + values.size());
+                return true;
+            }
+            break;
+
+        case ColumnType::FLOAT:
+        {
+            // Floats are stored as their bit pattern
+            auto push_double = [&cells](double p_value)
+            {
+                int64_t bits;
+                memcpy(&bits, &p_value, sizeof(bits));
+                cells.push_back(bits);
+            };
+            if (p_values.get_type() == Variant::PACKED_FLOAT32_ARRAY)
+            {
+                PackedFloat32Array values = p_values;
+                for (int64_t i = 0; i < values.size(); i++)
+                    push_double(values[i]);
+                return true;
+            }
+            if (p_values.get_type() == Variant::PACKED_FLOAT64_ARRAY)
+            {
+                PackedFloat64Array values = p_values;
+                for (int64_t i = 0; i < values.size(); i++)
+                    push_double(values[i]);
+                return true;
+            }
+            if (p_values.get_type() == Variant::ARRAY)
+            {
+                Array values = p_values;
+                for (int64_t i = 0; i < values.size(); i++)
+                    push_double(values[i]);
+                return true;
+            }
+            return false;
+        }
+
+        case ColumnType::ATOM:
+            if (p_values.get_type() == Variant::PACKED_STRING_ARRAY)
+            {
+                PackedStringArray values = p_values;
+                for (int64_t i = 0; i < values.size(); i++)
+                    cells.push_back(intern(values[i].utf8().get_data()));
+                return true;
+            }
+            if (p_values.get_type() == Variant::ARRAY)
+            {
+                Array values = p_values;
+                for (int64_t i = 0; i < values.size(); i++)
+                {
+                    String value = values[i];
+                    cells.push_back(intern(value.utf8().get_data()));
+                }
+                return true;
+            }
+            return false;
+    }
+
+    // Generic Array for integer columns
+    if (p_values.get_type() == Variant::ARRAY)
+    {
+        Array values = p_values;
+        for (int64_t i = 0; i < values.size(); i++)
+            cells.push_back((int64_t)values[i]);
+        return true;
+    }
+    return false;
+}
+
+bool FactTable::append(Array const& p_columns, String& r_error)
+{
+    if (m_file != nullptr)
+    {
+        r_error = "Fact table " + name() + " is mapped from a file: read-only";
+        return false;
+    }
+    if (p_columns.size() != (int64_t)m_columns.size())
+    {
+        r_error = "Fact table " + name() + " expects " +
+                  String::num_int64(m_columns.size()) + " columns, got " +
+                  String::num_int64(p_columns.size());
+        return false;
+    }
+
+    // Compaction may have been deferred by a query
+    compact();
+
+    // Append each column, then check they all have the same length
+    for (size_t i = 0; i < m_columns.size(); i++)
+    {
+        if (!append_column(m_columns[i], p_columns[i]))
+        {
+            r_error = "Invalid values for column " + String::num_int64(i) +
+                      " of fact table " + name();
+            break;
+        }
+        if (m_columns[i].storage.size() != m_columns[0].storage.size())
+        {
+            r_error = "Columns of fact table " + name() +
+                      " do not have the same length";
+            break;
+        }
+    }
+
+    // All or nothing: roll back the partially appended columns
+    if (!r_error.is_empty())
+    {
+        for (Column& column : m_columns)
+        {
+            column.storage.resize(m_rows);
+        }
+        return false;
+    }
+
+    // The storage may have been reallocated
+    for (Column& column : m_columns)
+    {
+        column.cells = column.storage.data();
+    }
+    size_t first_new_row = m_rows;
+    m_rows = m_columns[0].storage.size();
+    index_rows(first_new_row);
+    return true;
+}
+
+int64_t FactTable::remove(Array const& p_key, String& r_error)
+{
+    if (m_file != nullptr)
+    {
+        r_error = "Fact table " + name() + " is mapped from a file: read-only";
+        return -1;
+    }
+    if (p_key.size() > (int64_t)m_columns.size())
+    {
+        r_error = "Fact table " + name() + " has only " +
+                  String::num_int64(m_columns.size()) + " columns";
+        return -1;
+    }
+
+    // Convert the key. A value that no cell can hold matches no row.
+    std::vector<size_t> columns;
+    std::vector<int64_t> keys;
+    for (int64_t i = 0; i < p_key.size(); i++)
+    {
+        if (p_key[i].get_type() == Variant::NIL)
+            continue;
+        int64_t key;
+        if (!variant_key(m_columns[i], p_key[i], key))
+            return 0;
+        columns.push_back((size_t)i);
+        keys.push_back(key);
+    }
+
+    // Visit the rows of the most selective index, or all the rows
+    std::vector<uint32_t> const* bucket = nullptr;
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+        Column const& column = m_columns[columns[i]];
+        if (!column.indexed)
+            continue;
+        auto it = column.index.find(keys[i]);
+        if (it == column.index.end())
+            return 0;
+        if (bucket == nullptr || it->second.size() < bucket->size())
+            bucket = &it->second;
+    }
+
+    int64_t removed = 0;
+    size_t end = bucket ? bucket->size() : m_rows;
+    for (size_t position = 0; position < end; position++)
+    {
+        size_t row = bucket ? (*bucket)[position] : position;
+        if (is_removed(row))
+            continue;
+        bool matches = true;
+        for (size_t i = 0; i < columns.size() && matches; i++)
+            matches = (m_columns[columns[i]].cells[row] == keys[i]);
+        if (!matches)
+            continue;
+
+        if (m_removed.size() < m_rows)
+            m_removed.resize(m_rows, 0);
+        m_removed[row] = 1;
+        m_removed_count++;
+        removed++;
+    }
+    compact();
+    return removed;
+}
+
+bool FactTable::variant_key(Column const& p_column,
+                            Variant const& p_value,
+                            int64_t& r_key) const
+{
+    switch (p_column.type)
+    {
+        case ColumnType::INT:
+            if (p_value.get_type() != Variant::INT)
+                return false;
+            r_key = (int64_t)p_value;
+            return true;
+
+        case ColumnType::FLOAT:
+        {
+            if (p_value.get_type() != Variant::FLOAT &&
+                p_value.get_type() != Variant::INT)
+                return false;
+            double value = p_value;
+            memcpy(&r_key, &value, sizeof(r_key));
+            return true;
+        }
+
+        case ColumnType::ATOM:
+        {
+            String text = p_value;
+            auto it = m_symbol_ids.find(text.utf8().get_data());
+            if (it == m_symbol_ids.end())
+                return false;
+            r_key = it->second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FactTable::is_removed(size_t p_row) const
+{
+    return p_row < m_removed.size() && m_removed[p_row] != 0;
+}
+
+bool FactTable::save(String const& p_path, String& r_error) const
+{
+    // Symbol texts indexed by symbol id
+    std::vector<std::string> texts(m_file ? m_symbol_count : m_atoms.size());
+    if (m_file != nullptr)
+    {
+        for (size_t i = 0; i < texts.size(); i++)
+            texts[i] = symbol_text((int64_t)i);
+    }
+    else
+    {
+        for (auto const& it : m_symbol_ids)
+            texts[it.second] = it.first;
+    }
+    std::string name_text = name().utf8().get_data();
+
+    // Layout of the sections
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FACT_FILE_MAGIC, sizeof(header.magic));
+    header.version = FACT_FILE_VERSION;
+    header.byte_order = FACT_FILE_BYTE_ORDER;
+    header.arity = (uint32_t)m_columns.size();
+    header.name_length = (uint32_t)name_text.size();
+    header.rows = row_count();
+    header.symbol_count = texts.size();
+
+    size_t offset = sizeof(header) + m_columns.size() * sizeof(ColumnHeader);
+    header.name_offset = offset;
+    offset = align8(offset + name_text.size());
+    header.symbols_offset = offset;
+    offset += (texts.size() + 1) * sizeof(uint64_t);
+    header.text_offset = offset;
+    std::vector<uint64_t> offsets(1, 0);
+    for (std::string const& text : texts)
+    {
+        offsets.push_back(offsets.back() + text.size());
+    }
+    header.text_length = offsets.back();
+    offset = align8(offset + header.text_length);
+
+    std::vector<ColumnHeader> columns(m_columns.size());
+    for (size_t i = 0; i < m_columns.size(); i++)
+    {
+        columns[i].type = (uint32_t)m_columns[i].type;
+        columns[i].reserved = 0;
+        columns[i].cells_offset = offset;
+        offset += header.rows * sizeof(int64_t);
+    }
+
+    // Write the sections in order, padding them to 8 bytes. The file is
+    // written next to the target, then renamed over it: the cells and the
+    // symbols may be read from a mapping of the target itself.
+    String temporary = p_path + ".tmp";
+    std::ofstream out(temporary.utf8().get_data(),
+                      std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        r_error = "Cannot write fact file: " + p_path;
+        return false;
+    }
+    const char padding[8] = { 0 };
+    auto pad = [&out, &padding](size_t p_written)
+    { out.write(padding, align8(p_written) - p_written); };
+
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)columns.data(),
+              columns.size() * sizeof(ColumnHeader));
+    out.write(name_text.data(), name_text.size());
+    pad(header.name_offset + name_text.size());
+    out.write((const char*)offsets.data(), offsets.size() * sizeof(uint64_t));
+    for (std::string const& text : texts)
+    {
+        out.write(text.data(), text.size());
+    }
+    pad(header.text_offset + header.text_length);
+    for (Column const& column : m_columns)
+    {
+        if (m_removed_count == 0)
+        {
+            out.write((const char*)column.cells, m_rows * sizeof(int64_t));
+            continue;
+        }
+        std::vector<int64_t> cells;
+        cells.reserve(header.rows);
+        for (size_t row = 0; row < m_rows; row++)
+        {
+            if (!is_removed(row))
+                cells.push_back(column.cells[row]);
+        }
+        out.write((const char*)cells.data(), cells.size() * sizeof(int64_t));
+    }
+
+    out.close();
+    if (!out)
+    {
+        std::remove(temporary.utf8().get_data());
+        r_error = "Failed to write fact file: " + p_path;
+        return false;
+    }
+#ifdef _WIN32
+    // Fails while the target is mapped: Windows cannot replace it
+    bool renamed = MoveFileExW((LPCWSTR)temporary.utf16().get_data(),
+                               (LPCWSTR)p_path.utf16().get_data(),
+                               MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    bool renamed =
+        std::rename(temporary.utf8().get_data(), p_path.utf8().get_data()) ==
+        0;
+#endif
+    if (!renamed)
+    {
+        std::remove(temporary.utf8().get_data());
+        r_error = "Cannot replace fact file: " + p_path;
+        return false;
+    }
+    return true;
+}
+
+void FactTable::index_rows(size_t p_from)
+{
+    for (Column& column : m_columns)
+    {
+        if (!column.indexed)
+            continue;
+        for (size_t row = p_from; row < m_rows; row++)
+        {
+            column.index[column.cells[row]].push_back((uint32_t)row);
+        }
+    }
+}
+
+void FactTable::compact()
+{
+    // Below half of the table, moving the rows would cost more than the
+    // memory it saves
+    if (m_removed_count < COMPACT_MIN_REMOVED ||
+        m_removed_count * 2 < m_rows || m_cursors > 0)
+        return;
+
+    size_t kept = 0;
+    for (size_t row = 0; row < m_rows; row++)
+    {
+        if (is_removed(row))
+            continue;
+        for (Column& column : m_columns)
+        {
+            column.storage[kept] = column.storage[row];
+        }
+        kept++;
+    }
+    for (Column& column : m_columns)
+    {
+        column.storage.resize(kept);
+        column.storage.shrink_to_fit();
+        column.cells = column.storage.data();
+        column.index.clear();
+    }
+    m_rows = kept;
+    m_removed.clear();
+    m_removed.shrink_to_fit();
+    m_removed_count = 0;
+    index_rows(0);
+}
+
+// =============================================================================
+// Foreign Predicate
+// =============================================================================
+
+bool FactTable::cell_key(Column const& p_column,
+                         term_t p_arg,
+                         int64_t& r_key) const
+{
+    switch (p_column.type)
+    {
+        case ColumnType::INT:
+            return PL_is_integer(p_arg) && PL_get_int64(p_arg, &r_key);
+
+        case ColumnType::FLOAT:
+        {
+            // 1 does not unify with 1.0: only accept floats
+            double value;
+            if (!PL_is_float(p_arg) || !PL_get_float(p_arg, &value))
+                return false;
+            memcpy(&r_key, &value, sizeof(r_key));
+            return true;
+        }
+
+        case ColumnType::ATOM:
+        {
+            atom_t atom;
+            if (!PL_get_atom(p_arg, &atom))
+                return false;
+            auto it = m_atom_ids.find(atom);
+            if (it == m_atom_ids.end())
+                return false;
+            r_key = it->second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FactTable::row_matches(Cursor const& p_cursor, size_t p_row) const
+{
+    for (size_t i = 0; i < p_cursor.bound_columns.size(); i++)
+    {
+        if (m_columns[p_cursor.bound_columns[i]].cells[p_row] !=
+            p_cursor.keys[i])
+            return false;
+    }
+    return true;
+}
+
+bool FactTable::unify_row(term_t p_args, size_t p_row) const
+{
+    for (size_t i = 0; i < m_columns.size(); i++)
+    {
+        Column const& column = m_columns[i];
+        int64_t cell = column.cells[p_row];
+        bool ok = false;
+        switch (column.type)
+        {
+            case ColumnType::INT:
+                ok = PL_unify_int64(p_args + i, cell);
+                break;
+            case ColumnType::FLOAT:
+            {
+                double value;
+                memcpy(&value, &cell, sizeof(value));
+                ok = PL_unify_float(p_args + i, value);
+                break;
+            }
+            case ColumnType::ATOM:
+                ok = cell >= 0 && (size_t)cell < m_atoms.size() &&
+                     PL_unify_atom(p_args + i, m_atoms[cell]);
+                break;
+        }
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+bool FactTable::advance(Cursor& p_cursor) const
+{
+    while (p_cursor.position < p_cursor.end)
+    {
+        size_t row = p_cursor.bucket ? (*p_cursor.bucket)[p_cursor.position]
+                                     : p_cursor.position;
+        p_cursor.position++;
+        if (!is_removed(row) && row_matches(p_cursor, row))
+        {
+            p_cursor.row = row;
+            return true;
+        }
+    }
+    return false;
+}
+
+foreign_t FactTable::predicate(term_t p_args, int p_arity, control_t p_ctx)
+{
+    Cursor* cursor = nullptr;
+
+    switch (PL_foreign_control(p_ctx))
+    {
+        case PL_FIRST_CALL:
+        {
+            // Find the table from the name of the called predicate
+            atom_t name;
+            size_t arity;
+            module_t module;
+            if (!PL_predicate_info(PL_foreign_context_predicate(p_ctx),
+                                   &name,
+                                   &arity,
+                                   &module))
+                return FALSE;
+
+            std::shared_ptr<FactTable> table;
+            {
+                std::lock_guard<std::mutex> lock(s_mutex);
+                auto it = s_tables.find(name);
+                if (it != s_tables.end())
+                    table = it->second;
+            }
+            if (table == nullptr || table->arity() != (size_t)p_arity)
+                return FALSE;
+            if (!table->m_symbols_resolved)
+                table->resolve_symbols();
+
+            cursor = new Cursor(table);
+            cursor->end = table->m_rows;
+
+            // Collect the bound arguments. A bound argument that cannot
+            // be stored in its column (wrong type, unknown atom) matches
+            // no row. Use the most selective hash index.
+            for (size_t i = 0; i < table->m_columns.size(); i++)
+            {
+                if (PL_is_variable(p_args + i))
+                    continue;
+
+                Column const& column = table->m_columns[i];
+                int64_t key;
+                if (!table->cell_key(column, p_args + i, key))
+                {
+                    delete cursor;
+                    return FALSE;
+                }
+                cursor->bound_columns.push_back(i);
+                cursor->keys.push_back(key);
+
+                if (column.indexed)
+                {
+                    auto it = column.index.find(key);
+                    if (it == column.index.end())
+                    {
+                        delete cursor;
+                        return FALSE;
+                    }
+                    if (cursor->bucket == nullptr ||
+                        it->second.size() < cursor->end)
+                    {
+                        cursor->bucket = &it->second;
+                        cursor->end = it->second.size();
+                    }
+                }
+            }
+
+            if (!table->advance(*cursor))
+            {
+                delete cursor;
+                return FALSE;
+            }
+            break;
+        }
+
+        case PL_REDO:
+            cursor = (Cursor*)PL_foreign_context_address(p_ctx);
+            break;
+
+        case PL_PRUNED:
+            cursor = (Cursor*)PL_foreign_context_address(p_ctx);
+            delete cursor;
+            return TRUE;
+    }
+
+    // The cursor points to a candidate row: unify it, and look ahead for the
+    // next one so that the last solution leaves no choice point.
+    FactTable const& table = *cursor->table;
+    fid_t fid = PL_open_foreign_frame();
+    do
+    {
+        if (table.unify_row(p_args, cursor->row))
+        {
+            PL_close_foreign_frame(fid);
+            if (table.advance(*cursor))
+            {
+                PL_retry_address(cursor);
+            }
+            delete cursor;
+            return TRUE;
+        }
+        // Repeated variables (e.g., tile(X, X, T, C)) can still fail
+        PL_rewind_foreign_frame(fid);
+    } while (table.advance(*cursor));
+
+    PL_close_foreign_frame(fid);
+    delete cursor;
+    return FALSE;
+}
@@ -0,0 +1,293 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the FactTable class: a columnar, natively stored set of
+ * ground facts served to Prolog through a nondeterministic foreign predicate.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace godot;
+
+/**
+ * @class FactTable
+ * @brief Columnar storage for large regular fact sets.
+ *
+ * A fact table holds the rows of a predicate such as tile(X, Y, Type, Cost)
+ * as typed columns instead of compiled clauses. Each cell takes 8 bytes and
+ * atoms are interned once per table, so a million rows costs a few tens of
+ * megabytes and is loaded with a single pass over Godot Packed arrays.
+ *
+ * The table is visible from Prolog as a regular predicate named after the
+ * table (registered with PL_register_foreign_in_module()). The predicate is
+ * nondeterministic and enumerates the matching rows. Columns can have a hash
+ * index: when the corresponding argument is bound, only the rows sharing
+ * this value are visited instead of the whole table.
+ *
+ * Tables can also be saved to a binary fact file and later memory-mapped
+ * read-only: the columns are then served directly from the file pages,
+ * without parsing or copying, and the page cache is shared by all the
+ * processes mapping the same file.
+ *
+ * Tables are global to the Prolog runtime, like predicates, and are looked up
+ * by functor name. Appending rows while a query enumerates the same table is
+ * not supported from several threads at once.
+ *
+ * Binary fact file layout (native endianness, 8-byte aligned sections):
+ * @code
+ * FileHeader
+ * ColumnHeader[arity]
+ * functor name (UTF-8)
+ * symbol offsets: uint64_t[symbol_count + 1] into the symbol text
+ * symbol text (UTF-8, not terminated)
+ * column cells: int64_t[rows] per column
+ * @endcode
+ */
+class FactTable
+{
+public:
+
+    /** Type of the values stored in a column. */
+    enum class ColumnType
+    {
+        INT,   //!< Prolog integer (int64_t)
+        FLOAT, //!< Prolog float (double)
+        ATOM   //!< Prolog atom (interned symbol)
+    };
+
+    /**
+     * @brief Creates a table and registers its foreign predicate.
+     *
+     * Replaces any existing table with the same name. The initial rows are
+     * appended before the table is registered, so a failed creation leaves
+     * the existing table in place.
+     *
+     * @param p_name Functor name of the facts (e.g., "tile").
+     * @param p_column_types Column types: "int", "float" or "atom".
+     * @param p_columns Initial rows, one array per column (see append()), or
+     * an empty array for an empty table.
+     * @param p_indexes Column indexes (0-based) to hash-index.
+     * @param r_error Error message set when the creation fails.
+     * @return The new table, or nullptr on failure.
+     */
+    static std::shared_ptr<FactTable>
+    create(String const& p_name,
+           PackedStringArray const& p_column_types,
+           Array const& p_columns,
+           PackedInt32Array const& p_indexes,
+           String& r_error);
+
+    /**
+     * @brief Memory-maps a binary fact file and registers its predicate.
+     *
+     * Only the header is read: the rows stay in the file and are paged in
+     * on demand. Atoms are created on the first query. Replaces any existing
+     * table with the same name.
+     *
+     * @param p_path Absolute path of the file written by save().
+     * @param p_indexes Column indexes (0-based) to hash-index. Building an
+     * index reads the whole column.
+     * @param r_error Error message set when the file is rejected.
+     * @return The new read-only table, or nullptr on failure.
+     */
+    static std::shared_ptr<FactTable> map(String const& p_path,
+                                          PackedInt32Array const& p_indexes,
+                                          String& r_error);
+
+    /**
+     * @brief Finds a table by functor name.
+     *
+     * @param p_name Functor name of the table.
+     * @return The table, or nullptr if there is none.
+     */
+    static std::shared_ptr<FactTable> find(String const& p_name);
+
+    /**
+     * @brief Drops a table.
+     *
+     * The Prolog predicate stays defined but no longer has any solution.
+     *
+     * @param p_name Functor name of the table.
+     * @return true if a table was dropped.
+     */
+    static bool drop(String const& p_name);
+
+    /**
+     * @brief Drops all the tables (called before shutting down Prolog).
+     */
+    static void drop_all();
+
+    ~FactTable();
+
+    /**
+     * @brief Appends rows given as one array per column.
+     *
+     * Accepted column values: PackedInt32Array, PackedInt64Array or Array of
+     * int for "int" columns; PackedFloat32Array, PackedFloat64Array or Array
+     * of float for "float" columns; PackedStringArray or Array of String for
+     * "atom" columns. All columns must have the same length.
+     *
+     * @param p_columns Array with exactly one entry per column.
+     * @param r_error Error message set when the rows are rejected.
+     * @return true if the rows were appended, false if nothing was appended.
+     */
+    bool append(Array const& p_columns, String& r_error);
+
+    /**
+     * @brief Removes the rows matching a key.
+     *
+     * The key gives the values of the first columns; null values match any
+     * cell. Removed rows are skipped by queries and by save(). Once they
+     * make up half of the table, the remaining rows are moved down and the
+     * indexes rebuilt, so that a table updated in place stays bounded. This
+     * is deferred while a query enumerates the table.
+     *
+     * @param p_key Values of the first columns (at most one per column).
+     * @param r_error Error message set when the key is invalid.
+     * @return The number of rows removed, or -1 on error.
+     */
+    int64_t remove(Array const& p_key, String& r_error);
+
+    /**
+     * @brief Writes the table to a binary fact file that map() can load.
+     *
+     * The file is written under a temporary name, then renamed over the
+     * target, so a table can be saved to the file it is mapped from (except
+     * on Windows, which cannot replace a mapped file).
+     *
+     * @param p_path Absolute path of the file to write.
+     * @param r_error Error message set when the file cannot be written.
+     * @return true if the file was written.
+     */
+    bool save(String const& p_path, String& r_error) const;
+
+    /** @brief Number of rows. */
+    size_t row_count() const;
+
+    /** @brief Number of rows in memory, including removed rows. */
+    size_t stored_row_count() const;
+
+    /** @brief Number of columns (arity of the predicate). */
+    size_t arity() const;
+
+    /** @brief Functor name of the table. */
+    String name() const;
+
+private:
+
+    /** One column: all cells are 64 bits wide, interpreted by type. */
+    struct Column
+    {
+        ColumnType type;
+        //! Integer value, double bit pattern or symbol id, one per row.
+        //! Points either to the storage or to the mapped file.
+        const int64_t* cells = nullptr;
+        //! Cells owned by the table (empty for mapped tables).
+        std::vector<int64_t> storage;
+        //! Hash index from cell value to rows (empty when not indexed).
+        std::unordered_map<int64_t, std::vector<uint32_t>> index;
+        bool indexed = false;
+    };
+
+    /** State of an enumeration kept between two solutions. */
+    struct Cursor;
+
+    /** Read-only memory mapping of a binary fact file. */
+    class MappedFile;
+
+    FactTable(atom_t p_name, std::vector<ColumnType> const& p_types);
+
+    /** Marks the columns to index, returns false on invalid column. */
+    bool set_indexes(PackedInt32Array const& p_indexes, String& r_error);
+
+    /** Registers the foreign predicate and adds the table to the registry. */
+    static bool publish(std::shared_ptr<FactTable> const& p_table,
+                        String& r_error);
+
+    /** Creates the atoms of a mapped table (done once, on first query). */
+    void resolve_symbols();
+
+    /** Gets the UTF-8 text of a symbol. */
+    std::string symbol_text(int64_t p_id) const;
+
+    /** Interns an UTF-8 string and returns its symbol id. */
+    int64_t intern(std::string const& p_text);
+
+    /** Appends the values of one column, returns false on type mismatch. */
+    bool append_column(Column& p_column, Variant const& p_values);
+
+    /** Converts a Godot value to a cell value, false if none matches. */
+    bool variant_key(Column const& p_column,
+                     Variant const& p_value,
+                     int64_t& r_key) const;
+
+    /** Whether remove() has removed a row. */
+    bool is_removed(size_t p_row) const;
+
+    /** Adds rows [p_from, row_count) to the hash indexes. */
+    void index_rows(size_t p_from);
+
+    /** Drops the removed rows if they are many and no cursor is open. */
+    void compact();
+
+    /** Converts a bound argument to a cell value for the given column. */
+    bool cell_key(Column const& p_column, term_t p_arg, int64_t& r_key) const;
+
+    /** Checks the bound arguments of a cursor against a row. */
+    bool row_matches(Cursor const& p_cursor, size_t p_row) const;
+
+    /** Unifies the unbound arguments with the cells of a row. */
+    bool unify_row(term_t p_args, size_t p_row) const;
+
+    /** Moves the cursor to the next row matching its bound arguments. */
+    bool advance(Cursor& p_cursor) const;
+
+    /** Foreign predicate serving every table (PL_FA_VARARGS). */
+    static foreign_t predicate(term_t p_args, int p_arity, control_t p_ctx);
+
+private:
+
+    atom_t m_name;
+    std::vector<Column> m_columns;
+    size_t m_rows = 0;
+    /** Rows removed by remove() (sized lazily), and how many. */
+    std::vector<uint8_t> m_removed;
+    size_t m_removed_count = 0;
+    /** Open enumerations, which hold row numbers and index buckets. */
+    std::atomic<size_t> m_cursors { 0 };
+
+    /** Symbol id -> registered atom, and back. */
+    std::vector<atom_t> m_atoms;
+    std::unordered_map<atom_t, int64_t> m_atom_ids;
+    std::unordered_map<std::string, int64_t> m_symbol_ids;
+
+    /** Mapped file backing a read-only table (nullptr if owned). */
+    std::unique_ptr<MappedFile> m_file;
+    /** Symbol table of the mapped file. */
+    const uint64_t* m_symbol_offsets = nullptr;
+    const char* m_symbol_text = nullptr;
+    size_t m_symbol_count = 0;
+    /** Whether m_atoms holds an atom for every symbol. */
+    std::atomic<bool> m_symbols_resolved { true };
+
+    /** All the tables, keyed by functor name. */
+    static std::unordered_map<atom_t, std::shared_ptr<FactTable>> s_tables;
+    static std::mutex s_mutex;
+};
@@ -0,0 +1,353 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the ForwardRules class.
+ */
+
+#include "ForwardRules.hpp"
+#include "Prologot.hpp"
+
+#include <algorithm>
+
+namespace
+{
+
+/** Derived facts per asserted fact beyond which chaining is stopped. */
+constexpr size_t MAX_DERIVED_FACTS = 100000;
+
+/** Functor key of a callable term, empty if the term is not callable. */
+std::string functor_key(term_t p_term)
+{
+    atom_t name;
+    size_t arity;
+    if (!PL_get_name_arity(p_term, &name, &arity))
+        return std::string();
+    return std::string(PL_atom_chars(name)) + '/' + std::to_string(arity);
+}
+
+/** Error message of the pending exception of a query. */
+String exception_message(qid_t p_qid, String const& p_context)
+{
+    char* message = nullptr;
+    term_t exception = PL_exception(p_qid);
+    if (exception && PL_get_chars(exception,
+                                  &message,
+                                  CVT_WRITE | CVT_EXCEPTION | BUF_DISCARDABLE))
+    {
+        return p_context + ": " + String::utf8(message);
+    }
+    return p_context;
+}
+
+} // namespace
+
+// =============================================================================
+// ForwardRules
+// =============================================================================
+
+ForwardRules::~ForwardRules()
+{
+    // Records belong to Prolog: clear() must have been called before
+    // PL_cleanup(), so only forget them here
+    m_rules.clear();
+}
+
+bool ForwardRules::add(String const& p_name,
+                       PackedStringArray const& p_conditions,
+                       Dictionary const& p_options,
+                       String& r_error)
+{
+    if (p_conditions.is_empty())
+    {
+        r_error = "Forward rule " + p_name + " has no condition";
+        return false;
+    }
+
+    // Parsed as one text so that the conditions and the template share
+    // their variables, whose names are kept for the bindings
+    String text = "'$rule'([" + String(", ").join(p_conditions) + "], (" +
+                  String(p_options.get("assert", "true")) + "))";
+
+    fid_t fid = PL_open_foreign_frame();
+    term_t args = PL_new_term_refs(3);
+    term_t names = PL_new_term_ref();
+    term_t option = PL_new_term_ref();
+    CharString utf8 = text.utf8();
+    predicate_t term_string = PL_predicate("term_string", 3, "user");
+    bool ok = PL_put_chars(args + 1,
+                           PL_STRING | REP_UTF8,
+                           utf8.length(),
+                           utf8.get_data()) &&
+              PL_cons_functor(option,
+                              PL_new_functor(PL_new_atom("variable_names"), 1),
+                              names) &&
+              PL_put_nil(args + 2) && PL_cons_list(args + 2, option, args + 2);
+    qid_t qid = PL_open_query(
+        NULL, PL_Q_CATCH_EXCEPTION, term_string, args);
+    ok = ok && PL_next_solution(qid);
+    if (!ok)
+    {
+        r_error = exception_message(qid, "Invalid forward rule " + p_name);
+    }
+    PL_cut_query(qid);
+
+    // '$rule'(Conditions, Template) -> '$rule'(Names, Conditions, Template)
+    Rule rule;
+    term_t conditions = PL_new_term_ref();
+    term_t head = PL_new_term_ref();
+    term_t stored = PL_new_term_ref();
+    term_t parts = PL_new_term_refs(3);
+    if (ok)
+    {
+        ok = PL_get_arg(1, args, conditions) &&
+             PL_put_term(parts, names) && PL_get_arg(1, args, parts + 1) &&
+             PL_get_arg(2, args, parts + 2) &&
+             PL_cons_functor_v(
+                 stored, PL_new_functor(PL_new_atom("$rule"), 3), parts);
+        term_t list = PL_copy_term_ref(conditions);
+        while (ok && PL_get_list(list, head, list))
+        {
+            std::string key = functor_key(head);
+            if (key.empty())
+            {
+                r_error = "Forward rule " + p_name +
+                          ": conditions must be callable terms";
+                ok = false;
+            }
+            rule.keys.push_back(key);
+        }
+    }
+    if (ok)
+    {
+        remove(p_name);
+        rule.name = p_name;
+        rule.record = PL_record(stored);
+        rule.notify = p_options.get("notify", true);
+        m_rules.push_back(std::move(rule));
+        reindex();
+    }
+    PL_discard_foreign_frame(fid);
+    return ok;
+}
+
+bool ForwardRules::remove(String const& p_name)
+{
+    auto it = std::find_if(m_rules.begin(),
+                           m_rules.end(),
+                           [&](Rule const& p_rule)
+                           { return p_rule.name == p_name; });
+    if (it == m_rules.end())
+        return false;
+
+    PL_erase(it->record);
+    m_rules.erase(it);
+    reindex();
+    return true;
+}
+
+bool ForwardRules::on_assert(term_t p_fact,
+                             module_t p_module,
+                             String& r_error)
+{
+    std::vector<record_t> derived;
+    bool ok = match(p_fact, p_module, derived, r_error);
+
+    // Worklist of derived facts: asserted and matched unless already true
+    predicate_t clause = PL_predicate("clause", 2, "system");
+    size_t count = 0;
+    term_t fact = PL_new_term_refs(2);
+    fid_t fid = PL_open_foreign_frame();
+    while (!derived.empty())
+    {
+        record_t record = derived.back();
+        derived.pop_back();
+        if (ok && ++count > MAX_DERIVED_FACTS)
+        {
+            r_error = "Forward rules derived too many facts (cycle?)";
+            ok = false;
+        }
+        if (ok && PL_recorded(record, fact) &&
+            PL_put_atom_chars(fact + 1, "true"))
+        {
+            // clause/2 in a frame undoing its bindings: the fact is not
+            // asserted again, and undefined predicates are not an error
+            fid_t check = PL_open_foreign_frame();
+            bool known = PL_call_predicate(
+                p_module, PL_Q_CATCH_EXCEPTION, clause, fact);
+            PL_discard_foreign_frame(check);
+            if (!known && !(PL_assert(fact, p_module, PL_ASSERTZ) &&
+                            match(fact, p_module, derived, r_error)))
+            {
+                if (r_error.is_empty())
+                    r_error = "Forward rules cannot assert derived facts";
+                ok = false;
+            }
+        }
+        PL_clear_exception();
+        PL_erase(record);
+        PL_rewind_foreign_frame(fid);
+    }
+    PL_discard_foreign_frame(fid);
+    return ok;
+}
+
+bool ForwardRules::empty() const
+{
+    return m_rules.empty();
+}
+
+bool ForwardRules::has_firings() const
+{
+    return !m_firings.is_empty();
+}
+
+Array ForwardRules::take_firings()
+{
+    Array firings = m_firings;
+    m_firings = Array();
+    return firings;
+}
+
+void ForwardRules::clear()
+{
+    for (Rule const& rule : m_rules)
+        PL_erase(rule.record);
+    m_rules.clear();
+    m_index.clear();
+    m_firings = Array();
+}
+
+bool ForwardRules::match(term_t p_fact,
+                         module_t p_module,
+                         std::vector<record_t>& r_derived,
+                         String& r_error)
+{
+    auto entries = m_index.find(functor_key(p_fact));
+    if (entries == m_index.end())
+        return true;
+
+    // References created before the frame: rewinding it after each rule
+    // only releases the terms built for that rule. Handles are looked up
+    // on each call: they do not survive PL_cleanup().
+    predicate_t call = PL_predicate("call", 1, "user");
+    term_t stored = PL_new_term_ref();
+    term_t names = PL_new_term_ref();
+    term_t conditions = PL_new_term_ref();
+    term_t templ = PL_new_term_ref();
+    term_t condition = PL_new_term_ref();
+    term_t goal = PL_new_term_ref();
+    term_t name = PL_new_term_ref();
+    term_t value = PL_new_term_ref();
+    term_t list = PL_new_term_ref();
+    term_t pairs = PL_new_term_ref();
+    term_t pair = PL_new_term_ref();
+    term_t guards = PL_new_term_ref();
+    term_t check = PL_new_term_ref();
+    functor_t conjunction = PL_new_functor(PL_new_atom(","), 2);
+    functor_t different = PL_new_functor(PL_new_atom("\\=="), 2);
+    fid_t fid = PL_open_foreign_frame();
+    bool ok = true;
+
+    for (auto const& entry : entries->second)
+    {
+        Rule const& rule = m_rules[entry.first];
+
+        // Fresh copy of the rule, whose condition is unified with the fact
+        if (!PL_recorded(rule.record, stored) ||
+            !PL_get_arg(1, stored, names) ||
+            !PL_get_arg(2, stored, conditions) ||
+            !PL_get_arg(3, stored, templ))
+        {
+            ok = false;
+            break;
+        }
+        // A fact matching several conditions of the rule fires it once per
+        // solution: the solutions where an earlier condition with the same
+        // functor is the fact were found when matching that condition
+        PL_put_term(list, conditions);
+        PL_put_atom_chars(goal, "true");
+        PL_put_atom_chars(guards, "true");
+        std::string const& key = rule.keys[entry.second];
+        for (size_t i = 0; PL_get_list(list, condition, list); i++)
+        {
+            if (i == entry.second)
+            {
+                if (!PL_unify(condition, p_fact))
+                    break;
+                continue;
+            }
+            if (!PL_cons_functor(goal, conjunction, goal, condition) ||
+                (i < entry.second && rule.keys[i] == key &&
+                 !(PL_cons_functor(check, different, condition, p_fact) &&
+                   PL_cons_functor(guards, conjunction, guards, check))))
+            {
+                ok = false;
+                break;
+            }
+        }
+        if (!ok)
+            break;
+        if (!PL_get_nil(list))
+        {
+            PL_rewind_foreign_frame(fid);
+            continue; // The fact does not unify with the condition
+        }
+        if (!PL_cons_functor(goal, conjunction, goal, guards))
+        {
+            ok = false;
+            break;
+        }
+
+        qid_t qid =
+            PL_open_query(p_module, PL_Q_CATCH_EXCEPTION, call, goal);
+        while (PL_next_solution(qid))
+        {
+            if (rule.notify)
+            {
+                Dictionary bindings;
+                PL_put_term(pairs, names);
+                while (PL_get_list(pairs, pair, pairs))
+                {
+                    char* variable = nullptr;
+                    if (PL_get_arg(1, pair, name) &&
+                        PL_get_arg(2, pair, value) &&
+                        PL_get_chars(name, &variable, CVT_ATOM | REP_UTF8))
+                    {
+                        bindings[String::utf8(variable)] =
+                            Prologot::term_to_variant(value);
+                    }
+                }
+                Dictionary firing;
+                firing["rule"] = rule.name;
+                firing["bindings"] = bindings;
+                m_firings.push_back(firing);
+            }
+            if (!PL_is_atom(templ) || functor_key(templ) != "true/0")
+                r_derived.push_back(PL_record(templ));
+        }
+        if (PL_exception(qid))
+        {
+            r_error = exception_message(qid, "Forward rule " + rule.name);
+            ok = false;
+        }
+        PL_close_query(qid);
+        PL_rewind_foreign_frame(fid);
+        if (!ok)
+            break;
+    }
+    PL_discard_foreign_frame(fid);
+    return ok;
+}
+
+void ForwardRules::reindex()
+{
+    m_index.clear();
+    for (size_t r = 0; r < m_rules.size(); r++)
+    {
+        for (size_t c = 0; c < m_rules[r].keys.size(); c++)
+            m_index[m_rules[r].keys[c]].emplace_back(r, c);
+    }
+}
@@ -0,0 +1,132 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the ForwardRules class: forward-chaining rules matched
+ * incrementally against the asserted facts.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace godot;
+
+/**
+ * @class ForwardRules
+ * @brief Event-condition-action rules fired by new facts (TREAT-style).
+ *
+ * A rule is a list of conditions, e.g. [enemy(E, Room), player_in(Room)].
+ * Conditions are indexed by functor and arity: when a fact is asserted,
+ * only the conditions it unifies with are considered, and the other
+ * conditions of these rules are then called as a Prolog query with the
+ * bindings of the fact. The cost of a new fact is therefore proportional to
+ * the rules it touches, not to the number of rules or facts. Nothing is
+ * re-evaluated when no fact is asserted.
+ *
+ * Each solution is a firing, reported as a Dictionary {"rule": Name,
+ * "bindings": {Variable: Value}} and/or asserting an instance of the
+ * rule's fact template. Derived facts are matched in turn (forward
+ * chaining) unless they were already true, so rules reach a fixpoint.
+ */
+class ForwardRules
+{
+public:
+
+    ~ForwardRules();
+
+    /**
+     * @brief Adds a rule, replacing the rule with the same name.
+     *
+     * @param p_name Rule name reported in the firings.
+     * @param p_conditions Condition texts sharing their variables.
+     * @param p_options "assert" (fact template to assert per firing) and
+     * "notify" (report the firings, default true).
+     * @param r_error Error message on failure.
+     * @return true on success.
+     */
+    bool add(String const& p_name,
+             PackedStringArray const& p_conditions,
+             Dictionary const& p_options,
+             String& r_error);
+
+    /**
+     * @brief Removes a rule.
+     *
+     * @return true if the rule existed.
+     */
+    bool remove(String const& p_name);
+
+    /**
+     * @brief Matches a newly asserted fact and the facts it derives.
+     *
+     * @param p_fact Fact just asserted.
+     * @param p_module Module of the facts (NULL for user).
+     * @param r_error Error message on failure.
+     * @return true on success.
+     */
+    bool on_assert(term_t p_fact, module_t p_module, String& r_error);
+
+    /**
+     * @brief Whether no rule is defined (asserting then costs nothing).
+     */
+    bool empty() const;
+
+    /**
+     * @brief Whether some firings are waiting for take_firings().
+     */
+    bool has_firings() const;
+
+    /**
+     * @brief Gets and forgets the firings reported since the last call.
+     */
+    Array take_firings();
+
+    /**
+     * @brief Removes all the rules (called before shutting down Prolog).
+     */
+    void clear();
+
+private:
+
+    struct Rule
+    {
+        String name;
+        //! '$rule'(VariableNames, Conditions, Template), as a record.
+        record_t record;
+        //! Functor key ("name/arity") of each condition.
+        std::vector<std::string> keys;
+        bool notify;
+    };
+
+    /** Matches a fact against the rules; derived facts go to r_derived. */
+    bool match(term_t p_fact,
+               module_t p_module,
+               std::vector<record_t>& r_derived,
+               String& r_error);
+
+    /** Rebuilds m_index after adding or removing a rule. */
+    void reindex();
+
+private:
+
+    std::vector<Rule> m_rules;
+
+    /** Functor key -> (rule, condition) pairs matching it. */
+    std::unordered_map<std::string, std::vector<std::pair<size_t, size_t>>>
+        m_index;
+
+    /** Firings not yet taken. */
+    Array m_firings;
+};
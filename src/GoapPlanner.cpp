@@ -0,0 +1,494 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the GoapPlanner class.
+ */
+
+#include "GoapPlanner.hpp"
+#include <godot_cpp/classes/time.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <queue>
+
+namespace
+{
+
+/** Cached plans beyond which the cache is emptied. */
+constexpr size_t MAX_CACHED_PLANS = 4096;
+
+/** Expansions between two checks of the time budget. */
+constexpr int64_t BUDGET_CHECK_PERIOD = 16;
+
+/** Sorted proposition ids. */
+using State = std::vector<uint32_t>;
+
+/** FNV-1a hash of a state. */
+struct StateHash
+{
+    size_t operator()(State const& p_state) const
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (uint32_t id : p_state)
+        {
+            hash ^= id;
+            hash *= 1099511628211ull;
+        }
+        return size_t(hash);
+    }
+};
+
+void sort_unique(State& r_state)
+{
+    std::sort(r_state.begin(), r_state.end());
+    r_state.erase(std::unique(r_state.begin(), r_state.end()), r_state.end());
+}
+
+bool holds(State const& p_state, State const& p_propositions)
+{
+    return std::includes(p_state.begin(),
+                         p_state.end(),
+                         p_propositions.begin(),
+                         p_propositions.end());
+}
+
+/** Appends the ids of a state to a cache key. */
+void append_key(std::string& r_key, State const& p_state)
+{
+    for (uint32_t id : p_state)
+    {
+        r_key += std::to_string(id);
+        r_key += ',';
+    }
+    r_key += '|';
+}
+
+} // namespace
+
+// =============================================================================
+// Private types
+// =============================================================================
+
+struct GoapPlanner::Action
+{
+    String name;
+    State preconditions;
+    State add;
+    State remove;
+    double cost;
+};
+
+struct GoapPlanner::ActionSet
+{
+    std::vector<Action> actions;
+};
+
+struct GoapPlanner::Search
+{
+    /** Search tree node. */
+    struct Node
+    {
+        State state;
+        double cost;
+        size_t parent;
+        size_t action;
+    };
+
+    /** Open list entry, ordered by estimated total cost. */
+    struct Open
+    {
+        double estimate;
+        size_t node;
+
+        bool operator>(Open const& p_other) const
+        {
+            return estimate > p_other.estimate;
+        }
+    };
+
+    std::string key;
+    bool cache = true;
+    std::shared_ptr<ActionSet const> actions;
+    State goal;
+    predicate_t heuristic = nullptr;
+    int64_t max_nodes = 0;
+    int64_t expanded = 0;
+    std::vector<Node> nodes;
+    std::priority_queue<Open, std::vector<Open>, std::greater<Open>> open;
+    std::unordered_map<State, double, StateHash> best_cost;
+    Status status = RUNNING;
+    PackedStringArray plan;
+};
+
+// =============================================================================
+// GoapPlanner
+// =============================================================================
+
+GoapPlanner::GoapPlanner() = default;
+
+GoapPlanner::~GoapPlanner() = default;
+
+int64_t GoapPlanner::start(Array const& p_state,
+                           Array const& p_goal,
+                           Dictionary const& p_options,
+                           String& r_error)
+{
+    String predicate = p_options.get("actions", "action");
+    String heuristic_name = p_options.get("heuristic", "");
+    auto search = std::make_unique<Search>();
+    search->max_nodes = p_options.get("max_nodes", 10000);
+    search->cache = p_options.get("cache", true);
+
+    State state;
+    if (!intern_texts(p_state, state, r_error) ||
+        !intern_texts(p_goal, search->goal, r_error))
+    {
+        return -1;
+    }
+
+    // Plans only depend on the inputs: the key holds all of them
+    search->key = std::string(predicate.utf8().get_data()) + '|' +
+                  heuristic_name.utf8().get_data() + '|' +
+                  std::to_string(search->max_nodes) + '|';
+    append_key(search->key, state);
+    append_key(search->key, search->goal);
+
+    int64_t id = m_next_id++;
+    auto cached = search->cache ? m_plans.find(search->key) : m_plans.end();
+    if (cached != m_plans.end())
+    {
+        search->status = cached->second ? FOUND : FAILED;
+        if (cached->second)
+            search->plan = *cached->second;
+        m_searches[id] = std::move(search);
+        return id;
+    }
+
+    search->actions = actions(predicate, r_error);
+    if (!search->actions)
+        return -1;
+    if (!heuristic_name.is_empty())
+    {
+        search->heuristic =
+            PL_predicate(heuristic_name.utf8().get_data(), 3, "user");
+    }
+
+    double estimate;
+    if (!heuristic(*search, state, estimate, r_error))
+        return -1;
+    search->best_cost[state] = 0.0;
+    search->nodes.push_back({ std::move(state), 0.0, 0, 0 });
+    search->open.push({ estimate, 0 });
+    m_searches[id] = std::move(search);
+    return id;
+}
+
+GoapPlanner::Status
+GoapPlanner::step(int64_t p_id, uint64_t p_budget_usec, String& r_error)
+{
+    auto it = m_searches.find(p_id);
+    if (it == m_searches.end())
+    {
+        r_error = "Unknown plan search: " + String::num_int64(p_id);
+        return FAILED;
+    }
+    Search& search = *it->second;
+    if (search.status != RUNNING)
+        return search.status;
+
+    Time* time = Time::get_singleton();
+    uint64_t deadline = time->get_ticks_usec() + p_budget_usec;
+    std::vector<Action> const& actions = search.actions->actions;
+    int64_t iterations = 0;
+    bool found = false;
+    size_t last = 0;
+
+    while (!search.open.empty())
+    {
+        if (p_budget_usec > 0 && ++iterations % BUDGET_CHECK_PERIOD == 0 &&
+            time->get_ticks_usec() >= deadline)
+        {
+            return RUNNING;
+        }
+
+        size_t current = search.open.top().node;
+        search.open.pop();
+
+        // Copied: expanding the node grows search.nodes
+        State state = search.nodes[current].state;
+        double cost = search.nodes[current].cost;
+        if (cost > search.best_cost[state])
+            continue; // Reached again at a lower cost since queued
+        if (holds(state, search.goal))
+        {
+            found = true;
+            last = current;
+            break;
+        }
+        if (search.max_nodes > 0 && ++search.expanded > search.max_nodes)
+            break;
+
+        for (size_t a = 0; a < actions.size(); a++)
+        {
+            Action const& action = actions[a];
+            if (!holds(state, action.preconditions))
+                continue;
+
+            State next;
+            std::set_difference(state.begin(),
+                                state.end(),
+                                action.remove.begin(),
+                                action.remove.end(),
+                                std::back_inserter(next));
+            next.insert(next.end(), action.add.begin(), action.add.end());
+            sort_unique(next);
+
+            double next_cost = cost + action.cost;
+            auto known = search.best_cost.find(next);
+            if (known != search.best_cost.end() && known->second <= next_cost)
+                continue;
+
+            double estimate;
+            if (!heuristic(search, next, estimate, r_error))
+            {
+                // Errors are not cached: the heuristic may be fixed
+                search.status = FAILED;
+                return FAILED;
+            }
+            search.best_cost[next] = next_cost;
+            search.nodes.push_back({ std::move(next), next_cost, current, a });
+            search.open.push({ next_cost + estimate, search.nodes.size() - 1 });
+        }
+    }
+
+    std::shared_ptr<PackedStringArray> plan;
+    if (found)
+    {
+        std::vector<size_t> steps;
+        for (size_t node = last; node != 0; node = search.nodes[node].parent)
+            steps.push_back(search.nodes[node].action);
+        for (auto step = steps.rbegin(); step != steps.rend(); ++step)
+            search.plan.push_back(actions[*step].name);
+        plan = std::make_shared<PackedStringArray>(search.plan);
+    }
+    search.status = found ? FOUND : FAILED;
+
+    if (search.cache)
+    {
+        if (m_plans.size() >= MAX_CACHED_PLANS)
+            m_plans.clear();
+        m_plans[search.key] = plan;
+    }
+
+    // The search tree is no longer needed: only the plan is kept
+    search.nodes = {};
+    search.open = {};
+    search.best_cost = {};
+    return search.status;
+}
+
+PackedStringArray GoapPlanner::take_result(int64_t p_id)
+{
+    auto it = m_searches.find(p_id);
+    if (it == m_searches.end())
+        return PackedStringArray();
+
+    PackedStringArray plan = it->second->plan;
+    m_searches.erase(it);
+    return plan;
+}
+
+void GoapPlanner::clear_cache()
+{
+    m_plans.clear();
+    m_action_sets.clear();
+}
+
+void GoapPlanner::clear_all()
+{
+    m_searches.clear();
+    clear_cache();
+    for (record_t record : m_records)
+        PL_erase(record);
+    m_records.clear();
+    m_ids.clear();
+}
+
+// -----------------------------------------------------------------------------
+// Propositions
+// -----------------------------------------------------------------------------
+
+uint32_t GoapPlanner::intern(term_t p_term, String& r_error)
+{
+    char* text = nullptr;
+    if (!PL_is_ground(p_term) ||
+        !PL_get_chars(
+            p_term, &text, CVT_WRITEQ | BUF_DISCARDABLE | REP_UTF8))
+    {
+        r_error = "Propositions must be ground terms";
+        return UINT32_MAX;
+    }
+
+    auto it = m_ids.find(text);
+    if (it != m_ids.end())
+        return it->second;
+
+    uint32_t id = uint32_t(m_records.size());
+    m_records.push_back(PL_record(p_term));
+    m_ids.emplace(text, id);
+    return id;
+}
+
+bool GoapPlanner::intern_texts(Array const& p_texts,
+                               State& r_ids,
+                               String& r_error)
+{
+    fid_t fid = PL_open_foreign_frame();
+    term_t term = PL_new_term_ref();
+    bool ok = true;
+    for (int64_t i = 0; i < p_texts.size() && ok; i++)
+    {
+        String text = p_texts[i];
+        if (!PL_chars_to_term(text.utf8().get_data(), term))
+        {
+            r_error = "Invalid proposition: " + text;
+            ok = false;
+            break;
+        }
+        uint32_t id = intern(term, r_error);
+        ok = (id != UINT32_MAX);
+        r_ids.push_back(id);
+    }
+    PL_discard_foreign_frame(fid);
+    sort_unique(r_ids);
+    return ok;
+}
+
+bool GoapPlanner::intern_list(term_t p_list, State& r_ids, String& r_error)
+{
+    term_t list = PL_copy_term_ref(p_list);
+    term_t head = PL_new_term_ref();
+    while (PL_get_list(list, head, list))
+    {
+        uint32_t id = intern(head, r_error);
+        if (id == UINT32_MAX)
+            return false;
+        r_ids.push_back(id);
+    }
+    if (!PL_get_nil(list))
+    {
+        r_error = "Action preconditions and effects must be lists";
+        return false;
+    }
+    sort_unique(r_ids);
+    return true;
+}
+
+bool GoapPlanner::put_list(term_t p_list, State const& p_ids)
+{
+    term_t head = PL_new_term_ref();
+    if (!PL_put_nil(p_list))
+        return false;
+    for (auto id = p_ids.rbegin(); id != p_ids.rend(); ++id)
+    {
+        if (!PL_recorded(m_records[*id], head) ||
+            !PL_cons_list(p_list, head, p_list))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// Actions and heuristic
+// -----------------------------------------------------------------------------
+
+std::shared_ptr<GoapPlanner::ActionSet const>
+GoapPlanner::actions(String const& p_predicate, String& r_error)
+{
+    CharString name = p_predicate.utf8();
+    auto it = m_action_sets.find(name.get_data());
+    if (it != m_action_sets.end())
+        return it->second;
+
+    auto set = std::make_shared<ActionSet>();
+    fid_t fid = PL_open_foreign_frame();
+    term_t args = PL_new_term_refs(5);
+    predicate_t predicate = PL_predicate(name.get_data(), 5, "user");
+    qid_t qid = PL_open_query(NULL, PL_Q_CATCH_EXCEPTION, predicate, args);
+    bool ok = true;
+    while (ok && PL_next_solution(qid))
+    {
+        Action action;
+        char* text = nullptr;
+        ok = PL_get_chars(args,
+                          &text,
+                          CVT_ATOM | CVT_STRING | BUF_DISCARDABLE |
+                              REP_UTF8) ||
+             PL_get_chars(
+                 args, &text, CVT_WRITEQ | BUF_DISCARDABLE | REP_UTF8);
+        if (ok)
+            action.name = String::utf8(text);
+        ok = ok && intern_list(args + 1, action.preconditions, r_error) &&
+             intern_list(args + 2, action.add, r_error) &&
+             intern_list(args + 3, action.remove, r_error);
+        if (ok && (!PL_get_float(args + 4, &action.cost) || action.cost < 0))
+        {
+            r_error = "The cost of action " + action.name +
+                      " must be a non-negative number";
+            ok = false;
+        }
+        if (ok)
+            set->actions.push_back(std::move(action));
+    }
+    if (ok && PL_exception(qid))
+    {
+        r_error = "Cannot read the actions of " + p_predicate + "/5";
+        ok = false;
+    }
+    PL_cut_query(qid);
+    PL_discard_foreign_frame(fid);
+
+    if (!ok)
+        return nullptr;
+    m_action_sets[name.get_data()] = set;
+    return set;
+}
+
+bool GoapPlanner::heuristic(Search& p_search,
+                            State const& p_state,
+                            double& r_cost,
+                            String& r_error)
+{
+    if (p_search.heuristic == nullptr)
+    {
+        // Number of goal propositions not true yet
+        State missing;
+        std::set_difference(p_search.goal.begin(),
+                            p_search.goal.end(),
+                            p_state.begin(),
+                            p_state.end(),
+                            std::back_inserter(missing));
+        r_cost = double(missing.size());
+        return true;
+    }
+
+    fid_t fid = PL_open_foreign_frame();
+    term_t args = PL_new_term_refs(3);
+    bool ok = put_list(args, p_state) && put_list(args + 1, p_search.goal) &&
+              PL_call_predicate(
+                  NULL, PL_Q_CATCH_EXCEPTION, p_search.heuristic, args) &&
+              PL_get_float(args + 2, &r_cost);
+    PL_clear_exception();
+    PL_discard_foreign_frame(fid);
+    if (!ok)
+    {
+        r_error = "The plan heuristic failed or did not return a number";
+    }
+    return ok;
+}
@@ -0,0 +1,165 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the GoapPlanner class: a native A* planner over STRIPS
+ * actions defined in Prolog.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace godot;
+
+/**
+ * @class GoapPlanner
+ * @brief Goal-oriented action planning: A* search in C++, actions in Prolog.
+ *
+ * A world state is a set of ground terms (propositions) such as has(axe) or
+ * at(tree). Actions are the solutions of a Prolog predicate (action/5 by
+ * default):
+ * @code
+ * action(Name, Preconditions, AddList, DeleteList, Cost)
+ * @endcode
+ * An action applies when all its preconditions hold; it then removes the
+ * DeleteList propositions and adds the AddList ones. Actions may be rules
+ * (e.g. move(A, B) for each adjacent(A, B)) but their solutions must be
+ * ground. They are read once per predicate and kept until clear_cache().
+ *
+ * The search runs natively on states stored as sorted proposition ids. The
+ * default heuristic is the number of goal propositions not yet true; a
+ * Prolog predicate Heuristic(+State, +Goal, -H) can replace it. Searches can
+ * be run in one call or stepped with a time budget across frames, and the
+ * results (plans and failures) are cached by world state, goal and action
+ * predicate.
+ *
+ * The planner holds Prolog records: call clear_all() before shutting down
+ * Prolog.
+ */
+class GoapPlanner
+{
+public:
+
+    /** Result of step(). */
+    enum Status
+    {
+        FAILED = -1,
+        RUNNING = 0,
+        FOUND = 1
+    };
+
+    GoapPlanner();
+    ~GoapPlanner();
+
+    /**
+     * @brief Starts a search.
+     *
+     * @param p_state Propositions true in the initial state (term texts).
+     * @param p_goal Propositions that must be true at the end.
+     * @param p_options "actions" (predicate name), "heuristic" (predicate
+     * name), "max_nodes" (expansion limit) and "cache" (bool).
+     * @param r_error Error message on failure.
+     * @return The search id, or -1 on failure.
+     */
+    int64_t start(Array const& p_state,
+                  Array const& p_goal,
+                  Dictionary const& p_options,
+                  String& r_error);
+
+    /**
+     * @brief Continues a search for p_budget_usec microseconds at most
+     * (0 for no limit).
+     *
+     * @param p_id Search id returned by start().
+     * @param p_budget_usec Time budget.
+     * @param r_error Error message when the search fails on an error.
+     * @return FOUND, RUNNING or FAILED (also for an unknown id).
+     */
+    Status step(int64_t p_id, uint64_t p_budget_usec, String& r_error);
+
+    /**
+     * @brief Gets the plan of a search and forgets the search.
+     *
+     * @param p_id Search id returned by start().
+     * @return The action names, empty if no plan was found (yet).
+     */
+    PackedStringArray take_result(int64_t p_id);
+
+    /**
+     * @brief Forgets the cached plans and actions, e.g. after changing the
+     * action definitions. Running searches keep their actions.
+     */
+    void clear_cache();
+
+    /**
+     * @brief Forgets everything, including the running searches.
+     */
+    void clear_all();
+
+private:
+
+    struct Action;
+    struct ActionSet;
+    struct Search;
+
+    /** Id of a proposition, interning it if new. */
+    uint32_t intern(term_t p_term, String& r_error);
+
+    /** Reads and interns the propositions of a list of term texts. */
+    bool intern_texts(Array const& p_texts,
+                      std::vector<uint32_t>& r_ids,
+                      String& r_error);
+
+    /** Reads and interns the propositions of a Prolog list. */
+    bool intern_list(term_t p_list,
+                     std::vector<uint32_t>& r_ids,
+                     String& r_error);
+
+    /** Actions of a predicate, read on first use. */
+    std::shared_ptr<ActionSet const> actions(String const& p_predicate,
+                                             String& r_error);
+
+    /** Puts the Prolog list of some propositions in a term. */
+    bool put_list(term_t p_list, std::vector<uint32_t> const& p_ids);
+
+    /** Estimated cost from a state to the goal. */
+    bool heuristic(Search& p_search,
+                   std::vector<uint32_t> const& p_state,
+                   double& r_cost,
+                   String& r_error);
+
+private:
+
+    /** Proposition text (writeq) -> id. */
+    std::unordered_map<std::string, uint32_t> m_ids;
+
+    /** Proposition id -> recorded term. */
+    std::vector<record_t> m_records;
+
+    /** Action predicate name -> actions. */
+    std::unordered_map<std::string, std::shared_ptr<ActionSet const>>
+        m_action_sets;
+
+    /** Search key -> plan (nullptr entries are cached failures). */
+    std::unordered_map<std::string, std::shared_ptr<PackedStringArray>>
+        m_plans;
+
+    /** Running and finished searches by id. */
+    std::unordered_map<int64_t, std::unique_ptr<Search>> m_searches;
+
+    /** Next search id. */
+    int64_t m_next_id = 1;
+};
@@ -0,0 +1,474 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the JsonTerm class.
+ */
+
+#include "JsonTerm.hpp"
+#include "JsonValue.hpp"
+#include <cmath>
+#include <cstring>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+// Handles looked up by JsonTerm::register_predicates() after each
+// PL_initialise(): they do not survive PL_cleanup()
+atom_t s_atom_true = 0;
+atom_t s_atom_false = 0;
+atom_t s_atom_null = 0;
+functor_t s_functor_json1 = 0;
+functor_t s_functor_equal2 = 0;
+functor_t s_functor_minus2 = 0;
+
+/** Functor of a name; the functor keeps the atom of its name. */
+functor_t new_functor(const char* p_name, size_t p_arity)
+{
+    atom_t name = PL_new_atom(p_name);
+    functor_t functor = PL_new_functor(name, p_arity);
+    PL_unregister_atom(name);
+    return functor;
+}
+
+/**
+ * Serializes a ground term as compact JSON, remembering the first subterm
+ * that has no JSON equivalent.
+ */
+class JsonWriter
+{
+public:
+
+    bool write(term_t p_term)
+    {
+        switch (PL_term_type(p_term))
+        {
+            case PL_VARIABLE:
+                return fail(p_term, "unbound variable");
+            case PL_NIL:
+                m_json += "[]";
+                return true;
+            case PL_ATOM:
+            {
+                atom_t atom;
+                PL_get_atom(p_term, &atom);
+                if (atom == s_atom_true || atom == s_atom_false ||
+                    atom == s_atom_null)
+                {
+                    m_json += PL_atom_chars(atom);
+                    return true;
+                }
+                return write_text(p_term);
+            }
+            case PL_STRING:
+                return write_text(p_term);
+            case PL_INTEGER:
+            {
+                int64_t value;
+                if (!PL_get_int64(p_term, &value))
+                    return fail(p_term, "integer out of 64-bit range");
+                m_json += std::to_string(value);
+                return true;
+            }
+            case PL_FLOAT:
+                return write_float(p_term);
+            case PL_LIST_PAIR:
+                return write_list(p_term);
+            case PL_DICT:
+                return write_dict(p_term);
+            case PL_TERM:
+                return write_compound(p_term);
+            default:
+                return fail(p_term, "no JSON equivalent");
+        }
+    }
+
+    std::string m_json;
+    String m_error;
+    term_t m_culprit = 0;
+
+private:
+
+    bool fail(term_t p_term, const char* p_reason)
+    {
+        if (m_culprit == 0)
+        {
+            m_culprit = PL_copy_term_ref(p_term);
+            char* text = nullptr;
+            m_error = String("Cannot convert to JSON (") + p_reason + ")";
+            if (PL_get_chars(p_term, &text, CVT_WRITE | BUF_DISCARDABLE))
+            {
+                m_error += ": " + String::utf8(text);
+            }
+        }
+        return false;
+    }
+
+    void write_escaped(const char* p_text, size_t p_length)
+    {
+        static const char hex[] = "0123456789abcdef";
+        m_json += '"';
+        for (size_t i = 0; i < p_length; i++)
+        {
+            unsigned char c = (unsigned char)p_text[i];
+            switch (c)
+            {
+                case '"':
+                    m_json += "\\\"";
+                    break;
+                case '\\':
+                    m_json += "\\\\";
+                    break;
+                case '\n':
+                    m_json += "\\n";
+                    break;
+                case '\r':
+                    m_json += "\\r";
+                    break;
+                case '\t':
+                    m_json += "\\t";
+                    break;
+                default:
+                    if (c < 0x20)
+                    {
+                        m_json += "\\u00";
+                        m_json += hex[c >> 4];
+                        m_json += hex[c & 0xF];
+                    }
+                    else
+                    {
+                        m_json += (char)c; // UTF-8 is copied as is
+                    }
+                    break;
+            }
+        }
+        m_json += '"';
+    }
+
+    bool write_text(term_t p_term)
+    {
+        char* text = nullptr;
+        size_t length = 0;
+        if (!PL_get_nchars(p_term,
+                           &length,
+                           &text,
+                           CVT_ATOM | CVT_STRING | REP_UTF8 | BUF_DISCARDABLE))
+        {
+            return fail(p_term, "invalid text");
+        }
+        write_escaped(text, length);
+        return true;
+    }
+
+    bool write_float(term_t p_term)
+    {
+        double value;
+        PL_get_float(p_term, &value);
+        if (!std::isfinite(value))
+            return fail(p_term, "infinite or NaN float");
+
+        // Shortest text that reads back to the same double, kept a float.
+        // The classic locale writes and reads a '.' as the decimal point
+        // whatever the C locale of the process (printf() follows the latter)
+        std::string text;
+        for (int precision = 15; precision <= 17; precision++)
+        {
+            std::ostringstream out;
+            out.imbue(std::locale::classic());
+            out.precision(precision);
+            out << value;
+            text = out.str();
+
+            std::istringstream in(text);
+            in.imbue(std::locale::classic());
+            double read = 0.0;
+            in >> read;
+            if (read == value)
+                break;
+        }
+        m_json += text;
+        if (text.find_first_of(".eE") == std::string::npos)
+            m_json += ".0";
+        return true;
+    }
+
+    bool write_list(term_t p_term)
+    {
+        term_t head = PL_new_term_ref();
+        term_t tail = PL_copy_term_ref(p_term);
+        bool first = true;
+
+        m_json += '[';
+        while (PL_get_list(tail, head, tail))
+        {
+            if (!first)
+                m_json += ',';
+            first = false;
+            if (!write(head))
+                return false;
+        }
+        if (!PL_get_nil(tail))
+            return fail(tail, "partial list");
+        m_json += ']';
+        PL_reset_term_refs(head);
+        return true;
+    }
+
+    bool write_key(term_t p_key)
+    {
+        int64_t number;
+        if (PL_is_integer(p_key) && PL_get_int64(p_key, &number))
+        {
+            m_json += '"' + std::to_string(number) + '"';
+            return true;
+        }
+        if (!PL_is_atom(p_key) && !PL_is_string(p_key))
+            return fail(p_key, "object key is not an atom");
+        return write_text(p_key);
+    }
+
+    bool write_member(term_t p_key, term_t p_value, bool p_first)
+    {
+        if (!p_first)
+            m_json += ',';
+        if (!write_key(p_key))
+            return false;
+        m_json += ':';
+        return write(p_value);
+    }
+
+    /** Callback of PL_for_dict(): returns non-zero to stop. */
+    static int dict_member(term_t p_key, term_t p_value, void* p_closure)
+    {
+        JsonWriter* self = static_cast<JsonWriter*>(p_closure);
+        bool first = self->m_first_member;
+        self->m_first_member = false;
+        return self->write_member(p_key, p_value, first) ? 0 : -1;
+    }
+
+    bool write_dict(term_t p_term)
+    {
+        // Nested dicts are written from the callback: save the outer state
+        bool outer_first = m_first_member;
+        m_json += '{';
+        m_first_member = true;
+        if (PL_for_dict(p_term, dict_member, this, PL_FOR_DICT_SORTED) != 0)
+            return false;
+        m_json += '}';
+        m_first_member = outer_first;
+        return true;
+    }
+
+    /** Classic json([Key=Value, ...]) or json([Key-Value, ...]) object. */
+    bool write_compound(term_t p_term)
+    {
+        if (!PL_is_functor(p_term, s_functor_json1))
+            return fail(p_term, "compound term");
+
+        term_t pairs = PL_new_term_ref();
+        term_t pair = PL_new_term_ref();
+        term_t key = PL_new_term_ref();
+        term_t value = PL_new_term_ref();
+        PL_get_arg(1, p_term, pairs);
+
+        m_json += '{';
+        bool first = true;
+        while (PL_get_list(pairs, pair, pairs))
+        {
+            if (!PL_is_functor(pair, s_functor_equal2) &&
+                !PL_is_functor(pair, s_functor_minus2))
+                return fail(pair, "expected Key=Value");
+            PL_get_arg(1, pair, key);
+            PL_get_arg(2, pair, value);
+            if (!write_member(key, value, first))
+                return false;
+            first = false;
+        }
+        if (!PL_get_nil(pairs))
+            return fail(pairs, "partial list");
+        m_json += '}';
+        PL_reset_term_refs(pairs);
+        return true;
+    }
+
+private:
+
+    bool m_first_member = true;
+};
+
+// -----------------------------------------------------------------------------
+// Foreign predicates
+// -----------------------------------------------------------------------------
+
+/** json_to_term(+Text, -Term): Text is an atom, a string or a code list. */
+foreign_t pl_json_to_term(term_t p_text, term_t p_term)
+{
+    char* text = nullptr;
+    size_t length = 0;
+    if (!PL_get_nchars(p_text,
+                       &length,
+                       &text,
+                       CVT_ATOM | CVT_STRING | CVT_LIST | REP_UTF8 |
+                           CVT_EXCEPTION | BUF_DISCARDABLE))
+    {
+        return FALSE;
+    }
+
+    JsonValue document;
+    std::string error;
+    if (!JsonValue::parse(text, length, document, error))
+        return PL_syntax_error(error.c_str(), NULL);
+
+    term_t term = PL_new_term_ref();
+    String build_error;
+    if (!JsonTerm::to_term(document, term, build_error))
+    {
+        if (PL_exception(0))
+            return FALSE;
+        return PL_syntax_error(build_error.utf8().get_data(), NULL);
+    }
+    return PL_unify(p_term, term);
+}
+
+/** term_to_json(+Term, -String). */
+foreign_t pl_term_to_json(term_t p_term, term_t p_json)
+{
+    JsonWriter writer;
+    if (!writer.write(p_term))
+    {
+        if (PL_exception(0))
+            return FALSE;
+        if (PL_is_variable(writer.m_culprit))
+            return PL_instantiation_error(writer.m_culprit);
+        return PL_domain_error("json_term", writer.m_culprit);
+    }
+    return PL_unify_chars(p_json,
+                          PL_STRING | REP_UTF8,
+                          writer.m_json.size(),
+                          writer.m_json.c_str());
+}
+
+} // namespace
+
+// =============================================================================
+// JsonTerm
+// =============================================================================
+
+bool JsonTerm::to_term(JsonValue const& p_value,
+                       term_t p_term,
+                       String& r_error)
+{
+    switch (p_value.type)
+    {
+        case JsonValue::Type::NUL:
+            return PL_put_atom_chars(p_term, "null");
+        case JsonValue::Type::BOOLEAN:
+            return PL_put_atom_chars(p_term,
+                                     p_value.boolean ? "true" : "false");
+        case JsonValue::Type::INTEGER:
+            return PL_put_int64(p_term, p_value.integer);
+        case JsonValue::Type::NUMBER:
+            return PL_put_float(p_term, p_value.number);
+        case JsonValue::Type::STRING:
+            return PL_put_chars(p_term,
+                                PL_STRING | REP_UTF8,
+                                p_value.text.size(),
+                                p_value.text.c_str());
+        case JsonValue::Type::ARRAY:
+        {
+            // Build the list from its end; free the references afterwards
+            term_t item = PL_new_term_ref();
+            if (!PL_put_nil(p_term))
+                return false;
+            for (size_t i = p_value.items.size(); i-- > 0;)
+            {
+                if (!to_term(p_value.items[i], item, r_error) ||
+                    !PL_cons_list(p_term, item, p_term))
+                {
+                    return false;
+                }
+            }
+            PL_reset_term_refs(item);
+            return true;
+        }
+        case JsonValue::Type::OBJECT:
+        {
+            size_t count = p_value.members.size();
+            std::vector<atom_t> keys(count);
+            term_t values = PL_new_term_refs(count);
+            bool ok = true;
+            for (size_t i = 0; i < count && ok; i++)
+            {
+                std::string const& key = p_value.members[i].first;
+                keys[i] =
+                    PL_new_atom_mbchars(REP_UTF8, key.size(), key.c_str());
+                ok = to_term(p_value.members[i].second, values + i, r_error);
+            }
+            if (ok && !PL_put_dict(p_term, 0, count, keys.data(), values))
+            {
+                PL_clear_exception();
+                r_error = "Duplicate key in JSON object";
+                ok = false;
+            }
+
+            // The dict references the keys now: drop our references
+            for (atom_t key : keys)
+            {
+                if (key != 0)
+                    PL_unregister_atom(key);
+            }
+            PL_reset_term_refs(values);
+            return ok;
+        }
+    }
+    return false;
+}
+
+bool JsonTerm::parse(const char* p_text,
+                     size_t p_length,
+                     term_t p_term,
+                     String& r_error)
+{
+    JsonValue document;
+    std::string error;
+    if (!JsonValue::parse(p_text, p_length, document, error))
+    {
+        r_error = "Invalid JSON: " + String::utf8(error.c_str());
+        return false;
+    }
+    return to_term(document, p_term, r_error);
+}
+
+bool JsonTerm::to_json(term_t p_term, std::string& r_json, String& r_error)
+{
+    JsonWriter writer;
+    if (!writer.write(p_term))
+    {
+        PL_clear_exception();
+        r_error = writer.m_error;
+        return false;
+    }
+    r_json = std::move(writer.m_json);
+    return true;
+}
+
+void JsonTerm::register_predicates()
+{
+    s_atom_true = PL_new_atom("true");
+    s_atom_false = PL_new_atom("false");
+    s_atom_null = PL_new_atom("null");
+    s_functor_json1 = new_functor("json", 1);
+    s_functor_equal2 = new_functor("=", 2);
+    s_functor_minus2 = new_functor("-", 2);
+
+    PL_register_foreign_in_module(
+        "user", "json_to_term", 2, (pl_function_t)pl_json_to_term, 0);
+    PL_register_foreign_in_module(
+        "user", "term_to_json", 2, (pl_function_t)pl_term_to_json, 0);
+}
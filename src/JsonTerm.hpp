@@ -0,0 +1,85 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the JsonTerm class: direct conversion between JSON text
+ * and Prolog terms, without Godot Variants in between.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <godot_cpp/variant/string.hpp>
+
+#include <string>
+
+using namespace godot;
+
+class JsonValue;
+
+/**
+ * @class JsonTerm
+ * @brief Converts JSON text to Prolog terms and back.
+ *
+ * The mapping follows SWI-Prolog's json_read_dict/2:
+ * - objects <-> dicts (tag unbound); json([Key=Value, ...]) and
+ *   json([Key-Value, ...]) terms are also accepted when writing,
+ * - arrays <-> lists,
+ * - strings <-> strings (atoms other than true, false and null are written
+ *   as strings too),
+ * - numbers <-> integers and floats,
+ * - true, false, null <-> the atoms true, false, null.
+ *
+ * The conversions are also available from Prolog as json_to_term/2 and
+ * term_to_json/2 (see register_predicates()).
+ */
+class JsonTerm
+{
+public:
+
+    /**
+     * @brief Builds the term of a parsed JSON document.
+     *
+     * @param p_value Parsed JSON document.
+     * @param p_term Term reference receiving the term.
+     * @param r_error Error message on failure (e.g., duplicate keys).
+     * @return true on success.
+     */
+    static bool to_term(JsonValue const& p_value,
+                        term_t p_term,
+                        String& r_error);
+
+    /**
+     * @brief Parses a JSON text into a term.
+     *
+     * @param p_text UTF-8 JSON text.
+     * @param p_length Length of the text in bytes.
+     * @param p_term Term reference receiving the term.
+     * @param r_error Error message on failure.
+     * @return true on success.
+     */
+    static bool parse(const char* p_text,
+                      size_t p_length,
+                      term_t p_term,
+                      String& r_error);
+
+    /**
+     * @brief Writes a term as compact JSON text.
+     *
+     * @param p_term Term to convert (must be ground).
+     * @param r_json UTF-8 JSON text.
+     * @param r_error Error message when the term has no JSON equivalent.
+     * @return true on success.
+     */
+    static bool to_json(term_t p_term, std::string& r_json, String& r_error);
+
+    /**
+     * @brief Registers json_to_term(+Text, -Term) and
+     * term_to_json(+Term, -String) in the user module, and looks up the
+     * atoms and functors of the conversions. Called after each
+     * PL_initialise().
+     */
+    static void register_predicates();
+};
@@ -0,0 +1,757 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the JsonValue class.
+ */
+
+#include "JsonValue.hpp"
+#include <cmath>
+#include <locale>
+#include <sstream>
+
+namespace
+{
+
+//! Nesting limit protecting the stack against malicious documents.
+const int JSON_MAX_DEPTH = 512;
+
+/**
+ * Recursive descent parser over a text buffer.
+ */
+class JsonParser
+{
+public:
+
+    /**
+     * @param p_offset Offset of p_text in the document, for the messages.
+     * @param p_partial Whether p_text may be followed by more text: see
+     * hit_end().
+     */
+    JsonParser(const char* p_text,
+               size_t p_length,
+               size_t p_offset = 0,
+               bool p_partial = false)
+        : m_text(p_text),
+          m_end(p_text + p_length),
+          m_cursor(p_text),
+          m_offset(p_offset),
+          m_partial(p_partial)
+    {
+    }
+
+    bool parse_document(JsonValue& r_value)
+    {
+        if (!parse_value(r_value, 0))
+            return false;
+        skip_spaces();
+        return at_end() || fail("unexpected trailing characters");
+    }
+
+    std::string const& error() const
+    {
+        return m_error;
+    }
+
+    /** Number of bytes parsed so far. */
+    size_t position() const
+    {
+        return size_t(m_cursor - m_text);
+    }
+
+    /**
+     * Whether the parser looked past the end of a partial text: its result
+     * may change once more text is appended, so it must be run again.
+     */
+    bool hit_end() const
+    {
+        return m_hit_end && m_partial;
+    }
+
+    bool fail(const char* p_message)
+    {
+        m_error = std::string(p_message) + " at offset " +
+                  std::to_string(m_offset + position());
+        return false;
+    }
+
+    void skip_spaces()
+    {
+        while (!at_end() && (*m_cursor == ' ' || *m_cursor == '\t' ||
+                             *m_cursor == '\n' || *m_cursor == '\r'))
+        {
+            ++m_cursor;
+        }
+    }
+
+    /** Whether the whole text was parsed. */
+    bool at_end()
+    {
+        if (m_cursor != m_end)
+            return false;
+        m_hit_end = true;
+        return true;
+    }
+
+    /** Consumes p_char after optional spaces. */
+    bool expect(char p_char)
+    {
+        skip_spaces();
+        if (at_end() || *m_cursor != p_char)
+            return false;
+        ++m_cursor;
+        return true;
+    }
+
+    /** Whether the next character, after optional spaces, is p_char. */
+    bool next_is(char p_char)
+    {
+        skip_spaces();
+        return !at_end() && *m_cursor == p_char;
+    }
+
+    bool parse_value(JsonValue& r_value, int p_depth)
+    {
+        if (p_depth > JSON_MAX_DEPTH)
+            return fail("too deeply nested document");
+
+        skip_spaces();
+        if (at_end())
+            return fail("unexpected end of document");
+
+        switch (*m_cursor)
+        {
+            case '{':
+                return parse_object(r_value, p_depth);
+            case '[':
+                return parse_array(r_value, p_depth);
+            case '"':
+                r_value.type = JsonValue::Type::STRING;
+                return parse_string(r_value.text);
+            case 't':
+            case 'f':
+                r_value.type = JsonValue::Type::BOOLEAN;
+                r_value.boolean = (*m_cursor == 't');
+                return consume(r_value.boolean ? "true" : "false") ||
+                       fail("invalid literal");
+            case 'n':
+                r_value.type = JsonValue::Type::NUL;
+                return consume("null") || fail("invalid literal");
+            default:
+                return parse_number(r_value);
+        }
+    }
+
+    bool parse_object(JsonValue& r_value, int p_depth)
+    {
+        r_value.type = JsonValue::Type::OBJECT;
+        ++m_cursor; // '{'
+        skip_spaces();
+        if (!at_end() && *m_cursor == '}')
+        {
+            ++m_cursor;
+            return true;
+        }
+
+        while (true)
+        {
+            if (!next_is('"'))
+                return fail("expected member name");
+            r_value.members.emplace_back();
+            if (!parse_string(r_value.members.back().first))
+                return false;
+
+            if (!expect(':'))
+                return fail("expected ':'");
+            if (!parse_value(r_value.members.back().second, p_depth + 1))
+                return false;
+
+            if (expect(','))
+                continue;
+            if (expect('}'))
+                return true;
+            return fail("expected ',' or '}'");
+        }
+    }
+
+    bool parse_array(JsonValue& r_value, int p_depth)
+    {
+        r_value.type = JsonValue::Type::ARRAY;
+        ++m_cursor; // '['
+        skip_spaces();
+        if (!at_end() && *m_cursor == ']')
+        {
+            ++m_cursor;
+            return true;
+        }
+
+        while (true)
+        {
+            r_value.items.emplace_back();
+            if (!parse_value(r_value.items.back(), p_depth + 1))
+                return false;
+
+            if (expect(','))
+                continue;
+            if (expect(']'))
+                return true;
+            return fail("expected ',' or ']'");
+        }
+    }
+
+    bool parse_hex4(uint32_t& r_code)
+    {
+        r_code = 0;
+        for (int i = 0; i < 4; i++, m_cursor++)
+        {
+            if (at_end())
+                return false;
+            char c = *m_cursor;
+            r_code <<= 4;
+            if (c >= '0' && c <= '9')
+                r_code |= uint32_t(c - '0');
+            else if (c >= 'a' && c <= 'f')
+                r_code |= uint32_t(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F')
+                r_code |= uint32_t(c - 'A' + 10);
+            else
+                return false;
+        }
+        return true;
+    }
+
+    static void append_utf8(std::string& r_text, uint32_t p_code)
+    {
+        if (p_code < 0x80)
+        {
+            r_text += char(p_code);
+        }
+        else if (p_code < 0x800)
+        {
+            r_text += char(0xC0 | (p_code >> 6));
+            r_text += char(0x80 | (p_code & 0x3F));
+        }
+        else if (p_code < 0x10000)
+        {
+            r_text += char(0xE0 | (p_code >> 12));
+            r_text += char(0x80 | ((p_code >> 6) & 0x3F));
+            r_text += char(0x80 | (p_code & 0x3F));
+        }
+        else
+        {
+            r_text += char(0xF0 | (p_code >> 18));
+            r_text += char(0x80 | ((p_code >> 12) & 0x3F));
+            r_text += char(0x80 | ((p_code >> 6) & 0x3F));
+            r_text += char(0x80 | (p_code & 0x3F));
+        }
+    }
+
+    bool parse_string(std::string& r_text)
+    {
+        ++m_cursor; // '"'
+        while (!at_end())
+        {
+            // Copy runs of plain characters at once
+            const char* run = m_cursor;
+            while (m_cursor < m_end && *m_cursor != '"' && *m_cursor != '\\' &&
+                   (unsigned char)*m_cursor >= 0x20)
+            {
+                ++m_cursor;
+            }
+            r_text.append(run, m_cursor - run);
+            if (at_end())
+                break;
+
+            char c = *m_cursor++;
+            if (c == '"')
+                return true;
+            if (c != '\\')
+                return fail("control character in string");
+            if (at_end())
+                break;
+
+            c = *m_cursor++;
+            switch (c)
+            {
+                case '"':
+                case '\\':
+                case '/':
+                    r_text += c;
+                    break;
+                case 'b':
+                    r_text += '\b';
+                    break;
+                case 'f':
+                    r_text += '\f';
+                    break;
+                case 'n':
+                    r_text += '\n';
+                    break;
+                case 'r':
+                    r_text += '\r';
+                    break;
+                case 't':
+                    r_text += '\t';
+                    break;
+                case 'u':
+                {
+                    uint32_t code;
+                    if (!parse_hex4(code))
+                        return fail("invalid \\u escape");
+                    // Combine UTF-16 surrogate pairs
+                    if (code >= 0xD800 && code <= 0xDBFF)
+                    {
+                        uint32_t low;
+                        if (!consume("\\u") || !parse_hex4(low) ||
+                            low < 0xDC00 || low > 0xDFFF)
+                        {
+                            return fail("invalid surrogate pair");
+                        }
+                        code = 0x10000 + ((code - 0xD800) << 10) +
+                               (low - 0xDC00);
+                    }
+                    append_utf8(r_text, code);
+                    break;
+                }
+                default:
+                    return fail("invalid escape sequence");
+            }
+        }
+        return fail("unterminated string");
+    }
+
+    bool parse_number(JsonValue& r_value)
+    {
+        const char* start = m_cursor;
+        if (!at_end() && *m_cursor == '-')
+            ++m_cursor;
+        if (at_end() || *m_cursor < '0' || *m_cursor > '9')
+            return fail("unexpected character");
+        while (!at_end() &&
+               ((*m_cursor >= '0' && *m_cursor <= '9') || *m_cursor == '.' ||
+                *m_cursor == 'e' || *m_cursor == 'E' || *m_cursor == '+' ||
+                *m_cursor == '-'))
+        {
+            ++m_cursor;
+        }
+
+        if (!JsonValue::parse_number(
+                start, size_t(m_cursor - start), false, r_value))
+        {
+            m_cursor = start;
+            return fail("invalid number");
+        }
+        return true;
+    }
+
+private:
+
+    bool consume(const char* p_word)
+    {
+        const char* cursor = m_cursor;
+        for (; *p_word != '\0'; ++p_word, ++cursor)
+        {
+            if (cursor == m_end)
+            {
+                m_hit_end = true;
+                return false;
+            }
+            if (*cursor != *p_word)
+                return false;
+        }
+        m_cursor = cursor;
+        return true;
+    }
+
+    const char* m_text;
+    const char* m_end;
+    const char* m_cursor;
+    size_t m_offset;
+    bool m_partial;
+    bool m_hit_end = false;
+    std::string m_error;
+};
+
+bool has_bom(const char* p_text, size_t p_length)
+{
+    return p_length >= 3 && (unsigned char)p_text[0] == 0xEF &&
+           (unsigned char)p_text[1] == 0xBB && (unsigned char)p_text[2] == 0xBF;
+}
+
+/**
+ * Text of a document read by chunks, parsed by steps. A step that stopped
+ * at the end of the text read so far is run again once more text is read,
+ * so only the text of the current step is kept in memory.
+ */
+class JsonStream
+{
+public:
+
+    explicit JsonStream(JsonValue::ReadFunction const& p_read)
+        : m_read(p_read)
+    {
+    }
+
+    /**
+     * Runs p_step(JsonParser&) on the unparsed text and consumes what it
+     * parsed. Returns false, with the message in error(), if it failed.
+     */
+    template <typename STEP>
+    bool step(STEP p_step)
+    {
+        while (true)
+        {
+            JsonParser parser(m_buffer.data() + m_offset,
+                              m_buffer.size() - m_offset,
+                              m_position,
+                              !m_eof);
+            bool ok = p_step(parser);
+            if (parser.hit_end())
+            {
+                read_more();
+                continue;
+            }
+            if (!ok)
+            {
+                m_error = parser.error();
+                return false;
+            }
+            m_offset += parser.position();
+            m_position += parser.position();
+            return true;
+        }
+    }
+
+    std::string const& error() const
+    {
+        return m_error;
+    }
+
+private:
+
+    void read_more()
+    {
+        // Drop the parsed text before growing the buffer
+        m_buffer.erase(0, m_offset);
+        m_offset = 0;
+
+        // The first bytes are read until the byte order mark can be checked
+        do
+        {
+            size_t size = m_buffer.size();
+            m_buffer.resize(size + CHUNK_SIZE);
+            size_t read = m_read(&m_buffer[size], CHUNK_SIZE);
+            m_buffer.resize(size + read);
+            m_eof = (read == 0);
+        } while (!m_bom_checked && !m_eof && m_buffer.size() < 3);
+
+        // Skip the UTF-8 byte order mark written by some editors
+        if (!m_bom_checked)
+        {
+            m_bom_checked = true;
+            if (has_bom(m_buffer.data(), m_buffer.size()))
+            {
+                m_offset = m_position = 3;
+            }
+        }
+    }
+
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    JsonValue::ReadFunction const& m_read;
+    std::string m_buffer;
+    //! Start of the unparsed text in m_buffer.
+    size_t m_offset = 0;
+    //! Offset of the unparsed text in the document.
+    size_t m_position = 0;
+    bool m_eof = false;
+    bool m_bom_checked = false;
+    std::string m_error;
+};
+
+} // namespace
+
+// =============================================================================
+// JsonValue
+// =============================================================================
+
+bool JsonValue::parse(const char* p_text,
+                      size_t p_length,
+                      JsonValue& r_value,
+                      std::string& r_error)
+{
+    r_value = JsonValue();
+
+    // Skip the UTF-8 byte order mark written by some editors
+    size_t start = has_bom(p_text, p_length) ? 3 : 0;
+    JsonParser parser(p_text + start, p_length - start, start);
+    if (!parser.parse_document(r_value))
+    {
+        r_error = parser.error();
+        return false;
+    }
+    return true;
+}
+
+bool JsonValue::parse_items(ReadFunction const& p_read,
+                            std::string const& p_root,
+                            ItemFunction const& p_item,
+                            std::string& r_error)
+{
+    JsonStream stream(p_read);
+    JsonValue item;
+    size_t index = 0;
+    bool item_failed = false;
+
+    auto parse_array = [&]() -> bool
+    {
+        bool last = false;
+        if (!stream.step(
+                [&](JsonParser& p_parser)
+                {
+                    if (!p_parser.expect('['))
+                        return p_parser.fail("expected an array of objects");
+                    last = p_parser.expect(']');
+                    return true;
+                }))
+        {
+            return false;
+        }
+        while (!last)
+        {
+            if (!stream.step(
+                    [&](JsonParser& p_parser)
+                    {
+                        item = JsonValue();
+                        return p_parser.parse_value(item, 1);
+                    }))
+            {
+                return false;
+            }
+            if (!p_item(item, index++))
+            {
+                item_failed = true;
+                return false;
+            }
+            if (!stream.step(
+                    [&](JsonParser& p_parser)
+                    {
+                        if (p_parser.expect(','))
+                            return true;
+                        last = p_parser.expect(']');
+                        return last || p_parser.fail("expected ',' or ']'");
+                    }))
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    bool ok = true;
+    bool found = p_root.empty();
+    if (found)
+    {
+        ok = parse_array();
+    }
+    else
+    {
+        // Members before and after the root are parsed one at a time
+        bool last = false;
+        ok = stream.step(
+            [&](JsonParser& p_parser)
+            {
+                if (!p_parser.expect('{'))
+                    return p_parser.fail("expected an object");
+                last = p_parser.expect('}');
+                return true;
+            });
+        std::string name;
+        while (ok && !last)
+        {
+            ok = stream.step(
+                [&](JsonParser& p_parser)
+                {
+                    name.clear();
+                    if (!p_parser.next_is('"'))
+                        return p_parser.fail("expected member name");
+                    return p_parser.parse_string(name) &&
+                           (p_parser.expect(':') ||
+                            p_parser.fail("expected ':'"));
+                });
+            if (ok && !found && name == p_root)
+            {
+                found = true;
+                ok = parse_array();
+            }
+            else if (ok)
+            {
+                ok = stream.step(
+                    [&](JsonParser& p_parser)
+                    {
+                        JsonValue ignored;
+                        return p_parser.parse_value(ignored, 1);
+                    });
+            }
+            ok = ok && stream.step(
+                           [&](JsonParser& p_parser)
+                           {
+                               if (p_parser.expect(','))
+                                   return true;
+                               last = p_parser.expect('}');
+                               return last ||
+                                      p_parser.fail("expected ',' or '}'");
+                           });
+        }
+    }
+
+    ok = ok && stream.step(
+                   [&](JsonParser& p_parser)
+                   {
+                       p_parser.skip_spaces();
+                       return p_parser.at_end() ||
+                              p_parser.fail("unexpected trailing characters");
+                   });
+    if (!ok)
+    {
+        if (!item_failed)
+            r_error = stream.error();
+        return false;
+    }
+    if (!found)
+    {
+        r_error = "no member named " + p_root;
+        return false;
+    }
+    return true;
+}
+
+bool JsonValue::parse_number(const char* p_text,
+                             size_t p_length,
+                             bool p_lenient,
+                             JsonValue& r_value)
+{
+    const char* cursor = p_text;
+    const char* end = p_text + p_length;
+    bool negative = false;
+    if (cursor < end && (*cursor == '-' || (p_lenient && *cursor == '+')))
+    {
+        negative = (*cursor++ == '-');
+    }
+
+    // Up to 19 significant digits are kept exactly in the mantissa; the
+    // value is mantissa * 10^scale
+    uint64_t mantissa = 0;
+    int significant = 0;
+    int64_t scale = 0;
+    bool truncated = false;
+    size_t int_digits = 0;
+    size_t fraction_digits = 0;
+    auto digit = [&](bool p_fraction)
+    {
+        int value = *cursor++ - '0';
+        if (significant == 0 && value == 0)
+        {
+            scale -= p_fraction;
+        }
+        else if (significant < 19)
+        {
+            mantissa = mantissa * 10 + uint64_t(value);
+            significant++;
+            scale -= p_fraction;
+        }
+        else
+        {
+            truncated = truncated || (value != 0);
+            scale += !p_fraction;
+        }
+    };
+
+    for (; cursor < end && *cursor >= '0' && *cursor <= '9'; int_digits++)
+        digit(false);
+    bool integral = true;
+    if (cursor < end && *cursor == '.')
+    {
+        integral = false;
+        ++cursor;
+        for (; cursor < end && *cursor >= '0' && *cursor <= '9';
+             fraction_digits++)
+        {
+            digit(true);
+        }
+    }
+    if (int_digits + fraction_digits == 0 ||
+        (!p_lenient && (int_digits == 0 || (!integral && !fraction_digits))))
+    {
+        return false;
+    }
+    if (cursor < end && (*cursor == 'e' || *cursor == 'E'))
+    {
+        integral = false;
+        ++cursor;
+        bool exponent_negative = false;
+        if (cursor < end && (*cursor == '+' || *cursor == '-'))
+            exponent_negative = (*cursor++ == '-');
+        if (cursor == end || *cursor < '0' || *cursor > '9')
+            return false;
+        int64_t exponent = 0;
+        for (; cursor < end && *cursor >= '0' && *cursor <= '9'; ++cursor)
+        {
+            if (exponent < 100000)
+                exponent = exponent * 10 + (*cursor - '0');
+        }
+        scale += exponent_negative ? -exponent : exponent;
+    }
+    if (cursor != end)
+        return false;
+
+    if (integral && scale == 0 &&
+        mantissa <= uint64_t(INT64_MAX) + (negative ? 1 : 0))
+    {
+        r_value.type = Type::INTEGER;
+        r_value.integer = negative ? int64_t(0 - mantissa) : int64_t(mantissa);
+        return true;
+    }
+
+    // Exact when the mantissa and the power of ten are both exact doubles:
+    // a single rounding then gives the correctly rounded value
+    static const double powers[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    double number;
+    if (!truncated && mantissa <= (uint64_t(1) << 53) && scale >= -22 &&
+        scale <= 22)
+    {
+        number = (scale < 0) ? double(mantissa) / powers[-scale]
+                             : double(mantissa) * powers[scale];
+    }
+    else
+    {
+        // The classic locale reads '.' as the decimal point whatever the
+        // C locale of the process (strtod() follows the latter)
+        std::istringstream stream(std::string(p_text, p_length));
+        stream.imbue(std::locale::classic());
+        stream >> number;
+        if (stream.fail())
+            return false;
+        number = std::fabs(number);
+    }
+    if (!std::isfinite(number))
+        return false;
+
+    r_value.type = Type::NUMBER;
+    r_value.number = negative ? -number : number;
+    return true;
+}
+
+JsonValue const* JsonValue::find(std::string const& p_key) const
+{
+    for (auto const& member : members)
+    {
+        if (member.first == p_key)
+            return &member.second;
+    }
+    return nullptr;
+}
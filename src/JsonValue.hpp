@@ -0,0 +1,127 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the JsonValue class: a minimal JSON document parsed in
+ * a single pass, used to load and convert JSON data without going through
+ * Godot Variants.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @class JsonValue
+ * @brief Node of a parsed JSON document (RFC 8259).
+ *
+ * Integers that fit in 64 bits are kept exact, other numbers are doubles.
+ * Object members keep their order of appearance in the text. Strings are
+ * stored as UTF-8 with their escape sequences decoded.
+ */
+class JsonValue
+{
+public:
+
+    /** Type of a JSON value. */
+    enum class Type
+    {
+        NUL,
+        BOOLEAN,
+        INTEGER,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    /**
+     * @brief Parses a JSON text.
+     *
+     * @param p_text UTF-8 text (not necessarily null-terminated).
+     * @param p_length Length of the text in bytes.
+     * @param r_value Parsed document.
+     * @param r_error Error message, with the byte offset, on failure.
+     * @return true if the text is a single valid JSON value.
+     */
+    static bool parse(const char* p_text,
+                      size_t p_length,
+                      JsonValue& r_value,
+                      std::string& r_error);
+
+    /**
+     * @brief Reads the next bytes of a document into r_data (at most p_size)
+     * and returns their number, 0 at the end of the document.
+     */
+    using ReadFunction = std::function<size_t(char* r_data, size_t p_size)>;
+
+    /**
+     * @brief Receives an element of an array and its index; returns false
+     * to stop the parsing.
+     */
+    using ItemFunction =
+        std::function<bool(JsonValue const& p_item, size_t p_index)>;
+
+    /**
+     * @brief Parses the elements of a JSON array one at a time, from a text
+     * read by chunks.
+     *
+     * The whole document is validated, but only the element being parsed
+     * is kept in memory: each one is given to p_item, then freed.
+     *
+     * @param p_read Reads the text of the document.
+     * @param p_root Member of the top-level object holding the array, or
+     * empty if the document is the array.
+     * @param p_item Called with each element, in order.
+     * @param r_error Error message, with the byte offset, on failure (left
+     * unchanged if p_item stopped the parsing).
+     * @return true if the document is valid and p_item accepted all the
+     * elements.
+     */
+    static bool parse_items(ReadFunction const& p_read,
+                            std::string const& p_root,
+                            ItemFunction const& p_item,
+                            std::string& r_error);
+
+    /**
+     * @brief Converts the text of a number, whatever the C locale of the
+     * process.
+     *
+     * @param p_text Digits with an optional sign, fraction and exponent.
+     * @param p_length Length of the text in bytes.
+     * @param p_lenient Also accept a leading '+' and a fraction without
+     * integer or decimal digits (".5", "5."), as written in CSV files.
+     * @param r_value Set to an INTEGER if the text has no fraction nor
+     * exponent and fits in 64 bits, to a NUMBER otherwise.
+     * @return false if the text is not a finite number.
+     */
+    static bool parse_number(const char* p_text,
+                             size_t p_length,
+                             bool p_lenient,
+                             JsonValue& r_value);
+
+    /**
+     * @brief Finds the member of an object.
+     *
+     * @param p_key Member name.
+     * @return The member value, or nullptr if absent or not an object.
+     */
+    JsonValue const* find(std::string const& p_key) const;
+
+    Type type = Type::NUL;
+    bool boolean = false;
+    int64_t integer = 0;
+    double number = 0.0;
+    //! Text of a STRING value.
+    std::string text;
+    //! Elements of an ARRAY value.
+    std::vector<JsonValue> items;
+    //! Members of an OBJECT value, in document order.
+    std::vector<std::pair<std::string, JsonValue>> members;
+};
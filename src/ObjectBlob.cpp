@@ -0,0 +1,171 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the ObjectBlob class.
+ */
+
+#include "ObjectBlob.hpp"
+#include "Prologot.hpp"
+#include <godot_cpp/core/object.hpp>
+#include <godot_cpp/variant/node_path.hpp>
+
+#include <cinttypes>
+#include <cstring>
+
+namespace
+{
+
+int release_object(atom_t p_atom)
+{
+    return TRUE; // Nothing to free: the blob only holds the ObjectID
+}
+
+/** Reads the ObjectID stored in a blob (data may be unaligned). */
+uint64_t blob_id(atom_t p_atom)
+{
+    uint64_t id;
+    memcpy(&id, PL_blob_data(p_atom, nullptr, nullptr), sizeof(id));
+    return id;
+}
+
+int compare_objects(atom_t p_a, atom_t p_b)
+{
+    uint64_t a = blob_id(p_a);
+    uint64_t b = blob_id(p_b);
+    return (a < b) ? -1 : (a > b) ? 1 : 0;
+}
+
+int write_object(IOSTREAM* p_stream, atom_t p_atom, int p_flags)
+{
+    uint64_t id = blob_id(p_atom);
+    Sfprintf(p_stream, "<godot_object>(%" PRIu64 ")", id);
+    return TRUE;
+}
+
+PL_blob_t object_blob = {
+    PL_BLOB_MAGIC,
+    PL_BLOB_UNIQUE, // Same ObjectID -> same atom
+    (char*)"godot_object",
+    release_object,
+    compare_objects,
+    write_object,
+    nullptr, // acquire
+    nullptr, // save
+    nullptr, // load
+};
+
+/** Gets the live object of the first argument or raises an error. */
+Object* object_arg(term_t p_term)
+{
+    ObjectID id;
+    if (!ObjectBlob::get(p_term, id))
+    {
+        PL_type_error("godot_object", p_term);
+        return nullptr;
+    }
+    Object* object = ObjectDB::get_instance((uint64_t)id);
+    if (object == nullptr)
+    {
+        PL_existence_error("godot_object", p_term);
+    }
+    return object;
+}
+
+/** Gets a property name or path from an atom or a string. */
+bool property_arg(term_t p_term, NodePath& r_path)
+{
+    char* text = nullptr;
+    size_t length = 0;
+    if (!PL_get_nchars(p_term,
+                       &length,
+                       &text,
+                       CVT_ATOM | CVT_STRING | REP_UTF8 | CVT_EXCEPTION))
+    {
+        return false;
+    }
+    r_path = NodePath(String::utf8(text, (int64_t)length));
+    return true;
+}
+
+foreign_t pl_godot_get(term_t p_object, term_t p_property, term_t p_value)
+{
+    NodePath property;
+    Object* object = object_arg(p_object);
+    if (object == nullptr || !property_arg(p_property, property))
+        return FALSE;
+
+    term_t value = Prologot::variant_to_term(object->get_indexed(property));
+    return value && PL_unify(p_value, value);
+}
+
+foreign_t pl_godot_set(term_t p_object, term_t p_property, term_t p_value)
+{
+    NodePath property;
+    Object* object = object_arg(p_object);
+    if (object == nullptr || !property_arg(p_property, property))
+        return FALSE;
+
+    object->set_indexed(property, Prologot::term_to_variant(p_value));
+    return TRUE;
+}
+
+foreign_t pl_godot_class(term_t p_object, term_t p_class)
+{
+    Object* object = object_arg(p_object);
+    if (object == nullptr)
+        return FALSE;
+
+    CharString name = object->get_class().utf8();
+    return PL_unify_chars(
+        p_class, PL_ATOM | REP_UTF8, name.length(), name.get_data());
+}
+
+foreign_t pl_godot_valid(term_t p_object)
+{
+    return ObjectBlob::get_object(p_object) != nullptr;
+}
+
+} // namespace
+
+// =============================================================================
+// ObjectBlob
+// =============================================================================
+
+bool ObjectBlob::put(term_t p_term, Object const* p_object)
+{
+    uint64_t id = (uint64_t)p_object->get_instance_id();
+    return PL_put_blob(p_term, &id, sizeof(id), &object_blob);
+}
+
+bool ObjectBlob::get(term_t p_term, ObjectID& r_id)
+{
+    void* data = nullptr;
+    PL_blob_t* type = nullptr;
+    if (!PL_get_blob(p_term, &data, nullptr, &type) || type != &object_blob)
+        return false;
+    uint64_t id;
+    memcpy(&id, data, sizeof(id));
+    r_id = ObjectID(id);
+    return true;
+}
+
+Object* ObjectBlob::get_object(term_t p_term)
+{
+    ObjectID id;
+    return get(p_term, id) ? ObjectDB::get_instance((uint64_t)id) : nullptr;
+}
+
+void ObjectBlob::register_predicates()
+{
+    PL_register_foreign_in_module(
+        "user", "godot_get", 3, (pl_function_t)pl_godot_get, 0);
+    PL_register_foreign_in_module(
+        "user", "godot_set", 3, (pl_function_t)pl_godot_set, 0);
+    PL_register_foreign_in_module(
+        "user", "godot_class", 2, (pl_function_t)pl_godot_class, 0);
+    PL_register_foreign_in_module(
+        "user", "godot_valid", 1, (pl_function_t)pl_godot_valid, 0);
+}
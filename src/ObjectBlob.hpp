@@ -0,0 +1,73 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the ObjectBlob class: Godot Object handles stored in
+ * Prolog as blobs.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <godot_cpp/core/object.hpp>
+
+using namespace godot;
+
+/**
+ * @class ObjectBlob
+ * @brief Prolog blob type holding the ObjectID of a Godot Object.
+ *
+ * Objects and Nodes passed to Prolog become opaque handles printed as
+ * <godot_object>(ID) instead of names to look up again. The blob stores the
+ * ObjectID, not the pointer: a handle to a freed object stays a valid term
+ * and converts back to null. Blobs are unique, so two handles of the same
+ * object are identical (==) and can be used as first-argument index keys.
+ *
+ * Foreign predicates (registered in the user module):
+ * - godot_get(+Obj, +Property, -Value): reads a property. Property may be
+ *   an indexed path such as 'position:x'.
+ * - godot_set(+Obj, +Property, +Value): writes a property.
+ * - godot_class(+Obj, -Class): class name of the object.
+ * - godot_valid(+Obj): succeeds if the object is still alive.
+ *
+ * The predicates access the objects directly: like any Godot API call, use
+ * them from the thread owning the objects (typically the main thread).
+ */
+class ObjectBlob
+{
+public:
+
+    /**
+     * @brief Puts a handle to an object in a term.
+     *
+     * @param p_term Term reference receiving the blob.
+     * @param p_object Object (must not be nullptr).
+     * @return true on success.
+     */
+    static bool put(term_t p_term, Object const* p_object);
+
+    /**
+     * @brief Gets the ObjectID held by a term.
+     *
+     * @param p_term Term to inspect.
+     * @param r_id ObjectID of the handle.
+     * @return true if the term is an object handle.
+     */
+    static bool get(term_t p_term, ObjectID& r_id);
+
+    /**
+     * @brief Gets the live object of a handle.
+     *
+     * @param p_term Term to inspect.
+     * @return The object, or nullptr if the term is not a handle or the
+     * object has been freed.
+     */
+    static Object* get_object(term_t p_term);
+
+    /**
+     * @brief Registers the godot_* foreign predicates.
+     */
+    static void register_predicates();
+};
@@ -0,0 +1,261 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the OutputCapture class.
+ */
+
+#include "OutputCapture.hpp"
+#include <godot_cpp/variant/callable_method_pointer.hpp>
+#include <godot_cpp/variant/utility_functions.hpp>
+
+#include <cstddef>
+
+std::mutex OutputCapture::s_mutex;
+std::vector<std::shared_ptr<OutputCapture::Buffer>> OutputCapture::s_buffers;
+OutputCapture* OutputCapture::s_main_owner = nullptr;
+std::atomic<bool> OutputCapture::s_flush_pending(false);
+
+// =============================================================================
+// OutputCapture
+// =============================================================================
+
+OutputCapture::OutputCapture(size_t p_capacity, bool p_flush_to_godot)
+    : m_capacity(p_capacity), m_flush_to_godot(p_flush_to_godot)
+{
+}
+
+OutputCapture::~OutputCapture()
+{
+    if (m_flush_to_godot)
+    {
+        print(take());
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_main_owner == this)
+    {
+        s_main_owner = nullptr;
+    }
+    std::lock_guard<std::mutex> buffers_lock(m_mutex);
+    for (auto const& buffer : m_buffers)
+    {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+        buffer->detached = true;
+        buffer->text.clear();
+    }
+    m_buffers.clear();
+}
+
+bool OutputCapture::redirect(String& r_error)
+{
+    IOSTREAM* output = open_stream(false);
+    IOSTREAM* error = open_stream(true);
+    if (output == nullptr || error == nullptr)
+    {
+        r_error = "Cannot create the Prolog output buffers";
+        return false;
+    }
+
+    // The aliases of the standard streams are local to the engine.
+    // writeln/1 and format/2 write to the current output, which is still
+    // the former user_output: it is redirected too.
+    fid_t fid = PL_open_foreign_frame();
+    term_t stream = PL_new_term_ref();
+    bool ok = set_alias(output, "user_output") &&
+              set_alias(error, "user_error") &&
+              PL_unify_stream(stream, output) &&
+              PL_call_predicate(NULL,
+                                PL_Q_CATCH_EXCEPTION,
+                                PL_predicate("set_output", 1, "system"),
+                                stream);
+    PL_discard_foreign_frame(fid);
+    if (!ok)
+    {
+        r_error = "Cannot redirect the Prolog output streams";
+    }
+    return ok;
+}
+
+bool OutputCapture::capture_main_engine(String& r_error)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (s_main_owner != nullptr)
+        {
+            r_error = "The Prolog output of the main thread is already "
+                      "captured by another instance: only the output of the "
+                      "worker threads of this one is captured";
+            return false;
+        }
+        s_main_owner = this;
+    }
+    return redirect(r_error);
+}
+
+Dictionary OutputCapture::take()
+{
+    Dictionary text;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    take_buffers(m_buffers, text);
+    return text;
+}
+
+void OutputCapture::flush_all()
+{
+    s_flush_pending = false;
+
+    // The buffers of the captures kept for take() are left alone
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        for (auto const& buffer : s_buffers)
+        {
+            if (buffer->flush_to_godot)
+                buffers.push_back(buffer);
+        }
+    }
+    Dictionary text;
+    take_buffers(buffers, text);
+    print(text);
+}
+
+void OutputCapture::clear()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_buffers.clear();
+    s_main_owner = nullptr;
+}
+
+IOSTREAM* OutputCapture::open_stream(bool p_is_error)
+{
+    static IOFUNCTIONS functions = {
+        nullptr, &OutputCapture::write, nullptr, &OutputCapture::close,
+        nullptr, nullptr};
+
+    auto buffer = std::make_shared<Buffer>();
+    buffer->is_error = p_is_error;
+    buffer->capacity = m_capacity;
+    buffer->flush_to_godot = m_flush_to_godot;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_buffers.push_back(buffer);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_buffers.push_back(buffer);
+    }
+
+    // Line buffered: write() is called once per line, not per character
+    IOSTREAM* stream = Snew(buffer.get(),
+                            SIO_OUTPUT | SIO_TEXT | SIO_LBUF | SIO_RECORDPOS,
+                            &functions);
+    if (stream != nullptr)
+    {
+        stream->encoding = ENC_UTF8;
+    }
+    return stream;
+}
+
+void OutputCapture::take_buffers(
+    std::vector<std::shared_ptr<Buffer>> const& p_buffers,
+    Dictionary& r_text)
+{
+    std::string output;
+    std::string error;
+    int64_t dropped = 0;
+    for (auto const& buffer : p_buffers)
+    {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        (buffer->is_error ? error : output)
+            .append(buffer->text.begin(), buffer->text.end());
+        dropped += buffer->dropped;
+        buffer->text.clear();
+        buffer->dropped = 0;
+    }
+
+    r_text["output"] = String::utf8(output.data(), int64_t(output.size()));
+    r_text["error"] = String::utf8(error.data(), int64_t(error.size()));
+    r_text["dropped"] = dropped;
+}
+
+void OutputCapture::print(Dictionary const& p_text)
+{
+    // print() and printerr() end the batch with a new line
+    String output = p_text["output"];
+    String error = p_text["error"];
+    int64_t dropped = p_text["dropped"];
+    if (dropped > 0)
+    {
+        godot::UtilityFunctions::printerr(
+            "Prologot: " + String::num_int64(dropped) +
+            " bytes of Prolog output dropped (buffer full)");
+    }
+    if (!output.is_empty())
+    {
+        godot::UtilityFunctions::print(output.trim_suffix("\n"));
+    }
+    if (!error.is_empty())
+    {
+        godot::UtilityFunctions::printerr(error.trim_suffix("\n"));
+    }
+}
+
+bool OutputCapture::set_alias(IOSTREAM* p_stream, const char* p_alias)
+{
+    term_t args = PL_new_term_refs(2);
+    return PL_unify_stream(args, p_stream) &&
+           PL_unify_term(
+               args + 1, PL_FUNCTOR_CHARS, "alias", 1, PL_CHARS, p_alias) &&
+           PL_call_predicate(NULL,
+                             PL_Q_CATCH_EXCEPTION,
+                             PL_predicate("set_stream", 2, "system"),
+                             args);
+}
+
+ssize_t OutputCapture::write(void* p_handle, char* p_data, size_t p_size)
+{
+    Buffer* buffer = static_cast<Buffer*>(p_handle);
+    {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        if (buffer->detached)
+            return ssize_t(p_size);
+
+        // Drop the oldest text: popping from the front of a deque costs the
+        // bytes dropped, not the capacity. Text beyond the capacity is not
+        // even stored.
+        std::deque<char>& text = buffer->text;
+        size_t skip =
+            (p_size > buffer->capacity) ? p_size - buffer->capacity : 0;
+        text.insert(text.end(), p_data + skip, p_data + p_size);
+        size_t cut = skip;
+        if (text.size() > buffer->capacity)
+        {
+            size_t excess = text.size() - buffer->capacity;
+            text.erase(text.begin(), text.begin() + std::ptrdiff_t(excess));
+            cut += excess;
+        }
+        // Without splitting a UTF-8 sequence
+        while (cut > 0 && !text.empty() &&
+               (uint8_t(text.front()) & 0xC0) == 0x80)
+        {
+            text.pop_front();
+            cut++;
+        }
+        buffer->dropped += int64_t(cut);
+    }
+
+    // The first write of the frame schedules one print for all the engines
+    if (buffer->flush_to_godot && !s_flush_pending.exchange(true))
+    {
+        callable_mp_static(&OutputCapture::flush_all).call_deferred();
+    }
+    return ssize_t(p_size);
+}
+
+int OutputCapture::close(void* /*p_handle*/)
+{
+    return 0;
+}
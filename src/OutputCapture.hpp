@@ -0,0 +1,162 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the OutputCapture class: Prolog output streams written
+ * into in-memory buffers instead of the process stdout.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <SWI-Stream.h>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace godot;
+
+/**
+ * @class OutputCapture
+ * @brief Buffers the user_output and user_error streams of the engines of
+ * a Prologot instance.
+ *
+ * Without capture, format/2, writeln/1 or print_message/2 write to the
+ * process stdout and stderr, unbuffered, from the frame that runs the
+ * query. Each instance enabling the capture owns an OutputCapture, with its
+ * own capacity and flush mode: each engine it redirects (see redirect())
+ * writes to a pair of buffers of its own, so the engines never contend on
+ * a stream, and take() only returns the text of the engines of the
+ * instance. The buffers are either printed to Godot's output in one batch
+ * per frame (flush_all(), deferred by the first write of the frame) or
+ * kept for take().
+ *
+ * The engine of the main thread is shared by the instances: it is
+ * captured by the first instance asking for it (see capture_main_engine()),
+ * until that instance is freed.
+ *
+ * The streams are line buffered: a line is visible in the buffers once it
+ * is complete. Each buffer keeps at most the configured number of bytes;
+ * older text is dropped first and counted.
+ */
+class OutputCapture
+{
+public:
+
+    /**
+     * @param p_capacity Maximum number of bytes kept per buffer.
+     * @param p_flush_to_godot Whether the buffers are printed to Godot's
+     * output once per frame, or kept for take().
+     */
+    OutputCapture(size_t p_capacity, bool p_flush_to_godot);
+
+    /**
+     * @brief Prints the remaining text if the buffers are flushed to Godot,
+     * then detaches the buffers: the streams still open write nowhere.
+     */
+    ~OutputCapture();
+
+    OutputCapture(OutputCapture const&) = delete;
+    OutputCapture& operator=(OutputCapture const&) = delete;
+
+    /**
+     * @brief Redirects user_output, user_error and the current output of
+     * the engine of the calling thread to new buffers of this capture.
+     *
+     * @param r_error Error message on failure.
+     * @return true on success.
+     */
+    bool redirect(String& r_error);
+
+    /**
+     * @brief Redirects the engine of the main thread (the calling thread),
+     * unless another capture owns it.
+     *
+     * @param r_error Error message on failure, or if another instance
+     * already captures the main thread.
+     * @return true on success.
+     */
+    bool capture_main_engine(String& r_error);
+
+    /**
+     * @brief Takes the text of the buffers of this capture.
+     *
+     * @return {"output": String, "error": String, "dropped": int}: the text
+     * written to user_output and to user_error by the engines of this
+     * capture (engine after engine), and the number of bytes dropped
+     * because a buffer was full.
+     */
+    Dictionary take();
+
+    /**
+     * @brief Prints the text of the buffers of all the captures flushed to
+     * Godot's output (errors with printerr). Called on the main thread.
+     */
+    static void flush_all();
+
+    /**
+     * @brief Frees the buffers of all the captures. Called once Prolog is
+     * shut down, since its streams write to them until then.
+     */
+    static void clear();
+
+private:
+
+    /** Text written to a stream, appended by the engine owning it. */
+    struct Buffer
+    {
+        std::mutex mutex;
+        std::deque<char> text;
+        int64_t dropped = 0;
+        bool is_error = false;
+        //! Settings of the capture owning the buffer.
+        size_t capacity = 0;
+        bool flush_to_godot = false;
+        //! Set once the capture is freed: the text is discarded.
+        bool detached = false;
+    };
+
+    /** Creates a stream writing to a new buffer of this capture. */
+    IOSTREAM* open_stream(bool p_is_error);
+
+    /** Takes the text of buffers into r_text. */
+    static void take_buffers(
+        std::vector<std::shared_ptr<Buffer>> const& p_buffers,
+        Dictionary& r_text);
+
+    /** Prints text taken with take_buffers() to Godot's output. */
+    static void print(Dictionary const& p_text);
+
+    /** Binds a standard alias (user_output, user_error) to a stream. */
+    static bool set_alias(IOSTREAM* p_stream, const char* p_alias);
+
+    /** Swrite_function of the streams. */
+    static ssize_t write(void* p_handle, char* p_data, size_t p_size);
+
+    /** Sclose_function of the streams: the buffer outlives the stream. */
+    static int close(void* p_handle);
+
+private:
+
+    size_t m_capacity;
+    bool m_flush_to_godot;
+    std::mutex m_mutex;
+    //! Buffers of the engines redirected by this capture.
+    std::vector<std::shared_ptr<Buffer>> m_buffers;
+
+    static std::mutex s_mutex;
+    //! Buffers of all the captures, kept until Prolog closes the streams.
+    static std::vector<std::shared_ptr<Buffer>> s_buffers;
+    //! Capture of the engine of the main thread, if any.
+    static OutputCapture* s_main_owner;
+    static std::atomic<bool> s_flush_pending;
+};
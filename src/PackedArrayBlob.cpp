@@ -0,0 +1,507 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the PackedArrayBlob class.
+ */
+
+#include "PackedArrayBlob.hpp"
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/packed_float32_array.hpp>
+#include <godot_cpp/variant/packed_float64_array.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_int64_array.hpp>
+
+#include <cstring>
+
+namespace
+{
+
+using ElementType = PackedArrayBlob::ElementType;
+using View = PackedArrayBlob::View;
+
+/**
+ * Owner of the buffer referenced by a blob. Only the array matching the
+ * element type is set; holding it keeps the copy-on-write buffer alive and
+ * unchanged.
+ */
+struct Holder
+{
+    PackedByteArray bytes;
+    PackedInt32Array int32s;
+    PackedInt64Array int64s;
+    PackedFloat32Array float32s;
+    PackedFloat64Array float64s;
+    //! First byte of the whole buffer (to locate the view in slices).
+    const uint8_t* base = nullptr;
+    //! Whether the buffer holds the pixels of an image.
+    bool image = false;
+    View view;
+};
+
+size_t element_size(ElementType p_type)
+{
+    switch (p_type)
+    {
+        case ElementType::BYTE:
+            return 1;
+        case ElementType::INT32:
+        case ElementType::FLOAT32:
+            return 4;
+        default:
+            return 8;
+    }
+}
+
+int release_array(atom_t p_atom);
+int write_array(IOSTREAM* p_stream, atom_t p_atom, int p_flags);
+
+PL_blob_t packed_array_blob = {
+    PL_BLOB_MAGIC,
+    PL_BLOB_UNIQUE, // One atom per holder
+    (char*)"packed_array",
+    release_array,
+    nullptr, // compare: by address
+    write_array,
+    nullptr, // acquire
+    nullptr, // save
+    nullptr, // load
+};
+
+Holder* blob_holder(atom_t p_atom)
+{
+    Holder* holder;
+    memcpy(&holder, PL_blob_data(p_atom, nullptr, nullptr), sizeof(holder));
+    return holder;
+}
+
+/** Gets the holder of a blob term, or nullptr if not a packed array. */
+Holder* term_holder(term_t p_term)
+{
+    void* data = nullptr;
+    PL_blob_t* type = nullptr;
+    if (!PL_get_blob(p_term, &data, nullptr, &type) ||
+        type != &packed_array_blob)
+    {
+        return nullptr;
+    }
+    Holder* holder;
+    memcpy(&holder, data, sizeof(holder));
+    return holder;
+}
+
+int release_array(atom_t p_atom)
+{
+    // Drops the reference to the Godot buffer (atomic reference count)
+    delete blob_holder(p_atom);
+    return TRUE;
+}
+
+int write_array(IOSTREAM* p_stream, atom_t p_atom, int p_flags)
+{
+    static const char* type_names[] = {
+        "byte", "int32", "int64", "float32", "float64"
+    };
+    View const& view = blob_holder(p_atom)->view;
+    if (view.width > 0)
+    {
+        Sfprintf(p_stream,
+                 "<packed_array>(%s[%lldx%lld])",
+                 type_names[(int)view.type],
+                 (long long)view.width,
+                 (long long)(view.length / view.width));
+    }
+    else
+    {
+        Sfprintf(p_stream,
+                 "<packed_array>(%s[%lld])",
+                 type_names[(int)view.type],
+                 (long long)view.length);
+    }
+    return TRUE;
+}
+
+/** Wraps a holder in a blob, taking its ownership. */
+bool put_holder(term_t p_term, Holder* p_holder)
+{
+    if (!PL_put_blob(p_term, &p_holder, sizeof(p_holder), &packed_array_blob))
+    {
+        delete p_holder;
+        return false;
+    }
+    return true;
+}
+
+/** Puts element p_element of a view: a number, or a list of channels. */
+bool put_element(term_t p_term, View const& p_view, int64_t p_element)
+{
+    auto put_scalar = [&p_view](term_t p_value, int64_t p_index) -> bool
+    {
+        const uint8_t* cell =
+            p_view.data + p_index * element_size(p_view.type);
+        switch (p_view.type)
+        {
+            case ElementType::BYTE:
+                return PL_put_int64(p_value, *cell);
+            case ElementType::INT32:
+            {
+                int32_t value;
+                memcpy(&value, cell, sizeof(value));
+                return PL_put_int64(p_value, value);
+            }
+            case ElementType::INT64:
+            {
+                int64_t value;
+                memcpy(&value, cell, sizeof(value));
+                return PL_put_int64(p_value, value);
+            }
+            default:
+                return PL_put_float(p_value, p_view.number(p_index));
+        }
+    };
+
+    if (p_view.channels == 1)
+        return put_scalar(p_term, p_element);
+
+    term_t channel = PL_new_term_ref();
+    if (!PL_put_nil(p_term))
+        return false;
+    for (int64_t c = p_view.channels; c-- > 0;)
+    {
+        if (!put_scalar(channel, p_element * p_view.channels + c) ||
+            !PL_cons_list(p_term, channel, p_term))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Gets the view of the first argument or raises a type error. */
+bool view_arg(term_t p_term, View& r_view)
+{
+    if (!PackedArrayBlob::get(p_term, r_view))
+        return PL_type_error("packed_array", p_term);
+    return true;
+}
+
+foreign_t pl_pa_length(term_t p_blob, term_t p_length)
+{
+    View view;
+    return view_arg(p_blob, view) && PL_unify_int64(p_length, view.length);
+}
+
+foreign_t pl_pa_size(term_t p_blob, term_t p_width, term_t p_height)
+{
+    View view;
+    if (!view_arg(p_blob, view))
+        return FALSE;
+    int64_t width = (view.width > 0) ? view.width : view.length;
+    int64_t height = (view.width > 0) ? view.length / view.width : 1;
+    return PL_unify_int64(p_width, width) && PL_unify_int64(p_height, height);
+}
+
+foreign_t pl_pa_get3(term_t p_blob, term_t p_index, term_t p_value)
+{
+    View view;
+    int64_t index;
+    if (!view_arg(p_blob, view) || !PL_get_int64_ex(p_index, &index))
+        return FALSE;
+    if (index < 0 || index >= view.length)
+        return FALSE;
+
+    term_t value = PL_new_term_ref();
+    return put_element(value, view, index) && PL_unify(p_value, value);
+}
+
+foreign_t pl_pa_get4(term_t p_blob, term_t p_x, term_t p_y, term_t p_value)
+{
+    View view;
+    int64_t x, y;
+    if (!view_arg(p_blob, view) || !PL_get_int64_ex(p_x, &x) ||
+        !PL_get_int64_ex(p_y, &y))
+    {
+        return FALSE;
+    }
+    if (view.width == 0)
+        return PL_domain_error("packed_array_2d", p_blob);
+    if (x < 0 || x >= view.width || y < 0 || y >= view.length / view.width)
+        return FALSE;
+
+    term_t value = PL_new_term_ref();
+    return put_element(value, view, y * view.width + x) &&
+           PL_unify(p_value, value);
+}
+
+foreign_t pl_pa_slice(term_t p_blob,
+                      term_t p_from,
+                      term_t p_length,
+                      term_t p_slice)
+{
+    View view;
+    int64_t from, length;
+    if (!view_arg(p_blob, view) || !PL_get_int64_ex(p_from, &from) ||
+        !PL_get_int64_ex(p_length, &length))
+    {
+        return FALSE;
+    }
+    if (from < 0 || length < 0 || from > view.length ||
+        length > view.length - from)
+    {
+        return PL_domain_error("packed_array_range", p_from);
+    }
+
+    // The slice shares the buffer: copying the arrays only adds references
+    Holder* holder = new Holder(*term_holder(p_blob));
+    holder->view.data +=
+        from * view.channels * (int64_t)element_size(view.type);
+    holder->view.length = length;
+    holder->view.width = 0;
+
+    term_t slice = PL_new_term_ref();
+    return put_holder(slice, holder) && PL_unify(p_slice, slice);
+}
+
+foreign_t pl_pa_to_list(term_t p_blob, term_t p_list)
+{
+    View view;
+    if (!view_arg(p_blob, view))
+        return FALSE;
+
+    term_t list = PL_new_term_ref();
+    term_t element = PL_new_term_ref();
+    if (!PL_put_nil(list))
+        return FALSE;
+    for (int64_t i = view.length; i-- > 0;)
+    {
+        if (!put_element(element, view, i) ||
+            !PL_cons_list(list, element, list))
+        {
+            return FALSE;
+        }
+    }
+    return PL_unify(p_list, list);
+}
+
+} // namespace
+
+// =============================================================================
+// View
+// =============================================================================
+
+double PackedArrayBlob::View::number(int64_t p_index) const
+{
+    const uint8_t* cell = data + p_index * element_size(type);
+    switch (type)
+    {
+        case ElementType::BYTE:
+            return *cell;
+        case ElementType::INT32:
+        {
+            int32_t value;
+            memcpy(&value, cell, sizeof(value));
+            return value;
+        }
+        case ElementType::INT64:
+        {
+            int64_t value;
+            memcpy(&value, cell, sizeof(value));
+            return (double)value;
+        }
+        case ElementType::FLOAT32:
+        {
+            float value;
+            memcpy(&value, cell, sizeof(value));
+            return value;
+        }
+        default:
+        {
+            double value;
+            memcpy(&value, cell, sizeof(value));
+            return value;
+        }
+    }
+}
+
+// =============================================================================
+// PackedArrayBlob
+// =============================================================================
+
+bool PackedArrayBlob::put(term_t p_term, Variant const& p_array)
+{
+    Holder* holder = new Holder();
+    View& view = holder->view;
+    switch (p_array.get_type())
+    {
+        case Variant::PACKED_BYTE_ARRAY:
+            holder->bytes = p_array;
+            view.type = ElementType::BYTE;
+            view.data = holder->bytes.ptr();
+            view.length = holder->bytes.size();
+            break;
+        case Variant::PACKED_INT32_ARRAY:
+            holder->int32s = p_array;
+            view.type = ElementType::INT32;
+            view.data = (const uint8_t*)holder->int32s.ptr();
+            view.length = holder->int32s.size();
+            break;
+        case Variant::PACKED_INT64_ARRAY:
+            holder->int64s = p_array;
+            view.type = ElementType::INT64;
+            view.data = (const uint8_t*)holder->int64s.ptr();
+            view.length = holder->int64s.size();
+            break;
+        case Variant::PACKED_FLOAT32_ARRAY:
+            holder->float32s = p_array;
+            view.type = ElementType::FLOAT32;
+            view.data = (const uint8_t*)holder->float32s.ptr();
+            view.length = holder->float32s.size();
+            break;
+        case Variant::PACKED_FLOAT64_ARRAY:
+            holder->float64s = p_array;
+            view.type = ElementType::FLOAT64;
+            view.data = (const uint8_t*)holder->float64s.ptr();
+            view.length = holder->float64s.size();
+            break;
+        default:
+            delete holder;
+            return false;
+    }
+    holder->base = view.data;
+    return put_holder(p_term, holder);
+}
+
+bool PackedArrayBlob::put_image(term_t p_term, Image const* p_image)
+{
+    ElementType type;
+    int64_t channels;
+    switch (p_image->get_format())
+    {
+        case Image::FORMAT_L8:
+        case Image::FORMAT_R8:
+            type = ElementType::BYTE, channels = 1;
+            break;
+        case Image::FORMAT_LA8:
+        case Image::FORMAT_RG8:
+            type = ElementType::BYTE, channels = 2;
+            break;
+        case Image::FORMAT_RGB8:
+            type = ElementType::BYTE, channels = 3;
+            break;
+        case Image::FORMAT_RGBA8:
+            type = ElementType::BYTE, channels = 4;
+            break;
+        case Image::FORMAT_RF:
+            type = ElementType::FLOAT32, channels = 1;
+            break;
+        case Image::FORMAT_RGF:
+            type = ElementType::FLOAT32, channels = 2;
+            break;
+        case Image::FORMAT_RGBF:
+            type = ElementType::FLOAT32, channels = 3;
+            break;
+        case Image::FORMAT_RGBAF:
+            type = ElementType::FLOAT32, channels = 4;
+            break;
+        default:
+            return false; // Compressed or half-float formats
+    }
+
+    // Mipmaps follow the first level in the data: only the first level
+    // is exposed
+    Holder* holder = new Holder();
+    holder->bytes = p_image->get_data();
+    holder->image = true;
+    View& view = holder->view;
+    view.type = type;
+    view.channels = channels;
+    view.width = p_image->get_width();
+    view.length = view.width * p_image->get_height();
+    view.data = holder->bytes.ptr();
+    holder->base = view.data;
+    if (holder->bytes.size() <
+        view.length * channels * (int64_t)element_size(type))
+    {
+        delete holder;
+        return false;
+    }
+    return put_holder(p_term, holder);
+}
+
+bool PackedArrayBlob::get(term_t p_term, View& r_view)
+{
+    Holder* holder = term_holder(p_term);
+    if (holder == nullptr)
+        return false;
+    r_view = holder->view;
+    return true;
+}
+
+Variant PackedArrayBlob::to_variant(term_t p_term)
+{
+    Holder* holder = term_holder(p_term);
+    if (holder == nullptr)
+        return Variant();
+
+    View const& view = holder->view;
+    int64_t size = (int64_t)element_size(view.type);
+    int64_t begin = (view.data - holder->base) / size;
+    int64_t end = begin + view.length * view.channels;
+
+    // Images give back their raw pixel data
+    if (holder->image)
+    {
+        return holder->bytes.slice(begin * size, end * size);
+    }
+    if (begin == 0 && end == holder->bytes.size() + holder->int32s.size() +
+                                  holder->int64s.size() +
+                                  holder->float32s.size() +
+                                  holder->float64s.size())
+    {
+        // Whole array: share the buffer instead of copying it
+        switch (view.type)
+        {
+            case ElementType::BYTE:
+                return holder->bytes;
+            case ElementType::INT32:
+                return holder->int32s;
+            case ElementType::INT64:
+                return holder->int64s;
+            case ElementType::FLOAT32:
+                return holder->float32s;
+            default:
+                return holder->float64s;
+        }
+    }
+    switch (view.type)
+    {
+        case ElementType::BYTE:
+            return holder->bytes.slice(begin, end);
+        case ElementType::INT32:
+            return holder->int32s.slice(begin, end);
+        case ElementType::INT64:
+            return holder->int64s.slice(begin, end);
+        case ElementType::FLOAT32:
+            return holder->float32s.slice(begin, end);
+        default:
+            return holder->float64s.slice(begin, end);
+    }
+}
+
+void PackedArrayBlob::register_predicates()
+{
+    PL_register_foreign_in_module(
+        "user", "pa_length", 2, (pl_function_t)pl_pa_length, 0);
+    PL_register_foreign_in_module(
+        "user", "pa_size", 3, (pl_function_t)pl_pa_size, 0);
+    PL_register_foreign_in_module(
+        "user", "pa_get", 3, (pl_function_t)pl_pa_get3, 0);
+    PL_register_foreign_in_module(
+        "user", "pa_get", 4, (pl_function_t)pl_pa_get4, 0);
+    PL_register_foreign_in_module(
+        "user", "pa_slice", 4, (pl_function_t)pl_pa_slice, 0);
+    PL_register_foreign_in_module(
+        "user", "pa_to_list", 2, (pl_function_t)pl_pa_to_list, 0);
+}
@@ -0,0 +1,119 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the PackedArrayBlob class: Godot Packed arrays and
+ * Images passed to Prolog by reference.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <godot_cpp/classes/image.hpp>
+#include <godot_cpp/variant/variant.hpp>
+
+#include <cstdint>
+
+using namespace godot;
+
+/**
+ * @class PackedArrayBlob
+ * @brief Prolog blob type wrapping a numeric Packed array or an Image.
+ *
+ * Converting a 256x256 height map to a Prolog list costs 65k cons cells;
+ * a packed array blob instead holds a reference to the Godot buffer and
+ * rules read it in O(1) per access. The blob keeps its own reference to
+ * the copy-on-write buffer: if GDScript modifies its array afterwards,
+ * Godot copies the buffer on the GDScript side and the blob keeps seeing
+ * the values it was created with.
+ *
+ * Supported element types: PackedByteArray, PackedInt32Array,
+ * PackedInt64Array (integers) and PackedFloat32Array, PackedFloat64Array
+ * (floats). Images are supported for the uncompressed 8-bit (L8, R8, LA8,
+ * RG8, RGB8, RGBA8) and 32-bit float (RF, RGF, RGBF, RGBAF) formats, and
+ * are 2D: an element is a pixel, a list of channels if there are several.
+ *
+ * Foreign predicates (registered in the user module), indexes are 0-based:
+ * - pa_length(+Blob, -N): number of elements (pixels for images).
+ * - pa_get(+Blob, +I, -V): value of element I.
+ * - pa_get(+Blob, +X, +Y, -V): value of the element at column X, row Y of
+ *   an image.
+ * - pa_size(+Blob, -Width, -Height): dimensions (Height is 1 for arrays).
+ * - pa_slice(+Blob, +From, +Length, -Slice): 1D view sharing the buffer.
+ * - pa_to_list(+Blob, -List): materializes the elements (for small data).
+ */
+class PackedArrayBlob
+{
+public:
+
+    /** Type of the elements. */
+    enum class ElementType
+    {
+        BYTE,
+        INT32,
+        INT64,
+        FLOAT32,
+        FLOAT64
+    };
+
+    /** Read-only view of the data of a blob. */
+    struct View
+    {
+        ElementType type = ElementType::BYTE;
+        //! First element of the view.
+        const uint8_t* data = nullptr;
+        //! Number of elements (pixels for images).
+        int64_t length = 0;
+        //! Elements per row (0 for 1D arrays).
+        int64_t width = 0;
+        //! Scalars per element (channels of an image, 1 for arrays).
+        int64_t channels = 1;
+
+        /** Reads scalar p_index (element * channels + channel). */
+        double number(int64_t p_index) const;
+    };
+
+    /**
+     * @brief Puts a blob referencing a numeric Packed array in a term.
+     *
+     * @param p_term Term reference receiving the blob.
+     * @param p_array PackedByteArray, PackedInt32Array, PackedInt64Array,
+     * PackedFloat32Array or PackedFloat64Array.
+     * @return true on success, false if the Variant is not supported.
+     */
+    static bool put(term_t p_term, Variant const& p_array);
+
+    /**
+     * @brief Puts a blob referencing the pixels of an image in a term.
+     *
+     * @param p_term Term reference receiving the blob.
+     * @param p_image Image in a supported uncompressed format.
+     * @return true on success, false if the format is not supported.
+     */
+    static bool put_image(term_t p_term, Image const* p_image);
+
+    /**
+     * @brief Gets the view of a blob.
+     *
+     * @param p_term Term to inspect.
+     * @param r_view View of the data.
+     * @return true if the term is a packed array blob.
+     */
+    static bool get(term_t p_term, View& r_view);
+
+    /**
+     * @brief Converts a blob back to a Packed array (shared, not copied,
+     * unless the blob is a slice).
+     *
+     * @param p_term Term to inspect.
+     * @return The Packed array, or Variant() if not a blob.
+     */
+    static Variant to_variant(term_t p_term);
+
+    /**
+     * @brief Registers the pa_* foreign predicates.
+     */
+    static void register_predicates();
+};
@@ -0,0 +1,170 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the ParallelCall class.
+ */
+
+#include "ParallelCall.hpp"
+#include "Prologot.hpp"
+#include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+
+#include <algorithm>
+#include <utility>
+
+// =============================================================================
+// ParallelCall
+// =============================================================================
+
+ParallelCall::ParallelCall(String const& p_name,
+                           module_t p_module,
+                           Array const& p_rows,
+                           int64_t p_chunks,
+                           ReportFunction p_report)
+    : m_predicate(p_name),
+      m_name(PL_new_atom(p_name.utf8().get_data())),
+      m_module(p_module ? p_module : PL_new_module(PL_new_atom("user"))),
+      m_rows(p_rows),
+      m_results(size_t(p_rows.size())),
+      m_success(size_t(p_rows.size()), 0),
+      m_report(std::move(p_report))
+{
+    int64_t rows = p_rows.size();
+    int64_t chunks = std::max<int64_t>(1, std::min(p_chunks, rows));
+    m_chunk_size = (rows + chunks - 1) / chunks;
+    m_chunks = (m_chunk_size > 0) ? (rows + m_chunk_size - 1) / m_chunk_size
+                                  : 0;
+}
+
+ParallelCall::~ParallelCall()
+{
+    PL_unregister_atom(m_name);
+}
+
+int64_t ParallelCall::chunk_count() const
+{
+    return m_chunks;
+}
+
+void ParallelCall::run_chunk(int64_t p_chunk, EnginePool& p_engines)
+{
+    // The previous engine is restored: the pool may run a chunk on a thread
+    // that already has one (e.g., the main thread while it waits)
+    PL_engine_t engine = p_engines.acquire();
+    PL_engine_t previous = nullptr;
+    if (engine == nullptr ||
+        PL_set_engine(engine, &previous) != PL_ENGINE_SET)
+    {
+        report(-1, "cannot attach a Prolog engine", 0);
+        if (engine != nullptr)
+            p_engines.release(engine);
+        return;
+    }
+
+    int64_t begin = p_chunk * m_chunk_size;
+    int64_t end = std::min<int64_t>(begin + m_chunk_size, m_rows.size());
+    for (int64_t row = begin; row < end; row++)
+    {
+        Variant result;
+        if (call_row(row, result))
+        {
+            m_results[size_t(row)] = result;
+            m_success[size_t(row)] = 1;
+        }
+    }
+
+    PL_set_engine(previous, nullptr);
+    p_engines.release(engine);
+}
+
+Dictionary ParallelCall::take_results(int64_t& r_errors)
+{
+    PackedByteArray success;
+    Array results;
+    success.resize(int64_t(m_success.size()));
+    results.resize(int64_t(m_results.size()));
+    for (size_t i = 0; i < m_success.size(); i++)
+    {
+        success[int64_t(i)] = m_success[i];
+        results[int64_t(i)] = m_results[i];
+    }
+    r_errors = m_errors.load();
+
+    Dictionary outcome;
+    outcome["success"] = success;
+    outcome["results"] = results;
+    return outcome;
+}
+
+bool ParallelCall::call_row(int64_t p_row, Variant& r_result)
+{
+    Variant row_variant = m_rows[p_row];
+    if (row_variant.get_type() != Variant::ARRAY)
+    {
+        report(p_row, "row is not an Array", 0);
+        return false;
+    }
+
+    Array row = row_variant;
+    int64_t arity = row.size() + 1;
+    fid_t fid = PL_open_foreign_frame();
+    term_t args = PL_new_term_refs(int(arity));
+    bool ok = true;
+    for (int64_t i = 0; i < row.size() && ok; i++)
+    {
+        term_t arg = Prologot::variant_to_term(row[i]);
+        ok = (arg != 0) && PL_put_term(args + int(i), arg);
+    }
+    if (!ok)
+    {
+        report(p_row, "cannot convert the arguments", 0);
+        PL_discard_foreign_frame(fid);
+        return false;
+    }
+
+    predicate_t predicate =
+        PL_pred(PL_new_functor(m_name, size_t(arity)), m_module);
+    qid_t qid = PL_open_query(m_module, PL_Q_CATCH_EXCEPTION, predicate, args);
+    ok = PL_next_solution(qid);
+    if (ok)
+    {
+        r_result = Prologot::term_to_variant(args + int(arity - 1));
+    }
+    else if (term_t exception = PL_exception(qid))
+    {
+        report(p_row, String(), exception);
+    }
+    PL_cut_query(qid);
+    PL_discard_foreign_frame(fid);
+    return ok;
+}
+
+void ParallelCall::report(int64_t p_row,
+                          String const& p_message,
+                          term_t p_exception)
+{
+    // The exception term is recorded: it is only written if the record is
+    // read, by whichever thread reads it
+    ErrorRecord record;
+    record.type = "error";
+    record.context = "parallel_call";
+    record.goal = m_predicate;
+    if (p_row >= 0)
+    {
+        record.goal += " (row " + String::num_int64(p_row) + ")";
+    }
+    record.thread = OS::get_singleton()->get_thread_caller_id();
+    if (p_exception)
+    {
+        record.set_exception(p_exception);
+    }
+    else
+    {
+        record.message = "parallel_call: " + p_message;
+    }
+    m_errors++;
+    m_report(record);
+}
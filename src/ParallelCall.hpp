@@ -0,0 +1,114 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the ParallelCall class: a predicate called on rows of
+ * arguments by Godot's worker threads.
+ */
+
+#pragma once
+
+#include "EnginePool.hpp"
+#include "ErrorLog.hpp"
+#include <SWI-Prolog.h>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/string.hpp>
+#include <godot_cpp/variant/variant.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+using namespace godot;
+
+/**
+ * @class ParallelCall
+ * @brief Calls Name(Args..., Result) for each row of arguments, by chunks.
+ *
+ * The rows are split into contiguous chunks run by WorkerThreadPool tasks
+ * (see run_chunk()). Each chunk attaches an engine of an EnginePool to its
+ * thread, so the calls run concurrently instead of on the main thread. The
+ * results are written at the index of their row, so they come back in
+ * input order whatever the scheduling.
+ *
+ * Each row that cannot be called or raises an exception is reported by the
+ * worker thread running it, so the error is tagged with that thread.
+ */
+class ParallelCall
+{
+public:
+
+    /**
+     * @brief Receives an error raised by a row, on the worker thread that
+     * ran it; must be thread-safe.
+     */
+    using ReportFunction = std::function<void(ErrorRecord const&)>;
+
+    /**
+     * @param p_name Predicate name, called with one more argument than the
+     * row length (the result).
+     * @param p_module Module of the calls (NULL for user).
+     * @param p_rows Arrays of arguments; must outlive the call.
+     * @param p_chunks Number of chunks to split the rows into.
+     * @param p_report Receives the error of each failing row.
+     */
+    ParallelCall(String const& p_name,
+                 module_t p_module,
+                 Array const& p_rows,
+                 int64_t p_chunks,
+                 ReportFunction p_report);
+
+    ~ParallelCall();
+
+    /**
+     * @brief Number of chunks, i.e. of group task elements.
+     */
+    int64_t chunk_count() const;
+
+    /**
+     * @brief Runs the rows of a chunk. Called concurrently by the worker
+     * threads, one engine of p_engines per chunk.
+     */
+    void run_chunk(int64_t p_chunk, EnginePool& p_engines);
+
+    /**
+     * @brief Gets the results once all the chunks ran.
+     *
+     * @param r_errors Number of rows that reported an error.
+     * @return {"success": PackedByteArray, "results": Array}: per row, 1 and
+     * the value of the result argument if the call succeeded, 0 and null
+     * otherwise.
+     */
+    Dictionary take_results(int64_t& r_errors);
+
+private:
+
+    /** Calls the predicate on a row; false if it failed or raised. */
+    bool call_row(int64_t p_row, Variant& r_result);
+
+    /**
+     * @brief Reports the error of a row, tagged with the calling thread.
+     *
+     * @param p_row Row index (-1 for a whole chunk).
+     * @param p_message Error message; ignored if p_exception is set.
+     * @param p_exception Exception term raised by the call, or 0.
+     */
+    void report(int64_t p_row, String const& p_message, term_t p_exception);
+
+private:
+
+    String m_predicate;
+    atom_t m_name;
+    module_t m_module;
+    Array const& m_rows;
+    int64_t m_chunk_size;
+    int64_t m_chunks;
+    std::vector<Variant> m_results;
+    std::vector<uint8_t> m_success;
+    ReportFunction m_report;
+    std::atomic<int64_t> m_errors{0};
+};
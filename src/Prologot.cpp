@@ -8,6 +8,21 @@
  */
 
 #include "Prologot.hpp"
+#include "BitsetBlob.hpp"
+#include "Blackboard.hpp"
+#include "ClpfdSolver.hpp"
+#include "FactLoader.hpp"
+#include "FactTable.hpp"
+#include "JsonTerm.hpp"
+#include "ObjectBlob.hpp"
+#include "OutputCapture.hpp"
+#include "PackedArrayBlob.hpp"
+#include "ParallelCall.hpp"
+#include "QueryCursor.hpp"
+#include "SimdKernels.hpp"
+#include "TileMapFacts.hpp"
+#include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <string>
 #include <vector>
@@ -18,12 +33,18 @@
 #    include <dlfcn.h>  // For dladdr to find library path
 #    include <unistd.h> // For setenv on Unix
 #endif
+#include <godot_cpp/classes/bit_map.hpp>
 #include <godot_cpp/classes/dir_access.hpp>
 #include <godot_cpp/classes/engine.hpp>
 #include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/image.hpp>
+#include <godot_cpp/classes/os.hpp>
 #include <godot_cpp/classes/project_settings.hpp>
 #include <godot_cpp/classes/scene_tree.hpp>
+#include <godot_cpp/classes/time.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
 #include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/variant/callable_method_pointer.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
 
 // =============================================================================
@@ -31,6 +52,8 @@
 // =============================================================================
 
 Prologot* Prologot::m_singleton = nullptr;
+int Prologot::m_engine_users = 0;
+int64_t Prologot::m_overlay_count = 0;
 
 // =============================================================================
 // Godot Method Binding
@@ -44,6 +67,8 @@ void Prologot::_bind_methods()
                          DEFVAL(Dictionary()));
     ClassDB::bind_method(D_METHOD("cleanup"), &Prologot::cleanup);
     ClassDB::bind_method(D_METHOD("is_initialized"), &Prologot::is_initialized);
+    ClassDB::bind_method(D_METHOD("get_startup_profile"),
+                         &Prologot::get_startup_profile);
 
     // File/code loading methods
     ClassDB::bind_method(D_METHOD("consult_file", "filename"),
@@ -64,16 +89,168 @@ void Prologot::_bind_methods()
 
     // Dynamic assertion methods
     ClassDB::bind_method(D_METHOD("add_fact", "fact"), &Prologot::add_fact);
+    ClassDB::bind_method(D_METHOD("add_fact_ttl", "fact", "seconds"),
+                         &Prologot::add_fact_ttl);
+    ClassDB::bind_method(D_METHOD("tick", "delta"), &Prologot::tick);
     ClassDB::bind_method(D_METHOD("retract_fact", "fact"),
                          &Prologot::retract_fact);
     ClassDB::bind_method(D_METHOD("retract_all", "functor"),
                          &Prologot::retract_all);
 
+    // Fact table methods
+    ClassDB::bind_method(D_METHOD("create_fact_table",
+                                  "functor",
+                                  "column_types",
+                                  "columns",
+                                  "indexes"),
+                         &Prologot::create_fact_table,
+                         DEFVAL(Array()),
+                         DEFVAL(PackedInt32Array()));
+    ClassDB::bind_method(D_METHOD("append_fact_table", "functor", "columns"),
+                         &Prologot::append_fact_table);
+    ClassDB::bind_method(D_METHOD("remove_fact_table_rows", "functor", "key"),
+                         &Prologot::remove_fact_table_rows);
+    ClassDB::bind_method(D_METHOD("drop_fact_table", "functor"),
+                         &Prologot::drop_fact_table);
+    ClassDB::bind_method(D_METHOD("get_fact_table_size", "functor", "stored"),
+                         &Prologot::get_fact_table_size,
+                         DEFVAL(false));
+    ClassDB::bind_method(D_METHOD("save_fact_table", "functor", "path"),
+                         &Prologot::save_fact_table);
+    ClassDB::bind_method(D_METHOD("map_fact_file", "path", "indexes"),
+                         &Prologot::map_fact_file,
+                         DEFVAL(PackedInt32Array()));
+
+    // Bulk loading methods
+    ClassDB::bind_method(D_METHOD("load_csv_facts",
+                                  "path",
+                                  "functor",
+                                  "column_types",
+                                  "options"),
+                         &Prologot::load_csv_facts,
+                         DEFVAL(PackedStringArray()),
+                         DEFVAL(Dictionary()));
+    ClassDB::bind_method(D_METHOD("load_json_facts", "path", "mapping"),
+                         &Prologot::load_json_facts);
+    ClassDB::bind_method(D_METHOD("import_tilemap",
+                                  "map",
+                                  "functor",
+                                  "options"),
+                         &Prologot::import_tilemap,
+                         DEFVAL(Dictionary()));
+    ClassDB::bind_method(D_METHOD("sync_tilemap_cells",
+                                  "map",
+                                  "functor",
+                                  "cells"),
+                         &Prologot::sync_tilemap_cells);
+
+    // Scene tree mirroring
+    ClassDB::bind_method(D_METHOD("mirror_scene_tree", "root"),
+                         &Prologot::mirror_scene_tree);
+    ClassDB::bind_method(D_METHOD("mirror_update_groups", "node"),
+                         &Prologot::mirror_update_groups);
+    ClassDB::bind_method(D_METHOD("unmirror_scene_tree"),
+                         &Prologot::unmirror_scene_tree);
+
+    // Planning
+    ClassDB::bind_method(D_METHOD("plan", "state", "goal", "options"),
+                         &Prologot::plan,
+                         DEFVAL(Dictionary()));
+    ClassDB::bind_method(D_METHOD("plan_start", "state", "goal", "options"),
+                         &Prologot::plan_start,
+                         DEFVAL(Dictionary()));
+    ClassDB::bind_method(D_METHOD("plan_step", "id", "budget_usec"),
+                         &Prologot::plan_step);
+    ClassDB::bind_method(D_METHOD("plan_result", "id"),
+                         &Prologot::plan_result);
+    ClassDB::bind_method(D_METHOD("clear_plan_cache"),
+                         &Prologot::clear_plan_cache);
+
+    // Constraint solving
+    ClassDB::bind_method(D_METHOD("clpfd_solve",
+                                  "domains",
+                                  "constraints",
+                                  "options"),
+                         &Prologot::clpfd_solve,
+                         DEFVAL(Dictionary()));
+
+    // Forward rules
+    ClassDB::bind_method(D_METHOD("add_forward_rule",
+                                  "name",
+                                  "conditions",
+                                  "options"),
+                         &Prologot::add_forward_rule,
+                         DEFVAL(Dictionary()));
+    ClassDB::bind_method(D_METHOD("remove_forward_rule", "name"),
+                         &Prologot::remove_forward_rule);
+    ClassDB::bind_method(D_METHOD("flush_forward_rules"),
+                         &Prologot::flush_forward_rules);
+    ADD_SIGNAL(MethodInfo("forward_rules_fired",
+                          PropertyInfo(Variant::ARRAY, "firings")));
+
+    // Constraint Handling Rules
+    ClassDB::bind_method(D_METHOD("chr_consult", "code"),
+                         &Prologot::chr_consult);
+    ClassDB::bind_method(D_METHOD("chr_add", "constraints"),
+                         &Prologot::chr_add);
+    ClassDB::bind_method(D_METHOD("chr_get_store", "name"),
+                         &Prologot::chr_get_store,
+                         DEFVAL(""));
+    ClassDB::bind_method(D_METHOD("chr_snapshot"), &Prologot::chr_snapshot);
+    ClassDB::bind_method(D_METHOD("chr_restore", "snapshot"),
+                         &Prologot::chr_restore);
+    ClassDB::bind_method(D_METHOD("chr_reset"), &Prologot::chr_reset);
+
+    // Blackboard
+    ClassDB::bind_method(D_METHOD("bb_set", "key", "value"),
+                         &Prologot::bb_set);
+    ClassDB::bind_method(D_METHOD("bb_get", "key", "default"),
+                         &Prologot::bb_get,
+                         DEFVAL(Variant()));
+    ClassDB::bind_method(D_METHOD("bb_get_many", "keys"),
+                         &Prologot::bb_get_many);
+    ClassDB::bind_method(D_METHOD("bb_erase", "key"), &Prologot::bb_erase);
+
+    // Thread-Local Scratch
+    ClassDB::bind_method(D_METHOD("declare_thread_local", "indicator"),
+                         &Prologot::declare_thread_local);
+    ClassDB::bind_method(D_METHOD("query_scratch", "goal", "facts"),
+                         &Prologot::query_scratch,
+                         DEFVAL(PackedStringArray()));
+
+    // Parallel Calls
+    ClassDB::bind_method(
+        D_METHOD("parallel_call", "predicate", "arg_rows", "max_threads"),
+        &Prologot::parallel_call,
+        DEFVAL(0));
+
+    // Query cursors
+    ClassDB::bind_method(D_METHOD("query_open", "goal"),
+                         &Prologot::query_open);
+    ClassDB::bind_method(D_METHOD("query_next", "cursor", "count"),
+                         &Prologot::query_next,
+                         DEFVAL(1));
+    ClassDB::bind_method(D_METHOD("query_stats", "cursor"),
+                         &Prologot::query_stats);
+    ClassDB::bind_method(D_METHOD("query_close", "cursor"),
+                         &Prologot::query_close);
+
+    // Benchmarking
+    ClassDB::bind_method(
+        D_METHOD("benchmark", "goal", "iterations", "warmup"),
+        &Prologot::benchmark,
+        DEFVAL(1000),
+        DEFVAL(100));
+
     // Predicate methods
     ClassDB::bind_method(D_METHOD("call_predicate", "predicate", "args"),
                          &Prologot::call_predicate);
     ClassDB::bind_method(D_METHOD("call_function", "predicate", "args"),
                          &Prologot::call_function);
+    ClassDB::bind_method(D_METHOD("call_predicate_json", "predicate", "json"),
+                         &Prologot::call_predicate_json);
+    ClassDB::bind_method(D_METHOD("call_function_json", "predicate", "args"),
+                         &Prologot::call_function_json);
 
     // Introspection methods
     ClassDB::bind_method(D_METHOD("predicate_exists", "predicate", "arity"),
@@ -83,6 +260,12 @@ void Prologot::_bind_methods()
 
     // Error handling
     ClassDB::bind_method(D_METHOD("get_last_error"), &Prologot::get_last_error);
+    ClassDB::bind_method(D_METHOD("get_last_error_info"),
+                         &Prologot::get_last_error_info);
+    ClassDB::bind_method(D_METHOD("get_last_exception"),
+                         &Prologot::get_last_exception);
+    ClassDB::bind_method(D_METHOD("take_errors"), &Prologot::take_errors);
+    ClassDB::bind_method(D_METHOD("take_output"), &Prologot::take_output);
 }
 
 // =============================================================================
@@ -139,7 +322,100 @@ bool Prologot::initialize(Dictionary const& p_options)
     if (m_initialized)
         return true;
 
+    // Monotonic timing of each startup phase (in microseconds). Each call to
+    // end_phase() records the time elapsed since the previous one.
+    Time* time = Time::get_singleton();
+    uint64_t startup_begin = time->get_ticks_usec();
+    uint64_t phase_begin = startup_begin;
+    m_startup_profile.clear();
+    auto end_phase = [&](const char* p_phase)
+    {
+        uint64_t now = time->get_ticks_usec();
+        m_startup_profile[p_phase] = (int64_t)(now - phase_begin);
+        phase_begin = now;
+    };
+
     // Extract other options
+    bool profile_startup = p_options.get("profile startup", false);
+    String script_file = p_options.get("script file", "");
+    Variant goal_var = p_options.get("goal", Variant());
+    m_on_error = p_options.get("on error", "print");
+    m_on_warning = p_options.get("on warning", "print");
+
+    // Prolog runs once per process: only the first instance starts it, the
+    // next ones share it (see m_engine_users)
+    if (m_engine_users == 0 && !start_engine(p_options, end_phase))
+        return false;
+    m_engine_users++;
+    m_initialized = true;
+    setup_output(p_options);
+
+    if (!setup_module(p_options))
+    {
+        cleanup();
+        return false;
+    }
+    end_phase("module");
+
+    // The script file and the startup goals are run here rather than passed
+    // as -l and -g to PL_initialise(), so that they are timed separately and
+    // so that a failing goal is reported instead of halting the process.
+    if (!script_file.is_empty() && !consult_file(script_file))
+    {
+        push_error("Failed to load script file: " + script_file);
+        cleanup();
+        return false;
+    }
+    end_phase("script file");
+
+    Array goals;
+    if (goal_var.get_type() == Variant::STRING)
+    {
+        if (!String(goal_var).is_empty())
+            goals.push_back(goal_var);
+    }
+    else if (goal_var.get_type() == Variant::ARRAY)
+    {
+        goals = goal_var;
+    }
+    for (int i = 0; i < goals.size(); i++)
+    {
+        String goal = goals[i];
+        if (!query(goal))
+        {
+            push_error("Startup goal failed: " + goal);
+            cleanup();
+            return false;
+        }
+    }
+    end_phase("goals");
+
+    m_startup_profile["total"] =
+        (int64_t)(time->get_ticks_usec() - startup_begin);
+
+    // Log the breakdown when requested
+    if (profile_startup)
+    {
+        UtilityFunctions::print("[Prologot] Startup profile:");
+        Array phases = m_startup_profile.keys();
+        for (int i = 0; i < phases.size(); i++)
+        {
+            int64_t usec = m_startup_profile[phases[i]];
+            UtilityFunctions::print("[Prologot]   ",
+                                    String(phases[i]),
+                                    ": ",
+                                    String::num(usec / 1000.0, 3),
+                                    " ms");
+        }
+    }
+
+    return true;
+}
+
+bool Prologot::start_engine(Dictionary const& p_options,
+                            std::function<void(const char*)> const& p_end_phase)
+{
+    // Extract the options of the Prolog engine
     bool quiet = p_options.get("quiet", true);
     bool optimized = p_options.get("optimized", false);
     bool traditional = p_options.get("traditional", false);
@@ -149,20 +425,17 @@ bool Prologot::initialize(Dictionary const& p_options)
     String table_space = p_options.get("table space", "");
     String shared_table_space = p_options.get("shared table space", "");
     String init_file = p_options.get("init file", "");
-    String script_file = p_options.get("script file", "");
     String toplevel = p_options.get("toplevel", "");
-    Variant goal_var = p_options.get("goal", Variant());
-    m_on_error = p_options.get("on error", "print");
-    m_on_warning = p_options.get("on warning", "print");
 
     // Extract and resolve home directory
     auto [home, error] = set_swi_home_dir(p_options.get("home", ""));
     if (!error.is_empty())
     {
-        m_last_error = error;
+        set_last_error(error);
         push_error("Invalid SWI-Prolog home directory: " + error +
                    ". I will try to use the default one.");
     }
+    p_end_phase("home dir");
 
     // Build argv for PL_initialise
     // Note: Use std::string storage to keep char* pointers valid
@@ -185,7 +458,11 @@ bool Prologot::initialize(Dictionary const& p_options)
         argv_list.push_back("--traditional");
     if (!threads)
         argv_list.push_back("--no-threads");
-    if (!packs)
+    // Packs are attached afterwards by attach_packs/0 so that their cost is
+    // measured apart, unless the init file or the toplevel, both run by
+    // PL_initialise(), may use them: PL_initialise() then attaches them
+    bool deferred_packs = packs && init_file.is_empty() && toplevel.is_empty();
+    if (!packs || deferred_packs)
         argv_list.push_back("--no-packs");
 
     // Options with values (format --option=value)
@@ -227,12 +504,6 @@ bool Prologot::initialize(Dictionary const& p_options)
         string_storage.push_back(init_file.utf8().get_data());
         argv_list.push_back(string_storage.back().c_str());
     }
-    if (!script_file.is_empty())
-    {
-        argv_list.push_back("-l");
-        string_storage.push_back(script_file.utf8().get_data());
-        argv_list.push_back(string_storage.back().c_str());
-    }
     if (!toplevel.is_empty())
     {
         argv_list.push_back("-t");
@@ -240,29 +511,6 @@ bool Prologot::initialize(Dictionary const& p_options)
         argv_list.push_back(string_storage.back().c_str());
     }
 
-    // Goals (-g can be repeated)
-    if (goal_var.get_type() == Variant::STRING)
-    {
-        String goal = goal_var;
-        if (!goal.is_empty())
-        {
-            argv_list.push_back("-g");
-            string_storage.push_back(goal.utf8().get_data());
-            argv_list.push_back(string_storage.back().c_str());
-        }
-    }
-    else if (goal_var.get_type() == Variant::ARRAY)
-    {
-        Array goals = goal_var;
-        for (int i = 0; i < goals.size(); i++)
-        {
-            String goal = goals[i];
-            argv_list.push_back("-g");
-            string_storage.push_back(goal.utf8().get_data());
-            argv_list.push_back(string_storage.back().c_str());
-        }
-    }
-
     // Prolog flags (-D name=value)
     if (p_options.has("prolog flags"))
     {
@@ -305,17 +553,40 @@ bool Prologot::initialize(Dictionary const& p_options)
     }
 
     argv_list.push_back(nullptr);
+    p_end_phase("arguments");
 
     // Initialize Prolog engine
     if (!PL_initialise(argv_list.size() - 1, (char**)argv_list.data()))
     {
         if (!handle_prolog_exception(0, "PL_initialise"))
         {
-            m_last_error = "PL_initialise() failed (no details available)";
+            set_last_error("PL_initialise() failed (no details available)");
         }
 
         return false;
     }
+    if (packs && !deferred_packs)
+    {
+        p_end_phase("PL_initialise + packs");
+    }
+    else
+    {
+        p_end_phase("PL_initialise");
+
+        // Attach add-ons/packages (see the --no-packs note above). The packs
+        // flag, cleared by --no-packs, tells they are enabled.
+        term_t attach = PL_new_term_ref();
+        if (deferred_packs &&
+            (!PL_chars_to_term("attach_packs, "
+                               "catch(set_prolog_flag(packs, true), _, true)",
+                               attach) ||
+             !PL_call(attach, NULL)))
+        {
+            PL_clear_exception();
+            push_error("Failed to attach packs", "warning");
+        }
+        p_end_phase("packs");
+    }
 
     // Log which SWI_HOME_DIR is being used by Prolog
     term_t home_term = PL_new_term_ref();
@@ -330,6 +601,7 @@ bool Prologot::initialize(Dictionary const& p_options)
             UtilityFunctions::print("[Prologot] SWI-Prolog HOME: ", home_path);
         }
     }
+    p_end_phase("home flag");
 
     // Bootstrap helper predicates for consult_string()
     // These predicates allow loading Prolog code from strings by:
@@ -357,8 +629,72 @@ bool Prologot::initialize(Dictionary const& p_options)
         // Process query clauses (?- Goal) - execute immediately
         "prologot_process_clause((?- Goal)) :- !, call(Goal)",
 
-        // Process regular clauses - assert into knowledge base
-        "prologot_process_clause(Clause) :- assertz(Clause)",
+        // Process regular clauses - assert into knowledge base. Facts are
+        // given to the forward rules (see FactLoader::Listener)
+        "prologot_process_clause(Clause) :- assertz(Clause), "
+        "(Clause = (_ :- _) -> true ; '$prologot_asserted'(Clause))",
+
+        // Removes the predicates of an overlay module (see setup_module())
+        "prologot_clear_module(M) :- "
+        "forall(( current_predicate(_, M:H), "
+        "\\+ predicate_property(M:H, imported_from(_)) ), "
+        "( functor(H, N, A), catch(abolish(M:N/A), _, true) ))",
+
+        // Overlay predicates of a base (see setup_module()): only these base
+        // predicates get a dispatcher clause, placed before their base
+        // clauses, and each overlay gets its own dynamic definition. The
+        // other base predicates are left untouched.
+        "prologot_setup_overlay(Base, Overlay, PIs) :- "
+        "( prologot_overlay_base(Base) -> true "
+        "; assertz(prologot_overlay_base(Base)) ), "
+        "forall(member(PI, PIs), prologot_overlay_dispatcher(Base, PI)), "
+        "forall(prologot_overlay_predicate(Base, N/A), "
+        "dynamic(Overlay:N/A))",
+
+        "prologot_overlay_dispatcher(Base, N/A) :- "
+        "prologot_overlay_predicate(Base, N/A), !",
+        "prologot_overlay_dispatcher(Base, N/A) :- "
+        "dynamic(Base:N/A), functor(H, N, A), "
+        "asserta(Base:(H :- prologot_overlay_dispatch(Base, H))), "
+        "assertz(prologot_overlay_predicate(Base, N/A))",
+
+        // Looks up the overlay running the query among the context modules
+        // of the calling frames: base rules keep their own context module.
+        // Outside an overlay, the base clauses following the dispatcher are
+        // used.
+        "prologot_overlay_dispatch(Base, H) :- "
+        "prolog_current_frame(F), prologot_calling_overlay(F, Base, M), !, "
+        "M:H",
+        "prologot_calling_overlay(F, Base, M) :- "
+        "prolog_frame_attribute(F, context_module, M), M \\== Base, "
+        "import_module(M, Base), !",
+        "prologot_calling_overlay(F, Base, M) :- "
+        "prolog_frame_attribute(F, parent, P), "
+        "prologot_calling_overlay(P, Base, M)",
+
+        // Blackboard of the calling module (see Blackboard). Base rules run
+        // by an overlay use the blackboard of the overlay, like the overlay
+        // predicates; the frames are only walked for bases having overlays.
+        "bb_get(Key, Value) :- "
+        "context_module(C), prologot_bb_module(C, M), "
+        "'$prologot_bb_get'(M, Key, Value)",
+        "bb_set(Key, Value) :- "
+        "context_module(C), prologot_bb_module(C, M), "
+        "'$prologot_bb_set'(M, Key, Value)",
+        "prologot_bb_module(C, M) :- "
+        "prologot_overlay_base(C), prolog_current_frame(F), "
+        "prologot_calling_overlay(F, C, M), !",
+        "prologot_bb_module(C, C)",
+
+        // Predicates visible from a module: its own, then those of the
+        // modules it inherits from, up to user (see list_predicates())
+        "prologot_list_predicates(M, Goals) :- "
+        "findall(current_predicate(PI), "
+        "distinct(PI, ( prologot_visible_module(M, V), "
+        "current_predicate(V:PI) )), Goals)",
+        "prologot_visible_module(M, M)",
+        "prologot_visible_module(M, V) :- "
+        "import_module(M, I), I \\== system, prologot_visible_module(I, V)",
 
         nullptr // Sentinel to mark end of array
     };
@@ -375,8 +711,8 @@ bool Prologot::initialize(Dictionary const& p_options)
         // Parse the Prolog code string into a term
         if (!PL_chars_to_term(predicates[i], clause))
         {
-            m_last_error = String("Failed to parse bootstrap predicate: ") +
-                           String(predicates[i]);
+            set_last_error(String("Failed to parse bootstrap predicate: ") +
+                           String(predicates[i]));
             PL_cleanup(0); // Clean up on failure
             return false;
         }
@@ -398,22 +734,22 @@ bool Prologot::initialize(Dictionary const& p_options)
                 if (PL_get_chars(
                         ex, &msg, CVT_WRITE | BUF_DISCARDABLE | REP_UTF8))
                 {
-                    m_last_error =
+                    set_last_error(
                         String("Failed to assert bootstrap predicate: ") +
-                        String(msg);
+                        String(msg));
                 }
                 else
                 {
-                    m_last_error =
+                    set_last_error(
                         String("Failed to assert bootstrap predicate: ") +
-                        String(predicates[i]);
+                        String(predicates[i]));
                 }
             }
             else
             {
-                m_last_error =
+                set_last_error(
                     String("Failed to assert bootstrap predicate: ") +
-                    String(predicates[i]);
+                    String(predicates[i]));
             }
             PL_close_query(qid);
             PL_cleanup(0); // Clean up on failure
@@ -423,19 +759,185 @@ bool Prologot::initialize(Dictionary const& p_options)
         PL_close_query(qid);
     }
 
-    // Mark as initialized only after all steps succeed
-    m_initialized = true;
+    // Transparent helpers: consult_string() loads the clauses into the
+    // module of the instance, given as the context module of the query, and
+    // bb_get/2 and bb_set/2 use the blackboard of their caller
+    term_t transparent = PL_new_term_ref();
+    if (!PL_chars_to_term("module_transparent((load_program_from_string/1, "
+                          "prologot_load_clauses/1, "
+                          "prologot_process_clause/1, "
+                          "bb_get/2, bb_set/2)), "
+                          "dynamic((prologot_overlay_predicate/2, "
+                          "prologot_overlay_base/1))",
+                          transparent) ||
+        !PL_call(transparent, NULL))
+    {
+        set_last_error("Failed to declare the bootstrap predicates "
+                       "transparent");
+        PL_cleanup(0);
+        return false;
+    }
+    register_foreign_predicates();
+    p_end_phase("bootstrap");
+    return true;
+}
+
+bool Prologot::setup_module(Dictionary const& p_options)
+{
+    String name = p_options.get("module", "");
+    String base = p_options.get("base module", "");
+    if (base.is_empty() && (name.is_empty() || name == "user"))
+        return true; // Default: the user module, shared by the instances
+    if (name == "user")
+    {
+        push_error("The user module cannot be an overlay of " + base);
+        return false;
+    }
+
+    if (name.is_empty())
+    {
+        name = "prologot_overlay_" + String::num_int64(++m_overlay_count);
+    }
+    atom_t name_atom = PL_new_atom(name.utf8().get_data());
+    m_module = PL_new_module(name_atom);
+    PL_unregister_atom(name_atom);
+    m_owns_module = true;
+    if (base.is_empty())
+        return true;
+
+    // Overlay -> base -> user: the base predicates are found by module
+    // inheritance, the facts asserted by this instance stay in the overlay
+    term_t args = PL_new_term_refs(3);
+    predicate_t current = PL_predicate("current_module", 1, "system");
+    predicate_t add_import = PL_predicate("add_import_module", 3, "system");
+    if (!PL_put_atom_chars(args, base.utf8().get_data()) ||
+        !PL_call_predicate(NULL, PL_Q_CATCH_EXCEPTION, current, args))
+    {
+        push_error("Unknown base module: " + base);
+        return false;
+    }
+    if (!PL_put_atom_chars(args, name.utf8().get_data()) ||
+        !PL_put_atom_chars(args + 1, base.utf8().get_data()) ||
+        !PL_put_atom_chars(args + 2, "start") ||
+        !PL_call_predicate(NULL, PL_Q_CATCH_EXCEPTION, add_import, args))
+    {
+        push_error("Cannot import base module " + base + " into " + name);
+        return false;
+    }
+
+    // Dynamic predicates of the base whose clauses belong to each overlay,
+    // also declared in the overlays created before
+    PackedStringArray overlay =
+        p_options.get("overlay predicates", PackedStringArray());
+    String indicators = "[" + String(", ").join(overlay) + "]";
+    predicate_t setup = PL_predicate("prologot_setup_overlay", 3, "user");
+    if (!PL_put_atom_chars(args, base.utf8().get_data()) ||
+        !PL_put_atom_chars(args + 1, name.utf8().get_data()) ||
+        !PL_chars_to_term(indicators.utf8().get_data(), args + 2) ||
+        !PL_call_predicate(NULL, PL_Q_CATCH_EXCEPTION, setup, args))
+    {
+        push_error("Invalid overlay predicates of " + base + ": " +
+                   indicators);
+        PL_clear_exception();
+        return false;
+    }
     return true;
 }
 
+void Prologot::release_module()
+{
+    if (m_owns_module)
+    {
+        // Modules cannot be deleted: empty the overlay instead
+        Blackboard::clear(m_module);
+        term_t module = PL_new_term_ref();
+        predicate_t clear = PL_predicate("prologot_clear_module", 1, "user");
+        if (PL_put_atom(module, PL_module_name(m_module)))
+        {
+            PL_call_predicate(NULL, PL_Q_CATCH_EXCEPTION, clear, module);
+        }
+        PL_clear_exception();
+    }
+    m_module = NULL;
+    m_owns_module = false;
+}
+
+void Prologot::setup_output(Dictionary const& p_options)
+{
+    int64_t output_buffer = p_options.get("output buffer", 0);
+    if (output_buffer <= 0)
+        return;
+
+    // Output of the engine of the main thread, unless another instance
+    // captures it, then of the engines of the worker threads
+    m_output = std::make_unique<OutputCapture>(
+        size_t(output_buffer), p_options.get("output flush", true));
+    m_engines.set_output(m_output.get());
+    String error;
+    if (!m_output->capture_main_engine(error))
+    {
+        push_error(error, "warning");
+    }
+}
+
+void Prologot::register_foreign_predicates()
+{
+    BitsetBlob::register_predicates();
+    Blackboard::register_predicates();
+    ClpfdSolver::register_predicates();
+    FactLoader::Listener::register_predicates();
+    JsonTerm::register_predicates();
+    ObjectBlob::register_predicates();
+    PackedArrayBlob::register_predicates();
+    SimdKernels::register_predicates();
+}
+
 void Prologot::cleanup()
 {
     if (m_initialized)
     {
+        // State of this instance
+        unmirror_scene_tree();
+        m_planner.clear_all();
+        m_forward_rules.clear();
+        m_expiring_facts.clear();
+        {
+            std::lock_guard<std::mutex> lock(m_thread_locals_mutex);
+            for (functor_t functor : m_thread_locals)
+                PL_unregister_atom(PL_functor_name(functor));
+            m_thread_locals.clear();
+        }
+        {
+            // Closing waits for the fetches running on other threads
+            std::lock_guard<std::mutex> lock(m_cursors_mutex);
+            for (auto const& cursor : m_cursors)
+                cursor.second->close();
+            m_cursors.clear();
+        }
+        m_engines.clear();
+        m_engines.set_output(nullptr);
+        release_module();
+        m_errors.resolve_all();
+        m_initialized = false;
+
+        // Process-wide state, released with the last instance
+        if (--m_engine_users > 0)
+        {
+            m_output.reset();
+            return;
+        }
+
+        // Fact tables hold Prolog atoms: release them while Prolog runs
+        FactTable::drop_all();
+        TileMapFacts::forget_all();
+        m_chr.clear();
+        Blackboard::clear_all();
+
         // PL_cleanup(0) shuts down the Prolog engine
         // The argument (0) means normal cleanup
         PL_cleanup(0);
-        m_initialized = false;
+        m_output.reset();
+        OutputCapture::clear();
     }
 }
 
@@ -444,6 +946,11 @@ bool Prologot::is_initialized() const
     return m_initialized;
 }
 
+Dictionary Prologot::get_startup_profile() const
+{
+    return m_startup_profile;
+}
+
 // =============================================================================
 // File and Code Consultation
 // =============================================================================
@@ -456,7 +963,7 @@ bool Prologot::consult_file(String const& p_filename)
     // Validate input
     if (p_filename.is_empty())
     {
-        m_last_error = "Empty filename";
+        set_last_error("Empty filename");
         return false;
     }
 
@@ -475,18 +982,18 @@ bool Prologot::consult_file(String const& p_filename)
     // Set the filename argument as a Prolog atom
     if (!PL_put_atom_chars(args, filename.utf8().get_data()))
     {
-        m_last_error = "Failed to convert filename to Prolog atom";
+        set_last_error("Failed to convert filename to Prolog atom");
         return false;
     }
 
     // Call consult/1 with exception catching to avoid interactive mode
-    qid_t qid = PL_open_query(NULL, PL_Q_CATCH_EXCEPTION, pred, args);
+    qid_t qid = PL_open_query(m_module, PL_Q_CATCH_EXCEPTION, pred, args);
     int result = PL_next_solution(qid);
 
     // Handle exceptions
     if (result == PL_S_EXCEPTION)
     {
-        handle_prolog_exception(qid, "Consult");
+        handle_prolog_exception(qid, "Consult", filename);
         PL_close_query(qid);
         return false;
     }
@@ -503,7 +1010,7 @@ bool Prologot::consult_string(String const& p_prolog_code)
     // Validate input
     if (p_prolog_code.is_empty())
     {
-        m_last_error = "Empty Prolog code";
+        set_last_error("Empty Prolog code");
         return false;
     }
 
@@ -511,7 +1018,7 @@ bool Prologot::consult_string(String const& p_prolog_code)
     term_t t = PL_new_term_ref();
     if (!PL_put_string_chars(t, p_prolog_code.utf8().get_data()))
     {
-        m_last_error = "Failed to convert code to Prolog string";
+        set_last_error("Failed to convert code to Prolog string");
         return false;
     }
 
@@ -522,12 +1029,14 @@ bool Prologot::consult_string(String const& p_prolog_code)
     term_t args = PL_new_term_refs(1);
     if (!PL_put_term(args, t))
     {
-        m_last_error = "Failed to prepare arguments";
+        set_last_error("Failed to prepare arguments");
         return false;
     }
 
+    // The new facts fire the forward rules like add_fact()
+    FactLoader::Listener listener(forward_rules_listener());
     // Open query with exception catching
-    qid_t qid = PL_open_query(NULL, PL_Q_CATCH_EXCEPTION, pred, args);
+    qid_t qid = PL_open_query(m_module, PL_Q_CATCH_EXCEPTION, pred, args);
     int result = PL_next_solution(qid);
 
     // Handle exceptions
@@ -608,7 +1117,7 @@ bool Prologot::query(String const& p_predicate, Array const& p_args)
     // Validate input
     if (goal.is_empty())
     {
-        m_last_error = "Empty query";
+        set_last_error("Empty query");
         return false;
     }
 
@@ -616,14 +1125,14 @@ bool Prologot::query(String const& p_predicate, Array const& p_args)
     term_t t = PL_new_term_ref();
     if (!PL_chars_to_term(goal.utf8().get_data(), t))
     {
-        m_last_error = "Failed to parse query: " + goal;
+        set_last_error("Failed to parse query: " + goal);
         return false;
     }
 
     // Open a query using call/1 to execute the goal
     // Use PL_Q_CATCH_EXCEPTION to capture exceptions and avoid interactive mode
     qid_t qid = PL_open_query(
-        NULL, PL_Q_CATCH_EXCEPTION, PL_predicate("call", 1, "user"), t);
+        m_module, PL_Q_CATCH_EXCEPTION, PL_predicate("call", 1, "user"), t);
 
     // Get the first solution (if any)
     int result = PL_next_solution(qid);
@@ -631,7 +1140,7 @@ bool Prologot::query(String const& p_predicate, Array const& p_args)
     // Handle exceptions
     if (result == PL_S_EXCEPTION)
     {
-        handle_prolog_exception(qid, "Query");
+        handle_prolog_exception(qid, "Query", goal);
         PL_close_query(qid);
         return false;
     }
@@ -680,7 +1189,7 @@ Array Prologot::query_all(String const& p_predicate, Array const& p_args)
     // Validate input
     if (goal.is_empty())
     {
-        m_last_error = "Empty query";
+        set_last_error("Empty query");
         return results;
     }
 
@@ -712,20 +1221,20 @@ Array Prologot::query_all(String const& p_predicate, Array const& p_args)
     term_t t = PL_new_term_ref();
     if (!PL_chars_to_term(findall_goal.utf8().get_data(), t))
     {
-        m_last_error = "Failed to parse query: " + goal;
+        set_last_error("Failed to parse query: " + goal);
         return results;
     }
 
     // Execute the findall query with exception handling
     qid_t qid = PL_open_query(
-        NULL, PL_Q_CATCH_EXCEPTION, PL_predicate("call", 1, "user"), t);
+        m_module, PL_Q_CATCH_EXCEPTION, PL_predicate("call", 1, "user"), t);
 
     int solution_result = PL_next_solution(qid);
 
     // Handle Prolog exceptions
     if (solution_result == PL_S_EXCEPTION)
     {
-        handle_prolog_exception(qid, "Query all");
+        handle_prolog_exception(qid, "Query all", goal);
         PL_close_query(qid);
         return results;
     }
@@ -773,7 +1282,7 @@ Variant Prologot::query_one(String const& p_predicate, Array const& p_args)
     // Validate input
     if (goal.is_empty())
     {
-        m_last_error = "Empty query";
+        set_last_error("Empty query");
         return Variant();
     }
 
@@ -799,20 +1308,20 @@ Variant Prologot::query_one(String const& p_predicate, Array const& p_args)
     term_t t = PL_new_term_ref();
     if (!PL_chars_to_term(goal.utf8().get_data(), t))
     {
-        m_last_error = "Failed to parse query: " + goal;
+        set_last_error("Failed to parse query: " + goal);
         return Variant();
     }
 
     // Open a query with exception handling
     qid_t qid = PL_open_query(
-        NULL, PL_Q_CATCH_EXCEPTION, PL_predicate("call", 1, "user"), t);
+        m_module, PL_Q_CATCH_EXCEPTION, PL_predicate("call", 1, "user"), t);
 
     int result = PL_next_solution(qid);
 
     // Handle exceptions
     if (result == PL_S_EXCEPTION)
     {
-        handle_prolog_exception(qid, "Query one");
+        handle_prolog_exception(qid, "Query one", goal);
         PL_close_query(qid);
         return Variant();
     }
@@ -847,7 +1356,7 @@ bool Prologot::add_fact(String const& p_fact)
     // Validate input
     if (p_fact.is_empty())
     {
-        m_last_error = "Empty fact";
+        set_last_error("Empty fact");
         return false;
     }
 
@@ -862,7 +1371,7 @@ bool Prologot::add_fact(String const& p_fact)
     term_t t = PL_new_term_ref();
     if (!PL_chars_to_term(fact.utf8().get_data(), t))
     {
-        m_last_error = "Failed to parse fact: " + fact;
+        set_last_error("Failed to parse fact: " + fact);
         return false;
     }
 
@@ -871,21 +1380,110 @@ bool Prologot::add_fact(String const& p_fact)
     predicate_t pred = PL_predicate("assert", 1, "user");
 
     // Use exception catching to avoid interactive mode on syntax errors
-    qid_t qid = PL_open_query(NULL, PL_Q_CATCH_EXCEPTION, pred, t);
+    qid_t qid = PL_open_query(m_module, PL_Q_CATCH_EXCEPTION, pred, t);
     int result = PL_next_solution(qid);
 
     // Handle exceptions
     if (result == PL_S_EXCEPTION)
     {
-        handle_prolog_exception(qid, "Assert fact");
+        handle_prolog_exception(qid, "Assert fact", fact);
         PL_close_query(qid);
         return false;
     }
 
     PL_close_query(qid);
+    if (result != 0 && !m_forward_rules.empty())
+    {
+        run_forward_rules(t);
+    }
     return result != 0;
 }
 
+bool Prologot::add_fact_ttl(String const& p_fact, double p_seconds)
+{
+    if (!m_initialized)
+        return false;
+
+    // Validate input
+    if (p_fact.is_empty())
+    {
+        set_last_error("Empty fact");
+        return false;
+    }
+
+    // Remove trailing period if present (users might include it by mistake)
+    String fact = p_fact;
+    if (fact.length() > 0 && fact[fact.length() - 1] == '.')
+    {
+        fact = fact.substr(0, fact.length() - 1);
+    }
+
+    // Parse the fact string into a Prolog term
+    term_t args = PL_new_term_refs(2);
+    if (!PL_chars_to_term(fact.utf8().get_data(), args))
+    {
+        set_last_error("Failed to parse fact: " + fact);
+        return false;
+    }
+
+    // assertz/2 also returns a reference to the new clause, erased on expiry
+    // without searching the clauses of the predicate
+    predicate_t pred = PL_predicate("assertz", 2, "system");
+    qid_t qid = PL_open_query(m_module, PL_Q_CATCH_EXCEPTION, pred, args);
+    int result = PL_next_solution(qid);
+
+    // Handle exceptions
+    if (result == PL_S_EXCEPTION)
+    {
+        handle_prolog_exception(qid, "Assert fact", fact);
+        PL_close_query(qid);
+        return false;
+    }
+
+    PL_close_query(qid);
+    if (result == 0)
+        return false;
+
+    m_expiring_facts.schedule(p_seconds, PL_record(args + 1));
+    if (!m_forward_rules.empty())
+    {
+        run_forward_rules(args);
+    }
+    return true;
+}
+
+int64_t Prologot::tick(double p_delta)
+{
+    if (!m_initialized)
+        return 0;
+
+    std::vector<record_t> expired;
+    m_expiring_facts.advance(p_delta, expired);
+    if (expired.empty())
+        return 0;
+
+    // erase/1 raises an exception on facts already retracted: ignore it
+    int64_t count = 0;
+    predicate_t erase = PL_predicate("erase", 1, "system");
+    fid_t outer = PL_open_foreign_frame();
+    term_t clause = PL_new_term_ref();
+    fid_t fid = PL_open_foreign_frame();
+    for (record_t record : expired)
+    {
+        if (PL_recorded(record, clause) &&
+            PL_call_predicate(NULL, PL_Q_CATCH_EXCEPTION, erase, clause))
+        {
+            count++;
+        }
+        PL_clear_exception();
+        PL_erase(record);
+        PL_rewind_foreign_frame(fid);
+    }
+    PL_discard_foreign_frame(fid);
+    PL_discard_foreign_frame(outer);
+    return count;
+}
+
 bool Prologot::retract_fact(String const& p_fact)
 {
     if (!m_initialized)
@@ -894,7 +1492,7 @@ bool Prologot::retract_fact(String const& p_fact)
     // Validate input
     if (p_fact.is_empty())
     {
-        m_last_error = "Empty fact";
+        set_last_error("Empty fact");
         return false;
     }
 
@@ -909,7 +1507,7 @@ bool Prologot::retract_fact(String const& p_fact)
     term_t t = PL_new_term_ref();
     if (!PL_chars_to_term(fact.utf8().get_data(), t))
     {
-        m_last_error = "Failed to parse fact: " + fact;
+        set_last_error("Failed to parse fact: " + fact);
         return false;
     }
 
@@ -918,13 +1516,13 @@ bool Prologot::retract_fact(String const& p_fact)
     predicate_t pred = PL_predicate("retract", 1, "user");
 
     // Use exception catching to avoid interactive mode on syntax errors
-    qid_t qid = PL_open_query(NULL, PL_Q_CATCH_EXCEPTION, pred, t);
+    qid_t qid = PL_open_query(m_module, PL_Q_CATCH_EXCEPTION, pred, t);
     int result = PL_next_solution(qid);
 
     // Handle exceptions
     if (result == PL_S_EXCEPTION)
     {
-        handle_prolog_exception(qid, "Retract fact");
+        handle_prolog_exception(qid, "Retract fact", fact);
         PL_close_query(qid);
         return false;
     }
@@ -952,95 +1550,1169 @@ bool Prologot::retract_all(String const& p_functor)
 }
 
 // =============================================================================
-// Predicate Manipulation
+// Fact Tables
 // =============================================================================
 
-bool Prologot::call_predicate(String const& p_predicate, Array const& p_args)
+bool Prologot::create_fact_table(String const& p_functor,
+                                 PackedStringArray const& p_column_types,
+                                 Array const& p_columns,
+                                 PackedInt32Array const& p_indexes)
 {
     if (!m_initialized)
         return false;
 
-    // Validate input
-    if (p_predicate.is_empty())
+    String error;
+    std::shared_ptr<FactTable> table = FactTable::create(
+        p_functor, p_column_types, p_columns, p_indexes, error);
+    if (table == nullptr)
     {
-        m_last_error = "Empty predicate name";
+        push_error(error);
         return false;
     }
+    return true;
+}
 
-    // Allocate term references for all arguments
-    // PL_new_term_refs() allocates a contiguous array of term references
-    term_t t = PL_new_term_refs(p_args.size());
+bool Prologot::append_fact_table(String const& p_functor,
+                                 Array const& p_columns)
+{
+    if (!m_initialized)
+        return false;
 
-    // Convert each Godot Variant argument to a Prolog term
-    for (int i = 0; i < p_args.size(); i++)
+    std::shared_ptr<FactTable> table = FactTable::find(p_functor);
+    if (table == nullptr)
     {
-        term_t arg = variant_to_term(p_args[i]);
-        // PL_put_term() copies the term into the argument slot
-        // t + i is pointer arithmetic to access the i-th term reference
-        if (!PL_put_term(t + i, arg))
-        {
-            m_last_error = "Failed to convert argument " + String::num_int64(i);
-            return false;
-        }
+        set_last_error("Unknown fact table: " + p_functor);
+        return false;
     }
 
-    // Create the functor (predicate name + arity)
-    // The functor represents the predicate signature
-    functor_t f = PL_new_functor(PL_new_atom(p_predicate.utf8().get_data()),
-                                 p_args.size());
-
-    // Create the goal term by combining functor with arguments
-    term_t goal = PL_new_term_ref();
-    if (!PL_cons_functor_v(goal, f, t))
+    String error;
+    if (!table->append(p_columns, error))
     {
-        m_last_error = "Failed to construct predicate term";
+        push_error(error);
         return false;
     }
+    return true;
+}
 
-    // Execute the goal with exception catching to avoid interactive mode
-    qid_t qid = PL_open_query(
-        NULL, PL_Q_CATCH_EXCEPTION, PL_predicate("call", 1, "user"), goal);
-    int result = PL_next_solution(qid);
+int64_t Prologot::remove_fact_table_rows(String const& p_functor,
+                                         Array const& p_key)
+{
+    if (!m_initialized)
+        return -1;
 
-    // Handle exceptions
-    if (result == PL_S_EXCEPTION)
+    std::shared_ptr<FactTable> table = FactTable::find(p_functor);
+    if (table == nullptr)
     {
-        handle_prolog_exception(qid, "Call predicate");
-        PL_close_query(qid);
-        return false;
+        set_last_error("Unknown fact table: " + p_functor);
+        return -1;
     }
 
-    PL_close_query(qid);
-    return result != 0;
+    String error;
+    int64_t count = table->remove(p_key, error);
+    if (count < 0)
+    {
+        push_error(error);
+    }
+    return count;
 }
 
-Variant Prologot::call_function(String const& p_predicate, Array const& p_args)
+bool Prologot::drop_fact_table(String const& p_functor)
 {
     if (!m_initialized)
-        return Variant();
+        return false;
 
-    // Validate input
-    if (p_predicate.is_empty())
+    return FactTable::drop(p_functor);
+}
+
+int64_t Prologot::get_fact_table_size(String const& p_functor,
+                                      bool p_stored) const
+{
+    if (!m_initialized)
+        return -1;
+
+    std::shared_ptr<FactTable> table = FactTable::find(p_functor);
+    if (table == nullptr)
+        return -1;
+    return int64_t(p_stored ? table->stored_row_count() : table->row_count());
+}
+
+bool Prologot::save_fact_table(String const& p_functor, String const& p_path)
+{
+    if (!m_initialized)
+        return false;
+
+    std::shared_ptr<FactTable> table = FactTable::find(p_functor);
+    if (table == nullptr)
     {
-        m_last_error = "Empty predicate name";
-        return Variant();
+        set_last_error("Unknown fact table: " + p_functor);
+        return false;
     }
 
-    // Allocate term references for arguments plus one extra for the result
-    // The result will be stored in the last term reference
-    term_t t = PL_new_term_refs(p_args.size() + 1);
-
-    // Convert each input argument to a Prolog term
-    for (int i = 0; i < p_args.size(); i++)
+    String error;
+    if (!table->save(resolve_godot_path(p_path), error))
     {
-        term_t arg = variant_to_term(p_args[i]);
-        if (!PL_put_term(t + i, arg))
-        {
-            m_last_error = "Failed to convert argument " + String::num_int64(i);
-            return Variant();
-        }
+        push_error(error);
+        return false;
     }
-    // Note: t + args.size() is left unbound - Prolog will bind it
+    return true;
+}
+
+bool Prologot::map_fact_file(String const& p_path,
+                             PackedInt32Array const& p_indexes)
+{
+    if (!m_initialized)
+        return false;
+
+    String error;
+    if (FactTable::map(resolve_godot_path(p_path), p_indexes, error) ==
+        nullptr)
+    {
+        push_error(error);
+        return false;
+    }
+    return true;
+}
+
+// =============================================================================
+// Bulk Loading
+// =============================================================================
+
+int64_t Prologot::load_csv_facts(String const& p_path,
+                                 String const& p_functor,
+                                 PackedStringArray const& p_column_types,
+                                 Dictionary const& p_options)
+{
+    if (!m_initialized)
+        return -1;
+
+    String error;
+    std::vector<FactLoader::ValueType> types;
+    if (!FactLoader::parse_types(p_column_types, types, error))
+    {
+        push_error(error);
+        return -1;
+    }
+    String separator = p_options.get("separator", ",");
+    if (separator.length() != 1 || separator[0] > 127)
+    {
+        push_error("CSV separator must be a single ASCII character");
+        return -1;
+    }
+
+    // FileAccess also reads files packed in the exported PCK
+    Ref<FileAccess> file = FileAccess::open(p_path, FileAccess::READ);
+    if (file.is_null())
+    {
+        push_error("Cannot read CSV file: " + p_path);
+        return -1;
+    }
+
+    // The new facts fire the forward rules like add_fact()
+    FactLoader::Listener listener(forward_rules_listener());
+    FactLoader::FileInput input(file);
+    int64_t count = FactLoader::load_csv(input,
+                                         p_functor,
+                                         m_module,
+                                         types,
+                                         (char)separator[0],
+                                         p_options.get("header", true),
+                                         error);
+    if (count < 0)
+    {
+        push_error(p_path + ": " + error);
+    }
+    return count;
+}
+
+int64_t Prologot::load_json_facts(String const& p_path,
+                                  Dictionary const& p_mapping)
+{
+    if (!m_initialized)
+        return -1;
+
+    String functor = p_mapping.get("functor", "");
+    PackedStringArray fields = p_mapping.get("fields", PackedStringArray());
+    if (functor.is_empty() || fields.is_empty())
+    {
+        push_error("JSON mapping needs a \"functor\" and \"fields\"");
+        return -1;
+    }
+
+    String error;
+    std::vector<FactLoader::ValueType> types;
+    if (!FactLoader::parse_types(
+            p_mapping.get("types", PackedStringArray()), types, error))
+    {
+        push_error(error);
+        return -1;
+    }
+
+    Ref<FileAccess> file = FileAccess::open(p_path, FileAccess::READ);
+    if (file.is_null())
+    {
+        push_error("Cannot read JSON file: " + p_path);
+        return -1;
+    }
+
+    // The new facts fire the forward rules like add_fact()
+    FactLoader::Listener listener(forward_rules_listener());
+    // The rows may be nested in a member of the root object
+    FactLoader::FileInput input(file);
+    int64_t count = FactLoader::load_json(input,
+                                          p_mapping.get("root", ""),
+                                          functor,
+                                          m_module,
+                                          fields,
+                                          types,
+                                          error);
+    if (count < 0)
+    {
+        push_error(p_path + ": " + error);
+    }
+    return count;
+}
+
+int64_t Prologot::import_tilemap(Node* p_map,
+                                 String const& p_functor,
+                                 Dictionary const& p_options)
+{
+    if (!m_initialized)
+        return -1;
+
+    // The new facts fire the forward rules like add_fact()
+    FactLoader::Listener listener(forward_rules_listener());
+    String error;
+    int64_t count =
+        TileMapFacts::import(p_map, p_functor, m_module, p_options, error);
+    if (count < 0)
+    {
+        push_error(error);
+    }
+    return count;
+}
+
+int64_t Prologot::sync_tilemap_cells(Node* p_map,
+                                     String const& p_functor,
+                                     Array const& p_cells)
+{
+    if (!m_initialized)
+        return -1;
+
+    // The new facts fire the forward rules like add_fact()
+    FactLoader::Listener listener(forward_rules_listener());
+    String error;
+    int64_t count =
+        TileMapFacts::sync(p_map, p_functor, m_module, p_cells, error);
+    if (count < 0)
+    {
+        push_error(error);
+    }
+    return count;
+}
+
+// =============================================================================
+// Scene Tree Mirroring
+// =============================================================================
+
+int64_t Prologot::mirror_scene_tree(Node* p_root)
+{
+    if (!m_initialized)
+        return -1;
+
+    // The new facts fire the forward rules like add_fact()
+    FactLoader::Listener listener(forward_rules_listener());
+    disconnect_mirror();
+    String error;
+    int64_t count = m_mirror.mirror(p_root, m_module, error);
+    if (count < 0)
+    {
+        push_error(error);
+        return -1;
+    }
+
+    SceneTree* tree = p_root->get_tree();
+    tree->connect("node_added",
+                  callable_mp(this, &Prologot::on_mirror_node_added));
+    tree->connect("node_removed",
+                  callable_mp(this, &Prologot::on_mirror_node_removed));
+    m_mirror_tree = tree->get_instance_id();
+    return count;
+}
+
+bool Prologot::mirror_update_groups(Node* p_node)
+{
+    if (!m_initialized)
+        return false;
+
+    // The new facts fire the forward rules like add_fact()
+    FactLoader::Listener listener(forward_rules_listener());
+    String error;
+    if (!m_mirror.update_groups(p_node, error))
+    {
+        push_error(error);
+        return false;
+    }
+    return true;
+}
+
+void Prologot::unmirror_scene_tree()
+{
+    if (!m_initialized)
+        return;
+
+    disconnect_mirror();
+    m_mirror.clear();
+}
+
+void Prologot::on_mirror_node_added(Node* p_node)
+{
+    // node_added is emitted parent first: the parent is already mirrored
+    if (!m_mirror.is_mirrored(p_node))
+        return;
+
+    // The new facts fire the forward rules like add_fact()
+    FactLoader::Listener listener(forward_rules_listener());
+    String error;
+    if (!m_mirror.add_node(p_node, error))
+    {
+        push_error(error);
+    }
+}
+
+void Prologot::on_mirror_node_removed(Node* p_node)
+{
+    // node_removed is emitted children first, while the node still has its
+    // parent
+    if (p_node == m_mirror.get_root())
+    {
+        unmirror_scene_tree();
+    }
+    else if (m_mirror.is_mirrored(p_node))
+    {
+        m_mirror.remove_node(p_node);
+    }
+}
+
+void Prologot::disconnect_mirror()
+{
+    SceneTree* tree = Object::cast_to<SceneTree>(
+        ObjectDB::get_instance((uint64_t)m_mirror_tree));
+    if (tree != nullptr)
+    {
+        tree->disconnect("node_added",
+                         callable_mp(this, &Prologot::on_mirror_node_added));
+        tree->disconnect(
+            "node_removed",
+            callable_mp(this, &Prologot::on_mirror_node_removed));
+    }
+    m_mirror_tree = ObjectID();
+}
+
+// =============================================================================
+// Planning
+// =============================================================================
+
+PackedStringArray Prologot::plan(Array const& p_state,
+                                 Array const& p_goal,
+                                 Dictionary const& p_options)
+{
+    int64_t id = plan_start(p_state, p_goal, p_options);
+    if (id < 0)
+        return PackedStringArray();
+
+    plan_step(id, 0);
+    return plan_result(id);
+}
+
+int64_t Prologot::plan_start(Array const& p_state,
+                             Array const& p_goal,
+                             Dictionary const& p_options)
+{
+    if (!m_initialized)
+        return -1;
+
+    String error;
+    int64_t id = m_planner.start(p_state, p_goal, p_options, error);
+    if (id < 0)
+    {
+        push_error(error);
+    }
+    return id;
+}
+
+int Prologot::plan_step(int64_t p_id, int64_t p_budget_usec)
+{
+    if (!m_initialized)
+        return -1;
+
+    String error;
+    GoapPlanner::Status status = m_planner.step(
+        p_id, (uint64_t)std::max<int64_t>(p_budget_usec, 0), error);
+    if (!error.is_empty())
+    {
+        push_error(error);
+    }
+    return int(status);
+}
+
+PackedStringArray Prologot::plan_result(int64_t p_id)
+{
+    return m_planner.take_result(p_id);
+}
+
+void Prologot::clear_plan_cache()
+{
+    m_planner.clear_cache();
+}
+
+// =============================================================================
+// Constraint Solving
+// =============================================================================
+
+PackedInt64Array Prologot::clpfd_solve(Dictionary const& p_domains,
+                                       PackedStringArray const& p_constraints,
+                                       Dictionary const& p_options)
+{
+    PackedInt64Array solutions;
+    if (!m_initialized)
+        return solutions;
+
+    String error;
+    switch (ClpfdSolver::solve(
+        p_domains, p_constraints, p_options, solutions, error))
+    {
+        case ClpfdSolver::Outcome::ERROR:
+            push_error(error);
+            break;
+        case ClpfdSolver::Outcome::LIMIT_EXCEEDED:
+            // Not an error: the caller asked for a bounded search
+            set_last_error("clpfd_solve: search limit exceeded");
+            break;
+        case ClpfdSolver::Outcome::COMPLETE:
+            break;
+    }
+    return solutions;
+}
+
+// =============================================================================
+// Forward Rules
+// =============================================================================
+
+bool Prologot::add_forward_rule(String const& p_name,
+                                PackedStringArray const& p_conditions,
+                                Dictionary const& p_options)
+{
+    if (!m_initialized)
+        return false;
+
+    String error;
+    if (!m_forward_rules.add(p_name, p_conditions, p_options, error))
+    {
+        push_error(error);
+        return false;
+    }
+    return true;
+}
+
+bool Prologot::remove_forward_rule(String const& p_name)
+{
+    if (!m_initialized)
+        return false;
+
+    return m_forward_rules.remove(p_name);
+}
+
+void Prologot::flush_forward_rules()
+{
+    m_forward_flush_pending = false;
+    if (m_forward_rules.has_firings())
+    {
+        emit_signal("forward_rules_fired", m_forward_rules.take_firings());
+    }
+}
+
+std::function<void(term_t)> Prologot::forward_rules_listener()
+{
+    return [this](term_t p_fact)
+    {
+        if (!m_forward_rules.empty())
+            run_forward_rules(p_fact);
+    };
+}
+
+void Prologot::run_forward_rules(term_t p_fact)
+{
+    String error;
+    if (!m_forward_rules.on_assert(p_fact, m_module, error))
+    {
+        push_error(error);
+    }
+
+    // One signal per frame, whatever the number of facts added
+    if (m_forward_rules.has_firings() && !m_forward_flush_pending)
+    {
+        m_forward_flush_pending = true;
+        call_deferred("flush_forward_rules");
+    }
+}
+
+// =============================================================================
+// Constraint Handling Rules
+// =============================================================================
+
+bool Prologot::chr_consult(String const& p_code)
+{
+    if (!m_initialized)
+        return false;
+
+    String error;
+    if (!m_chr.consult(p_code, error))
+    {
+        push_error(error);
+        return false;
+    }
+    return true;
+}
+
+bool Prologot::chr_add(PackedStringArray const& p_constraints)
+{
+    if (!m_initialized)
+        return false;
+
+    String error;
+    if (m_chr.add(p_constraints, error))
+        return true;
+
+    if (error.is_empty())
+    {
+        // Inconsistent constraints are a normal outcome, not an error
+        set_last_error("CHR constraints failed");
+    }
+    else
+    {
+        push_error(error);
+    }
+    return false;
+}
+
+Array Prologot::chr_get_store(String const& p_name)
+{
+    if (!m_initialized)
+        return Array();
+
+    String error;
+    Array constraints = m_chr.get_store(p_name, error);
+    if (!error.is_empty())
+    {
+        push_error(error);
+    }
+    return constraints;
+}
+
+PackedStringArray Prologot::chr_snapshot()
+{
+    if (!m_initialized)
+        return PackedStringArray();
+
+    String error;
+    PackedStringArray snapshot = m_chr.snapshot(error);
+    if (!error.is_empty())
+    {
+        push_error(error);
+    }
+    return snapshot;
+}
+
+bool Prologot::chr_restore(PackedStringArray const& p_snapshot)
+{
+    if (!m_initialized)
+        return false;
+
+    String error;
+    if (m_chr.restore(p_snapshot, error))
+        return true;
+
+    if (error.is_empty())
+    {
+        set_last_error("CHR constraints failed");
+    }
+    else
+    {
+        push_error(error);
+    }
+    return false;
+}
+
+void Prologot::chr_reset()
+{
+    if (!m_initialized)
+        return;
+
+    m_chr.reset();
+}
+
+// =============================================================================
+// Blackboard
+// =============================================================================
+
+bool Prologot::bb_set(String const& p_key, Variant const& p_value)
+{
+    if (!m_initialized)
+        return false;
+
+    String error;
+    if (!Blackboard::set(m_module, p_key, p_value, error))
+    {
+        push_error(error);
+        return false;
+    }
+    return true;
+}
+
+Variant Prologot::bb_get(String const& p_key, Variant const& p_default)
+{
+    if (!m_initialized)
+        return p_default;
+
+    Variant value;
+    return Blackboard::get(m_module, p_key, value) ? value : p_default;
+}
+
+Dictionary Prologot::bb_get_many(PackedStringArray const& p_keys)
+{
+    if (!m_initialized)
+        return Dictionary();
+
+    return Blackboard::get_many(m_module, p_keys);
+}
+
+bool Prologot::bb_erase(String const& p_key)
+{
+    if (!m_initialized)
+        return false;
+
+    return Blackboard::erase(m_module, p_key);
+}
+
+// =============================================================================
+// Thread-Local Scratch
+// =============================================================================
+
+bool Prologot::declare_thread_local(String const& p_indicator)
+{
+    if (!m_initialized)
+        return false;
+
+    // Parse Name/Arity
+    fid_t fid = PL_open_foreign_frame();
+    term_t indicator = PL_new_term_ref();
+    term_t name = PL_new_term_ref();
+    term_t arity = PL_new_term_ref();
+    atom_t name_atom;
+    int arity_value;
+    if (!PL_chars_to_term(p_indicator.utf8().get_data(), indicator) ||
+        !PL_is_functor(indicator, PL_new_functor(PL_new_atom("/"), 2)) ||
+        !PL_get_arg(1, indicator, name) || !PL_get_arg(2, indicator, arity) ||
+        !PL_get_atom(name, &name_atom) ||
+        !PL_get_integer(arity, &arity_value) || arity_value < 0)
+    {
+        set_last_error("Invalid predicate indicator: " + p_indicator);
+        PL_discard_foreign_frame(fid);
+        return false;
+    }
+
+    // thread_local/1 raises a permission error if the predicate already has
+    // clauses
+    predicate_t pred = PL_predicate("thread_local", 1, "system");
+    qid_t qid = PL_open_query(m_module, PL_Q_CATCH_EXCEPTION, pred, indicator);
+    int result = PL_next_solution(qid);
+    if (!result)
+    {
+        handle_prolog_exception(qid, "Declare thread-local", p_indicator);
+    }
+    PL_close_query(qid);
+    PL_discard_foreign_frame(fid);
+    if (!result)
+        return false;
+
+    functor_t functor = PL_new_functor(name_atom, size_t(arity_value));
+    std::lock_guard<std::mutex> lock(m_thread_locals_mutex);
+    if (std::find(m_thread_locals.begin(), m_thread_locals.end(), functor) ==
+        m_thread_locals.end())
+    {
+        PL_register_atom(name_atom);
+        m_thread_locals.push_back(functor);
+    }
+    return true;
+}
+
+Array Prologot::query_scratch(String const& p_goal,
+                              PackedStringArray const& p_facts)
+{
+    Array results;
+    if (!m_initialized)
+        return results;
+
+    // A worker thread (e.g., evaluating agents in parallel) borrows a pooled
+    // engine, which gets back to the pool without scratch clauses
+    PL_engine_t engine = nullptr;
+    PL_engine_t previous = nullptr;
+    if (PL_thread_self() == -1)
+    {
+        engine = m_engines.acquire();
+        if (engine == nullptr ||
+            PL_set_engine(engine, &previous) != PL_ENGINE_SET)
+        {
+            if (engine != nullptr)
+                m_engines.release(engine);
+            push_error("query_scratch: cannot attach a Prolog engine");
+            return results;
+        }
+    }
+
+    std::vector<functor_t> thread_locals;
+    {
+        std::lock_guard<std::mutex> lock(m_thread_locals_mutex);
+        thread_locals = m_thread_locals;
+    }
+
+    // Scratch facts must be thread-local, otherwise they would outlive the
+    // call and be seen by the other threads
+    bool ok = true;
+    fid_t fid = PL_open_foreign_frame();
+    term_t fact = PL_new_term_ref();
+    for (int64_t i = 0; i < p_facts.size() && ok; i++)
+    {
+        functor_t functor;
+        if (!PL_chars_to_term(p_facts[i].utf8().get_data(), fact) ||
+            !PL_get_functor(fact, &functor))
+        {
+            set_last_error("Failed to parse fact: " + p_facts[i]);
+            ok = false;
+        }
+        else if (std::find(thread_locals.begin(),
+                           thread_locals.end(),
+                           functor) == thread_locals.end())
+        {
+            set_last_error("Scratch fact of a predicate not declared "
+                           "thread-local: " +
+                           p_facts[i]);
+            ok = false;
+        }
+        else if (!PL_assert(fact, m_module, PL_ASSERTZ))
+        {
+            set_last_error("Failed to assert scratch fact: " + p_facts[i]);
+            ok = false;
+        }
+    }
+    PL_clear_exception();
+    PL_discard_foreign_frame(fid);
+
+    if (ok)
+    {
+        results = query_all(p_goal);
+    }
+    clear_thread_locals(thread_locals);
+
+    if (engine != nullptr)
+    {
+        PL_set_engine(previous, nullptr);
+        m_engines.release(engine);
+    }
+    return results;
+}
+
+void Prologot::clear_thread_locals(std::vector<functor_t> const& p_functors)
+{
+    predicate_t retractall = PL_predicate("retractall", 1, "user");
+    fid_t fid = PL_open_foreign_frame();
+    term_t head = PL_new_term_ref();
+    for (functor_t functor : p_functors)
+    {
+        if (PL_put_functor(head, functor))
+        {
+            PL_call_predicate(m_module, PL_Q_CATCH_EXCEPTION, retractall, head);
+        }
+    }
+    PL_clear_exception();
+    PL_discard_foreign_frame(fid);
+}
+
+// =============================================================================
+// Parallel Calls
+// =============================================================================
+
+Dictionary Prologot::parallel_call(String const& p_predicate,
+                                   Array const& p_arg_rows,
+                                   int64_t p_max_threads)
+{
+    if (!m_initialized)
+        return Dictionary();
+
+    if (m_parallel_call != nullptr)
+    {
+        set_last_error("parallel_call: already running");
+        return Dictionary();
+    }
+
+    int64_t threads = (p_max_threads > 0)
+                          ? p_max_threads
+                          : OS::get_singleton()->get_processor_count();
+    threads = std::max<int64_t>(1, std::min(threads, p_arg_rows.size()));
+
+    // Engines are created here, by a Prolog thread, rather than by the tasks.
+    // A few chunks per task balance the load when some rows cost more.
+    String error;
+    if (!m_engines.reserve(size_t(threads), error))
+    {
+        push_error(error);
+        return Dictionary();
+    }
+    // Each failing row is reported by its worker thread, so that the error
+    // is the last one of that thread and is queued with its id
+    ParallelCall call(p_predicate,
+                      m_module,
+                      p_arg_rows,
+                      threads * 4,
+                      [this](ErrorRecord const& p_record)
+                      { report_error(p_record); });
+    if (call.chunk_count() > 0)
+    {
+        WorkerThreadPool* pool = WorkerThreadPool::get_singleton();
+        m_parallel_call = &call;
+        int64_t task = pool->add_group_task(
+            callable_mp(this, &Prologot::run_parallel_chunk),
+            int(call.chunk_count()),
+            int(threads),
+            true,
+            "Prologot parallel_call");
+        pool->wait_for_group_task_completion(task);
+        m_parallel_call = nullptr;
+    }
+
+    // The caller only gets a summary, already reported by the workers
+    int64_t errors = 0;
+    Dictionary outcome = call.take_results(errors);
+    if (errors > 0)
+    {
+        set_last_error("parallel_call: " + String::num_int64(errors) +
+                           " rows raised errors (see take_errors())",
+                       "error",
+                       "parallel_call",
+                       p_predicate);
+    }
+    return outcome;
+}
+
+void Prologot::run_parallel_chunk(uint32_t p_chunk)
+{
+    m_parallel_call->run_chunk(int64_t(p_chunk), m_engines);
+}
+
+// =============================================================================
+// Query Cursors
+// =============================================================================
+
+int64_t Prologot::query_open(String const& p_goal)
+{
+    if (!m_initialized)
+        return 0;
+
+    String goal = build_query(p_goal, Array());
+    if (goal.is_empty())
+    {
+        set_last_error("Empty query");
+        return 0;
+    }
+
+    auto cursor = std::make_shared<QueryCursor>(m_engines);
+    String error;
+    if (!cursor->open(goal, m_module, error))
+    {
+        set_last_error(error, "error", "Query cursor", goal);
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_cursors_mutex);
+    m_cursors[++m_cursor_count] = cursor;
+    return m_cursor_count;
+}
+
+Array Prologot::query_next(int64_t p_cursor, int64_t p_count)
+{
+    Array solutions;
+    if (!m_initialized)
+        return solutions;
+
+    std::shared_ptr<QueryCursor> cursor = find_cursor(p_cursor);
+    if (!cursor)
+    {
+        set_last_error("Unknown query cursor: " + String::num_int64(p_cursor));
+        return solutions;
+    }
+
+    // The error is reported by the calling thread (see report_error())
+    ErrorRecord error;
+    if (!cursor->next(p_count, solutions, error))
+    {
+        ErrorRecord record = make_error_record(
+            error.message, "error", error.context, error.goal);
+        record.exception = error.exception;
+        report_error(record);
+    }
+    return solutions;
+}
+
+Dictionary Prologot::query_stats(int64_t p_cursor) const
+{
+    std::shared_ptr<QueryCursor> cursor = find_cursor(p_cursor);
+    return cursor ? cursor->stats() : Dictionary();
+}
+
+bool Prologot::query_close(int64_t p_cursor)
+{
+    std::shared_ptr<QueryCursor> cursor;
+    {
+        std::lock_guard<std::mutex> lock(m_cursors_mutex);
+        auto it = m_cursors.find(p_cursor);
+        if (it == m_cursors.end())
+            return false;
+        cursor = it->second;
+        m_cursors.erase(it);
+    }
+    cursor->close();
+    return true;
+}
+
+std::shared_ptr<QueryCursor> Prologot::find_cursor(int64_t p_cursor) const
+{
+    std::lock_guard<std::mutex> lock(m_cursors_mutex);
+    auto it = m_cursors.find(p_cursor);
+    return (it != m_cursors.end()) ? it->second : nullptr;
+}
+
+// =============================================================================
+// Benchmarking
+// =============================================================================
+
+Dictionary Prologot::benchmark(String const& p_goal,
+                               int64_t p_iterations,
+                               int64_t p_warmup)
+{
+    if (!m_initialized)
+        return Dictionary();
+
+    String goal = build_query(p_goal, Array());
+    if (goal.is_empty() || p_iterations < 1)
+    {
+        set_last_error("benchmark: empty goal or no iteration");
+        return Dictionary();
+    }
+    if (p_warmup < 0)
+    {
+        set_last_error("benchmark: negative warmup");
+        return Dictionary();
+    }
+
+    // A worker thread (e.g., of the editor dock) borrows a pooled engine
+    PL_engine_t engine = nullptr;
+    PL_engine_t previous = nullptr;
+    if (PL_thread_self() == -1)
+    {
+        engine = m_engines.acquire();
+        if (engine == nullptr ||
+            PL_set_engine(engine, &previous) != PL_ENGINE_SET)
+        {
+            if (engine != nullptr)
+                m_engines.release(engine);
+            push_error("benchmark: cannot attach a Prolog engine");
+            return Dictionary();
+        }
+    }
+
+    Dictionary report;
+    fid_t outer = PL_open_foreign_frame();
+    term_t t = PL_new_term_ref();
+    predicate_t call = PL_predicate("call", 1, "user");
+    if (!PL_chars_to_term(goal.utf8().get_data(), t))
+    {
+        set_last_error("Failed to parse query: " + goal);
+    }
+    else
+    {
+        // Nanosecond clock: most goals worth comparing take less than the
+        // microsecond of Time::get_ticks_usec()
+        using Clock = std::chrono::steady_clock;
+        std::vector<int64_t> times;
+        times.reserve(size_t(p_iterations));
+        int64_t succeeded = 0;
+        int64_t allocated = 0;
+        int64_t inferences = 0;
+        bool raised = false;
+
+        // Inferences counted by a statistics/2 reading itself, subtracted
+        // from each bracket below
+        int64_t reading = statistics_value("inferences");
+        reading = statistics_value("inferences") - reading;
+        for (int64_t i = 0; i < p_warmup + p_iterations && !raised; i++)
+        {
+            bool measured = (i >= p_warmup);
+
+            // Discarding the frame undoes the bindings of the call. The
+            // statistics are read before and after the timed call only.
+            fid_t fid = PL_open_foreign_frame();
+            int64_t global = measured ? statistics_value("globalused") : 0;
+            int64_t counted = measured ? statistics_value("inferences") : 0;
+            Clock::time_point begin = Clock::now();
+            qid_t qid = PL_open_query(
+                m_module, PL_Q_NODEBUG | PL_Q_CATCH_EXCEPTION, call, t);
+            bool ok = PL_next_solution(qid);
+            if (!ok && PL_exception(qid))
+            {
+                handle_prolog_exception(qid, "Benchmark", goal);
+                raised = true;
+            }
+            PL_cut_query(qid);
+            Clock::time_point end = Clock::now();
+            if (measured)
+            {
+                times.push_back(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        end - begin)
+                        .count());
+                inferences +=
+                    statistics_value("inferences") - counted - reading;
+                allocated += std::max<int64_t>(
+                    0, statistics_value("globalused") - global);
+                succeeded += ok ? 1 : 0;
+            }
+            PL_discard_foreign_frame(fid);
+        }
+
+        if (!raised)
+        {
+            std::sort(times.begin(), times.end());
+            int64_t total = 0;
+            for (int64_t time : times)
+                total += time;
+            size_t n = times.size();
+            report["goal"] = goal;
+            report["iterations"] = int64_t(n);
+            report["succeeded"] = succeeded;
+            report["mean_usec"] = double(total) / double(n) / 1000.0;
+            report["p50_usec"] = double(times[n / 2]) / 1000.0;
+            report["p99_usec"] =
+                double(times[std::min(n - 1, n * 99 / 100)]) / 1000.0;
+            report["min_usec"] = double(times.front()) / 1000.0;
+            report["max_usec"] = double(times.back()) / 1000.0;
+            report["inferences_per_call"] =
+                double(std::max<int64_t>(0, inferences)) / double(n);
+            report["allocated_bytes_per_call"] =
+                double(allocated) / double(n);
+        }
+    }
+    PL_discard_foreign_frame(outer);
+
+    if (engine != nullptr)
+    {
+        PL_set_engine(previous, nullptr);
+        m_engines.release(engine);
+    }
+    return report;
+}
+
+// =============================================================================
+// Predicate Manipulation
+// =============================================================================
+
+bool Prologot::call_predicate(String const& p_predicate, Array const& p_args)
+{
+    if (!m_initialized)
+        return false;
+
+    // Validate input
+    if (p_predicate.is_empty())
+    {
+        set_last_error("Empty predicate name");
+        return false;
+    }
+
+    // Allocate term references for all arguments
+    // PL_new_term_refs() allocates a contiguous array of term references
+    term_t t = PL_new_term_refs(p_args.size());
+
+    // Convert each Godot Variant argument to a Prolog term
+    for (int i = 0; i < p_args.size(); i++)
+    {
+        term_t arg = variant_to_term(p_args[i]);
+        // PL_put_term() copies the term into the argument slot
+        // t + i is pointer arithmetic to access the i-th term reference
+        if (!PL_put_term(t + i, arg))
+        {
+            set_last_error("Failed to convert argument " +
+                           String::num_int64(i));
+            return false;
+        }
+    }
+
+    // Create the functor (predicate name + arity)
+    // The functor represents the predicate signature
+    functor_t f = PL_new_functor(PL_new_atom(p_predicate.utf8().get_data()),
+                                 p_args.size());
+
+    // Create the goal term by combining functor with arguments
+    term_t goal = PL_new_term_ref();
+    if (!PL_cons_functor_v(goal, f, t))
+    {
+        set_last_error("Failed to construct predicate term");
+        return false;
+    }
+
+    // Execute the goal with exception catching to avoid interactive mode
+    qid_t qid = PL_open_query(
+        m_module, PL_Q_CATCH_EXCEPTION, PL_predicate("call", 1, "user"), goal);
+    int result = PL_next_solution(qid);
+
+    // Handle exceptions
+    if (result == PL_S_EXCEPTION)
+    {
+        handle_prolog_exception(qid, "Call predicate", p_predicate);
+        PL_close_query(qid);
+        return false;
+    }
+
+    PL_close_query(qid);
+    return result != 0;
+}
+
+Variant Prologot::call_function(String const& p_predicate, Array const& p_args)
+{
+    if (!m_initialized)
+        return Variant();
+
+    // Validate input
+    if (p_predicate.is_empty())
+    {
+        set_last_error("Empty predicate name");
+        return Variant();
+    }
+
+    // Allocate term references for arguments plus one extra for the result
+    // The result will be stored in the last term reference
+    term_t t = PL_new_term_refs(p_args.size() + 1);
+
+    // Convert each input argument to a Prolog term
+    for (int i = 0; i < p_args.size(); i++)
+    {
+        term_t arg = variant_to_term(p_args[i]);
+        if (!PL_put_term(t + i, arg))
+        {
+            set_last_error("Failed to convert argument " +
+                           String::num_int64(i));
+            return Variant();
+        }
+    }
+    // Note: t + args.size() is left unbound - Prolog will bind it
 
     // Create the functor with arity = args.size() + 1 (includes result)
     functor_t f = PL_new_functor(PL_new_atom(p_predicate.utf8().get_data()),
@@ -1048,19 +2720,19 @@ Variant Prologot::call_function(String const& p_predicate, Array const& p_args)
     term_t goal = PL_new_term_ref();
     if (!PL_cons_functor_v(goal, f, t))
     {
-        m_last_error = "Failed to construct predicate term";
+        set_last_error("Failed to construct predicate term");
         return Variant();
     }
 
     // Execute the goal with exception catching to avoid interactive mode
     qid_t qid = PL_open_query(
-        NULL, PL_Q_CATCH_EXCEPTION, PL_predicate("call", 1, "user"), goal);
+        m_module, PL_Q_CATCH_EXCEPTION, PL_predicate("call", 1, "user"), goal);
     int result = PL_next_solution(qid);
 
     // Handle exceptions
     if (result == PL_S_EXCEPTION)
     {
-        handle_prolog_exception(qid, "Call function");
+        handle_prolog_exception(qid, "Call function", p_predicate);
         PL_close_query(qid);
         return Variant();
     }
@@ -1076,6 +2748,117 @@ Variant Prologot::call_function(String const& p_predicate, Array const& p_args)
     return var;
 }
 
+bool Prologot::call_predicate_json(String const& p_predicate,
+                                   String const& p_json)
+{
+    if (!m_initialized)
+        return false;
+
+    if (p_predicate.is_empty())
+    {
+        set_last_error("Empty predicate name");
+        return false;
+    }
+
+    // Parse the JSON text straight into the argument term
+    CharString json = p_json.utf8();
+    term_t arg = PL_new_term_ref();
+    String error;
+    if (!JsonTerm::parse(json.get_data(), json.length(), arg, error))
+    {
+        push_error(error);
+        return false;
+    }
+
+    functor_t f =
+        PL_new_functor(PL_new_atom(p_predicate.utf8().get_data()), 1);
+    term_t goal = PL_new_term_ref();
+    if (!PL_cons_functor_v(goal, f, arg))
+    {
+        set_last_error("Failed to construct predicate term");
+        return false;
+    }
+
+    qid_t qid = PL_open_query(
+        m_module, PL_Q_CATCH_EXCEPTION, PL_predicate("call", 1, "user"), goal);
+    int result = PL_next_solution(qid);
+
+    if (result == PL_S_EXCEPTION)
+    {
+        handle_prolog_exception(qid, "Call predicate JSON", p_predicate);
+        PL_close_query(qid);
+        return false;
+    }
+
+    PL_close_query(qid);
+    return result != 0;
+}
+
+String Prologot::call_function_json(String const& p_predicate,
+                                    Array const& p_args)
+{
+    if (!m_initialized)
+        return String();
+
+    if (p_predicate.is_empty())
+    {
+        set_last_error("Empty predicate name");
+        return String();
+    }
+
+    // Input arguments, plus an unbound result as last argument
+    term_t t = PL_new_term_refs(p_args.size() + 1);
+    for (int i = 0; i < p_args.size(); i++)
+    {
+        term_t arg = variant_to_term(p_args[i]);
+        if (!PL_put_term(t + i, arg))
+        {
+            set_last_error("Failed to convert argument " +
+                           String::num_int64(i));
+            return String();
+        }
+    }
+
+    functor_t f = PL_new_functor(PL_new_atom(p_predicate.utf8().get_data()),
+                                 p_args.size() + 1);
+    term_t goal = PL_new_term_ref();
+    if (!PL_cons_functor_v(goal, f, t))
+    {
+        set_last_error("Failed to construct predicate term");
+        return String();
+    }
+
+    qid_t qid = PL_open_query(
+        m_module, PL_Q_CATCH_EXCEPTION, PL_predicate("call", 1, "user"), goal);
+    int result = PL_next_solution(qid);
+
+    if (result == PL_S_EXCEPTION)
+    {
+        handle_prolog_exception(qid, "Call function JSON", p_predicate);
+        PL_close_query(qid);
+        return String();
+    }
+
+    // Serialize the result while the query still holds its bindings
+    String json;
+    if (result)
+    {
+        std::string text;
+        String error;
+        if (JsonTerm::to_json(t + p_args.size(), text, error))
+        {
+            json = String::utf8(text.c_str(), (int64_t)text.size());
+        }
+        else
+        {
+            push_error(error);
+        }
+    }
+
+    PL_close_query(qid);
+    return json;
+}
+
 // =============================================================================
 // Introspection
 // =============================================================================
@@ -1085,12 +2868,33 @@ bool Prologot::predicate_exists(String const& p_predicate, int p_arity)
     if (!m_initialized)
         return false;
 
-    // PL_predicate() looks up a predicate by name and arity
-    // Returns 0 (NULL) if the predicate doesn't exist
-    // NULL as module means search in all modules
-    predicate_t pred =
-        PL_predicate(p_predicate.utf8().get_data(), p_arity, NULL);
-    return pred != 0;
+    if (p_arity < 0)
+        return false;
+
+    // predicate_property(Module:Head, visible): defined in the module of
+    // the instance, inherited (base module, user, system) or autoloadable
+    CharString name = p_predicate.utf8();
+    atom_t name_atom =
+        PL_new_atom_mbchars(REP_UTF8, name.length(), name.get_data());
+    functor_t functor = PL_new_functor(name_atom, size_t(p_arity));
+    PL_unregister_atom(name_atom);
+
+    fid_t fid = PL_open_foreign_frame();
+    term_t args = PL_new_term_refs(2);
+    term_t module = PL_new_term_ref();
+    term_t head = PL_new_term_ref();
+    bool exists =
+        put_module(module) && PL_put_functor(head, functor) &&
+        PL_cons_functor(
+            args, PL_new_functor(PL_new_atom(":"), 2), module, head) &&
+        PL_put_atom_chars(args + 1, "visible") &&
+        PL_call_predicate(NULL,
+                          PL_Q_CATCH_EXCEPTION | PL_Q_NODEBUG,
+                          PL_predicate("predicate_property", 2, "system"),
+                          args);
+    PL_clear_exception();
+    PL_discard_foreign_frame(fid);
+    return exists;
 }
 
 Array Prologot::list_predicates()
@@ -1099,12 +2903,33 @@ Array Prologot::list_predicates()
     if (!m_initialized)
         return predicates;
 
-    // Query for all current predicates using Prolog's built-in
-    // current_predicate/1 This returns all predicates in the form Name/Arity
-    String goal = "current_predicate(Name/Arity)";
-    Array results = query_all(goal);
+    // current_predicate/1 only enumerates the predicates of one module: the
+    // helper also lists those inherited by an overlay from its base
+    fid_t fid = PL_open_foreign_frame();
+    term_t args = PL_new_term_refs(2);
+    term_t head = PL_new_term_ref();
+    if (put_module(args) &&
+        PL_call_predicate(NULL,
+                          PL_Q_CATCH_EXCEPTION,
+                          PL_predicate("prologot_list_predicates", 2, "user"),
+                          args))
+    {
+        term_t tail = PL_copy_term_ref(args + 1);
+        while (PL_get_list(tail, head, tail))
+        {
+            predicates.push_back(term_to_variant(head));
+        }
+    }
+    PL_clear_exception();
+    PL_discard_foreign_frame(fid);
+    return predicates;
+}
 
-    return results;
+bool Prologot::put_module(term_t r_module) const
+{
+    if (m_module == NULL)
+        return PL_put_atom_chars(r_module, "user");
+    return PL_put_atom(r_module, PL_module_name(m_module));
 }
 
 // =============================================================================
@@ -1167,6 +2992,23 @@ Variant Prologot::term_to_variant(term_t p_term)
             return Array();
         }
 
+        case PL_BLOB:
+        {
+            // Packed array blob - return the referenced Packed array
+            Variant array = PackedArrayBlob::to_variant(p_term);
+            if (array.get_type() != Variant::NIL)
+                return array;
+
+            // Bitset - return one byte (0 or 1) per bit
+            Variant bits = BitsetBlob::to_variant(p_term);
+            if (bits.get_type() != Variant::NIL)
+                return bits;
+
+            // Godot object handle - return the live object (null if freed)
+            Object* object = ObjectBlob::get_object(p_term);
+            return (object != nullptr) ? Variant(object) : Variant();
+        }
+
         case PL_LIST_PAIR:
         {
             // Non-empty list [H|T] - convert to Godot Array
@@ -1303,6 +3145,15 @@ term_t Prologot::variant_to_term(Variant const& p_var)
             }
             break;
 
+        case Variant::STRING_NAME:
+        case Variant::NODE_PATH:
+            // Node names, signal names and paths are atoms like Strings
+            if (!PL_put_atom_chars(t, ((String)p_var).utf8().get_data()))
+            {
+                return (term_t)0;
+            }
+            break;
+
         case Variant::ARRAY:
         {
             // Array becomes Prolog list [elem1, elem2, ...]
@@ -1395,6 +3246,53 @@ term_t Prologot::variant_to_term(Variant const& p_var)
             break;
         }
 
+        case Variant::PACKED_BYTE_ARRAY:
+        case Variant::PACKED_INT32_ARRAY:
+        case Variant::PACKED_INT64_ARRAY:
+        case Variant::PACKED_FLOAT32_ARRAY:
+        case Variant::PACKED_FLOAT64_ARRAY:
+            // Numeric buffers are referenced, not converted to lists
+            if (!PackedArrayBlob::put(t, p_var))
+            {
+                return (term_t)0;
+            }
+            break;
+
+        case Variant::OBJECT:
+        {
+            // Objects become opaque handles holding their ObjectID so that
+            // Prolog can pass them around and give them back as is
+            // Images are data: their pixels are referenced like Packed arrays
+            // and BitMaps become bitsets
+            Object* object = p_var;
+            Image* image = Object::cast_to<Image>(object);
+            if (image != nullptr && PackedArrayBlob::put_image(t, image))
+            {
+                break;
+            }
+            BitMap* bitmap = Object::cast_to<BitMap>(object);
+            if (bitmap != nullptr)
+            {
+                if (!BitsetBlob::put_bitmap(t, bitmap))
+                {
+                    return (term_t)0;
+                }
+                break;
+            }
+            if (object != nullptr)
+            {
+                if (!ObjectBlob::put(t, object))
+                {
+                    return (term_t)0;
+                }
+            }
+            else if (!PL_put_atom_chars(t, "[]"))
+            {
+                return (term_t)0; // Null object, like Variant::NIL
+            }
+            break;
+        }
+
         default:
             // Unknown or unsupported types become empty list atom
             // This provides a safe fallback for unexpected types
@@ -1407,60 +3305,115 @@ term_t Prologot::variant_to_term(Variant const& p_var)
     return t;
 }
 
+int64_t Prologot::statistics_value(const char* p_key)
+{
+    fid_t fid = PL_open_foreign_frame();
+    term_t args = PL_new_term_refs(2);
+    int64_t value = 0;
+    if (!PL_put_atom_chars(args, p_key) ||
+        !PL_call_predicate(NULL,
+                           PL_Q_NODEBUG | PL_Q_CATCH_EXCEPTION,
+                           PL_predicate("statistics", 2, "system"),
+                           args) ||
+        !PL_get_int64(args + 1, &value))
+    {
+        value = 0;
+    }
+    PL_discard_foreign_frame(fid);
+    return value;
+}
+
 // =============================================================================
 // Exception Handling
 // =============================================================================
 
-void Prologot::push_error(String const& p_message, String const& p_type)
+ErrorRecord Prologot::make_error_record(String const& p_message,
+                                        String const& p_type,
+                                        String const& p_context,
+                                        String const& p_goal)
+{
+    ErrorRecord record;
+    record.type = p_type;
+    record.context = p_context;
+    record.goal = p_goal;
+    record.message = p_message;
+    record.thread = OS::get_singleton()->get_thread_caller_id();
+    return record;
+}
+
+void Prologot::set_last_error(String const& p_message,
+                              String const& p_type,
+                              String const& p_context,
+                              String const& p_goal)
+{
+    m_errors.add(make_error_record(p_message, p_type, p_context, p_goal));
+}
+
+void Prologot::push_error(String const& p_message,
+                          String const& p_type,
+                          String const& p_context,
+                          String const& p_goal)
+{
+    report_error(make_error_record(p_message, p_type, p_context, p_goal));
+}
+
+void Prologot::report_error(ErrorRecord const& p_record)
 {
-    // Store error in m_last_error
-    m_last_error = p_message;
+    m_errors.add(p_record);
 
     // Determine which option to check
-    String option = (p_type == "warning") ? m_on_warning : m_on_error;
+    String option = (p_record.type == "warning") ? m_on_warning : m_on_error;
 
-    // Handle according to option
-    if (option == "print")
-    {
-        godot::UtilityFunctions::push_error("Prologot: " + p_message);
-    }
-    else if (option == "halt")
-    {
-        godot::UtilityFunctions::push_error("Prologot: " + p_message);
+    // "status" option: only store the error record, don't print. The
+    // message of an exception is then only written if it is asked for.
+    if (option != "print" && option != "halt")
+        return;
 
+    // Printing is thread-safe in Godot; quitting is not, so a thread other
+    // than the main one defers it
+    godot::UtilityFunctions::push_error("Prologot: " + p_record.get_message());
+    if (option == "halt")
+    {
         // Quit the application
         Engine* engine = Engine::get_singleton();
         if (engine)
         {
             SceneTree* scene_tree =
                 Object::cast_to<SceneTree>(engine->get_main_loop());
-            if (scene_tree)
+            OS* os = OS::get_singleton();
+            if (scene_tree &&
+                os->get_thread_caller_id() == os->get_main_thread_id())
             {
                 scene_tree->quit(1);
             }
+            else if (scene_tree)
+            {
+                callable_mp(scene_tree, &SceneTree::quit).call_deferred(1);
+            }
         }
     }
-    // "status" option: only store in m_last_error, don't print
 }
 
-bool Prologot::handle_prolog_exception(qid_t p_qid, String const& p_context)
+bool Prologot::handle_prolog_exception(qid_t p_qid,
+                                       String const& p_context,
+                                       String const& p_goal)
 {
     term_t exception = PL_exception(p_qid);
-    if (exception)
-    {
-        char* exception_str;
-        if (PL_get_chars(exception,
-                         &exception_str,
-                         CVT_WRITE | CVT_EXCEPTION | BUF_DISCARDABLE))
-        {
-            String error_msg =
-                p_context + String(" error: ") + String(exception_str);
-            push_error(error_msg, "error");
-            return true;
-        }
+    if (!exception)
         return false;
+
+    // The term is recorded rather than written: get_last_error() and
+    // get_last_exception() format it when called
+    ErrorRecord record =
+        make_error_record(String(), "error", p_context, p_goal);
+    record.set_exception(exception);
+    if (!m_initialized)
+    {
+        // Startup failed: Prolog may be shut down before the term is read
+        record.resolve();
     }
-    return false;
+    report_error(record);
+    return true;
 }
 
 // =============================================================================
@@ -1474,5 +3427,49 @@ Prologot* Prologot::get_singleton()
 
 String Prologot::get_last_error() const
 {
-    return m_last_error;
+    ErrorRecord record;
+    if (!m_errors.last(OS::get_singleton()->get_thread_caller_id(), record))
+        return String();
+    return record.get_message();
+}
+
+Dictionary Prologot::get_last_error_info() const
+{
+    ErrorRecord record;
+    if (!m_errors.last(OS::get_singleton()->get_thread_caller_id(), record))
+        return Dictionary();
+    return record.to_dictionary();
+}
+
+Dictionary Prologot::get_last_exception() const
+{
+    ErrorRecord record;
+    if (!m_errors.last(OS::get_singleton()->get_thread_caller_id(), record))
+        return Dictionary();
+    return record.exception_to_dictionary();
+}
+
+Array Prologot::take_errors()
+{
+    int64_t dropped = 0;
+    Array records = m_errors.take_pending(dropped);
+    if (dropped > 0)
+    {
+        ErrorRecord record;
+        record.type = "warning";
+        record.context = "Error queue";
+        record.message = String::num_int64(dropped) +
+                         " older errors were dropped (queue full)";
+        record.thread = OS::get_singleton()->get_main_thread_id();
+        records.push_front(record.to_dictionary());
+    }
+    return records;
+}
+
+Dictionary Prologot::take_output()
+{
+    if (!m_initialized || !m_output)
+        return Dictionary();
+
+    return m_output->take();
 }
@@ -10,15 +10,36 @@
 
 #pragma once
 
+#include "ChrStore.hpp"
+#include "EnginePool.hpp"
+#include "ErrorLog.hpp"
+#include "ForwardRules.hpp"
+#include "GoapPlanner.hpp"
+#include "OutputCapture.hpp"
+#include "SceneTreeMirror.hpp"
+#include "TimerWheel.hpp"
 #include <SWI-Prolog.h>
+#include <godot_cpp/classes/node.hpp>
 #include <godot_cpp/classes/ref_counted.hpp>
 #include <godot_cpp/variant/array.hpp>
 #include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_int64_array.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
 #include <godot_cpp/variant/string.hpp>
 #include <godot_cpp/variant/variant.hpp>
 
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 using namespace godot;
 
+class ParallelCall;
+class QueryCursor;
+
 /**
  * @class Prologot
  * @brief Main class providing SWI-Prolog integration for Godot 4.
@@ -71,7 +92,11 @@ public:
      * 2. Parses the options Dictionary for configuration settings
      * 3. Sets up the SWI-Prolog home directory if provided
      * 4. Initializes the Prolog engine with the specified options
-     * 5. Bootstraps helper predicates needed for consult_string()
+     * 5. Attaches packs, then bootstraps helper predicates needed for
+     *    consult_string()
+     * 6. Loads the script file and runs the startup goals
+     *
+     * Each of these phases is timed, see get_startup_profile().
      *
      * The bootstrap predicates enable loading Prolog code from strings by:
      * - Parsing multi-line Prolog code into individual clauses
@@ -104,6 +129,23 @@ public:
      *     - "prolog flags" (Dictionary): Define Prolog flags
      *     - "file search paths" (Dictionary): Define file search paths
      *     - "custom args" (Array): Additional custom arguments
+     *   Diagnostics:
+     *     - "profile startup" (bool): Print the startup timing breakdown
+     *   Modules:
+     *     - "base module" (String): Module whose predicates are inherited by
+     *       the module of this instance (a shared read-only base)
+     *     - "module" (String): Module of this instance (default: "user", or a
+     *       generated overlay name when "base module" is given)
+     *     - "overlay predicates" (PackedStringArray): Dynamic predicates of
+     *       the base whose clauses belong to each overlay, even when called
+     *       by base rules (only these base predicates are changed)
+     *
+     * SWI-Prolog is started by the first initialized instance only: the next
+     * instances share it and ignore the engine options (all but "on error",
+     * "on warning", "script file", "goal", "profile startup" and the module
+     * options). The queries, facts and consulted code of an instance go to
+     * its module, so instances with their own module do not see each
+     * other's dynamic facts.
      *
      * @return true if initialization succeeded, false otherwise.
      */
@@ -115,6 +157,9 @@ public:
      * This method is safe to call multiple times. It only performs cleanup
      * if the engine was actually initialized. After cleanup, the engine
      * must be re-initialized before use.
+     *
+     * The module created for the instance is emptied. Prolog itself is
+     * shut down with the last initialized instance.
      */
     void cleanup();
 
@@ -125,6 +170,27 @@ public:
      */
     bool is_initialized() const;
 
+    /**
+     * @brief Gets the timing breakdown of the last initialize() call.
+     *
+     * Durations are measured with a monotonic clock and stored in the order
+     * the phases ran: "home dir", "arguments", "PL_initialise", "packs",
+     * "home flag", "bootstrap", "module", "script file", "goals" and "total".
+     * With an "init file" or a "toplevel", which may use pack libraries,
+     * "PL_initialise + packs" replaces "PL_initialise" and "packs".
+     * Phases that were not reached (because initialization failed) are
+     * missing, as well as the phases up to "bootstrap" when the Prolog engine
+     * was already started by another instance.
+     *
+     * @return Dictionary mapping phase names to durations in microseconds.
+     *
+     * @example
+     * prolog.initialize({"script file": "res://ai/rules.pl"})
+     * var profile = prolog.get_startup_profile()
+     * print(profile["PL_initialise"], " us to start SWI-Prolog")
+     */
+    Dictionary get_startup_profile() const;
+
     // =========================================================================
     // File and Code Consultation
     // =========================================================================
@@ -292,7 +358,8 @@ public:
     /**
      * @brief Gets the last error message from Prolog.
      *
-     * This method returns the last error message stored in m_last_error.
+     * This method returns the message of the last error raised on the
+     * calling thread: errors raised by other threads do not overwrite it.
      * Note: This method does not call push_error(). Errors are automatically
      * handled according to the "on error" and "on warning" options set during
      * initialization. Use this method to retrieve error messages for custom
@@ -302,6 +369,61 @@ public:
      */
     String get_last_error() const;
 
+    /**
+     * @brief Gets the last error raised on the calling thread as a record.
+     *
+     * @return {"type", "context", "goal", "message", "thread"}: "error" or
+     * "warning", what was running (e.g., "Query"), the goal, fact or file
+     * concerned, the message returned by get_last_error() and the id of the
+     * thread. Empty if the thread raised no error.
+     */
+    Dictionary get_last_error_info() const;
+
+    /**
+     * @brief Decomposes the Prolog exception of the last error raised on the
+     * calling thread.
+     *
+     * Exceptions are recorded as terms and only written when this method or
+     * get_last_error() asks for them, so loops whose calls raise on purpose
+     * (with the "status" option) do not pay for formatting.
+     *
+     * @return get_last_error_info() plus "kind" (e.g., "type_error",
+     * "existence_error", or "throw" for a term that is not error/2),
+     * "culprit", "detail" and "term" (see ErrorRecord). Empty if the last
+     * error is not a Prolog exception.
+     */
+    Dictionary get_last_exception() const;
+
+    /**
+     * @brief Takes the errors raised by all the threads since the previous
+     * call, oldest first.
+     *
+     * Errors raised by worker threads are queued here for the main thread,
+     * which typically polls this method once per frame. The queue keeps the
+     * last ErrorLog::MAX_PENDING records; when older ones were dropped, the
+     * first record is a warning telling how many.
+     *
+     * @return Array of records as returned by get_last_error_info().
+     */
+    Array take_errors();
+
+    /**
+     * @brief Takes the text written by the engines of this instance since
+     * the previous call, when its "output buffer" option captures it (see
+     * OutputCapture).
+     *
+     * With the "output flush" option left to true, the text is printed to
+     * Godot's output once per frame, so this method only gets what was
+     * written since the last frame. The engine of the main thread is
+     * captured by the first instance asking for it only.
+     *
+     * @return {"output": String, "error": String, "dropped": int}: the text
+     * written to user_output (format/2, writeln/1, ...) and to user_error
+     * (print_message/2, warnings), and the number of bytes dropped because
+     * a buffer was full.
+     */
+    Dictionary take_output();
+
     // =========================================================================
     // Dynamic Assertions
     // =========================================================================
@@ -323,9 +445,45 @@ public:
      * prolog.add_fact("parent(tom, bob)")
      * prolog.add_fact("game_state(level, 5)")
      * # Note: "parent(tom, bob)." also works (period is removed automatically)
+     *
+     * The new fact is matched against the forward rules (see
+     * add_forward_rule()).
      */
     bool add_fact(String const& p_fact);
 
+    /**
+     * @brief Adds a fact that is retracted after a delay.
+     *
+     * Meant for short-lived knowledge such as perception memory. Expiring
+     * facts are kept in a hierarchical timer wheel and retracted in a batch
+     * by tick(), at a cost proportional to the expired facts: the fact base
+     * is never scanned. Like add_fact(), the fact is matched against the
+     * forward rules.
+     *
+     * @param p_fact The Prolog fact to add.
+     * @param p_seconds Lifetime of the fact in seconds (10 ms resolution).
+     * @return true if the fact was added successfully, false otherwise.
+     *
+     * @example
+     * prolog.add_fact_ttl("saw(player, 12, 7)", 5.0)
+     */
+    bool add_fact_ttl(String const& p_fact, double p_seconds);
+
+    /**
+     * @brief Advances the clock of add_fact_ttl() and retracts the facts
+     * that expired.
+     *
+     * A fact already retracted by other means is ignored.
+     *
+     * @param p_delta Elapsed time in seconds, typically the frame delta.
+     * @return Number of facts retracted.
+     *
+     * @example
+     * func _process(delta):
+     *     prolog.tick(delta)
+     */
+    int64_t tick(double p_delta);
+
     /**
      * @brief Removes a fact from the Prolog knowledge base.
      *
@@ -368,6 +526,711 @@ public:
      */
     bool retract_all(String const& p_functor);
 
+    // =========================================================================
+    // Fact Tables
+    // =========================================================================
+
+    /**
+     * @brief Creates a native fact table served as a Prolog predicate.
+     *
+     * Large regular fact sets (e.g., one tile(X, Y, Type, Cost) fact per map
+     * cell) are stored as typed columns instead of compiled clauses, which
+     * takes far less memory and loads from Packed arrays in a single pass.
+     * The predicate p_functor/N (N = number of columns) is then callable
+     * from any Prolog rule. Bound arguments on indexed columns are resolved
+     * through a hash index instead of a full scan.
+     *
+     * Creating a table replaces any table with the same functor, and any
+     * clause previously defined for p_functor/N. A failed call (invalid
+     * types, indexes or rows) leaves the existing table in place.
+     *
+     * @param p_functor Functor name of the facts (e.g., "tile").
+     * @param p_column_types Type of each column: "int", "float" or "atom".
+     * @param p_columns Optional initial rows, one array per column (see
+     * append_fact_table()).
+     * @param p_indexes Optional 0-based columns to hash-index.
+     * @return true if the table was created, false otherwise.
+     *
+     * @example
+     * prolog.create_fact_table("tile", ["int", "int", "atom", "float"],
+     *     [xs, ys, types, costs],  # PackedInt32Array, ..., PackedFloat32Array
+     *     [0, 1])                  # Index X and Y
+     * prolog.query_all("tile(3, 4, Type, Cost)")
+     */
+    bool create_fact_table(String const& p_functor,
+                           PackedStringArray const& p_column_types,
+                           Array const& p_columns = Array(),
+                           PackedInt32Array const& p_indexes =
+                               PackedInt32Array());
+
+    /**
+     * @brief Appends rows to a fact table.
+     *
+     * Rows are given column by column: "int" columns accept
+     * PackedInt32Array, PackedInt64Array or Array; "float" columns accept
+     * PackedFloat32Array, PackedFloat64Array or Array; "atom" columns accept
+     * PackedStringArray or Array. All columns must have the same length.
+     * Nothing is appended if a column is invalid.
+     *
+     * @param p_functor Functor name of the table.
+     * @param p_columns One array per column.
+     * @return true if the rows were appended, false otherwise.
+     */
+    bool append_fact_table(String const& p_functor, Array const& p_columns);
+
+    /**
+     * @brief Removes the rows of a fact table matching a key.
+     *
+     * The key gives the values of the first columns; null values match any
+     * cell. This allows updating rows in place: remove them, then append
+     * the new values.
+     *
+     * @param p_functor Functor name of the table.
+     * @param p_key Values of the first columns.
+     * @return The number of rows removed, or -1 on error.
+     *
+     * @example
+     * prolog.remove_fact_table_rows("tile", [3, 4])  # tile(3, 4, _, _)
+     * prolog.append_fact_table("tile", [[3], [4], ["lava"], [10.0]])
+     */
+    int64_t remove_fact_table_rows(String const& p_functor,
+                                   Array const& p_key);
+
+    /**
+     * @brief Drops a fact table and frees its rows.
+     *
+     * The predicate stays defined but has no more solution.
+     *
+     * @param p_functor Functor name of the table.
+     * @return true if a table was dropped, false if there was none.
+     */
+    bool drop_fact_table(String const& p_functor);
+
+    /**
+     * @brief Gets the number of rows of a fact table.
+     *
+     * @param p_functor Functor name of the table.
+     * @param p_stored Also count the removed rows whose memory has not been
+     * reclaimed yet.
+     * @return The number of rows, or -1 if there is no such table.
+     */
+    int64_t get_fact_table_size(String const& p_functor,
+                                bool p_stored = false) const;
+
+    /**
+     * @brief Saves a fact table to a binary fact file.
+     *
+     * The file can be memory-mapped later with map_fact_file(), typically
+     * to ship a large pre-built world with the game.
+     *
+     * @param p_functor Functor name of the table.
+     * @param p_path File path (supports res:// and user://).
+     * @return true if the file was written, false otherwise.
+     */
+    bool save_fact_table(String const& p_functor, String const& p_path);
+
+    /**
+     * @brief Memory-maps a binary fact file as a read-only fact table.
+     *
+     * The rows are not parsed nor copied: they are served from the file
+     * pages, loaded on demand by the OS and shared between processes. The
+     * table is named after the functor stored in the file and replaces any
+     * table with the same name. Rows cannot be appended to it.
+     *
+     * The file must be a regular file on disk: res:// paths work in the
+     * editor but not from inside an exported PCK.
+     *
+     * @param p_path File path (supports res:// and user://).
+     * @param p_indexes Optional 0-based columns to hash-index (built at
+     * load time by reading the whole column).
+     * @return true if the file was mapped, false otherwise.
+     */
+    bool map_fact_file(String const& p_path,
+                       PackedInt32Array const& p_indexes = PackedInt32Array());
+
+    // =========================================================================
+    // Bulk Loading
+    // =========================================================================
+
+    /**
+     * @brief Loads the rows of a CSV file as Prolog facts.
+     *
+     * The file is parsed natively and each row is asserted as a
+     * p_functor/N fact without going through the Prolog parser. Column
+     * types are "int", "float", "atom", "string" or "auto"; undeclared
+     * types are inferred from the whole column (int, then float, then
+     * atom). Nothing is asserted if a row is invalid.
+     *
+     * @param p_path File path (supports res:// and user://).
+     * @param p_functor Functor of the facts.
+     * @param p_column_types Optional type of each column.
+     * @param p_options Optional settings:
+     * - "header" (bool, default: true): skip the first line.
+     * - "separator" (String, default: ","): field separator.
+     * @return The number of facts asserted, or -1 on error.
+     *
+     * @example
+     * # items.csv: id,name,price
+     * prolog.load_csv_facts("res://data/items.csv", "item",
+     *     ["int", "atom", "float"])
+     * prolog.query("item(3, Name, Price)")
+     */
+    int64_t load_csv_facts(String const& p_path,
+                           String const& p_functor,
+                           PackedStringArray const& p_column_types =
+                               PackedStringArray(),
+                           Dictionary const& p_options = Dictionary());
+
+    /**
+     * @brief Loads the objects of a JSON file as Prolog facts.
+     *
+     * The file must hold an array of objects (or an object whose p_mapping
+     * "root" member is that array). Each object is asserted as one fact
+     * whose arguments are the values of the mapped fields. Numbers map to
+     * integers or floats, strings to atoms, true/false/null to atoms and
+     * arrays to lists, unless "types" says otherwise. Nothing is asserted
+     * if an object is invalid.
+     *
+     * @param p_path File path (supports res:// and user://).
+     * @param p_mapping Mapping settings:
+     * - "functor" (String): functor of the facts.
+     * - "fields" (PackedStringArray): object member of each argument.
+     * - "types" (PackedStringArray, optional): type of each argument.
+     * - "root" (String, optional): member holding the array of objects.
+     * @return The number of facts asserted, or -1 on error.
+     *
+     * @example
+     * prolog.load_json_facts("res://data/monsters.json",
+     *     {"functor": "monster", "fields": ["name", "hp", "tags"]})
+     */
+    int64_t load_json_facts(String const& p_path,
+                            Dictionary const& p_mapping);
+
+    /**
+     * @brief Stores the used cells of a TileMapLayer or a GridMap as facts.
+     *
+     * The cells are read natively (a TileMapLayer in a single call) and
+     * stored as one p_functor/N fact per cell, either as asserted clauses
+     * or as the rows of a fact table indexed on the coordinates. A new
+     * import replaces the facts of the previous one; changed cells are
+     * then updated with sync_tilemap_cells().
+     *
+     * @param p_map TileMapLayer or GridMap.
+     * @param p_functor Functor of the facts.
+     * @param p_options Optional settings:
+     * - "fields" (PackedStringArray): argument of each field. TileMapLayer:
+     *   "x", "y", "source", "atlas_x", "atlas_y", "alternative" and
+     *   "data:<layer>" for a custom data layer (default: x, y, source,
+     *   atlas_x, atlas_y). GridMap: "x", "y", "z", "item", "orientation"
+     *   (default: x, y, z, item). Coordinates are mandatory.
+     * - "table" (bool, default: false): store the cells in a fact table.
+     * - "indexes" (PackedInt32Array): fact table columns to index
+     *   (default: the coordinates).
+     * @return The number of facts, or -1 on error.
+     *
+     * @example
+     * prolog.import_tilemap($Ground, "tile",
+     *     {"fields": ["x", "y", "data:terrain"], "table": true})
+     * prolog.query("tile(3, 4, Terrain)")
+     */
+    int64_t import_tilemap(Node* p_map,
+                           String const& p_functor,
+                           Dictionary const& p_options = Dictionary());
+
+    /**
+     * @brief Updates the facts of cells changed since import_tilemap().
+     *
+     * Only the listed cells are read again: their facts are removed, and
+     * added back with the new values unless the cell was erased.
+     *
+     * @param p_map Map given to import_tilemap().
+     * @param p_functor Functor given to import_tilemap().
+     * @param p_cells Coordinates of the changed cells (Vector2i for a
+     * TileMapLayer, Vector3i for a GridMap).
+     * @return The number of cells updated, or -1 on error.
+     *
+     * @example
+     * $Ground.set_cell(Vector2i(3, 4), 0, Vector2i(2, 0))
+     * prolog.sync_tilemap_cells($Ground, "tile", [Vector2i(3, 4)])
+     */
+    int64_t sync_tilemap_cells(Node* p_map,
+                               String const& p_functor,
+                               Array const& p_cells);
+
+    // =========================================================================
+    // Scene Tree Mirroring
+    // =========================================================================
+
+    /**
+     * @brief Mirrors a subtree of the scene tree as facts kept up to date.
+     *
+     * Asserts node_type(Node, Class) for each node, parent(Node, Parent)
+     * for each node but the root and in_group(Node, Group) for each user
+     * group, nodes being object handles. The SceneTree node_added and
+     * node_removed signals then update the facts of the nodes entering or
+     * leaving the subtree one by one. Group changes have no signal: call
+     * mirror_update_groups() after add_to_group() or remove_from_group().
+     *
+     * A new mirror replaces the previous one; the mirror stops when its root
+     * leaves the tree.
+     *
+     * @param p_root Root of the subtree (must be inside the scene tree).
+     * @return The number of nodes mirrored, or -1 on error.
+     *
+     * @example
+     * prolog.mirror_scene_tree($Level)
+     * prolog.query_all("in_group(N, enemies), parent(N, P), node_type(P, T)")
+     */
+    int64_t mirror_scene_tree(Node* p_root);
+
+    /**
+     * @brief Replaces the in_group/2 facts of a mirrored node by its
+     * current groups.
+     *
+     * @param p_node Node of the mirrored subtree.
+     * @return true on success, false if the node is not mirrored.
+     */
+    bool mirror_update_groups(Node* p_node);
+
+    /**
+     * @brief Stops mirroring and retracts the node_type/2, parent/2 and
+     * in_group/2 facts.
+     */
+    void unmirror_scene_tree();
+
+    // =========================================================================
+    // Planning
+    // =========================================================================
+
+    /**
+     * @brief Finds the cheapest sequence of actions reaching a goal (GOAP).
+     *
+     * Actions are the solutions of action(Name, Preconditions, AddList,
+     * DeleteList, Cost) and states are sets of ground terms. The A* search
+     * runs natively; plans are cached by state, goal and options.
+     *
+     * @param p_state Propositions true initially, as term texts.
+     * @param p_goal Propositions to make true, as term texts.
+     * @param p_options Optional settings:
+     * - "actions" (String): action predicate of arity 5 (default: "action").
+     * - "heuristic" (String): predicate Name(+State, +Goal, -H) estimating
+     *   the remaining cost (default: number of unmet goals).
+     * - "max_nodes" (int): expansion limit, 0 for none (default: 10000).
+     * - "cache" (bool): use the plan cache (default: true).
+     * @return The action names, empty if the goal holds or there is no
+     * plan.
+     *
+     * @example
+     * prolog.plan(["at(home)"], ["has(wood)"])  # ["go(forest)", "chop"]
+     */
+    PackedStringArray plan(Array const& p_state,
+                           Array const& p_goal,
+                           Dictionary const& p_options = Dictionary());
+
+    /**
+     * @brief Starts a planning search continued by plan_step().
+     *
+     * @param p_state Propositions true initially, as term texts.
+     * @param p_goal Propositions to make true, as term texts.
+     * @param p_options Same options as plan().
+     * @return The search id, or -1 on error.
+     */
+    int64_t plan_start(Array const& p_state,
+                       Array const& p_goal,
+                       Dictionary const& p_options = Dictionary());
+
+    /**
+     * @brief Continues a planning search within a time budget.
+     *
+     * @param p_id Search id returned by plan_start().
+     * @param p_budget_usec Time budget in microseconds (0 for no limit).
+     * @return 1 when a plan is found, 0 while searching, -1 when there is
+     * no plan or on error.
+     *
+     * @example
+     * # In _process(): 200 µs of planning per frame
+     * if prolog.plan_step(search, 200) != 0:
+     *     actions = prolog.plan_result(search)
+     */
+    int plan_step(int64_t p_id, int64_t p_budget_usec);
+
+    /**
+     * @brief Gets the plan of a search and releases the search.
+     *
+     * @param p_id Search id returned by plan_start().
+     * @return The action names, empty if no plan was found.
+     */
+    PackedStringArray plan_result(int64_t p_id);
+
+    /**
+     * @brief Forgets the cached plans and actions. Call it after changing
+     * the action definitions.
+     */
+    void clear_plan_cache();
+
+    // =========================================================================
+    // Constraint Solving
+    // =========================================================================
+
+    /**
+     * @brief Solves a CLP(FD) problem under a time or inference budget.
+     *
+     * Posts a variable per p_domains entry, then the constraints, and
+     * labels the variables. When a limit stops the search, the solutions
+     * found so far are returned and get_last_error() tells which limit was
+     * exceeded.
+     *
+     * @param p_domains Variable name (Prolog variable syntax) -> domain:
+     * Vector2i(min, max), array of allowed integers or CLP(FD) domain text
+     * such as "1..5 \/ 10..sup".
+     * @param p_constraints CLP(FD) constraints over the variable names
+     * (e.g. "A + B #= C", "all_distinct([A, B, C])").
+     * @param p_options Optional settings:
+     * - "labeling" (PackedStringArray): labeling/2 options (e.g. ["ff"]).
+     * - "solutions" (int): maximum number of solutions, 0 for all
+     *   (default: 1).
+     * - "time_limit" (float): time limit in seconds.
+     * - "inference_limit" (int): inference limit.
+     * @return The values of the variables in p_domains order, solution
+     * after solution; empty if there is no solution or on error.
+     *
+     * @example
+     * prolog.clpfd_solve({"A": Vector2i(0, 9), "B": Vector2i(0, 9)},
+     *     ["A + B #= 10", "A #> B"], {"labeling": ["down"]})  # [9, 1]
+     */
+    PackedInt64Array
+    clpfd_solve(Dictionary const& p_domains,
+                PackedStringArray const& p_constraints,
+                Dictionary const& p_options = Dictionary());
+
+    // =========================================================================
+    // Forward Rules
+    // =========================================================================
+
+    /**
+     * @brief Adds a forward-chaining rule fired by the facts added with
+     * add_fact(), add_fact_ttl(), consult_string(), the fact loaders, the
+     * tile map import and the scene tree mirror (not by consult_file() nor
+     * by assertz/1 called from Prolog).
+     *
+     * When a new fact unifies with a condition, the other conditions are
+     * called with its bindings; each solution fires the rule. Firings are
+     * batched and delivered once per frame by the forward_rules_fired
+     * signal. Only the rules with a condition on the functor of the new fact
+     * are evaluated.
+     *
+     * @param p_name Rule name (replaces the rule with the same name).
+     * @param p_conditions Conditions sharing their variables.
+     * @param p_options Optional settings:
+     * - "assert" (String): fact asserted for each firing, using the rule
+     *   variables. Derived facts fire the rules in turn unless they already
+     *   exist.
+     * - "notify" (bool): report the firings in the signal (default: true).
+     * @return true if the rule was added, false otherwise.
+     *
+     * @example
+     * prolog.add_forward_rule("ambush", ["enemy_in(E, R)", "player_in(R)"])
+     * prolog.forward_rules_fired.connect(_on_rules_fired)
+     * prolog.add_fact("player_in(hall)")  # Fires for each enemy in hall
+     */
+    bool add_forward_rule(String const& p_name,
+                          PackedStringArray const& p_conditions,
+                          Dictionary const& p_options = Dictionary());
+
+    /**
+     * @brief Removes a forward rule.
+     *
+     * @param p_name Rule name.
+     * @return true if the rule existed.
+     */
+    bool remove_forward_rule(String const& p_name);
+
+    /**
+     * @brief Emits forward_rules_fired now with the pending firings instead
+     * of waiting for the end of the frame.
+     */
+    void flush_forward_rules();
+
+    // =========================================================================
+    // Constraint Handling Rules
+    // =========================================================================
+
+    /**
+     * @brief Loads CHR rules into the user module.
+     *
+     * The code is compiled by the CHR compiler (library(chr) is imported
+     * automatically). Each call replaces all the rules of the previous call,
+     * which are compiled as the same source: give all the rules at once.
+     * Call chr_reset() if the store holds constraints of the previous rules.
+     *
+     * @param p_code CHR program text.
+     * @return true on success, false otherwise.
+     *
+     * @example
+     * prolog.chr_consult("""
+     *     :- chr_constraint item/1, craft/0.
+     *     item(wood), item(wood) <=> item(plank).
+     * """)
+     */
+    bool chr_consult(String const& p_code);
+
+    /**
+     * @brief Adds constraints to the persistent store.
+     *
+     * The store persists across calls, so the rules only propagate the new
+     * constraints. The constraints are added all at once: if they fail
+     * (inconsistent with the store), none is added.
+     *
+     * @param p_constraints Constraint texts.
+     * @return true if the constraints were added, false otherwise.
+     *
+     * @example
+     * prolog.chr_add(["item(wood)", "item(wood)"])
+     */
+    bool chr_add(PackedStringArray const& p_constraints);
+
+    /**
+     * @brief Gets the constraints of the store.
+     *
+     * @param p_name Constraint name to select, empty for all.
+     * @return The constraints converted like query results.
+     */
+    Array chr_get_store(String const& p_name = "");
+
+    /**
+     * @brief Saves the store as constraint texts (e.g. in a save game).
+     *
+     * @return The constraints, as texts accepted by chr_add().
+     */
+    PackedStringArray chr_snapshot();
+
+    /**
+     * @brief Replaces the store by a snapshot.
+     *
+     * The constraints are added again, so the propagation rules fire again.
+     * The current store is kept if the snapshot is invalid or inconsistent.
+     *
+     * @param p_snapshot Result of chr_snapshot().
+     * @return true on success, false otherwise.
+     */
+    bool chr_restore(PackedStringArray const& p_snapshot);
+
+    /**
+     * @brief Empties the store. The rules stay loaded.
+     */
+    void chr_reset();
+
+    // =========================================================================
+    // Blackboard
+    // =========================================================================
+
+    /**
+     * @brief Sets a blackboard value.
+     *
+     * Meant for values changing many times per frame (HP, current tick...):
+     * an update costs O(1) and creates no clause to garbage collect, unlike
+     * retract_all() followed by add_fact(). Rules read the value with
+     * bb_get(Key, Value). An overlay instance has its own keys, not shared
+     * with its base or with the other overlays.
+     *
+     * @param p_key Key name (an atom in Prolog).
+     * @param p_value Value, converted like query arguments.
+     * @return true on success, false if the value cannot be converted.
+     *
+     * @example
+     * prolog.bb_set("player_hp", 42)
+     * prolog.query("bb_get(player_hp, HP), HP < 50")  # true
+     */
+    bool bb_set(String const& p_key, Variant const& p_value);
+
+    /**
+     * @brief Gets a blackboard value.
+     *
+     * @param p_key Key name.
+     * @param p_default Value returned when the key has no value.
+     * @return The value converted like query results.
+     */
+    Variant bb_get(String const& p_key, Variant const& p_default = Variant());
+
+    /**
+     * @brief Gets several blackboard values at once.
+     *
+     * @param p_keys Key names.
+     * @return Key -> value Dictionary, without the keys having no value.
+     */
+    Dictionary bb_get_many(PackedStringArray const& p_keys);
+
+    /**
+     * @brief Removes a blackboard value.
+     *
+     * @param p_key Key name.
+     * @return true if the key had a value.
+     */
+    bool bb_erase(String const& p_key);
+
+    // =========================================================================
+    // Thread-Local Scratch
+    // =========================================================================
+
+    /**
+     * @brief Declares a predicate as thread-local (see thread_local/1).
+     *
+     * Each thread sees its own clauses of a thread-local predicate, so
+     * agents evaluated on different threads never lock or garbage collect
+     * each other's working memory. Must be declared before the predicate
+     * has clauses.
+     *
+     * @param p_indicator Predicate indicator, e.g. "belief/2".
+     * @return true on success, false otherwise.
+     *
+     * @example
+     * prolog.declare_thread_local("belief/2")
+     */
+    bool declare_thread_local(String const& p_indicator);
+
+    /**
+     * @brief Runs a query with temporary thread-local facts.
+     *
+     * The facts are asserted, the goal is run like query_all(), then the
+     * clauses of all the predicates declared with declare_thread_local()
+     * are removed for the calling thread, even if the goal raised an error.
+     * The scratch facts never outlive the call nor reach other threads.
+     * Worker threads (e.g., WorkerThreadPool tasks evaluating agents) can
+     * call it concurrently: a thread without a Prolog engine borrows a
+     * pooled one.
+     *
+     * @param p_goal The goal to run.
+     * @param p_facts Facts of thread-local predicates to assert first.
+     * @return Array of solutions, as query_all().
+     *
+     * @example
+     * prolog.query_scratch("best_target(T)", ["belief(hp, 30)"])
+     */
+    Array query_scratch(String const& p_goal,
+                        PackedStringArray const& p_facts = PackedStringArray());
+
+    // =========================================================================
+    // Parallel Calls
+    // =========================================================================
+
+    /**
+     * @brief Calls a predicate on rows of arguments using WorkerThreadPool.
+     *
+     * Each row is an Array of arguments; the predicate is called with the
+     * row followed by a result variable, i.e. Name(Args..., Result). The
+     * rows are split into chunks run as a WorkerThreadPool group task, each
+     * chunk attaching a pooled Prolog engine to its thread, so Prolog work
+     * shares the cores with the rest of the job system. The calling thread
+     * waits for the results.
+     *
+     * Calls run in the module of the instance and must not depend on each
+     * other: they run concurrently, in any order. Predicates declared with
+     * declare_thread_local() have separate clauses per engine.
+     *
+     * @param p_predicate Predicate name.
+     * @param p_arg_rows Array of argument Arrays.
+     * @param p_max_threads Maximum number of concurrent tasks (0: one per
+     * processor).
+     * @return {"success": PackedByteArray, "results": Array}, in input
+     * order: 1 and the value of Result for the rows whose call succeeded, 0
+     * and null otherwise. Empty Dictionary if the call cannot run. The error
+     * of each failing row is reported by its worker thread (see
+     * take_errors()); the last error of the caller counts them.
+     *
+     * @example
+     * var out = prolog.parallel_call("threat", [[orc, hero], [elf, hero]])
+     * for i in out.results.size():
+     *     if out.success[i]:
+     *         print(out.results[i])
+     */
+    Dictionary parallel_call(String const& p_predicate,
+                             Array const& p_arg_rows,
+                             int64_t p_max_threads = 0);
+
+    // =========================================================================
+    // Query Cursors
+    // =========================================================================
+
+    /**
+     * @brief Opens a query whose solutions are fetched by query_next().
+     *
+     * The goal is parsed and its query opened in a pooled Prolog engine of
+     * its own, but no solution is computed yet. Any thread can then fetch
+     * the solutions, e.g. a WorkerThreadPool task, so that a long query
+     * does not freeze the main thread. A cursor is used by one thread at a
+     * time: concurrent calls on the same cursor wait for each other.
+     *
+     * @param p_goal Goal, as for query_all().
+     * @return Id of the cursor (> 0), or 0 on error (see get_last_error()).
+     *
+     * @example
+     * var cursor = prolog.query_open("between(1, 1000000, X)")
+     * var page = prolog.query_next(cursor, 20)
+     * print(prolog.query_stats(cursor))
+     * prolog.query_close(cursor)
+     */
+    int64_t query_open(String const& p_goal);
+
+    /**
+     * @brief Computes the next solutions of a cursor, on the calling thread.
+     *
+     * @param p_cursor Id returned by query_open().
+     * @param p_count Maximum number of solutions.
+     * @return The solutions, as returned by query_all(goal). Fewer than
+     * p_count (possibly none) once the last solution is reached, or if the
+     * goal raised an error.
+     */
+    Array query_next(int64_t p_cursor, int64_t p_count = 1);
+
+    /**
+     * @brief Gets the statistics of a cursor.
+     *
+     * @return {"goal", "solutions", "exhausted", "wall_time_usec",
+     * "inferences"}: the goal, the number of solutions fetched, whether the
+     * last one was reached, and the wall time and the inferences spent in
+     * query_next() (see QueryCursor::stats()). Empty for an unknown cursor.
+     */
+    Dictionary query_stats(int64_t p_cursor) const;
+
+    /**
+     * @brief Closes a cursor and frees its engine. Waits for a running
+     * query_next() on it.
+     *
+     * @return false if the cursor is unknown.
+     */
+    bool query_close(int64_t p_cursor);
+
+    // =========================================================================
+    // Benchmarking
+    // =========================================================================
+
+    /**
+     * @brief Measures the cost of a goal, called in a tight native loop.
+     *
+     * The goal is parsed once, then called p_warmup times without being
+     * measured (to fill caches and create tables) and p_iterations times
+     * measured. Each call is like once/1: the first solution, then its
+     * bindings are undone. The calling thread must be the main thread or a
+     * worker thread: a thread without a Prolog engine borrows a pooled one.
+     *
+     * @param p_goal Goal, as for query().
+     * @param p_iterations Number of measured calls.
+     * @param p_warmup Number of calls before the measures (0 or more).
+     * @return {"goal", "iterations", "succeeded", "mean_usec", "p50_usec",
+     * "p99_usec", "min_usec", "max_usec", "inferences_per_call",
+     * "allocated_bytes_per_call"}: times of one call in microseconds,
+     * inferences counted by statistics/2, and bytes of terms created on the
+     * global stack. Empty on error (see get_last_error()); a goal raising an
+     * exception stops the measures.
+     *
+     * @example
+     * var a = prolog.benchmark("nth1(500, List, _)", 10000)
+     * print(a.p50_usec, " us, ", a.inferences_per_call, " inferences")
+     */
+    Dictionary benchmark(String const& p_goal,
+                         int64_t p_iterations = 1000,
+                         int64_t p_warmup = 100);
+
     // =========================================================================
     // Predicate Manipulation
     // =========================================================================
@@ -415,6 +1278,45 @@ public:
      */
     Variant call_function(String const& p_predicate, Array const& p_args);
 
+    /**
+     * @brief Calls a Prolog predicate with a JSON document as argument.
+     *
+     * The JSON text is parsed natively and passed as a term (objects become
+     * dicts, arrays lists, strings strings; see json_to_term/2), without
+     * going through a Godot Dictionary. Suited to large payloads such as
+     * save data.
+     *
+     * @param p_predicate Name of the predicate, called as p_predicate(Term).
+     * @param p_json JSON text.
+     * @return true if the predicate succeeded, false otherwise (including
+     * invalid JSON).
+     *
+     * @example
+     * prolog.consult_string("load_save(D) :- get_dict(gold, D, G), "
+     *     + "retractall(gold(_)), assertz(gold(G)).")
+     * prolog.call_predicate_json("load_save",
+     *     FileAccess.get_file_as_string("user://save.json"))
+     */
+    bool call_predicate_json(String const& p_predicate, String const& p_json);
+
+    /**
+     * @brief Calls a Prolog predicate and returns its result as JSON text.
+     *
+     * Like call_function(), but the result (last argument) is serialized
+     * natively to JSON (dicts and json([Key=Value]) become objects, lists
+     * arrays; see term_to_json/2) instead of being converted to a Variant.
+     *
+     * @param p_predicate Name of the predicate to call.
+     * @param p_args Array of input arguments (result is the last argument).
+     * @return The JSON text, or an empty String if the call failed or the
+     * result has no JSON equivalent.
+     *
+     * @example
+     * var json = prolog.call_function_json("make_save", [])
+     * FileAccess.open("user://save.json", FileAccess.WRITE).store_string(json)
+     */
+    String call_function_json(String const& p_predicate, Array const& p_args);
+
     // =========================================================================
     // Introspection
     // =========================================================================
@@ -422,8 +1324,9 @@ public:
     /**
      * @brief Checks if a predicate exists with the given arity.
      *
-     * This method uses PL_predicate() to look up a predicate. If the predicate
-     * doesn't exist, PL_predicate() returns 0 (NULL).
+     * The predicate must be callable from the module of the instance:
+     * defined there, inherited (from the base module of an overlay, user or
+     * system) or autoloadable.
      *
      * @param p_predicate Name of the predicate to check.
      * @param p_arity Number of arguments the predicate should have.
@@ -434,9 +1337,9 @@ public:
     /**
      * @brief Lists all currently defined predicates.
      *
-     * This method uses Prolog's current_predicate/1 to query for all predicates
-     * currently in the knowledge base. Returns an Array of results from
-     * query_all().
+     * The predicates of the module of the instance are listed, with those
+     * it inherits from its base module and from user, as
+     * current_predicate(Name/Arity) terms.
      *
      * @return Array of Dictionary objects describing each predicate.
      *
@@ -448,6 +1351,41 @@ public:
      */
     Array list_predicates();
 
+    // =========================================================================
+    // Term Conversion (C++ only)
+    // =========================================================================
+
+    /**
+     * @brief Converts a Prolog term to a Godot Variant.
+     *
+     * Handles atoms, integers, floats, strings, lists, compound terms and
+     * Godot object handles. Static so that foreign predicates can use it.
+     *
+     * @param p_term The Prolog term to convert.
+     * @return The converted Variant.
+     */
+    static Variant term_to_variant(term_t p_term);
+
+    /**
+     * @brief Converts a Godot Variant to a Prolog term.
+     *
+     * Handles NIL, bool, int, float, String, Array, Dictionary and Object
+     * types. Static so that foreign predicates can use it.
+     *
+     * @param p_var The Variant to convert.
+     * @return The created Prolog term (0 if conversion failed).
+     */
+    static term_t variant_to_term(Variant const& p_var);
+
+    /**
+     * @brief Reads an integer value of statistics/2 (e.g., "inferences",
+     * "globalused") for the engine of the calling thread.
+     *
+     * @param p_key The statistics key.
+     * @return The value, or 0 if the key is unknown.
+     */
+    static int64_t statistics_value(const char* p_key);
+
 protected:
 
     /**
@@ -488,26 +1426,49 @@ private:
     static String resolve_godot_path(String const& p_path);
 
     /**
-     * @brief Converts a Prolog term to a Godot Variant.
-     *
-     * Internal helper method for converting Prolog data types to Godot types.
-     * Handles atoms, integers, floats, strings, lists, and compound terms.
+     * @brief Starts SWI-Prolog: builds the command line from the options,
+     * calls PL_initialise(), attaches packs and bootstraps the helper
+     * predicates. Only called by the first instance (see m_engine_users).
      *
-     * @param p_term The Prolog term to convert.
-     * @return The converted Variant.
+     * @param p_options Options given to initialize().
+     * @param p_end_phase Records the duration of a startup phase.
+     * @return true on success.
      */
-    Variant term_to_variant(term_t p_term);
+    bool start_engine(Dictionary const& p_options,
+                      std::function<void(const char*)> const& p_end_phase);
 
     /**
-     * @brief Converts a Godot Variant to a Prolog term.
+     * @brief Creates the module of the instance from the "module" and
+     * "base module" options of initialize().
      *
-     * Internal helper method for converting Godot types to Prolog terms.
-     * Handles NIL, bool, int, float, String, and Array types.
-     *
-     * @param p_var The Variant to convert.
-     * @return The created Prolog term (0 if conversion failed).
+     * @return true on success (also when the instance uses the user module).
      */
-    term_t variant_to_term(Variant const& p_var);
+    bool setup_module(Dictionary const& p_options);
+
+    /**
+     * @brief Captures the output of the engines of the instance from the
+     * "output buffer" and "output flush" options of initialize(). Failures
+     * are reported as warnings.
+     */
+    void setup_output(Dictionary const& p_options);
+
+    /**
+     * @brief Puts the name of the module of the instance in a term.
+     */
+    bool put_module(term_t r_module) const;
+
+    /**
+     * @brief Empties the overlay module of the instance, if any, and goes
+     * back to the user module.
+     */
+    void release_module();
+
+    /**
+     * @brief Registers the foreign predicates provided by the extension
+     * (json_to_term/2, term_to_json/2, ...). Called once PL_initialise()
+     * succeeded.
+     */
+    void register_foreign_predicates();
 
     /**
      * @brief Helper to create Prolog lists from Godot Arrays.
@@ -544,37 +1505,123 @@ private:
      */
     Dictionary extract_variables(term_t p_term, Array const& p_variables);
 
+    /**
+     * @brief Builds an error record raised by the calling thread.
+     */
+    static ErrorRecord make_error_record(String const& p_message,
+                                         String const& p_type,
+                                         String const& p_context,
+                                         String const& p_goal);
+
+    /**
+     * @brief Stores an error record for the calling thread without printing
+     * it (see m_errors).
+     *
+     * @param p_message The error message.
+     * @param p_type The error type ("error" or "warning").
+     * @param p_context What was running (e.g., "Query").
+     * @param p_goal The goal, fact or file concerned.
+     */
+    void set_last_error(String const& p_message,
+                        String const& p_type = "error",
+                        String const& p_context = "",
+                        String const& p_goal = "");
+
     /**
      * @brief Helper to push error messages respecting error handling options.
      *
-     * This method checks the error handling options ("on error", "on warning")
-     * and either prints the error, halts, or only stores it in m_last_error.
+     * This method stores the error record, then checks the error handling
+     * options ("on error", "on warning") and either prints the error, halts,
+     * or does nothing more (see report_error()). May be called from any
+     * thread: halting is deferred to the main thread.
      *
      * @param p_message The error message to handle.
      * @param p_type The error type ("error" or "warning").
+     * @param p_context What was running (e.g., "Query").
+     * @param p_goal The goal, fact or file concerned.
      */
-    void push_error(String const& p_message, String const& p_type = "error");
+    void push_error(String const& p_message,
+                    String const& p_type = "error",
+                    String const& p_context = "",
+                    String const& p_goal = "");
+
+    /**
+     * @brief Stores an error record, then prints it or halts according to
+     * the error handling options (see push_error()).
+     */
+    void report_error(ErrorRecord const& p_record);
 
     /**
      * @brief Helper to handle Prolog exceptions.
      *
-     * This method extracts exception information from a failed query and
-     * stores it in m_last_error, then displays it as an error message.
+     * This method records the exception term of a failed query and reports
+     * it with report_error(). The message is only written when needed: by
+     * the "print" and "halt" options, or by get_last_error().
      *
      * @param p_qid The query ID that raised the exception.
      * @param p_context Context string for error messages (e.g., "Query",
      * "Load file").
+     * @param p_goal The goal, fact or file concerned.
      * @return true if exception was handled, false if no exception occurred.
      */
-    bool handle_prolog_exception(qid_t p_qid, String const& p_context);
+    bool handle_prolog_exception(qid_t p_qid,
+                                 String const& p_context,
+                                 String const& p_goal = "");
+
+    /**
+     * @brief Removes the clauses of thread-local predicates for the calling
+     * thread.
+     *
+     * @param p_functors Predicates declared with declare_thread_local().
+     */
+    void clear_thread_locals(std::vector<functor_t> const& p_functors);
+
+    /**
+     * @brief Gets a cursor opened by query_open(), or null.
+     */
+    std::shared_ptr<QueryCursor> find_cursor(int64_t p_cursor) const;
+
+    /**
+     * @brief WorkerThreadPool task of parallel_call(): runs a chunk of the
+     * running call.
+     */
+    void run_parallel_chunk(uint32_t p_chunk);
+
+    /**
+     * @brief SceneTree node_added handler of the scene tree mirror.
+     */
+    void on_mirror_node_added(Node* p_node);
+
+    /**
+     * @brief SceneTree node_removed handler of the scene tree mirror.
+     */
+    void on_mirror_node_removed(Node* p_node);
+
+    /**
+     * @brief Disconnects the scene tree mirror from the SceneTree signals.
+     */
+    void disconnect_mirror();
+
+    /**
+     * @brief Matches a new fact against the forward rules and schedules the
+     * signal of the firings.
+     */
+    void run_forward_rules(term_t p_fact);
+
+    /**
+     * @brief Function running the forward rules on the facts asserted by
+     * the loaders, the mirror and consult_string() (see
+     * FactLoader::Listener).
+     */
+    std::function<void(term_t)> forward_rules_listener();
 
 private:
 
     /** Whether the Prolog engine has been initialized. */
     bool m_initialized;
 
-    /** Last error message from Prolog. */
-    String m_last_error;
+    /** Last error of each thread and errors queued for take_errors(). */
+    ErrorLog m_errors;
 
     /** Error handling option: "print", "halt", or "status". */
     String m_on_error;
@@ -582,6 +1629,69 @@ private:
     /** Warning handling option: "print", "halt", or "status". */
     String m_on_warning;
 
+    /** Duration in microseconds of each phase of the last initialize(). */
+    Dictionary m_startup_profile;
+
+    /** Facts mirroring a subtree of the scene tree. */
+    SceneTreeMirror m_mirror;
+
+    /** SceneTree whose signals update m_mirror (null when not mirroring). */
+    ObjectID m_mirror_tree;
+
+    /** GOAP planner (plan caches and running searches). */
+    GoapPlanner m_planner;
+
+    /** Forward-chaining rules matched by the facts added from Godot. */
+    ForwardRules m_forward_rules;
+
+    /** Whether flush_forward_rules() is already deferred for this frame. */
+    bool m_forward_flush_pending = false;
+
+    /** Persistent CHR constraint store. */
+    ChrStore m_chr;
+
+    /** Clause references of the facts added by add_fact_ttl(). */
+    TimerWheel m_expiring_facts;
+
+    /** Predicates declared with declare_thread_local() (names registered). */
+    std::vector<functor_t> m_thread_locals;
+
+    /** Guards m_thread_locals, read by query_scratch() on any thread. */
+    std::mutex m_thread_locals_mutex;
+
+    /** Prolog engines attached by the worker threads of parallel_call(). */
+    EnginePool m_engines;
+
+    /** Output of the engines of the instance (null when not captured). */
+    std::unique_ptr<OutputCapture> m_output;
+
+    /** Call run by the worker threads (null when parallel_call() is idle). */
+    ParallelCall* m_parallel_call = nullptr;
+
+    /** Open query cursors by id (shared with the threads fetching them). */
+    std::unordered_map<int64_t, std::shared_ptr<QueryCursor>> m_cursors;
+
+    /** Guards m_cursors, used by any thread. */
+    mutable std::mutex m_cursors_mutex;
+
+    /** Number of cursors opened, to give them ids. */
+    int64_t m_cursor_count = 0;
+
+    /**
+     * Context module of the queries and assertions of this instance: NULL
+     * for the user module, or an overlay module (see setup_module()).
+     */
+    module_t m_module = NULL;
+
+    /** Whether m_module was created for this instance (emptied on cleanup). */
+    bool m_owns_module = false;
+
+    /** Number of initialized instances sharing the Prolog engine. */
+    static int m_engine_users;
+
+    /** Number of overlay modules created, to name them. */
+    static int64_t m_overlay_count;
+
     /**
      * @brief Singleton instance pointer for global access.
      *
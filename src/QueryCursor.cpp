@@ -0,0 +1,170 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the QueryCursor class.
+ */
+
+#include "QueryCursor.hpp"
+#include "Prologot.hpp"
+#include <godot_cpp/classes/time.hpp>
+
+// =============================================================================
+// QueryCursor
+// =============================================================================
+
+QueryCursor::QueryCursor(EnginePool& p_engines) : m_engines(p_engines) {}
+
+QueryCursor::~QueryCursor()
+{
+    close();
+}
+
+bool QueryCursor::open(String const& p_goal,
+                       module_t p_module,
+                       String& r_error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_goal = p_goal;
+    m_engine = m_engines.acquire();
+    PL_engine_t previous = nullptr;
+    if (m_engine == nullptr ||
+        PL_set_engine(m_engine, &previous) != PL_ENGINE_SET)
+    {
+        r_error = "Cannot attach a Prolog engine to the query cursor";
+        if (m_engine != nullptr)
+            m_engines.release(m_engine);
+        m_engine = nullptr;
+        m_exhausted = true;
+        return false;
+    }
+
+    // The frame holds the goal term until close(): the query and its
+    // bindings live in the engine of the cursor between two fetches
+    m_frame = PL_open_foreign_frame();
+    m_goal_term = PL_new_term_ref();
+    bool ok = PL_chars_to_term(p_goal.utf8().get_data(), m_goal_term);
+    if (ok)
+    {
+        m_qid = PL_open_query(p_module,
+                              PL_Q_CATCH_EXCEPTION,
+                              PL_predicate("call", 1, "user"),
+                              m_goal_term);
+    }
+    else
+    {
+        r_error = "Failed to parse query: " + p_goal;
+        PL_discard_foreign_frame(m_frame);
+        m_frame = 0;
+    }
+    PL_set_engine(previous, nullptr);
+
+    if (!ok)
+    {
+        m_engines.release(m_engine);
+        m_engine = nullptr;
+        m_exhausted = true;
+    }
+    return ok;
+}
+
+bool QueryCursor::next(int64_t p_count,
+                       Array& r_solutions,
+                       ErrorRecord& r_error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_exhausted)
+        return true;
+
+    PL_engine_t previous = nullptr;
+    if (PL_set_engine(m_engine, &previous) != PL_ENGINE_SET)
+    {
+        r_error.context = "Query cursor";
+        r_error.goal = m_goal;
+        r_error.message = "Cannot attach the Prolog engine of the cursor";
+        return false;
+    }
+
+    Time* time = Time::get_singleton();
+    uint64_t begin = time->get_ticks_usec();
+    int64_t inferences_begin = Prologot::statistics_value("inferences");
+    bool ok = true;
+    for (int64_t i = 0; i < p_count; i++)
+    {
+        if (!PL_next_solution(m_qid))
+        {
+            if (term_t exception = PL_exception(m_qid))
+            {
+                r_error.context = "Query cursor";
+                r_error.goal = m_goal;
+                r_error.set_exception(exception);
+                ok = false;
+            }
+            m_exhausted = true;
+            break;
+        }
+
+        // Term references of the conversion are released at once, so that
+        // a long paging does not grow the frame of the query
+        fid_t fid = PL_open_foreign_frame();
+        r_solutions.push_back(Prologot::term_to_variant(m_goal_term));
+        PL_discard_foreign_frame(fid);
+        m_solutions++;
+    }
+    m_inferences +=
+        Prologot::statistics_value("inferences") - inferences_begin;
+    m_wall_time += int64_t(time->get_ticks_usec() - begin);
+
+    // Last solution reached: the choice points and the engine are freed
+    // without waiting for close()
+    if (m_exhausted)
+    {
+        PL_close_query(m_qid);
+        PL_discard_foreign_frame(m_frame);
+        m_qid = 0;
+        m_frame = 0;
+    }
+    PL_set_engine(previous, nullptr);
+    if (m_exhausted)
+    {
+        m_engines.release(m_engine);
+        m_engine = nullptr;
+    }
+    return ok;
+}
+
+void QueryCursor::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_exhausted = true;
+    if (m_engine == nullptr)
+        return;
+
+    PL_engine_t previous = nullptr;
+    if (PL_set_engine(m_engine, &previous) == PL_ENGINE_SET)
+    {
+        if (m_qid != 0)
+            PL_close_query(m_qid);
+        if (m_frame != 0)
+            PL_discard_foreign_frame(m_frame);
+        PL_set_engine(previous, nullptr);
+    }
+    m_qid = 0;
+    m_frame = 0;
+    m_engines.release(m_engine);
+    m_engine = nullptr;
+}
+
+Dictionary QueryCursor::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Dictionary stats;
+    stats["goal"] = m_goal;
+    stats["solutions"] = m_solutions;
+    stats["exhausted"] = m_exhausted;
+    stats["wall_time_usec"] = m_wall_time;
+    stats["inferences"] = m_inferences;
+    return stats;
+}
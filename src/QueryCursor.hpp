@@ -0,0 +1,103 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the QueryCursor class: an open query whose solutions
+ * are fetched by pages, from any thread.
+ */
+
+#pragma once
+
+#include "EnginePool.hpp"
+#include "ErrorLog.hpp"
+#include <SWI-Prolog.h>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <cstdint>
+#include <mutex>
+
+using namespace godot;
+
+/**
+ * @class QueryCursor
+ * @brief A goal whose solutions are fetched a few at a time.
+ *
+ * The query is opened in an engine of an EnginePool owned by the cursor
+ * until it is closed: the query and its choice points stay in that engine
+ * between two fetches, and any thread can run the next fetch by attaching
+ * the engine (one thread at a time, see m_mutex). The main thread can thus
+ * open a cursor and let a worker thread compute the solutions.
+ *
+ * Each fetch is measured: wall time, and inferences counted by
+ * statistics/2 in the engine of the cursor.
+ */
+class QueryCursor
+{
+public:
+
+    /**
+     * @param p_engines Pool of the engine of the cursor; must outlive it.
+     */
+    explicit QueryCursor(EnginePool& p_engines);
+
+    /** Closes the query if it is still open. */
+    ~QueryCursor();
+
+    /**
+     * @brief Parses the goal and opens its query, without computing any
+     * solution.
+     *
+     * @param p_goal Goal, as for query_all().
+     * @param p_module Context module of the query (NULL for user).
+     * @param r_error Error message on failure.
+     * @return true on success.
+     */
+    bool open(String const& p_goal, module_t p_module, String& r_error);
+
+    /**
+     * @brief Computes the next solutions, on the calling thread.
+     *
+     * @param p_count Maximum number of solutions.
+     * @param r_solutions The solutions are appended, as the goal term
+     * instantiated by each solution (like query_all()).
+     * @param r_error Filled with the exception if the goal raised one (its
+     * context and goal; the type and thread are left to the caller).
+     * @return false if the goal raised an exception or no engine could be
+     * attached. The cursor is then exhausted.
+     */
+    bool next(int64_t p_count, Array& r_solutions, ErrorRecord& r_error);
+
+    /**
+     * @brief Closes the query and gives back the engine. Called by the
+     * destructor; waits for a running next().
+     */
+    void close();
+
+    /**
+     * @brief Statistics of the fetches so far.
+     *
+     * @return {"goal": String, "solutions": int, "exhausted": bool,
+     * "wall_time_usec": int, "inferences": int}: total number of solutions,
+     * whether the last one was reached, and time and inferences spent in
+     * the fetches.
+     */
+    Dictionary stats() const;
+
+private:
+
+    EnginePool& m_engines;
+    PL_engine_t m_engine = nullptr;
+    fid_t m_frame = 0;
+    qid_t m_qid = 0;
+    term_t m_goal_term = 0;
+    String m_goal;
+    int64_t m_solutions = 0;
+    int64_t m_wall_time = 0;
+    int64_t m_inferences = 0;
+    bool m_exhausted = false;
+    mutable std::mutex m_mutex;
+};
@@ -0,0 +1,230 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the SceneTreeMirror class.
+ */
+
+#include "SceneTreeMirror.hpp"
+#include "FactLoader.hpp"
+#include "ObjectBlob.hpp"
+
+#include <SWI-Prolog.h>
+
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+/** Mirrored predicates, all of arity 2 with the node first. */
+const char* const MIRROR_PREDICATES[] = { "node_type", "parent", "in_group" };
+
+/** Group membership of a node. */
+using Membership = std::pair<Node*, String>;
+
+bool put_atom(term_t p_term, String const& p_text)
+{
+    CharString text = p_text.utf8();
+    return PL_put_chars(
+        p_term, PL_ATOM | REP_UTF8, text.length(), text.get_data());
+}
+
+/** Appends the user groups of a node (internal groups start with '_'). */
+void collect_groups(Node* p_node, std::vector<Membership>& r_memberships)
+{
+    Array groups = p_node->get_groups();
+    for (int64_t i = 0; i < groups.size(); i++)
+    {
+        String group = groups[i];
+        if (!group.begins_with("_"))
+            r_memberships.emplace_back(p_node, group);
+    }
+}
+
+/** Appends a node and its descendants, internal children included. */
+void collect_subtree(Node* p_node, std::vector<Node*>& r_nodes)
+{
+    r_nodes.push_back(p_node);
+    int count = p_node->get_child_count(true);
+    for (int i = 0; i < count; i++)
+        collect_subtree(p_node->get_child(i, true), r_nodes);
+}
+
+/**
+ * Retracts the clauses of one of the mirrored predicates whose first
+ * argument is p_node, or all of them if p_node is nullptr, from p_module
+ * (the context module of retractall/1). retractall/1 also declares the
+ * predicate dynamic if it does not exist.
+ */
+bool retract_facts(const char* p_predicate,
+                   module_t p_module,
+                   Node const* p_node)
+{
+    // Looked up on each call: handles do not survive PL_cleanup()
+    predicate_t retractall = PL_predicate("retractall", 1, "user");
+    atom_t name = PL_new_atom(p_predicate);
+    functor_t functor = PL_new_functor(name, 2);
+    PL_unregister_atom(name);
+
+    fid_t fid = PL_open_foreign_frame();
+    term_t args = PL_new_term_refs(2);
+    term_t head = PL_new_term_ref();
+    bool ok = (p_node == nullptr || ObjectBlob::put(args, p_node)) &&
+              PL_cons_functor_v(head, functor, args) &&
+              PL_call_predicate(
+                  p_module, PL_Q_CATCH_EXCEPTION, retractall, head);
+    PL_clear_exception();
+    PL_discard_foreign_frame(fid);
+    return ok;
+}
+
+/**
+ * Asserts the facts of some nodes. The parent of p_root is outside the
+ * mirror: p_root gets no parent/2 fact.
+ */
+bool assert_nodes(std::vector<Node*> const& p_nodes,
+                  Node const* p_root,
+                  module_t p_module,
+                  String& r_error)
+{
+    std::vector<Node*> children;
+    std::vector<Membership> memberships;
+    for (Node* node : p_nodes)
+    {
+        if (node != p_root)
+            children.push_back(node);
+        collect_groups(node, memberships);
+    }
+
+    return FactLoader::assert_rows(
+               "node_type",
+               p_module,
+               2,
+               p_nodes.size(),
+               [&](size_t p_row, term_t p_args)
+               {
+                   Node* node = p_nodes[p_row];
+                   return ObjectBlob::put(p_args, node) &&
+                          put_atom(p_args + 1, node->get_class());
+               },
+               r_error) >= 0 &&
+           FactLoader::assert_rows(
+               "parent",
+               p_module,
+               2,
+               children.size(),
+               [&](size_t p_row, term_t p_args)
+               {
+                   Node* node = children[p_row];
+                   return ObjectBlob::put(p_args, node) &&
+                          ObjectBlob::put(p_args + 1, node->get_parent());
+               },
+               r_error) >= 0 &&
+           FactLoader::assert_rows(
+               "in_group",
+               p_module,
+               2,
+               memberships.size(),
+               [&](size_t p_row, term_t p_args)
+               {
+                   Membership const& membership = memberships[p_row];
+                   return ObjectBlob::put(p_args, membership.first) &&
+                          put_atom(p_args + 1, membership.second);
+               },
+               r_error) >= 0;
+}
+
+} // namespace
+
+// =============================================================================
+// SceneTreeMirror
+// =============================================================================
+
+int64_t SceneTreeMirror::mirror(Node* p_root,
+                                module_t p_module,
+                                String& r_error)
+{
+    if (p_root == nullptr || !p_root->is_inside_tree())
+    {
+        r_error = "mirror_scene_tree expects a node inside the scene tree";
+        return -1;
+    }
+
+    clear();
+    m_module = p_module;
+    std::vector<Node*> nodes;
+    collect_subtree(p_root, nodes);
+    if (!assert_nodes(nodes, p_root, m_module, r_error))
+    {
+        clear();
+        return -1;
+    }
+
+    m_root = p_root->get_instance_id();
+    return int64_t(nodes.size());
+}
+
+bool SceneTreeMirror::is_mirrored(Node const* p_node) const
+{
+    Node* root = get_root();
+    return root != nullptr && p_node != nullptr &&
+           (p_node == root || root->is_ancestor_of(p_node));
+}
+
+bool SceneTreeMirror::add_node(Node* p_node, String& r_error)
+{
+    return assert_nodes({ p_node }, get_root(), m_module, r_error);
+}
+
+bool SceneTreeMirror::remove_node(Node const* p_node)
+{
+    bool ok = true;
+    for (const char* predicate : MIRROR_PREDICATES)
+        ok = retract_facts(predicate, m_module, p_node) && ok;
+    return ok;
+}
+
+bool SceneTreeMirror::update_groups(Node* p_node, String& r_error)
+{
+    if (!is_mirrored(p_node))
+    {
+        r_error = "The node is not in the mirrored scene tree";
+        return false;
+    }
+
+    std::vector<Membership> memberships;
+    collect_groups(p_node, memberships);
+    if (!retract_facts("in_group", m_module, p_node))
+    {
+        r_error = "Cannot retract the in_group/2 facts";
+        return false;
+    }
+    return FactLoader::assert_rows(
+               "in_group",
+               m_module,
+               2,
+               memberships.size(),
+               [&](size_t p_row, term_t p_args)
+               {
+                   return ObjectBlob::put(p_args, p_node) &&
+                          put_atom(p_args + 1, memberships[p_row].second);
+               },
+               r_error) >= 0;
+}
+
+void SceneTreeMirror::clear()
+{
+    for (const char* predicate : MIRROR_PREDICATES)
+        retract_facts(predicate, m_module, nullptr);
+    m_root = ObjectID();
+}
+
+Node* SceneTreeMirror::get_root() const
+{
+    if (m_root.is_null())
+        return nullptr;
+    return Object::cast_to<Node>(ObjectDB::get_instance((uint64_t)m_root));
+}
@@ -0,0 +1,107 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the SceneTreeMirror class: a subtree of the scene tree
+ * mirrored as Prolog facts.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <godot_cpp/classes/node.hpp>
+#include <godot_cpp/core/object.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <cstdint>
+
+using namespace godot;
+
+/**
+ * @class SceneTreeMirror
+ * @brief Keeps facts describing the nodes of a subtree:
+ * - node_type(Node, Class): class name of every node, root included.
+ * - parent(Node, Parent): every node but the root.
+ * - in_group(Node, Group): groups of every node, except the internal ones
+ *   (starting with an underscore).
+ *
+ * Nodes are object handles (see ObjectBlob) and classes and groups are
+ * atoms. The subtree is exported once by mirror(); afterwards each added or
+ * removed node costs a few asserts or retracts indexed on the node, so the
+ * facts stay current without rescanning. Godot has no signal for group
+ * changes: update_groups() must be called after add_to_group() or
+ * remove_from_group().
+ *
+ * The mirror owns the three predicates of its module: their clauses are
+ * replaced by mirror() and removed by clear().
+ */
+class SceneTreeMirror
+{
+public:
+
+    /**
+     * @brief Replaces the facts by the ones of a subtree.
+     *
+     * @param p_root Root of the subtree (must be inside the scene tree).
+     * @param p_module Module of the facts (NULL for user), kept for the
+     * updates.
+     * @param r_error Error message on failure.
+     * @return The number of nodes mirrored, or -1 on failure.
+     */
+    int64_t mirror(Node* p_root, module_t p_module, String& r_error);
+
+    /**
+     * @brief Whether a node is the mirrored root or one of its descendants.
+     */
+    bool is_mirrored(Node const* p_node) const;
+
+    /**
+     * @brief Asserts the facts of a node that entered the subtree.
+     *
+     * @param p_node Added node (its ancestors are already mirrored).
+     * @param r_error Error message on failure.
+     * @return true on success.
+     */
+    bool add_node(Node* p_node, String& r_error);
+
+    /**
+     * @brief Retracts the facts of a node leaving the subtree.
+     *
+     * @param p_node Removed node (its descendants are already removed).
+     * @return true on success.
+     */
+    bool remove_node(Node const* p_node);
+
+    /**
+     * @brief Replaces the in_group/2 facts of a mirrored node by its current
+     * groups.
+     *
+     * @param p_node Mirrored node.
+     * @param r_error Error message on failure.
+     * @return true on success.
+     */
+    bool update_groups(Node* p_node, String& r_error);
+
+    /**
+     * @brief Retracts all the facts and forgets the root.
+     */
+    void clear();
+
+    /**
+     * @brief Root of the mirrored subtree.
+     *
+     * @return The root, or nullptr if nothing is mirrored or the root was
+     * freed.
+     */
+    Node* get_root() const;
+
+private:
+
+    /** Root of the mirrored subtree (null when nothing is mirrored). */
+    ObjectID m_root;
+
+    /** Module of the facts (NULL for user). */
+    module_t m_module = NULL;
+};
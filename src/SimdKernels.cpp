@@ -0,0 +1,968 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the SimdKernels class.
+ */
+
+#include "SimdKernels.hpp"
+#include "PackedArrayBlob.hpp"
+#include <SWI-Prolog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#    define PROLOGOT_X86
+#    include <immintrin.h>
+#endif
+
+#if defined(PROLOGOT_X86) &&                                  \
+    (defined(__SSE2__) || defined(_M_X64) ||                  \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#    define PROLOGOT_SSE2
+#endif
+
+// AVX kernels are compiled even without -mavx when the compiler allows
+// per-function targets, and only used if the CPU supports them. Every AVX
+// CPU has the popcnt instruction: enable it for the same functions.
+#if defined(__AVX__)
+#    define PROLOGOT_AVX
+#    define PROLOGOT_AVX_TARGET
+#elif defined(PROLOGOT_X86) && (defined(__GNUC__) || defined(__clang__))
+#    define PROLOGOT_AVX
+#    define PROLOGOT_AVX_RUNTIME
+#    define PROLOGOT_AVX_TARGET __attribute__((target("avx,popcnt")))
+#endif
+
+namespace
+{
+
+//! Word-wise operations of the bitset kernels.
+enum class BitOp
+{
+    AND,
+    OR,
+    AND_NOT
+};
+
+// -----------------------------------------------------------------------------
+// Scalar kernels (also used for the tails of the vectorised loops)
+// -----------------------------------------------------------------------------
+
+namespace scalar
+{
+
+template <typename T>
+double dot(const T* p_a, const T* p_b, size_t p_size)
+{
+    double result = 0.0;
+    for (size_t i = 0; i < p_size; i++)
+        result += double(p_a[i]) * double(p_b[i]);
+    return result;
+}
+
+template <typename T>
+double squared_distance(const T* p_a, const T* p_b, size_t p_size)
+{
+    double result = 0.0;
+    for (size_t i = 0; i < p_size; i++)
+    {
+        double delta = double(p_a[i]) - double(p_b[i]);
+        result += delta * delta;
+    }
+    return result;
+}
+
+template <typename T>
+double sum(const T* p_values, size_t p_size)
+{
+    double result = 0.0;
+    for (size_t i = 0; i < p_size; i++)
+        result += double(p_values[i]);
+    return result;
+}
+
+template <typename T>
+size_t argmin(const T* p_values, size_t p_size)
+{
+    size_t best = 0;
+    for (size_t i = 1; i < p_size; i++)
+    {
+        if (p_values[i] < p_values[best])
+            best = i;
+    }
+    return best;
+}
+
+template <typename T>
+size_t argmax(const T* p_values, size_t p_size)
+{
+    size_t best = 0;
+    for (size_t i = 1; i < p_size; i++)
+    {
+        if (p_values[i] > p_values[best])
+            best = i;
+    }
+    return best;
+}
+
+/** Index of the first element equal to p_value, or p_size. */
+template <typename T>
+size_t find(const T* p_values, size_t p_size, double p_value)
+{
+    for (size_t i = 0; i < p_size; i++)
+    {
+        if (double(p_values[i]) == p_value)
+            return i;
+    }
+    return p_size;
+}
+
+/** Number of bits set in a word (popcnt instruction when enabled). */
+inline size_t popcount_word(uint64_t p_word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return size_t(__builtin_popcountll(p_word));
+#else
+    p_word = p_word - ((p_word >> 1) & 0x5555555555555555ULL);
+    p_word = (p_word & 0x3333333333333333ULL) +
+             ((p_word >> 2) & 0x3333333333333333ULL);
+    p_word = (p_word + (p_word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return size_t((p_word * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+template <BitOp OP>
+void bitwise(const uint64_t* p_a,
+             const uint64_t* p_b,
+             uint64_t* r_out,
+             size_t p_words)
+{
+    for (size_t i = 0; i < p_words; i++)
+    {
+        r_out[i] = (OP == BitOp::AND)  ? (p_a[i] & p_b[i])
+                   : (OP == BitOp::OR) ? (p_a[i] | p_b[i])
+                                       : (p_a[i] & ~p_b[i]);
+    }
+}
+
+size_t popcount(const uint64_t* p_values, size_t p_words)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < p_words; i++)
+        count += popcount_word(p_values[i]);
+    return count;
+}
+
+} // namespace scalar
+
+// -----------------------------------------------------------------------------
+// SSE2 kernels: two doubles per register
+// -----------------------------------------------------------------------------
+
+#ifdef PROLOGOT_SSE2
+namespace sse2
+{
+
+inline __m128d load(const double* p_values)
+{
+    return _mm_loadu_pd(p_values);
+}
+
+inline __m128d load(const float* p_values)
+{
+    __m128i pair = _mm_loadl_epi64((const __m128i*)p_values);
+    return _mm_cvtps_pd(_mm_castsi128_ps(pair));
+}
+
+inline double add_lanes(__m128d p_vector)
+{
+    return _mm_cvtsd_f64(
+        _mm_add_sd(p_vector, _mm_unpackhi_pd(p_vector, p_vector)));
+}
+
+template <typename T>
+double dot(const T* p_a, const T* p_b, size_t p_size)
+{
+    // Two accumulators hide the latency of the additions
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= p_size; i += 4)
+    {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(load(p_a + i), load(p_b + i)));
+        acc1 = _mm_add_pd(acc1,
+                          _mm_mul_pd(load(p_a + i + 2), load(p_b + i + 2)));
+    }
+    return add_lanes(_mm_add_pd(acc0, acc1)) +
+           scalar::dot(p_a + i, p_b + i, p_size - i);
+}
+
+template <typename T>
+double squared_distance(const T* p_a, const T* p_b, size_t p_size)
+{
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= p_size; i += 4)
+    {
+        __m128d d0 = _mm_sub_pd(load(p_a + i), load(p_b + i));
+        __m128d d1 = _mm_sub_pd(load(p_a + i + 2), load(p_b + i + 2));
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(d0, d0));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(d1, d1));
+    }
+    return add_lanes(_mm_add_pd(acc0, acc1)) +
+           scalar::squared_distance(p_a + i, p_b + i, p_size - i);
+}
+
+template <typename T>
+double sum(const T* p_values, size_t p_size)
+{
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= p_size; i += 4)
+    {
+        acc0 = _mm_add_pd(acc0, load(p_values + i));
+        acc1 = _mm_add_pd(acc1, load(p_values + i + 2));
+    }
+    return add_lanes(_mm_add_pd(acc0, acc1)) +
+           scalar::sum(p_values + i, p_size - i);
+}
+
+/** Smallest (p_max false) or largest (p_max true) element. */
+template <typename T>
+double extremum(const T* p_values, size_t p_size, bool p_max)
+{
+    if (p_size < 2)
+        return double(p_values[0]);
+
+    __m128d best = load(p_values);
+    size_t i = 2;
+    for (; i + 2 <= p_size; i += 2)
+    {
+        __m128d values = load(p_values + i);
+        best = p_max ? _mm_max_pd(best, values) : _mm_min_pd(best, values);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, best);
+    double result = p_max ? std::max(lanes[0], lanes[1])
+                          : std::min(lanes[0], lanes[1]);
+    for (; i < p_size; i++)
+    {
+        result = p_max ? std::max(result, double(p_values[i]))
+                       : std::min(result, double(p_values[i]));
+    }
+    return result;
+}
+
+template <typename T>
+size_t argmin(const T* p_values, size_t p_size)
+{
+    // NaNs make the vectorised extremum unreliable: fall back to scalar
+    size_t index =
+        scalar::find(p_values, p_size, extremum(p_values, p_size, false));
+    return (index < p_size) ? index : scalar::argmin(p_values, p_size);
+}
+
+template <typename T>
+size_t argmax(const T* p_values, size_t p_size)
+{
+    size_t index =
+        scalar::find(p_values, p_size, extremum(p_values, p_size, true));
+    return (index < p_size) ? index : scalar::argmax(p_values, p_size);
+}
+
+template <BitOp OP>
+void bitwise(const uint64_t* p_a,
+             const uint64_t* p_b,
+             uint64_t* r_out,
+             size_t p_words)
+{
+    size_t i = 0;
+    for (; i + 2 <= p_words; i += 2)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(p_a + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(p_b + i));
+        __m128i result = (OP == BitOp::AND)  ? _mm_and_si128(a, b)
+                         : (OP == BitOp::OR) ? _mm_or_si128(a, b)
+                                             : _mm_andnot_si128(b, a);
+        _mm_storeu_si128((__m128i*)(r_out + i), result);
+    }
+    scalar::bitwise<OP>(p_a + i, p_b + i, r_out + i, p_words - i);
+}
+
+} // namespace sse2
+#endif
+
+// -----------------------------------------------------------------------------
+// AVX kernels: four doubles per register
+// -----------------------------------------------------------------------------
+
+#ifdef PROLOGOT_AVX
+namespace avx
+{
+
+PROLOGOT_AVX_TARGET inline __m256d load(const double* p_values)
+{
+    return _mm256_loadu_pd(p_values);
+}
+
+PROLOGOT_AVX_TARGET inline __m256d load(const float* p_values)
+{
+    return _mm256_cvtps_pd(_mm_loadu_ps(p_values));
+}
+
+PROLOGOT_AVX_TARGET inline double add_lanes(__m256d p_vector)
+{
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(p_vector),
+                              _mm256_extractf128_pd(p_vector, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+template <typename T>
+PROLOGOT_AVX_TARGET double dot(const T* p_a, const T* p_b, size_t p_size)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= p_size; i += 8)
+    {
+        acc0 = _mm256_add_pd(acc0,
+                             _mm256_mul_pd(load(p_a + i), load(p_b + i)));
+        acc1 = _mm256_add_pd(
+            acc1, _mm256_mul_pd(load(p_a + i + 4), load(p_b + i + 4)));
+    }
+    return add_lanes(_mm256_add_pd(acc0, acc1)) +
+           scalar::dot(p_a + i, p_b + i, p_size - i);
+}
+
+template <typename T>
+PROLOGOT_AVX_TARGET double
+squared_distance(const T* p_a, const T* p_b, size_t p_size)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= p_size; i += 8)
+    {
+        __m256d d0 = _mm256_sub_pd(load(p_a + i), load(p_b + i));
+        __m256d d1 = _mm256_sub_pd(load(p_a + i + 4), load(p_b + i + 4));
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(d0, d0));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(d1, d1));
+    }
+    return add_lanes(_mm256_add_pd(acc0, acc1)) +
+           scalar::squared_distance(p_a + i, p_b + i, p_size - i);
+}
+
+template <typename T>
+PROLOGOT_AVX_TARGET double sum(const T* p_values, size_t p_size)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= p_size; i += 8)
+    {
+        acc0 = _mm256_add_pd(acc0, load(p_values + i));
+        acc1 = _mm256_add_pd(acc1, load(p_values + i + 4));
+    }
+    return add_lanes(_mm256_add_pd(acc0, acc1)) +
+           scalar::sum(p_values + i, p_size - i);
+}
+
+template <typename T>
+PROLOGOT_AVX_TARGET double
+extremum(const T* p_values, size_t p_size, bool p_max)
+{
+    if (p_size < 4)
+    {
+        size_t index = p_max ? scalar::argmax(p_values, p_size)
+                             : scalar::argmin(p_values, p_size);
+        return double(p_values[index]);
+    }
+
+    __m256d best = load(p_values);
+    size_t i = 4;
+    for (; i + 4 <= p_size; i += 4)
+    {
+        __m256d values = load(p_values + i);
+        best = p_max ? _mm256_max_pd(best, values)
+                     : _mm256_min_pd(best, values);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, best);
+    double result = lanes[0];
+    for (int lane = 1; lane < 4; lane++)
+    {
+        result = p_max ? std::max(result, lanes[lane])
+                       : std::min(result, lanes[lane]);
+    }
+    for (; i < p_size; i++)
+    {
+        result = p_max ? std::max(result, double(p_values[i]))
+                       : std::min(result, double(p_values[i]));
+    }
+    return result;
+}
+
+template <typename T>
+PROLOGOT_AVX_TARGET size_t argmin(const T* p_values, size_t p_size)
+{
+    size_t index =
+        scalar::find(p_values, p_size, extremum(p_values, p_size, false));
+    return (index < p_size) ? index : scalar::argmin(p_values, p_size);
+}
+
+template <typename T>
+PROLOGOT_AVX_TARGET size_t argmax(const T* p_values, size_t p_size)
+{
+    size_t index =
+        scalar::find(p_values, p_size, extremum(p_values, p_size, true));
+    return (index < p_size) ? index : scalar::argmax(p_values, p_size);
+}
+
+template <BitOp OP>
+PROLOGOT_AVX_TARGET void bitwise(const uint64_t* p_a,
+                                 const uint64_t* p_b,
+                                 uint64_t* r_out,
+                                 size_t p_words)
+{
+    // AVX has no 256-bit integer logic: the double variants are bitwise
+    size_t i = 0;
+    for (; i + 4 <= p_words; i += 4)
+    {
+        __m256d a = _mm256_castsi256_pd(
+            _mm256_loadu_si256((const __m256i*)(p_a + i)));
+        __m256d b = _mm256_castsi256_pd(
+            _mm256_loadu_si256((const __m256i*)(p_b + i)));
+        __m256d result = (OP == BitOp::AND)  ? _mm256_and_pd(a, b)
+                         : (OP == BitOp::OR) ? _mm256_or_pd(a, b)
+                                             : _mm256_andnot_pd(b, a);
+        _mm256_storeu_si256((__m256i*)(r_out + i),
+                            _mm256_castpd_si256(result));
+    }
+    scalar::bitwise<OP>(p_a + i, p_b + i, r_out + i, p_words - i);
+}
+
+PROLOGOT_AVX_TARGET size_t popcount(const uint64_t* p_values, size_t p_words)
+{
+    // Independent counters keep several popcnt in flight
+    size_t count0 = 0, count1 = 0, count2 = 0, count3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= p_words; i += 4)
+    {
+        count0 += scalar::popcount_word(p_values[i]);
+        count1 += scalar::popcount_word(p_values[i + 1]);
+        count2 += scalar::popcount_word(p_values[i + 2]);
+        count3 += scalar::popcount_word(p_values[i + 3]);
+    }
+    return count0 + count1 + count2 + count3 +
+           scalar::popcount(p_values + i, p_words - i);
+}
+
+} // namespace avx
+#endif
+
+// -----------------------------------------------------------------------------
+// Dispatch
+// -----------------------------------------------------------------------------
+
+enum class Backend
+{
+    SCALAR,
+    SSE2,
+    AVX
+};
+
+Backend detect_backend()
+{
+#if defined(PROLOGOT_AVX_RUNTIME)
+    if (__builtin_cpu_supports("avx") && __builtin_cpu_supports("popcnt"))
+        return Backend::AVX;
+#elif defined(PROLOGOT_AVX)
+    return Backend::AVX;
+#endif
+#ifdef PROLOGOT_SSE2
+    return Backend::SSE2;
+#else
+    return Backend::SCALAR;
+#endif
+}
+
+Backend current_backend()
+{
+    static const Backend backend = detect_backend();
+    return backend;
+}
+
+/** Kernels of the backend in use, for one element type. */
+template <typename T>
+struct KernelTable
+{
+    double (*dot)(const T*, const T*, size_t);
+    double (*squared_distance)(const T*, const T*, size_t);
+    double (*sum)(const T*, size_t);
+    size_t (*argmin)(const T*, size_t);
+    size_t (*argmax)(const T*, size_t);
+};
+
+template <typename T>
+KernelTable<T> make_kernel_table()
+{
+    switch (current_backend())
+    {
+#ifdef PROLOGOT_AVX
+        case Backend::AVX:
+            return { avx::dot<T>,
+                     avx::squared_distance<T>,
+                     avx::sum<T>,
+                     avx::argmin<T>,
+                     avx::argmax<T> };
+#endif
+#ifdef PROLOGOT_SSE2
+        case Backend::SSE2:
+            return { sse2::dot<T>,
+                     sse2::squared_distance<T>,
+                     sse2::sum<T>,
+                     sse2::argmin<T>,
+                     sse2::argmax<T> };
+#endif
+        default:
+            return { scalar::dot<T>,
+                     scalar::squared_distance<T>,
+                     scalar::sum<T>,
+                     scalar::argmin<T>,
+                     scalar::argmax<T> };
+    }
+}
+
+template <typename T>
+KernelTable<T> const& kernels()
+{
+    static const KernelTable<T> table = make_kernel_table<T>();
+    return table;
+}
+
+/** Word-wise kernels of the backend in use. */
+struct BitKernelTable
+{
+    void (*bit_and)(const uint64_t*, const uint64_t*, uint64_t*, size_t);
+    void (*bit_or)(const uint64_t*, const uint64_t*, uint64_t*, size_t);
+    void (*bit_and_not)(const uint64_t*, const uint64_t*, uint64_t*, size_t);
+    size_t (*popcount)(const uint64_t*, size_t);
+};
+
+BitKernelTable make_bit_kernel_table()
+{
+    switch (current_backend())
+    {
+#ifdef PROLOGOT_AVX
+        case Backend::AVX:
+            return { avx::bitwise<BitOp::AND>,
+                     avx::bitwise<BitOp::OR>,
+                     avx::bitwise<BitOp::AND_NOT>,
+                     avx::popcount };
+#endif
+#ifdef PROLOGOT_SSE2
+        case Backend::SSE2:
+            // SSE2 has no popcount: the scalar loop is as fast
+            return { sse2::bitwise<BitOp::AND>,
+                     sse2::bitwise<BitOp::OR>,
+                     sse2::bitwise<BitOp::AND_NOT>,
+                     scalar::popcount };
+#endif
+        default:
+            return { scalar::bitwise<BitOp::AND>,
+                     scalar::bitwise<BitOp::OR>,
+                     scalar::bitwise<BitOp::AND_NOT>,
+                     scalar::popcount };
+    }
+}
+
+BitKernelTable const& bit_kernels()
+{
+    static const BitKernelTable table = make_bit_kernel_table();
+    return table;
+}
+
+// -----------------------------------------------------------------------------
+// Foreign predicates
+// -----------------------------------------------------------------------------
+
+/**
+ * Numbers of a vector argument. Float blobs are read in place; lists and
+ * integer blobs are converted to doubles.
+ */
+struct Operand
+{
+    bool float32 = false;
+    const double* doubles = nullptr;
+    const float* floats = nullptr;
+    size_t size = 0;
+    std::vector<double> double_buffer;
+    std::vector<float> float_buffer;
+
+    void use_doubles()
+    {
+        if (float32)
+        {
+            double_buffer.assign(floats, floats + size);
+            doubles = double_buffer.data();
+            float32 = false;
+        }
+    }
+
+    void use_floats()
+    {
+        if (!float32)
+        {
+            float_buffer.assign(doubles, doubles + size);
+            floats = float_buffer.data();
+            float32 = true;
+        }
+    }
+};
+
+/** Reads a list of numbers or a packed array blob, raising on errors. */
+bool get_operand(term_t p_term, Operand& r_operand)
+{
+    PackedArrayBlob::View view;
+    if (PackedArrayBlob::get(p_term, view))
+    {
+        r_operand.size = size_t(view.length * view.channels);
+        if (view.type == PackedArrayBlob::ElementType::FLOAT32)
+        {
+            r_operand.float32 = true;
+            r_operand.floats = reinterpret_cast<const float*>(view.data);
+        }
+        else if (view.type == PackedArrayBlob::ElementType::FLOAT64)
+        {
+            r_operand.doubles = reinterpret_cast<const double*>(view.data);
+        }
+        else
+        {
+            r_operand.double_buffer.resize(r_operand.size);
+            for (size_t i = 0; i < r_operand.size; i++)
+                r_operand.double_buffer[i] = view.number(int64_t(i));
+            r_operand.doubles = r_operand.double_buffer.data();
+        }
+        return true;
+    }
+
+    term_t head = PL_new_term_ref();
+    term_t tail = PL_copy_term_ref(p_term);
+    while (PL_get_list(tail, head, tail))
+    {
+        double value;
+        if (!PL_get_float(head, &value))
+            return PL_type_error("number", head);
+        r_operand.double_buffer.push_back(value);
+    }
+    if (!PL_get_nil(tail))
+        return PL_type_error("list", p_term);
+    PL_reset_term_refs(head);
+
+    r_operand.doubles = r_operand.double_buffer.data();
+    r_operand.size = r_operand.double_buffer.size();
+    return true;
+}
+
+/** Reads two vectors of the same length and element type. */
+bool get_operands(term_t p_a, term_t p_b, Operand& r_a, Operand& r_b)
+{
+    if (!get_operand(p_a, r_a) || !get_operand(p_b, r_b))
+        return false;
+    if (r_a.size != r_b.size)
+        return PL_domain_error("vector_of_same_length", p_b);
+    if (r_a.float32 != r_b.float32)
+    {
+        r_a.use_doubles();
+        r_b.use_doubles();
+    }
+    return true;
+}
+
+foreign_t pl_vec_dot(term_t p_a, term_t p_b, term_t p_dot)
+{
+    Operand a, b;
+    if (!get_operands(p_a, p_b, a, b))
+        return FALSE;
+    double dot = a.float32 ? SimdKernels::dot(a.floats, b.floats, a.size)
+                           : SimdKernels::dot(a.doubles, b.doubles, a.size);
+    return PL_unify_float(p_dot, dot);
+}
+
+foreign_t pl_vec_dist(term_t p_a, term_t p_b, term_t p_distance)
+{
+    Operand a, b;
+    if (!get_operands(p_a, p_b, a, b))
+        return FALSE;
+    double squared =
+        a.float32
+            ? SimdKernels::squared_distance(a.floats, b.floats, a.size)
+            : SimdKernels::squared_distance(a.doubles, b.doubles, a.size);
+    return PL_unify_float(p_distance, std::sqrt(squared));
+}
+
+foreign_t pl_vec_sum(term_t p_vector, term_t p_sum)
+{
+    Operand v;
+    if (!get_operand(p_vector, v))
+        return FALSE;
+    return PL_unify_float(p_sum,
+                          v.float32 ? SimdKernels::sum(v.floats, v.size)
+                                    : SimdKernels::sum(v.doubles, v.size));
+}
+
+foreign_t pl_argmin(term_t p_vector, term_t p_index)
+{
+    Operand v;
+    if (!get_operand(p_vector, v) || v.size == 0)
+        return FALSE;
+    size_t index = v.float32 ? SimdKernels::argmin(v.floats, v.size)
+                             : SimdKernels::argmin(v.doubles, v.size);
+    return PL_unify_int64(p_index, int64_t(index));
+}
+
+foreign_t pl_argmax(term_t p_vector, term_t p_index)
+{
+    Operand v;
+    if (!get_operand(p_vector, v) || v.size == 0)
+        return FALSE;
+    size_t index = v.float32 ? SimdKernels::argmax(v.floats, v.size)
+                             : SimdKernels::argmax(v.doubles, v.size);
+    return PL_unify_int64(p_index, int64_t(index));
+}
+
+/** Squared distances from the query to points stored one after another. */
+bool flat_distances(Operand& p_query,
+                    term_t p_points,
+                    std::vector<std::pair<double, size_t>>& r_distances)
+{
+    Operand points;
+    if (!get_operand(p_points, points))
+        return false;
+    size_t dimension = p_query.size;
+    if (points.size % dimension != 0)
+        return PL_domain_error("vector_of_points", p_points);
+
+    // The query is short: convert it rather than the points
+    if (points.float32)
+        p_query.use_floats();
+    else
+        p_query.use_doubles();
+
+    size_t count = points.size / dimension;
+    r_distances.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        double squared = points.float32
+                             ? SimdKernels::squared_distance(
+                                   p_query.floats,
+                                   points.floats + i * dimension,
+                                   dimension)
+                             : SimdKernels::squared_distance(
+                                   p_query.doubles,
+                                   points.doubles + i * dimension,
+                                   dimension);
+        r_distances[i] = { squared, i };
+    }
+    return true;
+}
+
+/** Squared distances from the query to each vector of a list. */
+bool list_distances(Operand& p_query,
+                    term_t p_points,
+                    std::vector<std::pair<double, size_t>>& r_distances)
+{
+    term_t head = PL_new_term_ref();
+    term_t tail = PL_copy_term_ref(p_points);
+    p_query.use_doubles();
+    while (PL_get_list(tail, head, tail))
+    {
+        Operand point;
+        if (!get_operand(head, point))
+            return false;
+        if (point.size != p_query.size)
+            return PL_domain_error("vector_of_same_length", head);
+        point.use_doubles();
+        double squared = SimdKernels::squared_distance(
+            p_query.doubles, point.doubles, point.size);
+        r_distances.emplace_back(squared, r_distances.size());
+    }
+    if (!PL_get_nil(tail))
+        return PL_type_error("list", p_points);
+    PL_reset_term_refs(head);
+    return true;
+}
+
+foreign_t
+pl_k_nearest(term_t p_query, term_t p_points, term_t p_k, term_t p_indexes)
+{
+    Operand query;
+    if (!get_operand(p_query, query))
+        return FALSE;
+    if (query.size == 0)
+        return PL_domain_error("non_empty_vector", p_query);
+
+    int64_t k;
+    if (!PL_get_int64_ex(p_k, &k))
+        return FALSE;
+    if (k < 0)
+        return PL_domain_error("not_less_than_zero", p_k);
+
+    // A flat vector (blob or list of numbers) or a list of vectors
+    std::vector<std::pair<double, size_t>> distances;
+    term_t first = PL_new_term_refs(2);
+    PackedArrayBlob::View view;
+    bool flat = PackedArrayBlob::get(p_points, view) ||
+                (PL_get_list(p_points, first, first + 1) &&
+                 PL_is_number(first));
+    if (!(flat ? flat_distances(query, p_points, distances)
+               : list_distances(query, p_points, distances)))
+    {
+        return FALSE;
+    }
+
+    // Ties keep the order of the points
+    size_t count = std::min(size_t(k), distances.size());
+    std::partial_sort(distances.begin(),
+                      distances.begin() + count,
+                      distances.end());
+
+    term_t list = PL_copy_term_ref(p_indexes);
+    term_t item = PL_new_term_ref();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!PL_unify_list(list, item, list) ||
+            !PL_unify_int64(item, int64_t(distances[i].second)))
+        {
+            return FALSE;
+        }
+    }
+    return PL_unify_nil(list);
+}
+
+} // namespace
+
+// =============================================================================
+// SimdKernels
+// =============================================================================
+
+double SimdKernels::dot(const double* p_a, const double* p_b, size_t p_size)
+{
+    return kernels<double>().dot(p_a, p_b, p_size);
+}
+
+double SimdKernels::dot(const float* p_a, const float* p_b, size_t p_size)
+{
+    return kernels<float>().dot(p_a, p_b, p_size);
+}
+
+double SimdKernels::squared_distance(const double* p_a,
+                                     const double* p_b,
+                                     size_t p_size)
+{
+    return kernels<double>().squared_distance(p_a, p_b, p_size);
+}
+
+double SimdKernels::squared_distance(const float* p_a,
+                                     const float* p_b,
+                                     size_t p_size)
+{
+    return kernels<float>().squared_distance(p_a, p_b, p_size);
+}
+
+double SimdKernels::sum(const double* p_values, size_t p_size)
+{
+    return kernels<double>().sum(p_values, p_size);
+}
+
+double SimdKernels::sum(const float* p_values, size_t p_size)
+{
+    return kernels<float>().sum(p_values, p_size);
+}
+
+size_t SimdKernels::argmin(const double* p_values, size_t p_size)
+{
+    return kernels<double>().argmin(p_values, p_size);
+}
+
+size_t SimdKernels::argmin(const float* p_values, size_t p_size)
+{
+    return kernels<float>().argmin(p_values, p_size);
+}
+
+size_t SimdKernels::argmax(const double* p_values, size_t p_size)
+{
+    return kernels<double>().argmax(p_values, p_size);
+}
+
+size_t SimdKernels::argmax(const float* p_values, size_t p_size)
+{
+    return kernels<float>().argmax(p_values, p_size);
+}
+
+void SimdKernels::bit_and(const uint64_t* p_a,
+                          const uint64_t* p_b,
+                          uint64_t* r_out,
+                          size_t p_words)
+{
+    bit_kernels().bit_and(p_a, p_b, r_out, p_words);
+}
+
+void SimdKernels::bit_or(const uint64_t* p_a,
+                         const uint64_t* p_b,
+                         uint64_t* r_out,
+                         size_t p_words)
+{
+    bit_kernels().bit_or(p_a, p_b, r_out, p_words);
+}
+
+void SimdKernels::bit_and_not(const uint64_t* p_a,
+                              const uint64_t* p_b,
+                              uint64_t* r_out,
+                              size_t p_words)
+{
+    bit_kernels().bit_and_not(p_a, p_b, r_out, p_words);
+}
+
+size_t SimdKernels::popcount(const uint64_t* p_values, size_t p_words)
+{
+    return bit_kernels().popcount(p_values, p_words);
+}
+
+const char* SimdKernels::backend()
+{
+    switch (current_backend())
+    {
+        case Backend::AVX:
+            return "avx";
+        case Backend::SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
+
+void SimdKernels::register_predicates()
+{
+    PL_register_foreign_in_module(
+        "user", "vec_dot", 3, (pl_function_t)pl_vec_dot, 0);
+    PL_register_foreign_in_module(
+        "user", "vec_dist", 3, (pl_function_t)pl_vec_dist, 0);
+    PL_register_foreign_in_module(
+        "user", "vec_sum", 2, (pl_function_t)pl_vec_sum, 0);
+    PL_register_foreign_in_module(
+        "user", "argmin", 2, (pl_function_t)pl_argmin, 0);
+    PL_register_foreign_in_module(
+        "user", "argmax", 2, (pl_function_t)pl_argmax, 0);
+    PL_register_foreign_in_module(
+        "user", "k_nearest", 4, (pl_function_t)pl_k_nearest, 0);
+}
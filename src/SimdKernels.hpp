@@ -0,0 +1,97 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the SimdKernels class: vectorised numeric kernels
+ * exposed to Prolog as foreign predicates.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class SimdKernels
+ * @brief Numeric kernels over contiguous vectors, with AVX, SSE2 and
+ * scalar implementations.
+ *
+ * The implementation is chosen once: AVX when the CPU supports it (checked
+ * at runtime with GCC and Clang on x86, at compile time otherwise), else
+ * SSE2 on x86, else plain C++. Float vectors are widened to double before
+ * accumulating, so all the implementations return the same results up to
+ * rounding.
+ *
+ * Foreign predicates (registered in the user module) accept Prolog lists
+ * of numbers or packed array blobs (see PackedArrayBlob) and return floats;
+ * indexes are 0-based:
+ * - vec_dot(+A, +B, -Dot): dot product (also a weighted sum).
+ * - vec_dist(+A, +B, -Dist): Euclidean distance.
+ * - vec_sum(+V, -Sum): sum of the elements.
+ * - argmin(+V, -Index), argmax(+V, -Index): index of the first smallest
+ *   (largest) element; fail on empty vectors.
+ * - k_nearest(+Query, +Points, +K, -Indexes): indexes of the K points
+ *   closest to Query, nearest first. Points is a list of vectors, or a flat
+ *   vector holding one point every length(Query) elements.
+ */
+class SimdKernels
+{
+public:
+
+    /** Dot product of two vectors of p_size elements. */
+    static double dot(const double* p_a, const double* p_b, size_t p_size);
+    static double dot(const float* p_a, const float* p_b, size_t p_size);
+
+    /** Squared Euclidean distance between two vectors. */
+    static double squared_distance(const double* p_a,
+                                   const double* p_b,
+                                   size_t p_size);
+    static double squared_distance(const float* p_a,
+                                   const float* p_b,
+                                   size_t p_size);
+
+    /** Sum of the elements of a vector. */
+    static double sum(const double* p_values, size_t p_size);
+    static double sum(const float* p_values, size_t p_size);
+
+    /** Index of the first smallest element (p_size must not be 0). */
+    static size_t argmin(const double* p_values, size_t p_size);
+    static size_t argmin(const float* p_values, size_t p_size);
+
+    /** Index of the first largest element (p_size must not be 0). */
+    static size_t argmax(const double* p_values, size_t p_size);
+    static size_t argmax(const float* p_values, size_t p_size);
+
+    /** Word-wise r_out = p_a & p_b (r_out may be one of the inputs). */
+    static void bit_and(const uint64_t* p_a,
+                        const uint64_t* p_b,
+                        uint64_t* r_out,
+                        size_t p_words);
+
+    /** Word-wise r_out = p_a | p_b. */
+    static void bit_or(const uint64_t* p_a,
+                       const uint64_t* p_b,
+                       uint64_t* r_out,
+                       size_t p_words);
+
+    /** Word-wise r_out = p_a & ~p_b. */
+    static void bit_and_not(const uint64_t* p_a,
+                            const uint64_t* p_b,
+                            uint64_t* r_out,
+                            size_t p_words);
+
+    /** Number of bits set in p_words words. */
+    static size_t popcount(const uint64_t* p_values, size_t p_words);
+
+    /**
+     * @brief Name of the implementation in use: "avx", "sse2" or "scalar".
+     */
+    static const char* backend();
+
+    /**
+     * @brief Registers the vec_* foreign predicates.
+     */
+    static void register_predicates();
+};
@@ -0,0 +1,599 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the TileMapFacts class.
+ */
+
+#include "TileMapFacts.hpp"
+#include "FactLoader.hpp"
+#include "FactTable.hpp"
+#include "Prologot.hpp"
+#include <godot_cpp/classes/grid_map.hpp>
+#include <godot_cpp/classes/tile_data.hpp>
+#include <godot_cpp/classes/tile_map_layer.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/vector2i.hpp>
+#include <godot_cpp/variant/vector3i.hpp>
+
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+/** Value stored in an argument of the facts. */
+enum class Field
+{
+    X,
+    Y,
+    Z,
+    SOURCE,
+    ATLAS_X,
+    ATLAS_Y,
+    ALTERNATIVE,
+    ITEM,
+    ORIENTATION,
+    DATA
+};
+
+struct FieldSpec
+{
+    Field field;
+    //! Custom data layer name (Field::DATA).
+    String data_layer;
+    //! Fact table column type.
+    String column_type = "int";
+};
+
+/** How a map was imported, kept for sync(). */
+struct Layout
+{
+    bool grid = false;
+    bool table = false;
+    std::vector<FieldSpec> fields;
+};
+
+/** Cell of a TileMapLayer (z unused) or of a GridMap. */
+struct Cell
+{
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t z = 0;
+    int32_t source = -1;
+    int32_t atlas_x = -1;
+    int32_t atlas_y = -1;
+    int32_t alternative = 0;
+    int32_t item = -1;
+    int32_t orientation = 0;
+};
+
+std::unordered_map<std::string, Layout> s_layouts;
+std::mutex s_mutex;
+
+/** Key of an import in s_layouts: the module, then the functor. */
+std::string layout_key(module_t p_module, String const& p_functor)
+{
+    std::string key =
+        (p_module != NULL) ? PL_atom_chars(PL_module_name(p_module)) : "user";
+    return key + ":" + p_functor.utf8().get_data();
+}
+
+// -----------------------------------------------------------------------------
+// Reading the maps
+// -----------------------------------------------------------------------------
+
+uint16_t read_u16(const uint8_t* p_bytes)
+{
+    return uint16_t(p_bytes[0] | (p_bytes[1] << 8));
+}
+
+Cell read_tile_cell(TileMapLayer* p_layer, Vector2i const& p_coords)
+{
+    Cell cell;
+    cell.x = p_coords.x;
+    cell.y = p_coords.y;
+    cell.source = p_layer->get_cell_source_id(p_coords);
+    Vector2i atlas = p_layer->get_cell_atlas_coords(p_coords);
+    cell.atlas_x = atlas.x;
+    cell.atlas_y = atlas.y;
+    cell.alternative = p_layer->get_cell_alternative_tile(p_coords);
+    return cell;
+}
+
+Cell read_grid_cell(GridMap* p_grid, Vector3i const& p_coords)
+{
+    Cell cell;
+    cell.x = p_coords.x;
+    cell.y = p_coords.y;
+    cell.z = p_coords.z;
+    cell.item = p_grid->get_cell_item(p_coords);
+    cell.orientation = p_grid->get_cell_item_orientation(p_coords);
+    return cell;
+}
+
+void read_tile_cells(TileMapLayer* p_layer, std::vector<Cell>& r_cells)
+{
+    // Fast path: the whole layer serialized by a single call. Format 0 is
+    // a uint16 version followed by 12 bytes per cell (little endian): int16
+    // x, int16 y, uint16 source, atlas x, atlas y and alternative.
+    PackedByteArray data = p_layer->get_tile_map_data_as_array();
+    const uint8_t* bytes = data.ptr();
+    if (data.size() >= 2 && (data.size() - 2) % 12 == 0 &&
+        read_u16(bytes) == 0)
+    {
+        size_t count = size_t(data.size() - 2) / 12;
+        r_cells.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint8_t* entry = bytes + 2 + i * 12;
+            Cell& cell = r_cells[i];
+            cell.x = int16_t(read_u16(entry));
+            cell.y = int16_t(read_u16(entry + 2));
+            cell.source = read_u16(entry + 4);
+            cell.atlas_x = read_u16(entry + 6);
+            cell.atlas_y = read_u16(entry + 8);
+            cell.alternative = read_u16(entry + 10);
+        }
+        return;
+    }
+
+    Array used = p_layer->get_used_cells();
+    r_cells.resize(size_t(used.size()));
+    for (int64_t i = 0; i < used.size(); i++)
+        r_cells[size_t(i)] = read_tile_cell(p_layer, used[i]);
+}
+
+void read_grid_cells(GridMap* p_grid, std::vector<Cell>& r_cells)
+{
+    Array used = p_grid->get_used_cells();
+    r_cells.resize(size_t(used.size()));
+    for (int64_t i = 0; i < used.size(); i++)
+        r_cells[size_t(i)] = read_grid_cell(p_grid, used[i]);
+}
+
+int32_t int_field(Cell const& p_cell, Field p_field)
+{
+    switch (p_field)
+    {
+        case Field::X:
+            return p_cell.x;
+        case Field::Y:
+            return p_cell.y;
+        case Field::Z:
+            return p_cell.z;
+        case Field::SOURCE:
+            return p_cell.source;
+        case Field::ATLAS_X:
+            return p_cell.atlas_x;
+        case Field::ATLAS_Y:
+            return p_cell.atlas_y;
+        case Field::ALTERNATIVE:
+            return p_cell.alternative;
+        case Field::ITEM:
+            return p_cell.item;
+        case Field::ORIENTATION:
+            return p_cell.orientation;
+        default:
+            return 0;
+    }
+}
+
+Variant custom_data(Node* p_map, Cell const& p_cell, String const& p_layer)
+{
+    TileMapLayer* layer = Object::cast_to<TileMapLayer>(p_map);
+    TileData* data = layer->get_cell_tile_data(Vector2i(p_cell.x, p_cell.y));
+    return (data != nullptr) ? data->get_custom_data(p_layer) : Variant();
+}
+
+// -----------------------------------------------------------------------------
+// Layout
+// -----------------------------------------------------------------------------
+
+bool parse_fields(Variant const& p_names, Layout& r_layout, String& r_error)
+{
+    PackedStringArray names = p_names;
+    if (p_names.get_type() == Variant::NIL)
+    {
+        static const char* tile_fields[] = {
+            "x", "y", "source", "atlas_x", "atlas_y"
+        };
+        static const char* grid_fields[] = { "x", "y", "z", "item" };
+        if (r_layout.grid)
+        {
+            for (const char* name : grid_fields)
+                names.push_back(name);
+        }
+        else
+        {
+            for (const char* name : tile_fields)
+                names.push_back(name);
+        }
+    }
+
+    bool has_x = false, has_y = false, has_z = false;
+    for (int64_t i = 0; i < names.size(); i++)
+    {
+        String name = names[i];
+        FieldSpec spec;
+        if (name == "x")
+            spec.field = Field::X, has_x = true;
+        else if (name == "y")
+            spec.field = Field::Y, has_y = true;
+        else if (name == "z" && r_layout.grid)
+            spec.field = Field::Z, has_z = true;
+        else if (name == "item" && r_layout.grid)
+            spec.field = Field::ITEM;
+        else if (name == "orientation" && r_layout.grid)
+            spec.field = Field::ORIENTATION;
+        else if (name == "source" && !r_layout.grid)
+            spec.field = Field::SOURCE;
+        else if (name == "atlas_x" && !r_layout.grid)
+            spec.field = Field::ATLAS_X;
+        else if (name == "atlas_y" && !r_layout.grid)
+            spec.field = Field::ATLAS_Y;
+        else if (name == "alternative" && !r_layout.grid)
+            spec.field = Field::ALTERNATIVE;
+        else if (name.begins_with("data:") && !r_layout.grid)
+        {
+            spec.field = Field::DATA;
+            spec.data_layer = name.substr(5);
+        }
+        else
+        {
+            r_error = "Unknown " +
+                      String(r_layout.grid ? "GridMap" : "TileMapLayer") +
+                      " field: " + name;
+            return false;
+        }
+        r_layout.fields.push_back(spec);
+    }
+
+    if (!has_x || !has_y || (r_layout.grid && !has_z))
+    {
+        r_error = "The fields must include the cell coordinates";
+        return false;
+    }
+    return true;
+}
+
+/** Fact table column types: custom data typed after its first value. */
+void infer_column_types(Node* p_map,
+                        std::vector<Cell> const& p_cells,
+                        Layout& r_layout)
+{
+    for (FieldSpec& spec : r_layout.fields)
+    {
+        if (spec.field != Field::DATA)
+            continue;
+        spec.column_type = "atom";
+        for (Cell const& cell : p_cells)
+        {
+            Variant value = custom_data(p_map, cell, spec.data_layer);
+            if (value.get_type() == Variant::NIL)
+                continue;
+            if (value.get_type() == Variant::INT)
+                spec.column_type = "int";
+            else if (value.get_type() == Variant::FLOAT)
+                spec.column_type = "float";
+            break;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Storing the cells
+// -----------------------------------------------------------------------------
+
+/** One column per field, in the formats accepted by FactTable::append(). */
+Array table_columns(Node* p_map,
+                    Layout const& p_layout,
+                    std::vector<Cell> const& p_cells)
+{
+    Array columns;
+    for (FieldSpec const& spec : p_layout.fields)
+    {
+        if (spec.field != Field::DATA)
+        {
+            PackedInt32Array values;
+            values.resize(int64_t(p_cells.size()));
+            int32_t* cells = values.ptrw();
+            for (size_t i = 0; i < p_cells.size(); i++)
+                cells[i] = int_field(p_cells[i], spec.field);
+            columns.push_back(values);
+            continue;
+        }
+
+        // Missing custom data: 0 in numeric columns, [] in atom columns
+        Array values;
+        for (Cell const& cell : p_cells)
+        {
+            Variant value = custom_data(p_map, cell, spec.data_layer);
+            if (value.get_type() == Variant::NIL)
+                value = (spec.column_type == "atom") ? Variant("[]")
+                                                     : Variant(0);
+            values.push_back(value);
+        }
+        columns.push_back(values);
+    }
+    return columns;
+}
+
+int64_t assert_cells(Node* p_map,
+                     String const& p_functor,
+                     module_t p_module,
+                     Layout const& p_layout,
+                     std::vector<Cell> const& p_cells,
+                     String& r_error)
+{
+    return FactLoader::assert_rows(
+        p_functor,
+        p_module,
+        p_layout.fields.size(),
+        p_cells.size(),
+        [&](size_t p_row, term_t p_args)
+        {
+            Cell const& cell = p_cells[p_row];
+            for (size_t i = 0; i < p_layout.fields.size(); i++)
+            {
+                FieldSpec const& spec = p_layout.fields[i];
+                if (spec.field != Field::DATA)
+                {
+                    if (!PL_put_int64(p_args + i, int_field(cell, spec.field)))
+                        return false;
+                    continue;
+                }
+                term_t value = Prologot::variant_to_term(
+                    custom_data(p_map, cell, spec.data_layer));
+                if (!value || !PL_put_term(p_args + i, value))
+                    return false;
+            }
+            return true;
+        },
+        r_error);
+}
+
+/**
+ * Retracts the facts of a cell, or all the facts if p_cell is nullptr, from
+ * p_module (the context module of retractall/1). retractall/1 also declares
+ * the predicate dynamic if it does not exist.
+ */
+bool retract_cells(String const& p_functor,
+                   module_t p_module,
+                   Layout const& p_layout,
+                   Cell const* p_cell)
+{
+    // Looked up on each call: handles do not survive PL_cleanup()
+    predicate_t retractall = PL_predicate("retractall", 1, "user");
+
+    CharString name = p_functor.utf8();
+    fid_t fid = PL_open_foreign_frame();
+    size_t arity = p_layout.fields.size();
+    term_t args = PL_new_term_refs(arity);
+    term_t head = PL_new_term_ref();
+    bool ok = true;
+    for (size_t i = 0; i < arity && p_cell != nullptr && ok; i++)
+    {
+        Field field = p_layout.fields[i].field;
+        if (field == Field::X || field == Field::Y || field == Field::Z)
+            ok = PL_put_int64(args + i, int_field(*p_cell, field));
+    }
+    ok = ok &&
+         PL_cons_functor_v(
+             head,
+             PL_new_functor(
+                 PL_new_atom_mbchars(REP_UTF8, name.length(), name.get_data()),
+                 arity),
+             args) &&
+         PL_call_predicate(
+             p_module, PL_Q_CATCH_EXCEPTION, retractall, head);
+    PL_clear_exception();
+    PL_discard_foreign_frame(fid);
+    return ok;
+}
+
+/** Fact table key selecting the row of a cell (null for other columns). */
+Array cell_key(Layout const& p_layout, Cell const& p_cell)
+{
+    Array key;
+    for (FieldSpec const& spec : p_layout.fields)
+    {
+        Field field = spec.field;
+        if (field == Field::X || field == Field::Y || field == Field::Z)
+            key.push_back(int_field(p_cell, field));
+        else
+            key.push_back(Variant());
+    }
+    return key;
+}
+
+} // namespace
+
+// =============================================================================
+// TileMapFacts
+// =============================================================================
+
+int64_t TileMapFacts::import(Node* p_map,
+                             String const& p_functor,
+                             module_t p_module,
+                             Dictionary const& p_options,
+                             String& r_error)
+{
+    TileMapLayer* layer = Object::cast_to<TileMapLayer>(p_map);
+    GridMap* grid = Object::cast_to<GridMap>(p_map);
+    if (layer == nullptr && grid == nullptr)
+    {
+        r_error = "import_tilemap expects a TileMapLayer or a GridMap";
+        return -1;
+    }
+    if (p_functor.is_empty())
+    {
+        r_error = "Empty functor";
+        return -1;
+    }
+
+    Layout layout;
+    layout.grid = (grid != nullptr);
+    layout.table = p_options.get("table", false);
+    if (!parse_fields(p_options.get("fields", Variant()), layout, r_error))
+        return -1;
+
+    std::vector<Cell> cells;
+    if (layer != nullptr)
+        read_tile_cells(layer, cells);
+    else
+        read_grid_cells(grid, cells);
+
+    int64_t count;
+    if (layout.table)
+    {
+        // Index the coordinates unless told otherwise
+        infer_column_types(p_map, cells, layout);
+        PackedStringArray types;
+        PackedInt32Array indexes;
+        for (size_t i = 0; i < layout.fields.size(); i++)
+        {
+            types.push_back(layout.fields[i].column_type);
+            if (layout.fields[i].field <= Field::Z)
+                indexes.push_back(int32_t(i));
+        }
+        indexes = p_options.get("indexes", indexes);
+
+        std::shared_ptr<FactTable> table =
+            FactTable::create(p_functor,
+                              types,
+                              table_columns(p_map, layout, cells),
+                              indexes,
+                              r_error);
+        if (table == nullptr)
+            return -1;
+        count = int64_t(table->row_count());
+    }
+    else
+    {
+        if (!retract_cells(p_functor, p_module, layout, nullptr))
+        {
+            r_error = "Cannot replace the " + p_functor + " facts";
+            return -1;
+        }
+        count = assert_cells(
+            p_map, p_functor, p_module, layout, cells, r_error);
+        if (count < 0)
+            return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_layouts[layout_key(p_module, p_functor)] = layout;
+    return count;
+}
+
+int64_t TileMapFacts::sync(Node* p_map,
+                           String const& p_functor,
+                           module_t p_module,
+                           Array const& p_cells,
+                           String& r_error)
+{
+    Layout layout;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto it = s_layouts.find(layout_key(p_module, p_functor));
+        if (it == s_layouts.end())
+        {
+            r_error = "No map imported as " + p_functor;
+            return -1;
+        }
+        layout = it->second;
+    }
+
+    TileMapLayer* layer = Object::cast_to<TileMapLayer>(p_map);
+    GridMap* grid = Object::cast_to<GridMap>(p_map);
+    if ((layout.grid ? (void*)grid : (void*)layer) == nullptr)
+    {
+        r_error = "The map does not match the " + p_functor + " import";
+        return -1;
+    }
+
+    // Read each listed cell once
+    std::vector<std::array<int32_t, 3>> coords;
+    for (int64_t i = 0; i < p_cells.size(); i++)
+    {
+        Variant const& value = p_cells[i];
+        if (layout.grid && value.get_type() == Variant::VECTOR3I)
+        {
+            Vector3i c = value;
+            coords.push_back({ c.x, c.y, c.z });
+        }
+        else if (!layout.grid && value.get_type() == Variant::VECTOR2I)
+        {
+            Vector2i c = value;
+            coords.push_back({ c.x, c.y, 0 });
+        }
+        else
+        {
+            r_error = String("Expected ") +
+                      (layout.grid ? "Vector3i" : "Vector2i") +
+                      " cell coordinates";
+            return -1;
+        }
+    }
+    std::sort(coords.begin(), coords.end());
+    coords.erase(std::unique(coords.begin(), coords.end()), coords.end());
+
+    std::shared_ptr<FactTable> table;
+    if (layout.table)
+    {
+        table = FactTable::find(p_functor);
+        if (table == nullptr)
+        {
+            r_error = "Unknown fact table: " + p_functor;
+            return -1;
+        }
+    }
+
+    // Remove the old facts, then store the cells that are still used
+    std::vector<Cell> used;
+    for (auto const& c : coords)
+    {
+        Cell cell = layout.grid
+                        ? read_grid_cell(grid, Vector3i(c[0], c[1], c[2]))
+                        : read_tile_cell(layer, Vector2i(c[0], c[1]));
+        bool removed = layout.table
+                           ? table->remove(cell_key(layout, cell), r_error) >= 0
+                           : retract_cells(p_functor, p_module, layout, &cell);
+        if (!removed)
+        {
+            if (r_error.is_empty())
+                r_error = "Cannot update the " + p_functor + " facts";
+            return -1;
+        }
+        if (layout.grid ? (cell.item >= 0) : (cell.source >= 0))
+            used.push_back(cell);
+    }
+
+    if (layout.table)
+    {
+        if (!used.empty() &&
+            !table->append(table_columns(p_map, layout, used), r_error))
+        {
+            return -1;
+        }
+    }
+    else if (assert_cells(
+                 p_map, p_functor, p_module, layout, used, r_error) < 0)
+    {
+        return -1;
+    }
+    return int64_t(coords.size());
+}
+
+void TileMapFacts::forget_all()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_layouts.clear();
+}
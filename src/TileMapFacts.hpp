@@ -0,0 +1,78 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the TileMapFacts class: the cells of a TileMapLayer or
+ * a GridMap mirrored as Prolog facts.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+#include <godot_cpp/classes/node.hpp>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+using namespace godot;
+
+/**
+ * @class TileMapFacts
+ * @brief Reads the cells of a map natively and stores one fact per cell.
+ *
+ * A cell gives a fact whose arguments are the requested fields, e.g.
+ * tile(X, Y, SourceId, AtlasX, AtlasY). The facts are either asserted
+ * clauses of a module or the rows of a FactTable. The import is remembered
+ * by module and functor so that changed cells can be synchronized one by
+ * one afterwards.
+ *
+ * Fields of a TileMapLayer: "x", "y", "source", "atlas_x", "atlas_y",
+ * "alternative" and "data:<layer>" (value of a custom data layer of the
+ * TileSet). Fields of a GridMap: "x", "y", "z", "item", "orientation". The
+ * coordinate fields are mandatory.
+ */
+class TileMapFacts
+{
+public:
+
+    /**
+     * @brief Stores the used cells of a map as facts, replacing the facts
+     * of a previous import.
+     *
+     * @param p_map TileMapLayer or GridMap.
+     * @param p_functor Functor of the facts.
+     * @param p_module Module of the clauses (NULL for user).
+     * @param p_options "fields" (field names), "table" (true for a fact
+     * table) and "indexes" (columns to index in table mode).
+     * @param r_error Error message on failure.
+     * @return The number of facts, or -1 on failure.
+     */
+    static int64_t import(Node* p_map,
+                          String const& p_functor,
+                          module_t p_module,
+                          Dictionary const& p_options,
+                          String& r_error);
+
+    /**
+     * @brief Updates the facts of some cells after they changed in the map.
+     *
+     * @param p_map Map given to import().
+     * @param p_functor Functor given to import().
+     * @param p_module Module given to import().
+     * @param p_cells Coordinates of the cells (Vector2i or Vector3i).
+     * @param r_error Error message on failure.
+     * @return The number of cells updated, or -1 on failure.
+     */
+    static int64_t sync(Node* p_map,
+                        String const& p_functor,
+                        module_t p_module,
+                        Array const& p_cells,
+                        String& r_error);
+
+    /**
+     * @brief Forgets all the imports (called before shutting down Prolog).
+     */
+    static void forget_all();
+};
@@ -0,0 +1,110 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file implements the TimerWheel class.
+ */
+
+#include "TimerWheel.hpp"
+
+#include <cmath>
+
+// =============================================================================
+// TimerWheel
+// =============================================================================
+
+TimerWheel::~TimerWheel()
+{
+    // Records belong to Prolog: clear() must have been called before
+    // PL_cleanup(), so only forget them here
+    for (auto& level : m_levels)
+    {
+        for (Slot& slot : level)
+            slot.clear();
+    }
+}
+
+void TimerWheel::schedule(double p_seconds, record_t p_record)
+{
+    double ticks = std::ceil(p_seconds / RESOLUTION);
+    uint64_t delay = (ticks < 1.0) ? 1 : uint64_t(ticks);
+    insert({m_now + delay, p_record});
+    m_size++;
+}
+
+void TimerWheel::advance(double p_seconds, std::vector<record_t>& r_expired)
+{
+    if (p_seconds > 0.0)
+        m_remainder += p_seconds;
+    uint64_t ticks = uint64_t(m_remainder / RESOLUTION);
+    m_remainder -= double(ticks) * RESOLUTION;
+
+    Slot cascaded;
+    for (; ticks > 0 && m_size > 0; ticks--)
+    {
+        m_now++;
+
+        // Each level wrapping around cascades the next slot of the level
+        // above: its timers are now close enough for the lower levels
+        for (int level = 1; level < LEVELS; level++)
+        {
+            if ((m_now & ((uint64_t(1) << (BITS * level)) - 1)) != 0)
+                break;
+            size_t index = (m_now >> (BITS * level)) & (SLOTS - 1);
+            cascaded.swap(m_levels[level][index]);
+            for (Timer const& timer : cascaded)
+                insert(timer);
+            cascaded.clear();
+        }
+
+        Slot& slot = m_levels[0][m_now & (SLOTS - 1)];
+        for (Timer const& timer : slot)
+            r_expired.push_back(timer.record);
+        m_size -= slot.size();
+        slot.clear();
+    }
+
+    // Nothing left to expire: skip the remaining ticks at once
+    m_now += ticks;
+}
+
+size_t TimerWheel::size() const
+{
+    return m_size;
+}
+
+void TimerWheel::clear()
+{
+    for (auto& level : m_levels)
+    {
+        for (Slot& slot : level)
+        {
+            for (Timer const& timer : slot)
+                PL_erase(timer.record);
+            slot.clear();
+        }
+    }
+    m_size = 0;
+}
+
+void TimerWheel::insert(Timer const& p_timer)
+{
+    uint64_t delay = (p_timer.expiry > m_now) ? p_timer.expiry - m_now : 0;
+    for (int level = 0; level < LEVELS; level++)
+    {
+        if (delay < (uint64_t(1) << (BITS * (level + 1))))
+        {
+            size_t index = (p_timer.expiry >> (BITS * level)) & (SLOTS - 1);
+            m_levels[level][index].push_back(p_timer);
+            return;
+        }
+    }
+
+    // Beyond the wheel: wait in the last slot reached by the top level, the
+    // timer is placed again when this slot is cascaded
+    uint64_t horizon = m_now + (uint64_t(1) << (BITS * LEVELS)) - 1;
+    size_t index = (horizon >> (BITS * (LEVELS - 1))) & (SLOTS - 1);
+    m_levels[LEVELS - 1][index].push_back(p_timer);
+}
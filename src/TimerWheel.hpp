@@ -0,0 +1,101 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Lecrapouille <lecrapouille@gmail.com>
+ *
+ * Prologot - SWI-Prolog integration for Godot 4
+ *
+ * This file defines the TimerWheel class: a hierarchical timer wheel
+ * scheduling the expiry of facts.
+ */
+
+#pragma once
+
+#include <SWI-Prolog.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class TimerWheel
+ * @brief Hierarchical timer wheel of Prolog records.
+ *
+ * Time advances by ticks of RESOLUTION seconds. The wheel has LEVELS levels
+ * of SLOTS slots: level 0 holds the timers expiring within SLOTS ticks, one
+ * slot per tick; each next level covers SLOTS times more ticks per slot.
+ * When a level wraps around, the next slot of the level above is cascaded
+ * down. Scheduling is O(1) and advancing costs O(ticks + expired timers):
+ * timers are never scanned for their expiry time.
+ *
+ * With 10 ms ticks and 4 levels of 64 slots, the wheel covers 46 hours;
+ * longer timers wait in the top level and are cascaded again.
+ */
+class TimerWheel
+{
+public:
+
+    /** Duration of a tick in seconds. */
+    static constexpr double RESOLUTION = 0.01;
+
+    ~TimerWheel();
+
+    /**
+     * @brief Schedules a record to expire after a delay.
+     *
+     * @param p_seconds Delay, rounded up to whole ticks (at least one).
+     * @param p_record Record given back by advance(), owned by the wheel
+     * until then.
+     */
+    void schedule(double p_seconds, record_t p_record);
+
+    /**
+     * @brief Advances the time and collects the expired records.
+     *
+     * @param p_seconds Elapsed time (e.g., the frame delta).
+     * @param r_expired Receives the expired records, in expiry order. The
+     * caller owns them.
+     */
+    void advance(double p_seconds, std::vector<record_t>& r_expired);
+
+    /**
+     * @brief Number of scheduled records.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Erases all the scheduled records (called before shutting down
+     * Prolog).
+     */
+    void clear();
+
+private:
+
+    static constexpr int LEVELS = 4;
+    static constexpr int BITS = 6;
+    static constexpr uint64_t SLOTS = uint64_t(1) << BITS;
+
+    struct Timer
+    {
+        //! Tick at which the timer expires.
+        uint64_t expiry;
+        record_t record;
+    };
+
+    using Slot = std::vector<Timer>;
+
+    /** Places a timer in the slot matching its distance to m_now. */
+    void insert(Timer const& p_timer);
+
+private:
+
+    std::array<std::array<Slot, SLOTS>, LEVELS> m_levels;
+
+    /** Current tick. */
+    uint64_t m_now = 0;
+
+    /** Elapsed time not yet converted to ticks. */
+    double m_remainder = 0.0;
+
+    size_t m_size = 0;
+};
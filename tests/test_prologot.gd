@@ -51,6 +51,7 @@ func _ready() -> void:
 ## Run all test suites.
 func run_all_tests() -> void:
 	test_initialization()
+	test_startup_profile()
 	test_basic_queries()
 	test_fact_management()
 	test_rules()
@@ -60,6 +61,30 @@ func run_all_tests() -> void:
 	test_euclidean_distance()
 	test_tracking_with_distance()
 	test_error_handling()
+	test_fact_tables()
+	test_fact_files()
+	test_bulk_loading()
+	test_json_terms()
+	test_object_handles()
+	test_packed_array_blobs()
+	test_vector_predicates()
+	test_bitsets()
+	test_tilemap_import()
+	test_scene_tree_mirror()
+	test_goap_planner()
+	test_clpfd_solve()
+	test_forward_rules()
+	test_chr_store()
+	test_blackboard()
+	test_expiring_facts()
+	test_thread_local_scratch()
+	test_module_overlays()
+	test_parallel_call()
+	test_error_records()
+	test_lazy_exceptions()
+	test_output_capture()
+	test_query_cursors()
+	test_benchmark()
 
 	# Demo examples tests
 	test_demo_01_basic_queries()
@@ -168,6 +193,48 @@ func test_initialization() -> void:
 	prolog = null
 
 
+# =============================================================================
+# Test: Startup Profile
+# =============================================================================
+
+func test_startup_profile() -> void:
+	print("\n[Test Suite: Startup Profile]")
+
+	prolog = Prologot.new()
+	assert_true(prolog.get_startup_profile().is_empty(), "No profile before initialize()")
+
+	# Startup goals are timed in their own phase
+	var init_result: bool = prolog.initialize({"goal": "assertz(started(yes))"})
+	assert_true(init_result, "Initialization with a startup goal succeeds")
+	assert_true(prolog.query("started(yes)"), "Startup goal was run")
+
+	var profile: Dictionary = prolog.get_startup_profile()
+	for phase in ["home dir", "arguments", "PL_initialise", "packs", "home flag", "bootstrap", "script file", "goals", "total"]:
+		assert_true(profile.has(phase), "Profile has phase '%s'" % phase)
+	assert_true(profile["total"] >= profile["PL_initialise"], "Total covers PL_initialise")
+	assert_true(prolog.query("current_prolog_flag(packs, true)"), "Deferred packs are flagged enabled")
+	print("    Startup profile: ", profile)
+
+	prolog.cleanup()
+	prolog = null
+
+	# An init file runs inside PL_initialise(), once the packs are attached
+	var init_path := "user://test_init.pl"
+	var init_file := FileAccess.open(init_path, FileAccess.WRITE)
+	init_file.store_string(":- assertz(from_init(yes)).\n")
+	init_file.close()
+	prolog = Prologot.new()
+	assert_true(prolog.initialize({"init file": ProjectSettings.globalize_path(init_path)}), "Initialization with an init file succeeds")
+	assert_true(prolog.query("from_init(yes)"), "Init file was run")
+	profile = prolog.get_startup_profile()
+	assert_true(profile.has("PL_initialise + packs"), "Packs are timed with PL_initialise")
+	assert_false(profile.has("packs"), "No separate packs phase")
+
+	prolog.cleanup()
+	prolog = null
+	DirAccess.remove_absolute(ProjectSettings.globalize_path(init_path))
+
+
 # =============================================================================
 # Test: Basic Queries
 # =============================================================================
@@ -558,6 +625,1207 @@ func test_error_handling() -> void:
 	teardown_prolog()
 
 
+# =============================================================================
+# Test: Fact Tables
+# =============================================================================
+
+func test_fact_tables() -> void:
+	print("\n[Test Suite: Fact Tables]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	# A 3x2 map: tile(X, Y, Type, Cost)
+	var xs := PackedInt32Array([0, 1, 2, 0, 1, 2])
+	var ys := PackedInt32Array([0, 0, 0, 1, 1, 1])
+	var types := PackedStringArray(["grass", "water", "grass", "rock", "grass", "water"])
+	var costs := PackedFloat32Array([1.0, 5.0, 1.0, 3.0, 1.0, 5.0])
+	var created := prolog.create_fact_table("tile", ["int", "int", "atom", "float"], [xs, ys, types, costs], [0, 2])
+	assert_true(created, "Fact table created")
+	assert_equal(prolog.get_fact_table_size("tile"), 6, "Fact table has 6 rows")
+
+	# Queries through the foreign predicate
+	assert_true(prolog.query("tile(1, 0, water, 5.0)"), "Ground row found")
+	assert_false(prolog.query("tile(1, 0, grass, _)"), "Wrong type fails")
+	assert_false(prolog.query("tile(9, 9, _, _)"), "Unknown index key fails")
+	assert_false(prolog.query("tile(_, _, lava, _)"), "Unknown atom fails")
+
+	var water: Array = prolog.query_all("tile", ["X", "Y", "water", "_"])
+	assert_equal(water.size(), 2, "Two water tiles (indexed atom column)")
+
+	var row: Variant = prolog.query_one("tile(2, 1, T, C)")
+	assert_true(row is Dictionary and row["args"][2] == "water", "Lookup by X and Y")
+
+	var count: Variant = prolog.query_one("aggregate_all(count, tile(_, _, grass, _), N)")
+	assert_equal(count["args"][2], 3, "Three grass tiles")
+
+	# Repeated variables are unified, not only bound arguments
+	assert_true(prolog.query("tile(X, X, grass, _)"), "tile(X, X, ...) matches (0,0) and (1,1)")
+	assert_equal(prolog.query_all("tile", ["X", "X", "_", "_"]).size(), 2, "Two diagonal tiles")
+
+	# Rules can use the table like any predicate
+	prolog.consult_string("walkable(X, Y) :- tile(X, Y, T, _), T \\== water.")
+	assert_true(prolog.query("walkable(0, 1)"), "Rule over the fact table")
+	assert_false(prolog.query("walkable(1, 0)"), "Rule over the fact table fails on water")
+
+	# Append rows
+	assert_true(prolog.append_fact_table("tile", [[3], [0], ["lava"], [9.0]]), "Rows appended")
+	assert_equal(prolog.get_fact_table_size("tile"), 7, "Fact table has 7 rows")
+	assert_true(prolog.query("tile(3, 0, lava, _)"), "Appended row found through the index")
+
+	# Invalid input
+	assert_false(prolog.append_fact_table("tile", [[4], [0]]), "Wrong column count rejected")
+	assert_false(prolog.append_fact_table("tile", [[4, 5], [0], ["a"], [1.0]]), "Columns of different lengths rejected")
+	assert_equal(prolog.get_fact_table_size("tile"), 7, "Rejected rows are not appended")
+	assert_false(prolog.create_fact_table("bad", ["int", "text"]), "Unknown column type rejected")
+	assert_false(prolog.create_fact_table("tile", ["int", "int", "atom", "float"], [[1], [2]]), "Invalid initial rows rejected")
+	assert_equal(prolog.get_fact_table_size("tile"), 7, "Failed creation keeps the previous table")
+
+	# Drop
+	assert_true(prolog.drop_fact_table("tile"), "Fact table dropped")
+	assert_equal(prolog.get_fact_table_size("tile"), -1, "Dropped table has no size")
+	assert_false(prolog.query("tile(_, _, _, _)"), "Dropped table has no solution")
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Fact Files
+# =============================================================================
+
+func test_fact_files() -> void:
+	print("\n[Test Suite: Fact Files]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	var path := "user://test_prologot.facts"
+	var xs := PackedInt32Array([0, 1, 2])
+	var kinds := PackedStringArray(["tree", "rock", "tree"])
+	var weights := PackedFloat64Array([0.5, 2.0, 0.25])
+	prolog.create_fact_table("prop", ["int", "atom", "float"], [xs, kinds, weights])
+	assert_true(prolog.save_fact_table("prop", path), "Fact table saved")
+	prolog.drop_fact_table("prop")
+
+	# Map the file back, with an index on the atom column
+	assert_true(prolog.map_fact_file(path, [1]), "Fact file mapped")
+	assert_equal(prolog.get_fact_table_size("prop"), 3, "Mapped table has 3 rows")
+	assert_true(prolog.query("prop(2, tree, 0.25)"), "Ground row found in mapped table")
+	assert_equal(prolog.query_all("prop", ["X", "tree", "_"]).size(), 2, "Two trees (indexed atom column)")
+	assert_false(prolog.query("prop(_, lava, _)"), "Unknown atom fails")
+
+	# Mapped tables are read-only
+	assert_false(prolog.append_fact_table("prop", [[3], ["bush"], [1.0]]), "Append to mapped table rejected")
+
+	# Saving a mapped table over its own file (Windows cannot replace it)
+	if OS.get_name() != "Windows":
+		assert_true(prolog.save_fact_table("prop", path), "Mapped table saved over its file")
+		assert_true(prolog.query("prop(1, rock, 2.0)"), "Mapping still readable")
+		assert_true(prolog.map_fact_file(path, [1]), "Rewritten file mapped")
+		assert_equal(prolog.query_all("prop", ["X", "tree", "_"]).size(), 2, "Rewritten file is intact")
+
+	# Invalid files
+	assert_false(prolog.map_fact_file("user://missing.facts"), "Missing file rejected")
+	var junk := FileAccess.open("user://junk.facts", FileAccess.WRITE)
+	junk.store_string("not a fact file at all, only text to be rejected")
+	junk.close()
+	assert_false(prolog.map_fact_file("user://junk.facts"), "Invalid file rejected")
+
+	prolog.drop_fact_table("prop")
+	DirAccess.remove_absolute(ProjectSettings.globalize_path(path))
+	DirAccess.remove_absolute(ProjectSettings.globalize_path("user://junk.facts"))
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Bulk Loading
+# =============================================================================
+
+func test_bulk_loading() -> void:
+	print("\n[Test Suite: Bulk Loading]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	# CSV with a header, quoted fields and inferred types
+	var csv_path := "user://test_items.csv"
+	var csv := FileAccess.open(csv_path, FileAccess.WRITE)
+	csv.store_string("id,name,price\n1,sword,12.5\n2,\"shield, wooden\",8\n3,\"bow \"\"long\"\"\",20\n")
+	csv.close()
+	assert_equal(prolog.load_csv_facts(csv_path, "item"), 3, "Three CSV rows loaded")
+	assert_true(prolog.query("item(1, sword, 12.5)"), "Inferred int, atom and float columns")
+	assert_true(prolog.query("item(2, 'shield, wooden', 8.0)"), "Quoted separator, int widened to float")
+	assert_true(prolog.query("item(3, 'bow \"long\"', _)"), "Escaped quotes")
+
+	# Declared types and options
+	var tsv := FileAccess.open(csv_path, FileAccess.WRITE)
+	tsv.store_string("7;north\n8;south\n")
+	tsv.close()
+	assert_equal(prolog.load_csv_facts(csv_path, "exit", ["int", "string"], {"header": false, "separator": ";"}), 2, "Two rows without header")
+	assert_true(prolog.query("exit(7, S), string(S)"), "Declared string column")
+
+	# Invalid rows leave the database untouched
+	var bad := FileAccess.open(csv_path, FileAccess.WRITE)
+	bad.store_string("1,a\n2,b\nx,c\n")
+	bad.close()
+	assert_equal(prolog.load_csv_facts(csv_path, "pair", ["int", "atom"], {"header": false}), -1, "Invalid int rejected")
+	assert_false(prolog.query("pair(_, _)"), "Nothing asserted on error")
+
+	# Rows spanning several read chunks
+	var big := FileAccess.open(csv_path, FileAccess.WRITE)
+	for i in range(20000):
+		big.store_string("%d,\"name %d\",%d.25\n" % [i, i, i])
+	big.close()
+	assert_equal(prolog.load_csv_facts(csv_path, "big", [], {"header": false}), 20000, "Rows read by chunks")
+	assert_true(prolog.query("big(19999, 'name 19999', 19999.25)"), "Last row intact")
+	var big_count: Variant = prolog.query_one("aggregate_all(count, big(_, _, _), N)")
+	assert_equal(big_count["args"][2], 20000, "No row lost at chunk boundaries")
+
+	# JSON array of objects nested in a root member
+	var json_path := "user://test_monsters.json"
+	var json := FileAccess.open(json_path, FileAccess.WRITE)
+	json.store_string('{"monsters": [{"name": "orc", "hp": 30, "tags": ["melee"]}, {"name": "imp", "hp": 12.5, "tags": []}]}')
+	json.close()
+	var mapping := {"functor": "monster", "fields": ["name", "hp", "tags"], "root": "monsters"}
+	assert_equal(prolog.load_json_facts(json_path, mapping), 2, "Two JSON objects loaded")
+	assert_true(prolog.query("monster(orc, 30, [melee])"), "JSON values converted")
+	assert_true(prolog.query("monster(imp, 12.5, [])"), "JSON float and empty list")
+	mapping["fields"] = ["name", "speed"]
+	assert_equal(prolog.load_json_facts(json_path, mapping), -1, "Missing field rejected")
+
+	# Top-level array, numbers read whatever the locale
+	json = FileAccess.open(json_path, FileAccess.WRITE)
+	json.store_string('[{"id": 1, "w": 0.5}, {"id": 2, "w": -1.25e2}]')
+	json.close()
+	assert_equal(prolog.load_json_facts(json_path, {"functor": "weight", "fields": ["id", "w"]}), 2, "Top-level array loaded")
+	assert_true(prolog.query("weight(2, -125.0)"), "Exponent parsed")
+	json = FileAccess.open(json_path, FileAccess.WRITE)
+	json.store_string('[{"id": 3, "w": 1.5}, {"id": 4, "w": 1,5}]')
+	json.close()
+	assert_equal(prolog.load_json_facts(json_path, {"functor": "weight", "fields": ["id", "w"]}), -1, "Malformed JSON rejected")
+	assert_false(prolog.query("weight(3, _)"), "Nothing asserted from malformed JSON")
+
+	DirAccess.remove_absolute(ProjectSettings.globalize_path(csv_path))
+	DirAccess.remove_absolute(ProjectSettings.globalize_path(json_path))
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: JSON Terms
+# =============================================================================
+
+func test_json_terms() -> void:
+	print("\n[Test Suite: JSON Terms]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	# Prolog side: json_to_term/2 and term_to_json/2
+	assert_true(prolog.query("json_to_term('{\"hp\": 30, \"name\": \"orc\"}', D), get_dict(hp, D, 30)"), "JSON object to dict")
+	assert_true(prolog.query("json_to_term('[1, 2.5, true, null]', [1, 2.5, true, null])"), "JSON array to list")
+	assert_true(prolog.query("term_to_json(_{a: 1, b: [x, \"y\"]}, S), S == \"{\\\"a\\\":1,\\\"b\\\":[\\\"x\\\",\\\"y\\\"]}\""), "Dict to JSON")
+	assert_true(prolog.query("term_to_json(json([k=1.0]), S), S == \"{\\\"k\\\":1.0}\""), "json/1 term to JSON")
+	assert_true(prolog.query("term_to_json([0.1, 1.5e300], S), S == \"[0.1,1.5e+300]\""), "Floats written with a decimal point")
+	assert_false(prolog.query("catch(json_to_term('{\"a\": }', _), _, fail)"), "Invalid JSON raises an error")
+	assert_false(prolog.query("catch(term_to_json(f(x), _), _, fail)"), "Compound term has no JSON equivalent")
+
+	# GDScript side: JSON text in and out without Variants
+	prolog.consult_string("save_gold(D) :- get_dict(gold, D, G), retractall(gold(_)), assertz(gold(G)).")
+	assert_true(prolog.call_predicate_json("save_gold", '{"gold": 120, "items": ["sword"]}'), "Predicate called with JSON")
+	assert_true(prolog.query("gold(120)"), "JSON value reached Prolog")
+	assert_false(prolog.call_predicate_json("save_gold", "{broken"), "Invalid JSON rejected")
+
+	prolog.consult_string("make_save(_{gold: G, tags: [a, b]}) :- gold(G).")
+	var json: String = prolog.call_function_json("make_save", [])
+	var parsed: Variant = JSON.parse_string(json)
+	assert_true(parsed is Dictionary and parsed["gold"] == 120 and parsed["tags"] == ["a", "b"], "Result returned as JSON")
+	assert_equal(prolog.call_function_json("length", [[1, 2, 3]]), "3", "Scalar result as JSON")
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Object Handles
+# =============================================================================
+
+func test_object_handles() -> void:
+	print("\n[Test Suite: Object Handles]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	var node := Node2D.new()
+	node.name = "Hero"
+	node.position = Vector2(3, 4)
+
+	# Objects go to Prolog as handles and come back as the same object
+	assert_true(prolog.call_function("=", [node]) == node, "Object round trip")
+	prolog.call_predicate("assertz", [{"functor": "hero", "args": [node]}])
+	assert_true(prolog.query("hero(H), godot_valid(H)"), "Handle stored in a fact")
+	assert_true(prolog.query("hero(H), godot_class(H, 'Node2D')"), "Class of the handle")
+
+	# Properties are read and written without GDScript round trips
+	assert_equal(prolog.call_function("godot_get", [node, "name"]), "Hero", "godot_get reads a property")
+	assert_equal(prolog.call_function("godot_get", [node, "position:x"]), 3.0, "godot_get reads an indexed property")
+	assert_true(prolog.query("hero(H), godot_set(H, 'position:y', 10.0)"), "godot_set writes a property")
+	assert_equal(node.position.y, 10.0, "Property updated")
+
+	# Freed objects
+	node.free()
+	assert_false(prolog.query("hero(H), godot_valid(H)"), "Freed object is no longer valid")
+	assert_false(prolog.query("catch((hero(H), godot_get(H, name, _)), error(existence_error(_, _), _), fail)"), "godot_get raises on freed object")
+	assert_true(prolog.call_function("hero", []) == null, "Freed handle converts to null")
+
+	prolog.retract_all("hero(_)")
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Packed Array Blobs
+# =============================================================================
+
+func test_packed_array_blobs() -> void:
+	print("\n[Test Suite: Packed Array Blobs]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	var heights := PackedFloat32Array([0.5, 1.5, 2.5, 3.5])
+	assert_equal(prolog.call_function("pa_length", [heights]), 4, "pa_length of a float array")
+	assert_equal(prolog.call_function("pa_get", [heights, 2]), 2.5, "pa_get by index")
+	assert_false(prolog.call_predicate("pa_get", [heights, 4, 0.0]), "Out of range index fails")
+	assert_equal(prolog.call_function("pa_get", [PackedInt64Array([7, 1 << 40]), 1]), 1 << 40, "Int64 values are exact")
+
+	# Slices share the buffer and convert back to Packed arrays
+	prolog.consult_string("middle(A, S) :- pa_slice(A, 1, 2, S).")
+	var middle: Variant = prolog.call_function("middle", [heights])
+	assert_true(middle is PackedFloat32Array and middle == PackedFloat32Array([1.5, 2.5]), "Slice converted back")
+	assert_equal(prolog.call_function("pa_to_list", [PackedByteArray([1, 2, 3])]), [1, 2, 3], "pa_to_list")
+
+	# Copy-on-write: the blob keeps the values it was created with
+	prolog.consult_string("keep(B) :- retractall(kept(_)), assertz(kept(B)).")
+	prolog.call_predicate("keep", [heights])
+	heights[0] = 99.0
+	assert_true(prolog.query("kept(B), pa_get(B, 0, 0.5)"), "Blob unaffected by later writes")
+
+	# Images are 2D, pixels with several channels are lists
+	var image := Image.create_empty(2, 2, false, Image.FORMAT_RGBA8)
+	image.set_pixel(1, 0, Color8(10, 20, 30, 255))
+	assert_equal(prolog.call_function("pa_get", [image, 1, 0]), [10, 20, 30, 255], "Pixel read by X and Y")
+	prolog.consult_string("dims(I, [W, H]) :- pa_size(I, W, H).")
+	assert_equal(prolog.call_function("dims", [image]), [2, 2], "Image dimensions")
+
+	prolog.retract_all("kept(_)")
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Vector Predicates
+# =============================================================================
+
+func test_vector_predicates() -> void:
+	print("\n[Test Suite: Vector Predicates]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	assert_equal(prolog.call_function("vec_dist", [[0, 0, 0], [3, 4, 0]]), 5.0, "vec_dist over lists")
+	assert_equal(prolog.call_function("vec_dot", [[1, 2, 3], [4, 5, 6]]), 32.0, "vec_dot over lists")
+	assert_equal(prolog.call_function("vec_sum", [[]]), 0.0, "vec_sum of empty list")
+
+	# Long enough to run the vectorised loops and their tails
+	var values := PackedFloat32Array()
+	for i in range(19):
+		values.append(float((i * 7) % 19))
+	assert_equal(prolog.call_function("vec_sum", [values]), 171.0, "vec_sum over a float blob")
+	assert_equal(prolog.call_function("argmin", [values]), 0, "argmin over a float blob")
+	assert_equal(prolog.call_function("argmax", [values]), 8, "argmax over a float blob")
+	assert_equal(prolog.call_function("vec_dot", [values, PackedFloat64Array(values)]), 2109.0, "vec_dot mixing float32 and float64")
+	assert_false(prolog.call_predicate("argmin", [[], 0]), "argmin fails on empty vectors")
+	assert_false(prolog.query("catch(vec_dot([1, 2], [1], _), error(domain_error(_, _), _), fail)"), "Different lengths raise a domain error")
+
+	# Flat points and lists of points
+	var points := PackedFloat32Array([9, 9, 1, 1, 0, 0, 5, 5])
+	assert_equal(prolog.call_function("k_nearest", [[0, 0], points, 2]), [2, 1], "k_nearest over flat points")
+	assert_equal(prolog.call_function("k_nearest", [[4, 4], [[0, 0], [5, 5], [9, 9]], 5]), [1, 0, 2], "k_nearest over a list of points")
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Bitsets
+# =============================================================================
+
+func test_bitsets() -> void:
+	print("\n[Test Suite: Bitsets]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	# 130 bits span three words: exercises the vectorised loops and tails
+	prolog.consult_string("""
+		sets(A, B) :- bs_from_list(130, [0, 64, 129], A), bs_from_list(130, [64, 100], B).
+		union_list(L) :- sets(A, B), bs_union(A, B, U), bs_to_list(U, L).
+		inter_list(L) :- sets(A, B), bs_intersect(A, B, I), bs_to_list(I, L).
+		diff_list(L) :- sets(A, B), bs_difference(A, B, D), bs_to_list(D, L).
+		members(L) :- sets(A, _), findall(I, bs_member(I, A), L).
+	""")
+	assert_equal(prolog.call_function("union_list", []), [0, 64, 100, 129], "bs_union")
+	assert_equal(prolog.call_function("inter_list", []), [64], "bs_intersect")
+	assert_equal(prolog.call_function("diff_list", []), [0, 129], "bs_difference")
+	assert_equal(prolog.call_function("members", []), [0, 64, 129], "bs_member enumerates members")
+	assert_true(prolog.query("sets(A, _), bs_member(64, A), \\+ bs_member(65, A)"), "bs_member checks members")
+	assert_true(prolog.query("sets(A, B), bs_union(A, B, U), bs_count(U, 4)"), "bs_count")
+	assert_false(prolog.query("catch((bs_new(8, A), bs_new(9, B), bs_union(A, B, _)), error(domain_error(_, _), _), fail)"), "Different sizes raise a domain error")
+	assert_true(prolog.query("catch(bs_new(1000000000000000, _), error(resource_error(memory), _), true)"), "Huge size raises a resource error")
+
+	# Bulk fill from Godot data, and back to bytes
+	var bytes := PackedByteArray([0, 1, 0, 7])
+	assert_equal(prolog.call_function("bs_from_bytes", [bytes]), PackedByteArray([0, 1, 0, 1]), "PackedByteArray round trip")
+	var bitmap := BitMap.new()
+	bitmap.create(Vector2i(10, 10))
+	bitmap.set_bit(3, 2, true)
+	assert_equal(prolog.call_function("bs_to_list", [bitmap]), [23], "BitMap pixels become bits")
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: TileMap Import
+# =============================================================================
+
+func test_tilemap_import() -> void:
+	print("\n[Test Suite: TileMap Import]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	# A GridMap needs no MeshLibrary to store item ids
+	var grid := GridMap.new()
+	grid.set_cell_item(Vector3i(0, 0, 0), 1)
+	grid.set_cell_item(Vector3i(1, 0, 2), 2)
+	grid.set_cell_item(Vector3i(-1, 3, 0), 1)
+
+	assert_equal(prolog.import_tilemap(grid, "cell"), 3, "Import cells as facts")
+	assert_true(prolog.query("cell(1, 0, 2, 2)"), "Cell fact has coordinates and item")
+	assert_equal(prolog.query_all("cell(X, Y, Z, 1)").size(), 2, "Query cells by item")
+
+	# Incremental update: one cell changed, one erased
+	grid.set_cell_item(Vector3i(0, 0, 0), 5)
+	grid.set_cell_item(Vector3i(-1, 3, 0), GridMap.INVALID_CELL_ITEM)
+	assert_equal(prolog.sync_tilemap_cells(grid, "cell", [Vector3i(0, 0, 0), Vector3i(-1, 3, 0)]), 2, "Sync changed cells")
+	assert_true(prolog.query("cell(0, 0, 0, 5)"), "Changed cell is updated")
+	assert_false(prolog.query("cell(-1, 3, 0, _)"), "Erased cell is removed")
+	assert_equal(prolog.query_all("cell(X, Y, Z, I)").size(), 2, "Other cells are kept")
+
+	# Fact table storage
+	assert_equal(prolog.import_tilemap(grid, "gcell", {"table": true, "fields": ["x", "y", "z", "item", "orientation"]}), 2, "Import cells as a fact table")
+	assert_equal(prolog.get_fact_table_size("gcell"), 2, "One row per cell")
+	grid.set_cell_item(Vector3i(1, 0, 2), GridMap.INVALID_CELL_ITEM)
+	prolog.sync_tilemap_cells(grid, "gcell", [Vector3i(1, 0, 2)])
+	assert_equal(prolog.get_fact_table_size("gcell"), 1, "Sync removes table rows")
+	assert_false(prolog.query("gcell(1, 0, 2, _, _)"), "Removed row no longer matches")
+
+	# Row removal with a partial key
+	prolog.create_fact_table("pos", ["int", "int"], [PackedInt32Array([0, 0, 1]), PackedInt32Array([0, 1, 0])], [0])
+	assert_equal(prolog.remove_fact_table_rows("pos", [0]), 2, "Remove rows by key prefix")
+	assert_equal(prolog.query_all("pos(X, Y)").size(), 1, "Remaining rows")
+	assert_equal(prolog.remove_fact_table_rows("pos", [null, 0]), 1, "null matches any value")
+
+	# Updating the same cells again and again reclaims the removed rows
+	for i in range(500):
+		grid.set_cell_item(Vector3i(0, 0, 0), i % 7)
+		prolog.sync_tilemap_cells(grid, "gcell", [Vector3i(0, 0, 0)])
+	assert_equal(prolog.get_fact_table_size("gcell"), 1, "Repeated sync keeps one row per cell")
+	assert_true(prolog.get_fact_table_size("gcell", true) <= 130, "Repeated sync keeps the storage bounded")
+	assert_true(prolog.query("gcell(0, 0, 0, 2, _)"), "Compacted table is reindexed")
+
+	# TileMapLayer: decoded from get_tile_map_data_as_array()
+	var tile_set := TileSet.new()
+	tile_set.add_custom_data_layer()
+	tile_set.set_custom_data_layer_name(0, "terrain")
+	tile_set.set_custom_data_layer_type(0, TYPE_STRING)
+	var atlas := TileSetAtlasSource.new()
+	atlas.texture = ImageTexture.create_from_image(Image.create(32, 16, false, Image.FORMAT_RGBA8))
+	atlas.texture_region_size = Vector2i(16, 16)
+	atlas.create_tile(Vector2i(0, 0))
+	atlas.create_tile(Vector2i(1, 0))
+	tile_set.add_source(atlas, 3)
+	atlas.get_tile_data(Vector2i(1, 0), 0).set_custom_data("terrain", "water")
+	atlas.get_tile_data(Vector2i(0, 0), 0).set_custom_data("terrain", "grass")
+
+	var layer := TileMapLayer.new()
+	layer.tile_set = tile_set
+	layer.set_cell(Vector2i(-2, 5), 3, Vector2i(1, 0))
+	layer.set_cell(Vector2i(4, -1), 3, Vector2i(0, 0))
+	layer.set_cell(Vector2i(300, -300), 3, Vector2i(1, 0))
+
+	assert_equal(prolog.import_tilemap(layer, "lcell"), 3, "Import layer cells as facts")
+	assert_true(prolog.query("lcell(-2, 5, 3, 1, 0)"), "Negative coordinates, source and atlas ids")
+	assert_true(prolog.query("lcell(4, -1, 3, 0, 0)"), "Second cell decoded")
+	assert_true(prolog.query("lcell(300, -300, 3, 1, 0)"), "Coordinates beyond one byte")
+
+	assert_equal(prolog.import_tilemap(layer, "terrain", {"fields": ["x", "y", "data:terrain", "alternative"]}), 3, "Import custom data")
+	var water: Variant = prolog.query_one("terrain(-2, 5, T, A)")
+	assert_true(water is Dictionary and water["args"][2] == "water" and water["args"][3] == 0, "data: field holds the custom data")
+	assert_equal(prolog.query_all("terrain(X, Y, water, _)").size(), 2, "Query cells by custom data")
+
+	layer.set_cell(Vector2i(4, -1), 3, Vector2i(1, 0))
+	layer.erase_cell(Vector2i(-2, 5))
+	assert_equal(prolog.sync_tilemap_cells(layer, "terrain", [Vector2i(4, -1), Vector2i(-2, 5)]), 2, "Sync layer cells")
+	assert_true(prolog.query("terrain(4, -1, water, 0)"), "Changed tile has its new custom data")
+	assert_false(prolog.query("terrain(-2, 5, _, _)"), "Erased tile is removed")
+
+	assert_equal(prolog.import_tilemap(layer, "ltile", {"table": true, "fields": ["x", "y", "source", "atlas_x", "data:terrain"]}), 2, "Import layer as a fact table")
+	assert_true(prolog.query("ltile(300, -300, 3, 1, water)"), "Table row decoded")
+
+	layer.free()
+	grid.free()
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Scene Tree Mirror
+# =============================================================================
+
+func test_scene_tree_mirror() -> void:
+	print("\n[Test Suite: Scene Tree Mirror]")
+
+	if not is_inside_tree():
+		print("  ✗ SKIP: The tests are not running in a scene tree")
+		return
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	var level := Node2D.new()
+	var room := Node2D.new()
+	var orc := Sprite2D.new()
+	orc.add_to_group("enemies")
+	room.add_child(orc)
+	level.add_child(room)
+	add_child(level)
+
+	assert_equal(prolog.mirror_scene_tree(level), 3, "Mirror the subtree")
+	prolog.consult_string("""
+		enemy_room(R) :- in_group(E, enemies), parent(E, R).
+		enemy_count(N) :- aggregate_all(count, in_group(_, enemies), N).
+		sprite_count(N) :- aggregate_all(count, node_type(_, 'Sprite2D'), N).
+	""")
+	assert_equal(prolog.call_function("enemy_room", []), room, "parent/2 and in_group/2 facts")
+	assert_equal(prolog.call_function("sprite_count", []), 1, "node_type/2 facts")
+	assert_false(prolog.query("parent(_, P), \\+ node_type(P, _)"), "The root has no parent fact")
+
+	# Incremental updates
+	var goblin := Sprite2D.new()
+	goblin.add_to_group("enemies")
+	room.add_child(goblin)
+	assert_equal(prolog.call_function("enemy_count", []), 2, "Added node is mirrored")
+	orc.queue_free()
+	room.remove_child(orc)
+	assert_equal(prolog.call_function("sprite_count", []), 1, "Removed node is retracted")
+	goblin.remove_from_group("enemies")
+	assert_true(prolog.mirror_update_groups(goblin), "Update groups")
+	assert_equal(prolog.call_function("enemy_count", []), 0, "Group change is mirrored")
+
+	# Nodes outside the subtree are ignored
+	var other := Sprite2D.new()
+	add_child(other)
+	assert_equal(prolog.call_function("sprite_count", []), 1, "Nodes outside the subtree are ignored")
+	other.queue_free()
+
+	prolog.unmirror_scene_tree()
+	assert_false(prolog.query("node_type(_, _)"), "Unmirror retracts the facts")
+	level.queue_free()
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: GOAP Planner
+# =============================================================================
+
+func test_goap_planner() -> void:
+	print("\n[Test Suite: GOAP Planner]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	prolog.consult_string("""
+		action(go(To), [at(From)], [at(To)], [at(From)], 1) :- path(From, To).
+		action(chop, [at(forest), has(axe)], [has(wood)], [], 2).
+		action(take_axe, [at(shed)], [has(axe)], [], 1).
+		action(buy_wood, [at(shop)], [has(wood)], [], 10).
+		path(From, To) :- road(From, To).
+		goals_left(State, Goal, H) :- subtract(Goal, State, L), length(L, H).
+	""")
+
+	for road in ["road(home, shed)", "road(shed, forest)", "road(home, shop)"]:
+		prolog.add_fact(road)
+
+	var expected := PackedStringArray(["go(shed)", "take_axe", "go(forest)", "chop"])
+	assert_equal(prolog.plan(["at(home)"], ["has(wood)"]), expected, "Cheapest plan")
+	assert_equal(prolog.plan(["at(home)"], ["has(wood)"]), expected, "Cached plan")
+	assert_equal(prolog.plan(["at(home)", "has(wood)"], ["has(wood)"]).size(), 0, "Goal already reached")
+	assert_equal(prolog.plan(["at(shop)"], ["has(axe)"]).size(), 0, "No plan")
+	assert_equal(prolog.plan(["at(home)"], ["has(wood)"], {"heuristic": "goals_left", "cache": false}), expected, "Prolog heuristic")
+
+	# Incremental search
+	var search := prolog.plan_start(["at(home)"], ["has(wood)", "at(forest)"], {"cache": false})
+	assert_true(search >= 0, "Start a search")
+	var status := 0
+	for i in 100:
+		status = prolog.plan_step(search, 50)
+		if status != 0:
+			break
+	assert_equal(status, 1, "Stepped search finds a plan")
+	assert_equal(prolog.plan_result(search), expected, "Stepped search result")
+
+	# Changed actions are seen after clearing the cache
+	prolog.add_fact("road(home, forest)")
+	prolog.clear_plan_cache()
+	assert_equal(prolog.plan(["at(home)", "has(axe)"], ["has(wood)"]), PackedStringArray(["go(forest)", "chop"]), "Replan after clear_plan_cache")
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: CLP(FD) Solve
+# =============================================================================
+
+func test_clpfd_solve() -> void:
+	print("\n[Test Suite: CLP(FD) Solve]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	var waves := {"W1": Vector2i(2, 6), "W2": Vector2i(2, 6), "W3": Vector2i(2, 6)}
+	var growing := PackedStringArray(["W1 + W2 + W3 #= 12", "W1 #< W2", "W2 #< W3"])
+	assert_equal(prolog.clpfd_solve(waves, growing), PackedInt64Array([2, 4, 6]), "First solution")
+	assert_equal(prolog.clpfd_solve(waves, growing, {"solutions": 0}), PackedInt64Array([2, 4, 6, 3, 4, 5]), "All solutions")
+	assert_equal(prolog.clpfd_solve(waves, growing, {"labeling": ["down"]}), PackedInt64Array([3, 4, 5]), "Labeling options")
+	assert_equal(prolog.clpfd_solve({"A": [1, 3, 5], "B": "10..sup"}, ["B #= A * 4"]), PackedInt64Array([3, 12]), "Set and text domains")
+	assert_equal(prolog.clpfd_solve(waves, ["W1 #> 6"]).size(), 0, "No solution")
+
+	# Budgets: the search stops early instead of running away
+	var queens := {}
+	var names := []
+	for i in 60:
+		queens["Q%d" % i] = Vector2i(1, 60)
+		names.append("Q%d" % i)
+	var list := "[" + ", ".join(names) + "]"
+	var result := prolog.clpfd_solve(queens, ["all_distinct(%s)" % list, "sum(%s, #=, 1000)" % list], {"solutions": 0, "inference_limit": 100000})
+	assert_true(result.size() % 60 == 0, "Partial results are whole solutions")
+	assert_true(prolog.get_last_error().contains("limit exceeded"), "Exceeded limit is reported")
+	result = prolog.clpfd_solve(queens, ["all_distinct(%s)" % list, "sum(%s, #=, 1000)" % list], {"solutions": 0, "time_limit": 0.05})
+	assert_true(prolog.get_last_error().contains("limit exceeded"), "Fractional time limit")
+
+	assert_equal(prolog.clpfd_solve({"lower": Vector2i(0, 1)}, []).size(), 0, "Invalid variable name")
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Forward Rules
+# =============================================================================
+
+func test_forward_rules() -> void:
+	print("\n[Test Suite: Forward Rules]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	var batches := []
+	prolog.forward_rules_fired.connect(func(firings): batches.append(firings))
+
+	assert_true(prolog.add_forward_rule("ambush", ["enemy_in(E, R)", "player_in(R)"]), "Add a rule")
+	assert_true(prolog.add_forward_rule("danger", ["enemy_in(_, R)"], {"assert": "dangerous(R)", "notify": false}), "Add a deriving rule")
+	assert_true(prolog.add_forward_rule("alert", ["dangerous(R)"], {"assert": "alert(R)"}), "Add a chained rule")
+
+	prolog.add_fact("enemy_in(orc, hall)")
+	prolog.add_fact("enemy_in(goblin, hall)")
+	prolog.add_fact("player_in(hall)")
+	prolog.add_fact("unrelated(fact)")
+	assert_true(prolog.query("dangerous(hall)"), "Derived fact is asserted")
+	assert_true(prolog.query("alert(hall)"), "Derived facts chain")
+	assert_equal(prolog.query_all("dangerous(R)").size(), 1, "Existing derived facts are not duplicated")
+
+	prolog.flush_forward_rules()
+	assert_equal(batches.size(), 1, "Firings are batched in one signal")
+	var rules := []
+	for firing in batches[0]:
+		rules.append(firing["rule"])
+	assert_equal(rules, ["alert", "ambush", "ambush"], "Firings in order")
+	assert_equal(batches[0][1]["bindings"], {"E": "orc", "R": "hall"}, "Firing bindings")
+
+	assert_true(prolog.remove_forward_rule("ambush"), "Remove a rule")
+	prolog.add_fact("enemy_in(troll, hall)")
+	prolog.flush_forward_rules()
+	assert_equal(batches.size(), 1, "Removed rule no longer fires")
+	assert_false(prolog.add_forward_rule("broken", ["foo(X"]), "Syntax errors are rejected")
+
+	# A fact matching two conditions of a rule fires it once
+	batches.clear()
+	assert_true(prolog.add_forward_rule("chain", ["link(A, B)", "link(B, C)"]), "Rule with two conditions on the same functor")
+	prolog.add_fact("link(a, a)")
+	prolog.flush_forward_rules()
+	assert_equal(batches.size(), 1, "Self-joined fact fires")
+	assert_equal(batches[0].size(), 1, "Self-joined fact fires once")
+
+	# Facts added by consult_string() and the loaders fire rules too
+	batches.clear()
+	prolog.consult_string("link(b, a). reach(X) :- link(X, _).")
+	var csv_path := "user://test_forward_rules.csv"
+	var csv := FileAccess.open(csv_path, FileAccess.WRITE)
+	csv.store_string("from,to\nc,b\n")
+	csv.close()
+	assert_equal(prolog.load_csv_facts(csv_path, "link", ["atom", "atom"]), 1, "Load a fact from CSV")
+	DirAccess.remove_absolute(ProjectSettings.globalize_path(csv_path))
+	prolog.flush_forward_rules()
+	var chains := []
+	for firing in batches[0]:
+		chains.append([firing["bindings"]["A"], firing["bindings"]["B"], firing["bindings"]["C"]])
+	assert_equal(chains, [["b", "a", "a"], ["c", "b", "a"]], "Consulted and loaded facts fire rules")
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: CHR Store
+# =============================================================================
+
+func test_chr_store() -> void:
+	print("\n[Test Suite: CHR Store]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	var rules := """
+		:- chr_constraint item/1, forbidden/1.
+		item(wood), item(wood) <=> item(plank).
+		forbidden(X), item(X) <=> fail.
+	"""
+	assert_true(prolog.chr_consult(rules), "Load CHR rules")
+
+	assert_true(prolog.chr_add(["item(wood)"]), "Add a constraint")
+	assert_true(prolog.chr_add(["item(wood)", "forbidden(gold)"]), "Add constraints in a new call")
+	assert_equal(prolog.chr_get_store("item").size(), 1, "Store persists across calls")
+	assert_equal(prolog.chr_get_store().size(), 2, "Whole store")
+
+	var saved: PackedStringArray = prolog.chr_snapshot()
+	assert_true("item(plank)" in saved, "Snapshot holds the derived constraint")
+
+	assert_false(prolog.chr_add(["item(stone)", "item(gold)"]), "Inconsistent constraints fail")
+	assert_equal(prolog.chr_get_store().size(), 2, "Failed add leaves the store unchanged")
+
+	prolog.chr_reset()
+	assert_equal(prolog.chr_get_store().size(), 0, "Reset empties the store")
+	assert_true(prolog.chr_restore(saved), "Restore a snapshot")
+	assert_equal(prolog.chr_snapshot().size(), saved.size(), "Restored store")
+	var restored: PackedStringArray = prolog.chr_snapshot()
+	assert_false(prolog.chr_restore(["item(gold)", "forbidden(gold)"]), "Inconsistent snapshot fails")
+	assert_false(prolog.chr_restore(["item(("]), "Invalid snapshot fails")
+	assert_equal(prolog.chr_snapshot(), restored, "Failed restore keeps the store")
+
+	# Each consult replaces the previous rules
+	prolog.chr_reset()
+	assert_true(prolog.chr_consult(":- chr_constraint token/1.\ntoken(X), token(X) <=> token(X)."), "Load other rules")
+	assert_true(prolog.chr_add(["token(a)", "token(a)"]), "New rules apply")
+	assert_equal(prolog.chr_get_store("token").size(), 1, "New rules simplify the store")
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Blackboard
+# =============================================================================
+
+func test_blackboard() -> void:
+	print("\n[Test Suite: Blackboard]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	assert_equal(prolog.bb_get("hp", -1), -1, "Missing key returns the default")
+	assert_true(prolog.bb_set("hp", 42), "Set a value")
+	assert_true(prolog.bb_set("hp", 17), "Replace a value")
+	assert_equal(prolog.bb_get("hp"), 17, "Get a value")
+	assert_true(prolog.bb_set("name", "hero"), "Set a string value")
+	assert_equal(prolog.bb_get_many(PackedStringArray(["hp", "name", "mana"])), {"hp": 17, "name": "hero"}, "Get several values")
+
+	prolog.consult_string("low_hp :- bb_get(hp, HP), HP < 20.")
+	assert_true(prolog.query("low_hp"), "Rules read the blackboard")
+	assert_true(prolog.query("bb_set(tick, 5)"), "Rules write the blackboard")
+	assert_equal(prolog.bb_get("tick"), 5, "Value set by a rule")
+	assert_false(prolog.query("bb_get(unknown, _)"), "bb_get/2 fails on missing keys")
+
+	assert_true(prolog.bb_erase("hp"), "Erase a value")
+	assert_false(prolog.bb_erase("hp"), "Erased value is gone")
+	assert_false(prolog.query("low_hp"), "Rules no longer see the value")
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Expiring Facts
+# =============================================================================
+
+func test_expiring_facts() -> void:
+	print("\n[Test Suite: Expiring Facts]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	assert_true(prolog.add_fact_ttl("saw(player, 1, 2)", 0.5), "Add a short-lived fact")
+	assert_true(prolog.add_fact_ttl("saw(player, 3, 4)", 2.0), "Add a longer-lived fact")
+	assert_true(prolog.add_fact_ttl("heard(noise)", 0.5), "Add a fact to retract by hand")
+	assert_true(prolog.add_fact("saw(player, 1, 2)"), "Add a permanent duplicate")
+	assert_true(prolog.retract_fact("heard(noise)"), "Retract before expiry")
+
+	assert_equal(prolog.tick(0.25), 0, "Nothing expired yet")
+	assert_equal(prolog.tick(0.25), 1, "Expired fact retracted")
+	assert_equal(prolog.query_all("saw(player, 1, 2)").size(), 1, "Only the expiring clause is retracted")
+	assert_true(prolog.query("saw(player, 3, 4)"), "Longer-lived fact remains")
+	assert_equal(prolog.tick(100.0), 1, "Large delta expires the remaining fact")
+	assert_false(prolog.query("saw(player, 3, 4)"), "Fact gone after expiry")
+	assert_equal(prolog.tick(1.0), 0, "Nothing left to expire")
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Thread-Local Scratch
+# =============================================================================
+
+func test_thread_local_scratch() -> void:
+	print("\n[Test Suite: Thread-Local Scratch]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	assert_true(prolog.declare_thread_local("belief/2"), "Declare a thread-local predicate")
+	assert_true(prolog.declare_thread_local("belief/2"), "Declaring again is allowed")
+	assert_false(prolog.declare_thread_local("belief"), "Invalid indicator is rejected")
+	prolog.add_fact("shared(1)")
+	assert_false(prolog.declare_thread_local("shared/1"), "Predicates with clauses cannot become thread-local")
+
+	prolog.consult_string("flee :- belief(hp, HP), HP < 20.")
+	assert_equal(prolog.query_scratch("flee", PackedStringArray(["belief(hp, 10)"])).size(), 1, "Goal sees the scratch facts")
+	assert_false(prolog.query("belief(_, _)"), "Scratch facts are cleared on return")
+	assert_true(prolog.query_scratch("flee", PackedStringArray(["belief(hp, 80)"])).is_empty(), "Next call starts empty")
+
+	assert_true(prolog.query_scratch("belief(X, Y)", PackedStringArray(["shared(2)"])).is_empty(), "Non thread-local facts are rejected")
+	assert_false(prolog.query("shared(2)"), "Rejected fact is not asserted")
+
+	# Agents evaluated concurrently by worker threads, each with its beliefs
+	prolog.consult_string("hp_of(HP) :- belief(hp, HP).")
+	var seen := []
+	seen.resize(16)
+	var evaluate := func(i: int):
+		var facts := PackedStringArray(["belief(hp, %d)" % i])
+		for round in range(20):
+			var rows: Array = prolog.query_scratch("hp_of(HP)", facts)
+			if rows.size() != 1 or rows[0]["HP"] != i:
+				seen[i] = rows
+				return
+		seen[i] = i
+	var task := WorkerThreadPool.add_group_task(evaluate, 16, 4)
+	prolog.declare_thread_local("other_belief/1")
+	WorkerThreadPool.wait_for_group_task_completion(task)
+	var agents_ok := true
+	for i in range(16):
+		agents_ok = agents_ok and (seen[i] is int) and seen[i] == i
+	assert_true(agents_ok, "Concurrent scratch queries see their own facts")
+	assert_false(prolog.query("belief(_, _)"), "Worker scratch facts are cleared")
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Module Overlays
+# =============================================================================
+
+func test_module_overlays() -> void:
+	print("\n[Test Suite: Module Overlays]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	# Shared base module, built by the first instance
+	assert_true(prolog.add_fact("rules:terrain(grass, 1)"), "Add a base fact")
+	assert_true(prolog.add_fact("rules:terrain(lava, 9)"), "Add another base fact")
+	assert_true(prolog.query("assertz((rules:walkable(T) :- rules:terrain(T, C), C < 5))"), "Add a base rule")
+
+	var match_a := Prologot.new()
+	var match_b := Prologot.new()
+	assert_true(match_a.initialize({"base module": "rules"}), "Initialize a first overlay")
+	assert_true(match_b.initialize({"base module": "rules"}), "Initialize a second overlay")
+	assert_true(match_a.query("walkable(grass)"), "Overlay inherits the base rules")
+	assert_false(match_a.query("walkable(lava)"), "Overlay sees the base facts")
+
+	assert_true(match_a.add_fact("score(red, 1)"), "Add a fact to an overlay")
+	assert_true(match_b.add_fact("score(blue, 2)"), "Add a fact to another overlay")
+	assert_equal(match_a.query_all("score", ["T", "S"]), [{"T": "red", "S": 1}], "Overlays do not share dynamic facts")
+	assert_false(prolog.query("current_predicate(rules:score/2)"), "Base module is not modified")
+
+	match_a.cleanup()
+	assert_true(match_b.query("score(blue, 2)"), "Other instances survive a cleanup")
+	assert_true(prolog.query("rules:terrain(grass, 1)"), "Prolog keeps running")
+	match_b.cleanup()
+
+	# Base rules reading the facts of the overlay running them
+	assert_true(prolog.query("assertz(rules:(leader(T) :- score(T, S), S > 2))"), "Add a base rule reading overlay facts")
+	var match_c := Prologot.new()
+	var match_d := Prologot.new()
+	assert_true(match_c.initialize({"base module": "rules", "overlay predicates": ["score/2"]}), "Declare overlay predicates")
+	assert_true(match_d.initialize({"base module": "rules"}), "Later overlays share the declaration")
+	match_c.add_fact("score(green, 3)")
+	match_d.add_fact("score(green, 1)")
+	assert_true(match_c.query("leader(green)"), "Base rules see the facts of the overlay")
+	assert_false(match_d.query("leader(green)"), "Each overlay sees its own facts")
+	assert_false(prolog.query("rules:leader(_)"), "Outside an overlay, the base clauses are used")
+
+	# Introspection follows the module of the instance
+	assert_true(match_c.predicate_exists("leader", 1), "Base predicate exists in the overlay")
+	assert_false(prolog.predicate_exists("leader", 1), "Base predicate is not in user")
+	assert_false(prolog.predicate_exists("no_such_predicate", 3), "Unknown predicate does not exist")
+	assert_true(str(match_c.list_predicates()).contains("leader"), "Overlay lists the base predicates")
+	assert_false(str(prolog.list_predicates()).contains("leader"), "user does not list them")
+	match_c.cleanup()
+	match_d.cleanup()
+
+	# Each overlay has its own blackboard
+	var match_e := Prologot.new()
+	var match_f := Prologot.new()
+	match_e.initialize({"base module": "rules"})
+	match_f.initialize({"base module": "rules"})
+	assert_true(match_e.bb_set("hp", 10), "Set a blackboard value in an overlay")
+	assert_true(match_f.bb_set("hp", 90), "Set the same key in another overlay")
+	assert_equal(match_e.bb_get("hp"), 10, "Overlays do not share blackboard keys")
+	assert_equal(prolog.bb_get("hp", -1), -1, "Overlay keys are not in user")
+	assert_true(prolog.query("assertz(rules:(hurt :- bb_get(hp, HP), HP < 50))"), "Add a base rule reading the blackboard")
+	assert_true(match_e.query("hurt"), "Base rules read the blackboard of the overlay")
+	assert_false(match_f.query("hurt"), "Each overlay reads its own blackboard")
+	assert_true(match_f.query("bb_set(hp, 5)"), "Rules write the blackboard of the overlay")
+	assert_equal(match_f.bb_get("hp"), 5, "Value set by a rule of the overlay")
+	assert_equal(match_e.bb_get("hp"), 10, "Other overlay keeps its value")
+	match_e.cleanup()
+	assert_equal(match_f.bb_get("hp"), 5, "Cleanup only empties the blackboard of the overlay")
+	match_f.cleanup()
+
+	# Bulk loaders write to the module of the instance
+	var level_a := Prologot.new()
+	var level_b := Prologot.new()
+	level_a.initialize({"base module": "rules"})
+	level_b.initialize({"base module": "rules"})
+	var csv_path := "user://overlay_spawns.csv"
+	var csv := FileAccess.open(csv_path, FileAccess.WRITE)
+	csv.store_string("x,y\n1,2\n3,4\n")
+	csv.close()
+	assert_equal(level_a.load_csv_facts(csv_path, "spawn"), 2, "Load CSV into an overlay")
+	var grid_a := GridMap.new()
+	var grid_b := GridMap.new()
+	grid_a.set_cell_item(Vector3i(0, 0, 0), 1)
+	grid_b.set_cell_item(Vector3i(5, 0, 5), 2)
+	grid_b.set_cell_item(Vector3i(6, 0, 6), 2)
+	assert_equal(level_a.import_tilemap(grid_a, "level_cell"), 1, "Import a map into an overlay")
+	assert_equal(level_b.import_tilemap(grid_b, "level_cell"), 2, "Import another map into another overlay")
+	assert_equal(level_a.query_all("level_cell(X, Y, Z, I)").size(), 1, "First overlay keeps its cells")
+	assert_equal(level_b.query_all("level_cell(X, Y, Z, I)").size(), 2, "Second overlay keeps its cells")
+	assert_false(level_b.query("spawn(_, _)"), "CSV facts stay in their overlay")
+	grid_b.set_cell_item(Vector3i(5, 0, 5), GridMap.INVALID_CELL_ITEM)
+	assert_equal(level_b.sync_tilemap_cells(grid_b, "level_cell", [Vector3i(5, 0, 5)]), 1, "Sync the cells of an overlay")
+	assert_equal(level_b.query_all("level_cell(X, Y, Z, I)").size(), 1, "Sync retracts in the overlay")
+	assert_true(level_a.query("level_cell(0, 0, 0, 1)"), "Other overlay is untouched")
+	assert_false(prolog.query("current_predicate(level_cell/4)"), "user is not polluted")
+	assert_false(prolog.query("current_predicate(rules:spawn/2)"), "Base module is not polluted")
+	grid_a.free()
+	grid_b.free()
+	level_a.cleanup()
+	level_b.cleanup()
+
+	var broken := Prologot.new()
+	assert_false(broken.initialize({"base module": "no_such_module"}), "Unknown base module is rejected")
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Parallel Calls
+# =============================================================================
+
+func test_parallel_call() -> void:
+	print("\n[Test Suite: Parallel Calls]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	prolog.consult_string("""
+		square(X, Y) :- Y is X * X.
+		positive_root(X, Y) :- X >= 0, Y is sqrt(X).
+		broken(_, _) :- throw(oops).
+	""")
+
+	var rows := []
+	var expected := []
+	for i in range(100):
+		rows.append([i])
+		expected.append(i * i)
+	var out: Dictionary = prolog.parallel_call("square", rows, 4)
+	assert_equal(out["results"], expected, "Results in input order")
+	assert_equal(Array(out["success"]).count(1), 100, "All rows succeeded")
+
+	out = prolog.parallel_call("positive_root", [[4], [-1], [9]])
+	assert_equal(Array(out["success"]), [1, 0, 1], "Failed rows are flagged")
+	assert_equal(out["results"][1], null, "Failed rows have no result")
+	assert_equal(out["results"][2], 3.0, "Other rows keep their results")
+
+	prolog.take_errors()
+	out = prolog.parallel_call("broken", [[1], [2], [3]])
+	assert_equal(Array(out["success"]), [0, 0, 0], "Exceptions fail the row")
+	var errors: Array = prolog.take_errors()
+	assert_equal(errors.size(), 4, "One record per row, then a summary")
+	var goals := []
+	for i in range(3):
+		assert_equal(errors[i]["context"], "parallel_call", "Row context")
+		assert_true(errors[i]["message"].contains("oops"), "Row exception")
+		assert_true(errors[i]["thread"] != OS.get_main_thread_id(),
+			"Tagged with the worker thread")
+		goals.append(errors[i]["goal"])
+	goals.sort()
+	assert_equal(goals, ["broken (row 0)", "broken (row 1)", "broken (row 2)"],
+		"Each row is reported")
+	assert_equal(errors[3]["thread"], OS.get_thread_caller_id(),
+		"Summary on the caller")
+	assert_true(prolog.get_last_error().begins_with("parallel_call: 3 rows"),
+		"Caller gets the count")
+	assert_equal(prolog.parallel_call("square", []).get("results"), [], "No rows")
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Error Records
+# =============================================================================
+func test_error_records() -> void:
+	print("\n[Test Suite: Error Records]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	assert_equal(prolog.get_last_error_info(), {}, "No error yet")
+	prolog.take_errors()
+
+	prolog.consult_string("boom :- throw(oops).")
+	assert_false(prolog.query("boom"), "Raising query fails")
+	var info: Dictionary = prolog.get_last_error_info()
+	assert_equal(info["context"], "Query", "Record has the context")
+	assert_equal(info["goal"], "boom", "Record has the goal")
+	assert_equal(info["type"], "error", "Record has the type")
+	assert_equal(info["message"], prolog.get_last_error(), "Same message")
+	assert_equal(info["thread"], OS.get_thread_caller_id(), "Caller thread")
+
+	prolog.query("")
+	assert_equal(prolog.get_last_error(), "Empty query", "Last error replaced")
+	var errors: Array = prolog.take_errors()
+	assert_equal(errors.size(), 2, "Both errors are queued")
+	assert_equal(errors[0]["context"], "Query", "Oldest first")
+	assert_equal(prolog.take_errors(), [], "Queue drained")
+	assert_equal(prolog.get_last_error(), "Empty query", "Last error kept")
+
+	for i in range(300):
+		prolog.query("")
+	errors = prolog.take_errors()
+	assert_equal(errors.size(), 257, "Queue is bounded")
+	assert_true(errors[0]["message"].begins_with("44 "), "Drop is reported")
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Lazy Exceptions
+# =============================================================================
+func test_lazy_exceptions() -> void:
+	print("\n[Test Suite: Lazy Exceptions]")
+
+	prolog = Prologot.new()
+	if not prolog.initialize({"on error": "status"}):
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	prolog.consult_string("probe(X) :- atom_length(X, foo).")
+	for i in range(1000):
+		prolog.query("probe", [i])
+	var ex: Dictionary = prolog.get_last_exception()
+	assert_equal(ex["kind"], "type_error", "Kind of the ISO error")
+	assert_equal(ex["detail"], "integer", "Expected type")
+	assert_equal(ex["culprit"], "foo", "Culprit")
+	assert_equal(ex["goal"], "probe(999)", "Goal of the last error")
+	assert_true(prolog.get_last_error().begins_with("Query error: "), "Message")
+
+	prolog.query("throw", ["'my ball'"])
+	ex = prolog.get_last_exception()
+	assert_equal(ex["kind"], "throw", "Not an error/2 term")
+	assert_equal(ex["culprit"], "'my ball'", "Thrown term, quoted")
+
+	prolog.query("")
+	assert_equal(prolog.get_last_exception(), {}, "Not an exception")
+	prolog.take_errors()
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Output Capture
+# =============================================================================
+func test_output_capture() -> void:
+	print("\n[Test Suite: Output Capture]")
+
+	prolog = Prologot.new()
+	if not prolog.initialize({"output buffer": 32, "output flush": false}):
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	prolog.consult_string("greet(N) :- format('Hello ~w~n', [N]).")
+	assert_true(prolog.query("greet(world)"), "Query writing output")
+	var text: Dictionary = prolog.take_output()
+	assert_equal(text["output"], "Hello world\n", "Output is captured")
+	assert_equal(text["dropped"], 0, "Nothing dropped")
+	assert_equal(prolog.take_output()["output"], "", "Output is taken once")
+
+	prolog.query("format(user_error, 'oops~n', [])")
+	assert_equal(prolog.take_output()["error"], "oops\n", "Errors apart")
+
+	prolog.query("forall(between(1, 10, I), format('line ~w~n', [I]))")
+	text = prolog.take_output()
+	assert_true(text["output"].length() <= 32, "Buffer is capped")
+	assert_true(text["output"].ends_with("line 10\n"), "Newest text kept")
+	assert_true(text["dropped"] > 0, "Dropped bytes are counted")
+
+	# Each instance takes the output of its own engines, with its own cap
+	var other := Prologot.new()
+	assert_true(other.initialize({"output buffer": 64, "output flush": false,
+		"on warning": "status"}), "Second capturing instance")
+	assert_true(other.get_last_error().contains("already captured"),
+		"Main thread conflict is reported")
+	other.consult_string("shout(X, X) :- format('~w~n', [X]).")
+	var long_text := "abcdefghijklmnopqrstuvwxyz0123456789"
+	other.parallel_call("shout", [[long_text]], 1)
+	assert_equal(prolog.take_output()["output"], "", "Not taken by the first")
+	text = other.take_output()
+	assert_equal(text["output"], long_text + "\n", "Worker output of the second")
+	assert_equal(text["dropped"], 0, "Capped by the second instance option")
+	prolog.query("greet(again)")
+	assert_equal(other.take_output()["output"], "", "Main thread not shared")
+	assert_equal(prolog.take_output()["output"], "Hello again\n",
+		"Main thread output stays with the first instance")
+	other.cleanup()
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Query Cursors
+# =============================================================================
+func test_query_cursors() -> void:
+	print("\n[Test Suite: Query Cursors]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	var cursor: int = prolog.query_open("between(1, 25, X)")
+	assert_true(cursor > 0, "Cursor opened")
+	var page: Array = prolog.query_next(cursor, 10)
+	assert_equal(page.size(), 10, "First page")
+	assert_equal(page[0], prolog.query_all("between(1, 25, X)")[0], "Same format as query_all")
+	var stats: Dictionary = prolog.query_stats(cursor)
+	assert_equal(stats["solutions"], 10, "Solutions counted")
+	assert_false(stats["exhausted"], "More solutions left")
+	assert_true(stats["inferences"] > 0, "Inferences counted")
+
+	# The next page is computed by a worker thread (lambdas capture locals
+	# by value: the page is appended to a shared Array)
+	var fetched := []
+	var task := WorkerThreadPool.add_task(
+		func(): fetched.append_array(prolog.query_next(cursor, 100)))
+	WorkerThreadPool.wait_for_task_completion(task)
+	assert_equal(fetched.size(), 15, "Last page from a worker thread")
+	assert_true(prolog.query_stats(cursor)["exhausted"], "Exhausted")
+	assert_equal(prolog.query_next(cursor, 10), [], "No more solutions")
+	assert_true(prolog.query_close(cursor), "Cursor closed")
+	assert_false(prolog.query_close(cursor), "Closed once")
+	assert_equal(prolog.query_stats(cursor), {}, "Unknown cursor")
+
+	assert_equal(prolog.query_open("foo(("), 0, "Syntax error")
+	prolog.consult_string("boom :- throw(oops).")
+	cursor = prolog.query_open("boom")
+	assert_equal(prolog.query_next(cursor), [], "Raising goal")
+	assert_equal(prolog.get_last_exception()["culprit"], "oops", "Error reported")
+	prolog.query_open("repeat")  # Left open, closed by cleanup()
+
+	teardown_prolog()
+
+
+# =============================================================================
+# Test: Benchmarking
+# =============================================================================
+func test_benchmark() -> void:
+	print("\n[Test Suite: Benchmarking]")
+
+	if not setup_prolog():
+		print("  ✗ SKIP: Could not initialize Prolog")
+		return
+
+	var report: Dictionary = prolog.benchmark("numlist(1, 100, L), length(L, N)", 200, 20)
+	assert_equal(report["iterations"], 200, "Measured calls")
+	assert_equal(report["succeeded"], 200, "All calls succeeded")
+	assert_true(report["p50_usec"] <= report["p99_usec"], "p50 <= p99")
+	assert_true(report["min_usec"] <= report["mean_usec"], "min <= mean")
+	assert_true(report["mean_usec"] <= report["max_usec"], "mean <= max")
+	assert_true(report["inferences_per_call"] > 0, "Inferences counted")
+	assert_true(report["allocated_bytes_per_call"] > 0, "List cells counted")
+
+	assert_equal(prolog.benchmark("fail", 10)["succeeded"], 0, "Failing goal")
+	prolog.consult_string("boom :- throw(oops).")
+	assert_equal(prolog.benchmark("boom", 10), {}, "Raising goal stops")
+	assert_equal(prolog.benchmark("", 10), {}, "Empty goal")
+	assert_equal(prolog.benchmark("true", 10, -1), {}, "Negative warmup")
+
+	# The statistics readings are not counted: the same goal costs the same
+	# number of inferences whatever the number of calls
+	var few: Dictionary = prolog.benchmark("numlist(1, 10, _)", 10, 0)
+	var many: Dictionary = prolog.benchmark("numlist(1, 10, _)", 500, 5)
+	assert_equal(few["inferences_per_call"], many["inferences_per_call"],
+		"Inferences per call do not depend on the iterations")
+
+	# From a worker thread, with a pooled engine
+	var reports := []
+	var task := WorkerThreadPool.add_task(
+		func(): reports.append(prolog.benchmark("true", 50, 0)))
+	WorkerThreadPool.wait_for_task_completion(task)
+	assert_equal(reports[0]["succeeded"], 50, "Benchmark on a worker thread")
+
+	teardown_prolog()
+
+
 # =============================================================================
 # Demo Examples Tests
 # =============================================================================